@@ -1042,9 +1042,7 @@ Packet::Packet(shared_ptr<Device> device,
 					structure->payload)});
 			break;
 		case SR_DF_LOGIC:
-			_payload.reset(new Logic{
-				static_cast<const struct sr_datafeed_logic *>(
-					structure->payload)});
+			_payload.reset(new Logic{structure});
 			break;
 		case SR_DF_ANALOG:
 			_payload.reset(new Analog{
@@ -1133,14 +1131,19 @@ map<const ConfigKey *, Glib::VariantBase> Meta::config() const
 	return result;
 }
 
-Logic::Logic(const struct sr_datafeed_logic *structure) :
+Logic::Logic(const struct sr_datafeed_packet *packet) :
 	PacketPayload(),
-	_structure(structure)
+	_structure(static_cast<const struct sr_datafeed_logic *>(packet->payload)),
+	_buffer(nullptr),
+	_data(nullptr)
 {
+	/* Share the driver's buffer where possible, never copy here. */
+	_buffer = sr_packet_buffer_get(packet, &_data, FALSE);
 }
 
 Logic::~Logic()
 {
+	sr_buffer_unref(_buffer);
 }
 
 shared_ptr<PacketPayload> Logic::share_owned_by(shared_ptr<Packet> _parent)
@@ -1151,7 +1154,7 @@ shared_ptr<PacketPayload> Logic::share_owned_by(shared_ptr<Packet> _parent)
 
 void *Logic::data_pointer()
 {
-	return _structure->data;
+	return _buffer ? _data : _structure->data;
 }
 
 size_t Logic::data_length() const
@@ -750,11 +750,14 @@ public:
 	/* Size of each sample in bytes. */
 	unsigned int unit_size() const;
 private:
-	explicit Logic(const struct sr_datafeed_logic *structure);
+	explicit Logic(const struct sr_datafeed_packet *packet);
 	~Logic();
 	shared_ptr<PacketPayload> share_owned_by(shared_ptr<Packet> parent);
 
 	const struct sr_datafeed_logic *_structure;
+	/* Reference keeping the data alive, if the driver sent a buffer. */
+	struct sr_buffer *_buffer;
+	void *_data;
 
 	friend class Packet;
 };
@@ -170,6 +170,8 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_rle. */
+	SR_DF_LOGIC_RLE,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -463,6 +465,69 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_buffer
+ * Opaque structure representing a reference-counted data buffer.
+ *
+ * @see sr_buffer_new(), sr_buffer_unref(), sr_packet_buffer_get().
+ */
+struct sr_buffer;
+
+/**
+ * @struct sr_buffer_pool
+ * Opaque structure representing a pool of reusable data buffers.
+ *
+ * @see sr_buffer_pool_new(), sr_buffer_pool_get().
+ */
+struct sr_buffer_pool;
+
+/**
+ * Statistics of the asynchronous datafeed bus of a session.
+ *
+ * @see sr_session_async_set(), sr_session_bus_stats_get().
+ */
+struct sr_session_bus_stats {
+	/** Number of packets currently waiting in the queue. */
+	uint64_t queue_depth;
+	/** Highest number of packets seen waiting in the queue. */
+	uint64_t max_queue_depth;
+	/** Number of packets queued since the session was started. */
+	uint64_t queued;
+	/** Number of data packets dropped because the queue was full. */
+	uint64_t dropped;
+	/** Longest time a packet waited in the queue, in microseconds. */
+	uint64_t max_latency;
+};
+
+/**
+ * Events recorded in the trace ring.
+ *
+ * @see sr_trace_set(), sr_trace_record().
+ */
+enum sr_trace_id {
+	/** A packet was sent to the session bus. Packet type, data bytes. */
+	SR_TRACE_SESSION_SEND = 1,
+	/** A USB transfer came back. Transfer status, bytes received. */
+	SR_TRACE_USB_TRANSFER,
+	/** Data was read from a serial port. Bytes read, bytes requested. */
+	SR_TRACE_SERIAL_READ,
+
+	/** First ID free for use by applications. */
+	SR_TRACE_USER = 10000,
+};
+
+/** An event in the trace ring. */
+struct sr_trace_event {
+	/** Monotonic time of the event, in microseconds. */
+	int64_t time;
+	/** Event ID, one of enum sr_trace_id. */
+	uint32_t id;
+	/** Number of the thread which recorded the event, starting at 0. */
+	uint32_t thread;
+	/** Event-specific arguments. */
+	int64_t arg1, arg2;
+};
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -494,6 +559,22 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Run-length encoded logic datafeed payload for type SR_DF_LOGIC_RLE.
+ *
+ * Run i consists of lengths[i] repetitions of the sample at
+ * samples + i * unitsize. Consecutive runs may hold the same sample.
+ *
+ * Unless enabled with sr_session_logic_rle_set(), such packets reach the
+ * datafeed callbacks expanded into SR_DF_LOGIC packets.
+ */
+struct sr_datafeed_logic_rle {
+	uint64_t num_runs;
+	uint16_t unitsize;
+	void *samples;
+	uint64_t *lengths;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG_OLD. */
 struct sr_datafeed_analog_old {
 	/** The channels for which data is included in this packet. */
@@ -576,16 +657,31 @@ struct sr_resource {
 	int type;
 };
 
+/** Flags for sr_input_load_file(). */
+enum sr_input_load_flag {
+	/**
+	 * If set, the file is read into memory rather than mapped, so that
+	 * changes to it while the data is in use can't affect the data.
+	 */
+	SR_INPUT_LOAD_COPY = 0x01,
+};
+
 /** Output module flags. */
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/**
+	 * If set, this output module handles SR_DF_LOGIC_RLE packets.
+	 * Otherwise sr_output_send() expands them into SR_DF_LOGIC packets.
+	 */
+	SR_OUTPUT_LOGIC_RLE = 0x02,
 };
 
 struct sr_input;
 struct sr_input_module;
 struct sr_output;
 struct sr_output_module;
+struct sr_output_sink;
 struct sr_transform;
 struct sr_transform_module;
 
@@ -976,6 +1072,39 @@ enum sr_configkey {
 	/** Over-temperature protection (OTP) active. */
 	SR_CONF_OVER_TEMPERATURE_PROTECTION_ACTIVE,
 
+	/**
+	 * Number of data transfers of the last acquisition which failed,
+	 * timed out or came back empty, so that samples may be missing.
+	 */
+	SR_CONF_OVERRUNS,
+
+	/**
+	 * Number of data transfers of the last acquisition which were
+	 * handled close to their timeout, because the host fell behind.
+	 */
+	SR_CONF_LATE_TRANSFERS,
+
+	/**
+	 * Largest number of samples the host was behind the device during
+	 * the last acquisition.
+	 */
+	SR_CONF_READ_LAG,
+
+	/**
+	 * Send samples as fast as they can be generated, instead of at the
+	 * samplerate.
+	 */
+	SR_CONF_UNPACED,
+
+	/** Size in bytes of the data packets sent to the session bus. */
+	SR_CONF_PACKET_SIZE,
+
+	/**
+	 * Number of samples per second actually sent during the last
+	 * acquisition.
+	 */
+	SR_CONF_ACHIEVED_SAMPLERATE,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Special stuff -------------------------------------------------*/
@@ -1009,6 +1138,13 @@ enum sr_configkey {
 	/** The device supports setting a probe factor. */
 	SR_CONF_PROBE_FACTOR,
 
+	/**
+	 * Number of the first sample to send from the capturefile. Lets
+	 * frontends start in the middle of a capture without reading
+	 * everything before it.
+	 */
+	SR_CONF_CAPTURE_OFFSET,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Acquisition modes, sample limiting ----------------------------*/
@@ -32,6 +32,8 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_to_float_channels(const struct sr_datafeed_analog *analog,
+		float **outbufs);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
 		char **result);
 SR_API void sr_rational_set(struct sr_rational *r, int64_t p, uint64_t q);
@@ -41,6 +43,20 @@ SR_API void sr_rational_set(struct sr_rational *r, int64_t p, uint64_t q);
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+SR_API struct sr_buffer *sr_buffer_new(size_t size);
+SR_API struct sr_buffer *sr_buffer_wrap(void *data, size_t size,
+		GDestroyNotify notify);
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf);
+SR_API void sr_buffer_unref(struct sr_buffer *buf);
+SR_API void *sr_buffer_data(const struct sr_buffer *buf);
+SR_API size_t sr_buffer_size(const struct sr_buffer *buf);
+SR_API struct sr_buffer_pool *sr_buffer_pool_new(size_t buf_size,
+		unsigned int max_free);
+SR_API struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_API void sr_buffer_pool_free(struct sr_buffer_pool *pool);
+
 /*--- log.c -----------------------------------------------------------------*/
 
 typedef int (*sr_log_callback)(void *cb_data, int loglevel,
@@ -51,6 +67,17 @@ SR_API int sr_log_loglevel_get(void);
 SR_API int sr_log_callback_set(sr_log_callback cb, void *cb_data);
 SR_API int sr_log_callback_set_default(void);
 
+/*--- trace.c ---------------------------------------------------------------*/
+
+SR_API int sr_trace_set(gboolean enable);
+SR_API gboolean sr_trace_get(void);
+SR_API void sr_trace_record(uint32_t id, int64_t arg1, int64_t arg2);
+SR_API int sr_trace_events_get(struct sr_trace_event **events,
+		size_t *num_events);
+SR_API void sr_trace_clear(void);
+SR_API int sr_trace_dump(const char *filename);
+SR_API const char *sr_trace_event_name(uint32_t id);
+
 /*--- device.c --------------------------------------------------------------*/
 
 SR_API int sr_dev_channel_name_set(struct sr_channel *channel,
@@ -127,6 +154,16 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_async_set(struct sr_session *session,
+		unsigned int queue_size, gboolean drop);
+SR_API int sr_session_bus_stats_get(struct sr_session *session,
+		struct sr_session_bus_stats *stats);
+SR_API int sr_session_logic_rle_set(struct sr_session *session,
+		gboolean enable);
+SR_API int sr_session_usb_thread_set(struct sr_session *session,
+		gboolean enable);
+SR_API struct sr_buffer *sr_packet_buffer_get(
+		const struct sr_datafeed_packet *packet, void **data, gboolean copy);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -155,6 +192,8 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in);
 SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_load_file(const struct sr_input *in,
+		const char *filename, struct sr_session *session, uint64_t flags);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
 
@@ -174,6 +213,14 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 		const char *filename);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API struct sr_output_sink *sr_output_sink_new(void);
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd);
+SR_API GString *sr_output_sink_buffer_get(struct sr_output_sink *sink);
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink);
+SR_API int sr_output_sink_free(struct sr_output_sink *sink);
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink);
 SR_API int sr_output_free(const struct sr_output *o);
 
 /*--- transform/transform.c -------------------------------------------------*/
@@ -25,6 +25,16 @@
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+/* AVX2 kernels are built with a target attribute, and picked at runtime. */
+#if defined(__SSE2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+	&& (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
 /** @cond PRIVATE */
 #define LOG_PREFIX "analog"
 /** @endcond */
@@ -151,6 +161,381 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/*
+ * Sample conversion kernels, one per sample format. A kernel converts
+ * count contiguous samples to dst[i] = sample * scale + offset.
+ */
+typedef void (*convert_kernel)(const uint8_t *src, float *dst, size_t count,
+		float scale, float offset);
+
+enum {
+	FMT_U8,
+	FMT_S8,
+	FMT_U16LE,
+	FMT_S16LE,
+	FMT_U16BE,
+	FMT_S16BE,
+	FMT_U32LE,
+	FMT_S32LE,
+	FMT_U32BE,
+	FMT_S32BE,
+	FMT_FLOAT_LE,
+	FMT_FLOAT_BE,
+	FMT_DOUBLE_LE,
+	FMT_DOUBLE_BE,
+	NUM_FORMATS,
+};
+
+/* Sample format of an encoding, or -1 if there is no kernel for it. */
+static int encoding_format(const struct sr_analog_encoding *encoding)
+{
+	int be, sgn;
+
+	be = encoding->is_bigendian ? 1 : 0;
+	sgn = encoding->is_signed ? 1 : 0;
+
+	if (encoding->is_float) {
+		switch (encoding->unitsize) {
+		case 4:
+			return FMT_FLOAT_LE + be;
+		case 8:
+			return FMT_DOUBLE_LE + be;
+		}
+		return -1;
+	}
+
+	switch (encoding->unitsize) {
+	case 1:
+		return FMT_U8 + sgn;
+	case 2:
+		return FMT_U16LE + 2 * be + sgn;
+	case 4:
+		return FMT_U32LE + 2 * be + sgn;
+	}
+
+	return -1;
+}
+
+#define RLDBL(x) ((union { uint64_t u; double f; }) { .u = RL64(x) }.f)
+#define RBDBL(x) ((union { uint64_t u; double f; }) { .u = RB64(x) }.f)
+
+#define SCALAR_KERNEL(name, size, read) \
+static void name(const uint8_t *src, float *dst, size_t count, \
+		float scale, float offset) \
+{ \
+	size_t i; \
+\
+	for (i = 0; i < count; i++) \
+		dst[i] = (float)read(src + i * size) * scale + offset; \
+}
+
+#define R8S(x) ((int8_t)R8(x))
+
+SCALAR_KERNEL(scalar_u8, 1, R8)
+SCALAR_KERNEL(scalar_s8, 1, R8S)
+SCALAR_KERNEL(scalar_u16le, 2, RL16)
+SCALAR_KERNEL(scalar_s16le, 2, RL16S)
+SCALAR_KERNEL(scalar_u16be, 2, RB16)
+SCALAR_KERNEL(scalar_s16be, 2, RB16S)
+SCALAR_KERNEL(scalar_u32le, 4, RL32)
+SCALAR_KERNEL(scalar_s32le, 4, RL32S)
+SCALAR_KERNEL(scalar_u32be, 4, RB32)
+SCALAR_KERNEL(scalar_s32be, 4, RB32S)
+SCALAR_KERNEL(scalar_floatle, 4, RLFL)
+SCALAR_KERNEL(scalar_floatbe, 4, RBFL)
+SCALAR_KERNEL(scalar_doublele, 8, RLDBL)
+SCALAR_KERNEL(scalar_doublebe, 8, RBDBL)
+
+static const convert_kernel scalar_kernels[NUM_FORMATS] = {
+	scalar_u8, scalar_s8,
+	scalar_u16le, scalar_s16le, scalar_u16be, scalar_s16be,
+	scalar_u32le, scalar_s32le, scalar_u32be, scalar_s32be,
+	scalar_floatle, scalar_floatbe,
+	scalar_doublele, scalar_doublebe,
+};
+
+#ifdef __SSE2__
+
+/*
+ * The SSE2 kernels widen the samples to 32 bits, convert them 4 at a time
+ * and leave the rest to the scalar kernel. The sign, byte order and unit
+ * size are constants in each kernel, so the branches below fold away.
+ */
+
+static inline __m128i sse2_bswap16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i sse2_bswap32(__m128i v)
+{
+	v = sse2_bswap16(v);
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+/* Unsigned 32-bit to float, in two exact 16-bit halves. */
+static inline __m128 sse2_cvtu32(__m128i v)
+{
+	__m128 hi, lo;
+
+	hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+	lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+
+	return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+}
+
+/* Widen the low or high four 16-bit values to 32 bits. */
+static inline __m128i sse2_widen16(__m128i v, int high, int is_signed)
+{
+	if (is_signed) {
+		v = high ? _mm_unpackhi_epi16(v, v) : _mm_unpacklo_epi16(v, v);
+		return _mm_srai_epi32(v, 16);
+	}
+
+	return high ? _mm_unpackhi_epi16(v, _mm_setzero_si128())
+		: _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+static inline void sse2_store(float *dst, __m128 v, __m128 scale,
+		__m128 offset)
+{
+	_mm_storeu_ps(dst, _mm_add_ps(_mm_mul_ps(v, scale), offset));
+}
+
+static inline void sse2_convert(const uint8_t *src, float *dst, size_t count,
+		float scale, float offset, int size, int is_signed, int is_float,
+		int swap, convert_kernel tail)
+{
+	__m128i v, lo, hi;
+	__m128 vscale, voffset;
+	size_t i;
+
+	vscale = _mm_set1_ps(scale);
+	voffset = _mm_set1_ps(offset);
+
+	i = 0;
+	for (; size == 1 && i + 16 <= count; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(src + i));
+		if (is_signed) {
+			lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+			hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+		} else {
+			lo = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+			hi = _mm_unpackhi_epi8(v, _mm_setzero_si128());
+		}
+		sse2_store(dst + i, _mm_cvtepi32_ps(sse2_widen16(lo, 0, is_signed)),
+				vscale, voffset);
+		sse2_store(dst + i + 4, _mm_cvtepi32_ps(sse2_widen16(lo, 1, is_signed)),
+				vscale, voffset);
+		sse2_store(dst + i + 8, _mm_cvtepi32_ps(sse2_widen16(hi, 0, is_signed)),
+				vscale, voffset);
+		sse2_store(dst + i + 12, _mm_cvtepi32_ps(sse2_widen16(hi, 1, is_signed)),
+				vscale, voffset);
+	}
+
+	for (; size == 2 && i + 8 <= count; i += 8) {
+		v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		if (swap)
+			v = sse2_bswap16(v);
+		sse2_store(dst + i, _mm_cvtepi32_ps(sse2_widen16(v, 0, is_signed)),
+				vscale, voffset);
+		sse2_store(dst + i + 4, _mm_cvtepi32_ps(sse2_widen16(v, 1, is_signed)),
+				vscale, voffset);
+	}
+
+	for (; size == 4 && i + 4 <= count; i += 4) {
+		v = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+		if (swap)
+			v = sse2_bswap32(v);
+		if (is_float)
+			sse2_store(dst + i, _mm_castsi128_ps(v), vscale, voffset);
+		else if (is_signed)
+			sse2_store(dst + i, _mm_cvtepi32_ps(v), vscale, voffset);
+		else
+			sse2_store(dst + i, sse2_cvtu32(v), vscale, voffset);
+	}
+
+	tail(src + i * size, dst + i, count - i, scale, offset);
+}
+
+#define SSE2_KERNEL(name, size, is_signed, is_float, swap, tail) \
+static void name(const uint8_t *src, float *dst, size_t count, \
+		float scale, float offset) \
+{ \
+	sse2_convert(src, dst, count, scale, offset, size, is_signed, \
+			is_float, swap, tail); \
+}
+
+SSE2_KERNEL(sse2_u8, 1, 0, 0, 0, scalar_u8)
+SSE2_KERNEL(sse2_s8, 1, 1, 0, 0, scalar_s8)
+SSE2_KERNEL(sse2_u16le, 2, 0, 0, 0, scalar_u16le)
+SSE2_KERNEL(sse2_s16le, 2, 1, 0, 0, scalar_s16le)
+SSE2_KERNEL(sse2_u16be, 2, 0, 0, 1, scalar_u16be)
+SSE2_KERNEL(sse2_s16be, 2, 1, 0, 1, scalar_s16be)
+SSE2_KERNEL(sse2_u32le, 4, 0, 0, 0, scalar_u32le)
+SSE2_KERNEL(sse2_s32le, 4, 1, 0, 0, scalar_s32le)
+SSE2_KERNEL(sse2_u32be, 4, 0, 0, 1, scalar_u32be)
+SSE2_KERNEL(sse2_s32be, 4, 1, 0, 1, scalar_s32be)
+SSE2_KERNEL(sse2_floatle, 4, 0, 1, 0, scalar_floatle)
+SSE2_KERNEL(sse2_floatbe, 4, 0, 1, 1, scalar_floatbe)
+
+static const convert_kernel sse2_kernels[NUM_FORMATS] = {
+	sse2_u8, sse2_s8,
+	sse2_u16le, sse2_s16le, sse2_u16be, sse2_s16be,
+	sse2_u32le, sse2_s32le, sse2_u32be, sse2_s32be,
+	sse2_floatle, sse2_floatbe,
+	scalar_doublele, scalar_doublebe,
+};
+
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+
+#define AVX2 __attribute__((target("avx2")))
+
+/* Same as the SSE2 kernels, 8 samples at a time. */
+
+AVX2 static inline __m256 avx2_cvtu32(__m256i v)
+{
+	__m256 hi, lo;
+
+	hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+	lo = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)));
+
+	return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+}
+
+AVX2 static inline void avx2_store(float *dst, __m256 v, __m256 scale,
+		__m256 offset)
+{
+	_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_mul_ps(v, scale), offset));
+}
+
+AVX2 static inline void avx2_convert(const uint8_t *src, float *dst,
+		size_t count, float scale, float offset, int size, int is_signed,
+		int is_float, int swap, convert_kernel tail)
+{
+	__m128i v8, v16;
+	__m256i v, bswap32;
+	__m256 vscale, voffset;
+	size_t i;
+
+	vscale = _mm256_set1_ps(scale);
+	voffset = _mm256_set1_ps(offset);
+	bswap32 = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+			11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4,
+			11, 10, 9, 8, 15, 14, 13, 12);
+
+	i = 0;
+	for (; size == 1 && i + 8 <= count; i += 8) {
+		v8 = _mm_loadl_epi64((const __m128i *)(src + i));
+		v = is_signed ? _mm256_cvtepi8_epi32(v8) : _mm256_cvtepu8_epi32(v8);
+		avx2_store(dst + i, _mm256_cvtepi32_ps(v), vscale, voffset);
+	}
+
+	for (; size == 2 && i + 8 <= count; i += 8) {
+		v16 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		if (swap)
+			v16 = _mm_or_si128(_mm_slli_epi16(v16, 8),
+					_mm_srli_epi16(v16, 8));
+		v = is_signed ? _mm256_cvtepi16_epi32(v16) : _mm256_cvtepu16_epi32(v16);
+		avx2_store(dst + i, _mm256_cvtepi32_ps(v), vscale, voffset);
+	}
+
+	for (; size == 4 && i + 8 <= count; i += 8) {
+		v = _mm256_loadu_si256((const __m256i *)(src + 4 * i));
+		if (swap)
+			v = _mm256_shuffle_epi8(v, bswap32);
+		if (is_float)
+			avx2_store(dst + i, _mm256_castsi256_ps(v), vscale, voffset);
+		else if (is_signed)
+			avx2_store(dst + i, _mm256_cvtepi32_ps(v), vscale, voffset);
+		else
+			avx2_store(dst + i, avx2_cvtu32(v), vscale, voffset);
+	}
+
+	tail(src + i * size, dst + i, count - i, scale, offset);
+}
+
+#define AVX2_KERNEL(name, size, is_signed, is_float, swap, tail) \
+AVX2 static void name(const uint8_t *src, float *dst, size_t count, \
+		float scale, float offset) \
+{ \
+	avx2_convert(src, dst, count, scale, offset, size, is_signed, \
+			is_float, swap, tail); \
+}
+
+AVX2_KERNEL(avx2_u8, 1, 0, 0, 0, scalar_u8)
+AVX2_KERNEL(avx2_s8, 1, 1, 0, 0, scalar_s8)
+AVX2_KERNEL(avx2_u16le, 2, 0, 0, 0, scalar_u16le)
+AVX2_KERNEL(avx2_s16le, 2, 1, 0, 0, scalar_s16le)
+AVX2_KERNEL(avx2_u16be, 2, 0, 0, 1, scalar_u16be)
+AVX2_KERNEL(avx2_s16be, 2, 1, 0, 1, scalar_s16be)
+AVX2_KERNEL(avx2_u32le, 4, 0, 0, 0, scalar_u32le)
+AVX2_KERNEL(avx2_s32le, 4, 1, 0, 0, scalar_s32le)
+AVX2_KERNEL(avx2_u32be, 4, 0, 0, 1, scalar_u32be)
+AVX2_KERNEL(avx2_s32be, 4, 1, 0, 1, scalar_s32be)
+AVX2_KERNEL(avx2_floatle, 4, 0, 1, 0, scalar_floatle)
+AVX2_KERNEL(avx2_floatbe, 4, 0, 1, 1, scalar_floatbe)
+
+static const convert_kernel avx2_kernels[NUM_FORMATS] = {
+	avx2_u8, avx2_s8,
+	avx2_u16le, avx2_s16le, avx2_u16be, avx2_s16be,
+	avx2_u32le, avx2_s32le, avx2_u32be, avx2_s32be,
+	avx2_floatle, avx2_floatbe,
+	scalar_doublele, scalar_doublebe,
+};
+
+#endif
+
+#ifdef __SSE2__
+static const convert_kernel *kernels = sse2_kernels;
+#else
+static const convert_kernel *kernels = scalar_kernels;
+#endif
+
+/**
+ * Pick the fastest conversion kernels the CPU supports.
+ *
+ * @private
+ */
+SR_PRIV void sr_analog_kernels_init(void)
+{
+#ifdef HAVE_AVX2_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		sr_dbg("Using AVX2 conversion kernels.");
+		kernels = avx2_kernels;
+	}
+#endif
+}
+
+/* Check the payload, and get its kernel and conversion parameters. */
+static int convert_setup(const struct sr_datafeed_analog *analog,
+		convert_kernel *kernel, float *scale, float *offset)
+{
+	int fmt;
+
+	if (!analog || !(analog->data) || !(analog->meaning)
+			|| !(analog->encoding))
+		return SR_ERR_ARG;
+
+	if ((fmt = encoding_format(analog->encoding)) < 0) {
+		sr_err("Unsupported unit size '%d' for analog-to-float conversion.",
+			analog->encoding->unitsize);
+		return SR_ERR;
+	}
+
+	*kernel = kernels[fmt];
+	*scale = analog->encoding->scale.p / (float)analog->encoding->scale.q;
+	*offset = analog->encoding->offset.p / (float)analog->encoding->offset.q;
+
+	return SR_OK;
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
@@ -171,13 +556,16 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *outbuf)
 {
-	float offset;
-	unsigned int b, i, count;
+	convert_kernel kernel;
+	float scale, offset;
+	unsigned int count;
 	gboolean bigendian;
+	int ret;
 
-	if (!analog || !(analog->data) || !(analog->meaning)
-			|| !(analog->encoding) || !outbuf)
+	if (!outbuf)
 		return SR_ERR_ARG;
+	if ((ret = convert_setup(analog, &kernel, &scale, &offset)) != SR_OK)
+		return ret;
 
 	count = analog->num_samples * g_slist_length(analog->meaning->channels);
 
@@ -186,107 +574,85 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 #else
 	bigendian = FALSE;
 #endif
-	if (!analog->encoding->is_float) {
-		float offset = analog->encoding->offset.p / (float)analog->encoding->offset.q;
-		float scale = analog->encoding->scale.p / (float)analog->encoding->scale.q;
-		gboolean is_signed = analog->encoding->is_signed;
-		gboolean is_bigendian = analog->encoding->is_bigendian;
-		int8_t *data8 = (int8_t *)(analog->data);
-		int16_t *data16 = (int16_t *)(analog->data);
-		int32_t *data32 = (int32_t *)(analog->data);
-
-		switch (analog->encoding->unitsize) {
-		case 1:
-			if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * data8[i];
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * R8(data8 + i);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 2:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 4:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		default:
-			sr_err("Unsupported unit size '%d' for analog-to-float conversion.",
-				analog->encoding->unitsize);
-			return SR_ERR;
-		}
-		return SR_OK;
-	}
-
-	if (analog->encoding->unitsize == sizeof(float)
+	if (analog->encoding->is_float
+			&& analog->encoding->unitsize == sizeof(float)
 			&& analog->encoding->is_bigendian == bigendian
-			&& analog->encoding->scale.p == 1
-			&& analog->encoding->scale.q == 1
-			&& analog->encoding->offset.p / (float)analog->encoding->offset.q == 0) {
+			&& scale == 1 && offset == 0) {
 		/* The data is already in the right format. */
 		memcpy(outbuf, analog->data, count * sizeof(float));
-	} else {
-		for (i = 0; i < count; i += analog->encoding->unitsize) {
-			for (b = 0; b < analog->encoding->unitsize; b++) {
-				if (analog->encoding->is_bigendian == bigendian)
-					((uint8_t *)outbuf)[i + b] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-				else
-					((uint8_t *)outbuf)[i + (analog->encoding->unitsize - b)] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-			}
-			if (analog->encoding->scale.p != 1
-					|| analog->encoding->scale.q != 1)
-				outbuf[i] = (outbuf[i] * analog->encoding->scale.p) / analog->encoding->scale.q;
-			offset = ((float)analog->encoding->offset.p / (float)analog->encoding->offset.q);
-			outbuf[i] += offset;
+		return SR_OK;
+	}
+
+	kernel(analog->data, outbuf, count, scale, offset);
+
+	return SR_OK;
+}
+
+/** @cond PRIVATE */
+#define DEINTERLEAVE_BLOCK 4096
+/** @endcond */
+
+/**
+ * Convert an analog datafeed payload to one array of floats per channel.
+ *
+ * Unlike sr_analog_to_float(), which keeps the samples of several channels
+ * interleaved, this separates them in the same pass.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbufs One buffer of analog->num_samples floats for each
+ *                     channel in analog->meaning->channels, in that order.
+ *                     Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_analog_to_float_channels(const struct sr_datafeed_analog *analog,
+		float **outbufs)
+{
+	convert_kernel kernel;
+	const uint8_t *src;
+	float scale, offset, *block;
+	unsigned int num_channels, frames, n, c, f, i;
+	int ret;
+
+	if (!outbufs)
+		return SR_ERR_ARG;
+	if ((ret = convert_setup(analog, &kernel, &scale, &offset)) != SR_OK)
+		return ret;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (num_channels == 0)
+		return SR_OK;
+	for (c = 0; c < num_channels; c++) {
+		if (!outbufs[c])
+			return SR_ERR_ARG;
+	}
+
+	if (num_channels == 1) {
+		kernel(analog->data, outbufs[0], analog->num_samples,
+				scale, offset);
+		return SR_OK;
+	}
+
+	/* Convert blocks of whole frames, then take the channels apart. */
+	frames = MAX(DEINTERLEAVE_BLOCK / num_channels, 1);
+	block = g_malloc(sizeof(float) * frames * num_channels);
+	src = analog->data;
+	for (f = 0; f < analog->num_samples; f += n) {
+		n = MIN(frames, analog->num_samples - f);
+		kernel(src, block, n * num_channels, scale, offset);
+		src += n * num_channels * analog->encoding->unitsize;
+		for (c = 0; c < num_channels; c++) {
+			for (i = 0; i < n; i++)
+				outbufs[c][f + i] = block[i * num_channels + c];
 		}
 	}
+	g_free(block);
 
 	return SR_OK;
 }
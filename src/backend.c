@@ -525,6 +525,7 @@ SR_API int sr_init(struct sr_context **ctx)
 	}
 #endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
+	sr_analog_kernels_init();
 
 	*ctx = context;
 	context = NULL;
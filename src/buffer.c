@@ -0,0 +1,361 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+/* Alignment of pool buffers, a page on common platforms. */
+#define POOL_BUF_ALIGN 4096
+
+/**
+ * @file
+ *
+ * Reference-counted data buffers and buffer pools.
+ */
+
+/**
+ * @defgroup grp_buffer Data buffers
+ *
+ * Reference-counted data buffers and buffer pools.
+ *
+ * Drivers can send datafeed packets whose sample data lives in an
+ * sr_buffer. Consumers which want to keep the data past their datafeed
+ * callback then take a reference with sr_packet_buffer_get(), instead of
+ * copying it. A buffer pool recycles buffers of a fixed size once their
+ * last reference is dropped. Pool buffers are page aligned, so they
+ * suit DMA and USB transfers.
+ *
+ * @{
+ */
+
+struct sr_buffer {
+	gint refcount;
+	size_t size;
+	void *data;
+	/* Allocation holding the data, which may start further in. */
+	void *alloc;
+	/* Pool the buffer returns to, or NULL. */
+	struct sr_buffer_pool *pool;
+	/* Called on notify_data of a wrapped buffer, or NULL. */
+	GDestroyNotify notify;
+	void *notify_data;
+};
+
+struct sr_buffer_pool {
+	/* One reference for the owner, one per buffer handed out. */
+	gint refcount;
+	GMutex mutex;
+	size_t buf_size;
+	unsigned int max_free;
+	/* Buffers ready for reuse. */
+	GSList *free_list;
+	unsigned int num_free;
+	/* Set by sr_buffer_pool_free(), no more recycling. */
+	gboolean closed;
+};
+
+static void buffer_keep_data(gpointer data)
+{
+	(void)data;
+}
+
+static void buffer_destroy(struct sr_buffer *buf)
+{
+	if (buf->notify)
+		buf->notify(buf->notify_data);
+	else
+		g_free(buf->alloc);
+	g_free(buf);
+}
+
+static struct sr_buffer *pool_buffer_new(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+	uintptr_t addr;
+
+	buf = g_malloc0(sizeof(struct sr_buffer));
+	buf->size = pool->buf_size;
+	buf->alloc = g_malloc(pool->buf_size + POOL_BUF_ALIGN - 1);
+	addr = ((uintptr_t)buf->alloc + POOL_BUF_ALIGN - 1)
+		& ~(uintptr_t)(POOL_BUF_ALIGN - 1);
+	buf->data = (void *)addr;
+	buf->pool = pool;
+
+	return buf;
+}
+
+static void pool_unref(struct sr_buffer_pool *pool)
+{
+	if (!g_atomic_int_dec_and_test(&pool->refcount))
+		return;
+
+	g_slist_free_full(pool->free_list, (GDestroyNotify)buffer_destroy);
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+/**
+ * Allocate a new data buffer.
+ *
+ * @param size Size of the buffer in bytes.
+ *
+ * @return A new buffer with a reference count of 1. Must be released
+ *         with sr_buffer_unref().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer *sr_buffer_new(size_t size)
+{
+	struct sr_buffer *buf;
+
+	buf = g_malloc0(sizeof(struct sr_buffer));
+	buf->refcount = 1;
+	buf->size = size;
+	buf->alloc = buf->data = g_malloc(size);
+
+	return buf;
+}
+
+/**
+ * Wrap existing memory in a data buffer.
+ *
+ * @param data The memory to wrap. Must not be NULL.
+ * @param size Size of the memory in bytes.
+ * @param notify Function to call on @a data once the last reference is
+ *               dropped. May be NULL if the memory outlives the buffer.
+ *
+ * @return A new buffer with a reference count of 1, or NULL if @a data
+ *         is NULL. Must be released with sr_buffer_unref().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer *sr_buffer_wrap(void *data, size_t size,
+		GDestroyNotify notify)
+{
+	return sr_buffer_wrap_full(data, size, notify, data);
+}
+
+/**
+ * Wrap existing memory in a data buffer, with a separate notify argument.
+ *
+ * Like sr_buffer_wrap(), but @a notify is called on @a notify_data. This
+ * lets a driver find out when consumers are done with memory it doesn't
+ * own, such as a mapped kernel buffer.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_wrap_full(void *data, size_t size,
+		GDestroyNotify notify, void *notify_data)
+{
+	struct sr_buffer *buf;
+
+	if (!data)
+		return NULL;
+
+	buf = g_malloc0(sizeof(struct sr_buffer));
+	buf->refcount = 1;
+	buf->size = size;
+	buf->data = data;
+	buf->notify = notify ? notify : buffer_keep_data;
+	buf->notify_data = notify_data;
+
+	return buf;
+}
+
+/**
+ * Take a reference to a data buffer.
+ *
+ * This function may be called from any thread.
+ *
+ * @param buf The buffer. May be NULL.
+ *
+ * @return The buffer that was passed in.
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf)
+{
+	if (buf)
+		g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/**
+ * Drop a reference to a data buffer.
+ *
+ * When the last reference is dropped, the buffer is returned to its pool,
+ * if it came from one, or freed. This function may be called from any
+ * thread.
+ *
+ * @param buf The buffer. May be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_buffer_unref(struct sr_buffer *buf)
+{
+	struct sr_buffer_pool *pool;
+
+	if (!buf || !g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	if (!(pool = buf->pool)) {
+		buffer_destroy(buf);
+		return;
+	}
+
+	g_mutex_lock(&pool->mutex);
+	if (!pool->closed && pool->num_free < pool->max_free) {
+		pool->free_list = g_slist_prepend(pool->free_list, buf);
+		pool->num_free++;
+		buf = NULL;
+	}
+	g_mutex_unlock(&pool->mutex);
+
+	if (buf)
+		buffer_destroy(buf);
+	pool_unref(pool);
+}
+
+/**
+ * Get the data of a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return Pointer to the data, valid while a reference is held.
+ *
+ * @since 0.5.0
+ */
+SR_API void *sr_buffer_data(const struct sr_buffer *buf)
+{
+	return buf ? buf->data : NULL;
+}
+
+/**
+ * Get the size of a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return Size of the buffer in bytes.
+ *
+ * @since 0.5.0
+ */
+SR_API size_t sr_buffer_size(const struct sr_buffer *buf)
+{
+	return buf ? buf->size : 0;
+}
+
+/**
+ * Create a pool of data buffers of a fixed size.
+ *
+ * @param buf_size Size of the buffers in bytes.
+ * @param max_free Maximum number of unused buffers kept for reuse.
+ *
+ * @return A new pool. Must be released with sr_buffer_pool_free().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer_pool *sr_buffer_pool_new(size_t buf_size,
+		unsigned int max_free)
+{
+	struct sr_buffer_pool *pool;
+
+	pool = g_malloc0(sizeof(struct sr_buffer_pool));
+	pool->refcount = 1;
+	g_mutex_init(&pool->mutex);
+	pool->buf_size = buf_size;
+	pool->max_free = max_free;
+
+	return pool;
+}
+
+/**
+ * Get a buffer from a pool.
+ *
+ * Buffers released by their last user are reused, most recently released
+ * first; otherwise a new one is allocated. The data of the buffer is
+ * aligned to 4096 bytes, its contents are undefined. This function may be
+ * called from any thread.
+ *
+ * @param pool The pool. Must not be NULL.
+ *
+ * @return A buffer with a reference count of 1, or NULL on invalid
+ *         arguments. Must be released with sr_buffer_unref().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+
+	if (!pool)
+		return NULL;
+
+	buf = NULL;
+	g_mutex_lock(&pool->mutex);
+	if (pool->free_list) {
+		buf = pool->free_list->data;
+		pool->free_list = g_slist_delete_link(pool->free_list,
+				pool->free_list);
+		pool->num_free--;
+	}
+	g_mutex_unlock(&pool->mutex);
+
+	if (!buf)
+		buf = pool_buffer_new(pool);
+	buf->refcount = 1;
+	g_atomic_int_inc(&pool->refcount);
+
+	return buf;
+}
+
+/**
+ * Release a buffer pool.
+ *
+ * Unused buffers are freed right away. Buffers still in use remain valid,
+ * and are freed when their last reference is dropped.
+ *
+ * @param pool The pool. May be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	GSList *free_list;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->closed = TRUE;
+	free_list = pool->free_list;
+	pool->free_list = NULL;
+	pool->num_free = 0;
+	g_mutex_unlock(&pool->mutex);
+
+	g_slist_free_full(free_list, (GDestroyNotify)buffer_destroy);
+	pool_unref(pool);
+}
+
+/** @} */
@@ -686,45 +686,33 @@ static void sigma_decode_dram_cluster(struct sigma_dram_cluster *dram_cluster,
 	struct dev_context *devc = sdi->priv;
 	struct sigma_state *ss = &devc->state;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
 	uint16_t tsdiff, ts;
-	uint8_t samples[2048];
+	/* get_trigger_offset() looks at one sample more than a cluster has. */
+	uint8_t samples[2 * (EVENTS_PER_CLUSTER + 1)] = { 0 };
+	uint8_t lastsample[2];
 	unsigned int i;
 
 	ts = sigma_dram_cluster_ts(dram_cluster);
 	tsdiff = ts - ss->lastts;
 	ss->lastts = ts;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = 2;
-	logic.data = samples;
-
 	/*
 	 * First of all, send Sigrok a copy of the last sample from
 	 * previous cluster as many times as needed to make up for
 	 * the differential characteristics of data we get from the
-	 * Sigma. Sigrok needs one sample of data per period.
+	 * Sigma. Sigrok needs one sample of data per period, but
+	 * the repetitions are sent as a single run.
 	 *
 	 * One DRAM cluster contains a timestamp and seven samples,
 	 * the units of timestamp are "devc->period_ps" , the first
 	 * sample in the cluster happens at the time of the timestamp
 	 * and the remaining samples happen at timestamp +1...+6 .
 	 */
-	for (ts = 0; ts < tsdiff - (EVENTS_PER_CLUSTER - 1); ts++) {
-		i = ts % 1024;
-		samples[2 * i + 0] = ss->lastsample & 0xff;
-		samples[2 * i + 1] = ss->lastsample >> 8;
-
-		/*
-		 * If we have 1024 samples ready or we're at the
-		 * end of submitting the padding samples, submit
-		 * the packet to Sigrok.
-		 */
-		if ((i == 1023) || (ts == (tsdiff - EVENTS_PER_CLUSTER))) {
-			logic.length = (i + 1) * logic.unitsize;
-			sr_session_send(sdi, &packet);
-		}
+	if (tsdiff > EVENTS_PER_CLUSTER - 1) {
+		lastsample[0] = ss->lastsample & 0xff;
+		lastsample[1] = ss->lastsample >> 8;
+		logic_rle_add(devc->rle, lastsample,
+				tsdiff - (EVENTS_PER_CLUSTER - 1));
 	}
 
 	/*
@@ -749,25 +737,23 @@ static void sigma_decode_dram_cluster(struct sigma_dram_cluster *dram_cluster,
 					ss->lastsample, &devc->trigger);
 
 		if (trigger_offset > 0) {
-			packet.type = SR_DF_LOGIC;
-			logic.length = trigger_offset * logic.unitsize;
-			sr_session_send(sdi, &packet);
+			logic_rle_add_samples(devc->rle, samples,
+					trigger_offset);
 			events_in_cluster -= trigger_offset;
 		}
 
 		/* Only send trigger if explicitly enabled. */
 		if (devc->use_triggers) {
+			logic_rle_flush(devc->rle);
 			packet.type = SR_DF_TRIGGER;
+			packet.payload = NULL;
 			sr_session_send(sdi, &packet);
 		}
 	}
 
-	if (events_in_cluster > 0) {
-		packet.type = SR_DF_LOGIC;
-		logic.length = events_in_cluster * logic.unitsize;
-		logic.data = samples + (trigger_offset * logic.unitsize);
-		sr_session_send(sdi, &packet);
-	}
+	if (events_in_cluster > 0)
+		logic_rle_add_samples(devc->rle,
+				samples + (trigger_offset * 2), events_in_cluster);
 
 	ss->lastsample =
 		samples[2 * (events_in_cluster - 1) + 0] |
@@ -847,6 +833,9 @@ static int download_capture(struct sr_dev_inst *sdi)
 	if (!dram_line)
 		return FALSE;
 
+	/* Long idle periods are sent as single runs, not sample by sample. */
+	devc->rle = logic_rle_new(sdi, 2, 1024);
+
 	sr_info("Downloading sample data.");
 
 	/* Stop acquisition. */
@@ -908,6 +897,9 @@ static int download_capture(struct sr_dev_inst *sdi)
 	}
 
 	/* All done. */
+	logic_rle_flush(devc->rle);
+	logic_rle_free(devc->rle);
+	devc->rle = NULL;
 	packet.type = SR_DF_END;
 	sr_session_send(sdi, &packet);
 
@@ -218,6 +218,8 @@ struct dev_context {
 	struct sigma_trigger trigger;
 	int use_triggers;
 	struct sigma_state state;
+	/* Collects the samples of download_capture() into runs. */
+	struct logic_rle *rle;
 	void *cb_data;
 };
 
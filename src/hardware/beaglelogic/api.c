@@ -37,6 +37,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_NUM_LOGIC_CHANNELS | SR_CONF_GET,
+	SR_CONF_READ_LAG | SR_CONF_GET,
 };
 
 /* Trigger matching capabilities */
@@ -75,9 +76,21 @@ static struct dev_context *beaglelogic_devc_alloc(void)
 	devc->fd = -1;
 	devc->limit_samples = (uint64_t)-1;
 
+	g_mutex_init(&devc->span_mutex);
+	g_cond_init(&devc->span_cond);
+
 	return devc;
 }
 
+static void beaglelogic_devc_free(void *priv)
+{
+	struct dev_context *devc = priv;
+
+	g_mutex_clear(&devc->span_mutex);
+	g_cond_clear(&devc->span_cond);
+	g_free(devc);
+}
+
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
 {
 	struct drv_context *drvc;
@@ -113,7 +126,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc = beaglelogic_devc_alloc();
 
 	if (beaglelogic_open_nonblock(devc) != SR_OK) {
-		g_free(devc);
+		beaglelogic_devc_free(devc);
 		sr_dev_inst_free(sdi);
 
 		return NULL;
@@ -152,7 +165,7 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 
 static int dev_clear(const struct sr_dev_driver *di)
 {
-	return std_dev_clear(di, NULL);
+	return std_dev_clear(di, beaglelogic_devc_free);
 }
 
 static int dev_open(struct sr_dev_inst *sdi)
@@ -192,6 +205,10 @@ static int dev_close(struct sr_dev_inst *sdi)
 	struct dev_context *devc = sdi->priv;
 
 	if (sdi->status == SR_ST_ACTIVE) {
+		/* Sent buffer units point into the mapping */
+		if (!beaglelogic_span_wait(devc, 1000))
+			sr_warn("Capture buffer still in use, unmapping anyway");
+
 		/* Close the memory mapping and the file */
 		beaglelogic_munmap(devc);
 		beaglelogic_close(devc);
@@ -214,7 +231,7 @@ static int cleanup(const struct sr_dev_driver *di)
 	for (l = drvc->instances; l; l = l->next) {
 		sdi = l->data;
 		di->dev_close(sdi);
-		g_free(sdi->priv);
+		beaglelogic_devc_free(sdi->priv);
 		sr_dev_inst_free(sdi);
 	}
 	g_slist_free(drvc->instances);
@@ -243,6 +260,10 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 	case SR_CONF_NUM_LOGIC_CHANNELS:
 		*data = g_variant_new_uint32(g_slist_length(sdi->channels));
 		break;
+	case SR_CONF_READ_LAG:
+		*data = g_variant_new_uint64(devc->max_lag /
+				SAMPLEUNIT_TO_BYTES(devc->sampleunit));
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -268,6 +289,12 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	case SR_CONF_LIMIT_SAMPLES:
 		tmp_u64 = g_variant_get_uint64(data);
 		devc->limit_samples = tmp_u64;
+
+		/* Without a limit, stream until stopped */
+		if (!tmp_u64) {
+			devc->triggerflags = BL_TRIGGERFLAGS_CONTINUOUS;
+			return beaglelogic_set_triggerflags(devc);
+		}
 		devc->triggerflags = BL_TRIGGERFLAGS_ONESHOT;
 
 		/* Check if we have sufficient buffer size */
@@ -353,6 +380,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	/* Clear capture state */
 	devc->bytes_read = 0;
 	devc->offset = 0;
+	devc->unit_pending = FALSE;
+	devc->max_lag = 0;
 
 	/* Configure channels */
 	devc->sampleunit = g_slist_length(sdi->channels) > 8 ?
@@ -362,7 +391,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	/* Configure triggers & send header packet */
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
 		int pre_trigger_samples = 0;
-		if (devc->limit_samples > 0)
+		if (devc->limit_samples > 0 && devc->limit_samples != (uint64_t)-1)
 			pre_trigger_samples = devc->capture_ratio * devc->limit_samples/100;
 		devc->stl = soft_trigger_logic_new(sdi, trigger, pre_trigger_samples);
 		if (!devc->stl)
@@ -394,6 +423,9 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 	/* Execute a stop on BeagleLogic */
 	beaglelogic_stop(devc);
 
+	/* The session may still hold the last buffer unit sent */
+	devc->unit_pending = FALSE;
+
 	/* lseek to offset 0, flushes the cache */
 	lseek(devc->fd, 0, SEEK_SET);
 
@@ -27,6 +27,159 @@
  * from the BeagleLogic kernel module */
 #define PACKET_SIZE	(512 * 1024)
 
+/* Longest wait for the session to release a buffer unit, per callback */
+#define SPAN_WAIT_MS	100
+
+/* Called when the last reference to a sent buffer unit is dropped. This
+ * may happen in the thread of the asynchronous datafeed bus. */
+static void span_released(void *data)
+{
+	struct dev_context *devc = data;
+
+	g_mutex_lock(&devc->span_mutex);
+	devc->span_held = FALSE;
+	g_cond_signal(&devc->span_cond);
+	g_mutex_unlock(&devc->span_mutex);
+}
+
+/* Wait up to timeout_ms for the session to release the last buffer unit
+ * sent. Returns TRUE if it is released. */
+SR_PRIV gboolean beaglelogic_span_wait(struct dev_context *devc, int timeout_ms)
+{
+	gint64 end_time;
+	gboolean held;
+
+	end_time = g_get_monotonic_time() + timeout_ms * G_TIME_SPAN_MILLISECOND;
+	g_mutex_lock(&devc->span_mutex);
+	while (devc->span_held) {
+		if (!g_cond_wait_until(&devc->span_cond, &devc->span_mutex,
+				end_time))
+			break;
+	}
+	held = devc->span_held;
+	g_mutex_unlock(&devc->span_mutex);
+
+	return !held;
+}
+
+/* Check if the buffer unit at the read position has been filled */
+static gboolean unit_ready(struct dev_context *devc)
+{
+	GPollFD pollfd;
+
+	pollfd.fd = devc->fd;
+	pollfd.events = G_IO_IN;
+	pollfd.revents = 0;
+
+	return g_poll(&pollfd, 1, 0) == 1 && (pollfd.revents & G_IO_IN);
+}
+
+/* Hand the buffer unit at the read position back to the kernel, once the
+ * session is done with it. Returns FALSE if it is still referenced. */
+static gboolean unit_return(struct dev_context *devc, int timeout_ms)
+{
+	if (!devc->unit_pending)
+		return TRUE;
+	if (!beaglelogic_span_wait(devc, timeout_ms))
+		return FALSE;
+
+	lseek(devc->fd, devc->bufunitsize, SEEK_CUR);
+	if ((devc->offset += devc->bufunitsize) >= devc->buffersize)
+		devc->offset = 0;
+	devc->unit_pending = FALSE;
+
+	return TRUE;
+}
+
+/* Send the buffer unit at the read position, without copying it */
+static void unit_send(struct dev_context *devc, uint64_t bytes_remaining)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_buffer *buf;
+	int trigger_offset, pre_trigger_samples;
+
+	devc->unit_pending = TRUE;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	logic.data = devc->sample_buf + devc->offset;
+	logic.length = MIN(devc->bufunitsize, bytes_remaining);
+
+	if (!devc->trigger_fired) {
+		trigger_offset = soft_trigger_logic_check(devc->stl,
+				logic.data, logic.length, &pre_trigger_samples);
+		if (trigger_offset == -1)
+			return;
+		devc->bytes_read += pre_trigger_samples * logic.unitsize;
+		trigger_offset *= logic.unitsize;
+		logic.length = MIN(logic.length - trigger_offset,
+				bytes_remaining);
+		logic.data += trigger_offset;
+		devc->trigger_fired = TRUE;
+	}
+
+	g_mutex_lock(&devc->span_mutex);
+	devc->span_held = TRUE;
+	g_mutex_unlock(&devc->span_mutex);
+
+	buf = sr_buffer_wrap_full(logic.data, logic.length, span_released, devc);
+	sr_session_send_buffer(devc->cb_data, &packet, buf);
+	sr_buffer_unref(buf);
+
+	devc->bytes_read += logic.length;
+}
+
+/* Continuous streaming: every filled buffer unit goes to the session bus
+ * as one packet, straight from the mmap'ed kernel buffer. The read position
+ * only moves past a unit once all references to it are dropped, so the
+ * kernel never hands it back to the PRU while it is still in use. */
+static int receive_stream(const struct sr_dev_inst *sdi,
+		struct dev_context *devc, int revents)
+{
+	struct sr_datafeed_packet packet;
+	uint64_t limit_bytes, lag;
+	uint32_t unitsize, num_units, n;
+	gboolean ready;
+
+	unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	limit_bytes = G_MAXUINT64;
+	if (devc->limit_samples && devc->limit_samples != (uint64_t)-1)
+		limit_bytes = devc->limit_samples * unitsize;
+
+	ready = revents == G_IO_IN;
+	if (devc->unit_pending) {
+		/* The session still had the last unit, wait a bit for it. */
+		if (!unit_return(devc, SPAN_WAIT_MS))
+			return TRUE;
+		ready = unit_ready(devc);
+	}
+
+	/* Each unit that is ready at once is one more the PRU is ahead. */
+	num_units = devc->buffersize / devc->bufunitsize;
+	lag = 0;
+	for (n = 0; ready && n < num_units && devc->bytes_read < limit_bytes; n++) {
+		unit_send(devc, limit_bytes - devc->bytes_read);
+		lag += devc->bufunitsize;
+		if (!unit_return(devc, 0))
+			break;
+		ready = unit_ready(devc);
+	}
+	devc->max_lag = MAX(devc->max_lag, lag);
+
+	if (devc->bytes_read >= limit_bytes) {
+		/* Send EOA Packet, stop polling */
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		sr_session_send(devc->cb_data, &packet);
+
+		sr_session_source_remove_pollfd(sdi->session, &devc->pollfd);
+	}
+
+	return TRUE;
+}
+
 /* This implementation is zero copy from the libsigrok side.
  * It does not copy any data, just passes a pointer from the mmap'ed
  * kernel buffers appropriately. It is up to the application which is
@@ -47,6 +200,9 @@ SR_PRIV int beaglelogic_receive_data(int fd, int revents, void *cb_data)
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
+	if (devc->triggerflags)
+		return receive_stream(sdi, devc, revents);
+
 	packetsize = PACKET_SIZE;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
 
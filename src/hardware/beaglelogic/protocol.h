@@ -59,6 +59,16 @@ struct dev_context {
 	uint32_t offset;
 	uint8_t *sample_buf;	/* mmap'd kernel buffer here */
 
+	/*
+	 * Continuous streaming: the buffer unit at the read position is
+	 * handed back to the kernel once the session is done with it.
+	 */
+	gboolean unit_pending;
+	GMutex span_mutex;
+	GCond span_cond;
+	gboolean span_held;
+	uint64_t max_lag;	/* In bytes */
+
 	void *cb_data;
 
 	/* Trigger logic */
@@ -66,6 +76,7 @@ struct dev_context {
 	gboolean trigger_fired;
 };
 
+SR_PRIV gboolean beaglelogic_span_wait(struct dev_context *devc, int timeout_ms);
 SR_PRIV int beaglelogic_receive_data(int fd, int revents, void *cb_data);
 
 #endif
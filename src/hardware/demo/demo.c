@@ -33,8 +33,14 @@
 #define DEFAULT_NUM_LOGIC_CHANNELS     8
 #define DEFAULT_NUM_ANALOG_CHANNELS    4
 
-/* The size in bytes of chunks to send through the session bus. */
+/* The default size in bytes of chunks to send through the session bus. */
 #define LOGIC_BUFSIZE        4096
+/* Largest chunk size which can be configured. */
+#define MAX_LOGIC_BUFSIZE    (64 * 1024 * 1024)
+/* Minimum size in bytes of the table of a periodic logic pattern. */
+#define LOGIC_TABLE_SIZE     4096
+/* Number of logic chunks sent per callback when running unpaced. */
+#define UNPACED_CHUNKS       16
 /* Size of the analog pattern space per channel. */
 #define ANALOG_BUFSIZE       4096
 
@@ -117,7 +123,19 @@ struct dev_context {
 	unsigned int logic_unitsize;
 	/* There is only ever one logic channel group, so its pattern goes here. */
 	uint8_t logic_pattern;
-	unsigned char logic_data[LOGIC_BUFSIZE];
+	/* Whole periods of the sigrok and incremental patterns, to copy from. */
+	uint8_t *logic_table;
+	uint64_t logic_table_units;
+	/* State of the pseudo-random pattern generator. */
+	uint64_t prng_state;
+	/* Size in bytes of the logic chunks. */
+	uint64_t logic_bufsize;
+	/* Buffers for the logic data, shared with the session bus. */
+	struct sr_buffer_pool *logic_pool;
+	/* Send samples as fast as possible, not at the samplerate. */
+	gboolean unpaced;
+	/* Samples per second actually sent by the last acquisition. */
+	uint64_t achieved_samplerate;
 	/* Analog */
 	int32_t num_analog_channels;
 	GHashTable *ch_ag;
@@ -143,6 +161,9 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_AVERAGING | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_UNPACED | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_PACKET_SIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_ACHIEVED_SAMPLERATE | SR_CONF_GET,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -257,6 +278,49 @@ static void generate_analog_pattern(struct analog_gen *ag, uint64_t sample_rate)
 	}
 }
 
+/*
+ * Fill the table of the sigrok and incremental patterns with as many whole
+ * periods as make up LOGIC_TABLE_SIZE bytes. The generator then copies
+ * runs of samples from it.
+ */
+static void logic_table_init(struct dev_context *devc)
+{
+	uint64_t period, i;
+	unsigned int j, unitsize;
+	uint8_t *p;
+
+	g_free(devc->logic_table);
+	devc->logic_table = NULL;
+	devc->logic_table_units = 0;
+	if (devc->logic_unitsize == 0)
+		return;
+
+	switch (devc->logic_pattern) {
+	case PATTERN_SIGROK:
+		period = sizeof(pattern_sigrok);
+		break;
+	case PATTERN_INC:
+		period = 256;
+		break;
+	default:
+		return;
+	}
+
+	unitsize = devc->logic_unitsize;
+	devc->logic_table_units = period
+		* ((LOGIC_TABLE_SIZE + period * unitsize - 1) / (period * unitsize));
+	devc->logic_table = g_malloc(devc->logic_table_units * unitsize);
+	p = devc->logic_table;
+	for (i = 0; i < devc->logic_table_units; i++) {
+		for (j = 0; j < unitsize; j++) {
+			if (devc->logic_pattern == PATTERN_SIGROK)
+				*p++ = ~(pattern_sigrok[(i + j) % period] >> 1);
+			else
+				*p++ = i;
+		}
+	}
+}
+
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
 {
 	struct drv_context *drvc;
@@ -298,6 +362,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->num_logic_channels = num_logic_channels;
 	devc->logic_unitsize = (devc->num_logic_channels + 7) / 8;
 	devc->logic_pattern = PATTERN_SIGROK;
+	devc->logic_bufsize = LOGIC_BUFSIZE;
+	logic_table_init(devc);
 	devc->num_analog_channels = num_analog_channels;
 
 	/* Logic channels, all in one channel group. */
@@ -386,6 +452,7 @@ static void clear_helper(void *priv)
 	while (g_hash_table_iter_next(&iter, NULL, &value))
 		g_free(value);
 	g_hash_table_unref(devc->ch_ag);
+	g_free(devc->logic_table);
 	g_free(devc);
 }
 
@@ -422,6 +489,15 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 	case SR_CONF_AVG_SAMPLES:
 		*data = g_variant_new_uint64(devc->avg_samples);
 		break;
+	case SR_CONF_UNPACED:
+		*data = g_variant_new_boolean(devc->unpaced);
+		break;
+	case SR_CONF_PACKET_SIZE:
+		*data = g_variant_new_uint64(devc->logic_bufsize);
+		break;
+	case SR_CONF_ACHIEVED_SAMPLERATE:
+		*data = g_variant_new_uint64(devc->achieved_samplerate);
+		break;
 	case SR_CONF_PATTERN_MODE:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -463,6 +539,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	GSList *l;
 	int logic_pattern, analog_pattern, ret;
 	unsigned int i;
+	uint64_t tmp_u64;
 	const char *stropt;
 
 	devc = sdi->priv;
@@ -491,6 +568,15 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 		devc->avg_samples = g_variant_get_uint64(data);
 		sr_dbg("Setting averaging rate to %" PRIu64, devc->avg_samples);
 		break;
+	case SR_CONF_UNPACED:
+		devc->unpaced = g_variant_get_boolean(data);
+		break;
+	case SR_CONF_PACKET_SIZE:
+		tmp_u64 = g_variant_get_uint64(data);
+		if (tmp_u64 == 0 || tmp_u64 > MAX_LOGIC_BUFSIZE)
+			return SR_ERR_ARG;
+		devc->logic_bufsize = tmp_u64;
+		break;
 	case SR_CONF_PATTERN_MODE:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -518,11 +604,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 				sr_dbg("Setting logic pattern to %s",
 						logic_pattern_str[logic_pattern]);
 				devc->logic_pattern = logic_pattern;
-				/* Might as well do this now, these are static. */
-				if (logic_pattern == PATTERN_ALL_LOW)
-					memset(devc->logic_data, 0x00, LOGIC_BUFSIZE);
-				else if (logic_pattern == PATTERN_ALL_HIGH)
-					memset(devc->logic_data, 0xff, LOGIC_BUFSIZE);
+				logic_table_init(devc);
 			} else if (ch->type == SR_CHANNEL_ANALOG) {
 				if (analog_pattern == -1)
 					return SR_ERR_ARG;
@@ -633,40 +715,45 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 	return SR_OK;
 }
 
-static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
+static void logic_generator(struct sr_dev_inst *sdi, uint8_t *logic_data,
+		uint64_t size)
 {
 	struct dev_context *devc;
-	uint64_t i, j;
-	uint8_t pat;
+	uint64_t i, pos, n, x, r;
+	unsigned int unitsize;
 
 	devc = sdi->priv;
+	unitsize = devc->logic_unitsize;
 
 	switch (devc->logic_pattern) {
 	case PATTERN_SIGROK:
-		memset(devc->logic_data, 0x00, size);
-		for (i = 0; i < size; i += devc->logic_unitsize) {
-			for (j = 0; j < devc->logic_unitsize; j++) {
-				pat = pattern_sigrok[(devc->step + j) % sizeof(pattern_sigrok)] >> 1;
-				devc->logic_data[i + j] = ~pat;
-			}
-			devc->step++;
+	case PATTERN_INC:
+		for (i = 0; i < size; i += n * unitsize) {
+			pos = devc->step % devc->logic_table_units;
+			n = MIN((size - i) / unitsize,
+					devc->logic_table_units - pos);
+			memcpy(logic_data + i, devc->logic_table + pos * unitsize,
+					n * unitsize);
+			devc->step += n;
 		}
 		break;
 	case PATTERN_RANDOM:
-		for (i = 0; i < size; i++)
-			devc->logic_data[i] = (uint8_t)(rand() & 0xff);
-		break;
-	case PATTERN_INC:
-		for (i = 0; i < size; i++) {
-			for (j = 0; j < devc->logic_unitsize; j++) {
-				devc->logic_data[i + j] = devc->step;
-			}
-			devc->step++;
+		/* xorshift64*, eight bytes at a time. */
+		x = devc->prng_state;
+		for (i = 0; i < size; i += 8) {
+			x ^= x >> 12;
+			x ^= x << 25;
+			x ^= x >> 27;
+			r = x * 0x2545f4914f6cdd1dULL;
+			memcpy(logic_data + i, &r, MIN(8, size - i));
 		}
+		devc->prng_state = x;
 		break;
 	case PATTERN_ALL_LOW:
+		memset(logic_data, 0x00, size);
+		break;
 	case PATTERN_ALL_HIGH:
-		/* These were set when the pattern mode was selected. */
+		memset(logic_data, 0xff, size);
 		break;
 	default:
 		sr_err("Unknown pattern: %d.", devc->logic_pattern);
@@ -741,10 +828,12 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_buffer *logic_buf;
 	struct analog_gen *ag;
 	GHashTableIter iter;
 	void *value;
 	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
+	uint64_t samples_per_chunk;
 	int64_t elapsed_us, limit_us, todo_us;
 
 	(void)fd;
@@ -761,6 +850,8 @@ static int prepare_data(int fd, int revents, void *cb_data)
 		return G_SOURCE_CONTINUE;
 	}
 
+	samples_per_chunk = MAX(1, devc->logic_bufsize / devc->logic_unitsize);
+
 	/* What time span should we send samples for? */
 	elapsed_us = g_get_monotonic_time() - devc->start_us;
 	limit_us = 1000 * devc->limit_msec;
@@ -769,9 +860,16 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	else
 		todo_us = MAX(0, elapsed_us - devc->spent_us);
 
-	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+	if (devc->unpaced) {
+		/* A few chunks per round, until the time limit is reached. */
+		samples_todo = 0;
+		if (limit_us == 0 || elapsed_us < limit_us)
+			samples_todo = UNPACED_CHUNKS * samples_per_chunk;
+	} else {
+		/* How many samples are outstanding since the last round? */
+		samples_todo = (todo_us * devc->cur_samplerate
+				+ G_USEC_PER_SEC - 1) / G_USEC_PER_SEC;
+	}
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
 			samples_todo = 0;
@@ -782,23 +880,28 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	 * count, rounded towards zero. This avoids getting stuck on a too-low
 	 * time delta with no samples being sent due to round-off.
 	 */
-	todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
+	if (!devc->unpaced)
+		todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
 
 	logic_done = 0;
-	analog_done = 0;
+	/* Without analog channels, there is no analog data to wait for. */
+	analog_done = devc->num_analog_channels > 0 ? 0 : samples_todo;
 
 	while (logic_done < samples_todo || analog_done < samples_todo) {
 		/* Logic */
 		if (logic_done < samples_todo) {
 			sending_now = MIN(samples_todo - logic_done,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+					samples_per_chunk);
+			logic_buf = sr_buffer_pool_get(devc->logic_pool);
+			logic_generator(sdi, sr_buffer_data(logic_buf),
+					sending_now * devc->logic_unitsize);
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
 			logic.length = sending_now * devc->logic_unitsize;
 			logic.unitsize = devc->logic_unitsize;
-			logic.data = devc->logic_data;
-			sr_session_send(sdi, &packet);
+			logic.data = sr_buffer_data(logic_buf);
+			sr_session_send_buffer(sdi, &packet, logic_buf);
+			sr_buffer_unref(logic_buf);
 			logic_done += sending_now;
 		}
 
@@ -860,12 +963,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 
 	devc = sdi->priv;
 	devc->sent_samples = 0;
+	devc->achieved_samplerate = 0;
+	devc->prng_state = 0x2545f4914f6cdd1dULL;
+	devc->logic_pool = sr_buffer_pool_new(MAX(devc->logic_bufsize,
+			devc->logic_unitsize), 16);
 
 	g_hash_table_iter_init(&iter, devc->ch_ag);
 	while (g_hash_table_iter_next(&iter, NULL, &value))
 		generate_analog_pattern(value, devc->cur_samplerate);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	sr_session_source_add(sdi->session, -1, 0, devc->unpaced ? 0 : 100,
 			prepare_data, (struct sr_dev_inst *)sdi);
 
 	/* Send header packet to the session bus. */
@@ -880,18 +987,33 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
+	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
+	int64_t elapsed_us;
 
 	(void)cb_data;
 
 	sr_dbg("Stopping acquisition.");
 
+	devc = sdi->priv;
 	sr_session_source_remove(sdi->session, -1);
 
+	elapsed_us = g_get_monotonic_time() - devc->start_us;
+	if (elapsed_us > 0)
+		devc->achieved_samplerate = (double)devc->sent_samples
+				* G_USEC_PER_SEC / elapsed_us;
+	sr_info("Sent %" PRIu64 " samples in %.3f s, %" PRIu64
+			" samples/s.", devc->sent_samples,
+			elapsed_us / 1e6, devc->achieved_samplerate);
+
 	/* Send last packet. */
 	packet.type = SR_DF_END;
 	sr_session_send(sdi, &packet);
 
+	/* Buffers still held by consumers remain valid. */
+	sr_buffer_pool_free(devc->logic_pool);
+	devc->logic_pool = NULL;
+
 	return SR_OK;
 }
 
@@ -131,6 +131,8 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_OVERRUNS | SR_CONF_GET,
+	SR_CONF_LATE_TRANSFERS | SR_CONF_GET,
 };
 
 static const char *channel_names[] = {
@@ -188,7 +190,16 @@ SR_PRIV struct sr_dev_driver fx2lafw_driver_info;
 
 static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
 {
-	return std_init(sr_ctx, di, LOG_PREFIX);
+	struct drv_context *drvc;
+	int ret;
+
+	if ((ret = std_init(sr_ctx, di, LOG_PREFIX)) != SR_OK)
+		return ret;
+
+	drvc = di->context;
+	drvc->usb_event_thread = TRUE;
+
+	return SR_OK;
 }
 
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
@@ -459,11 +470,16 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
 	struct sr_usb_dev_inst *usb;
+	struct dev_context *devc;
 
 	usb = sdi->conn;
+	devc = sdi->priv;
 	if (!usb->devhdl)
 		return SR_ERR;
 
+	sr_buffer_pool_free(devc->buffer_pool);
+	devc->buffer_pool = NULL;
+
 	sr_info("fx2lafw: Closing device on %d.%d (logical) / %s (physical) interface %d.",
 		usb->bus, usb->address, sdi->connection_id, USB_INTERFACE);
 	libusb_release_interface(usb->devhdl, USB_INTERFACE);
@@ -474,6 +490,16 @@ static int dev_close(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static void clear_helper(void *priv)
+{
+	struct dev_context *devc;
+
+	devc = priv;
+
+	sr_buffer_pool_free(devc->buffer_pool);
+	g_free(devc);
+}
+
 static int cleanup(const struct sr_dev_driver *di)
 {
 	int ret;
@@ -482,7 +508,7 @@ static int cleanup(const struct sr_dev_driver *di)
 	if (!(drvc = di->context))
 		return SR_OK;
 
-	ret = std_dev_clear(di, NULL);
+	ret = std_dev_clear(di, clear_helper);
 
 	g_free(drvc);
 
@@ -524,6 +550,12 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_OVERRUNS:
+		*data = g_variant_new_uint64(devc->num_overruns);
+		break;
+	case SR_CONF_LATE_TRANSFERS:
+		*data = g_variant_new_uint64(devc->num_late_transfers);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -639,16 +671,11 @@ static int receive_data(int fd, int revents, void *cb_data)
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
 	unsigned int i, num_transfers;
-	int endpoint, timeout, ret;
-	unsigned char *buf;
 	size_t size;
 
 	devc = sdi->priv;
-	usb = sdi->conn;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
@@ -668,35 +695,45 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	num_transfers = fx2lafw_get_number_of_transfers(devc);
 	size = fx2lafw_get_buffer_size(devc);
 	devc->submitted_transfers = 0;
-
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
+	devc->num_transfers = 0;
+	devc->num_overruns = 0;
+	devc->num_late_transfers = 0;
+
+	/* Leave room for the queue to grow. */
+	devc->transfers = g_try_malloc0(
+			sizeof(*devc->transfers) * NUM_MAX_TRANSFERS);
+	devc->transfer_buffers = g_try_malloc0(
+			sizeof(*devc->transfer_buffers) * NUM_MAX_TRANSFERS);
+	devc->submit_times = g_try_malloc0(
+			sizeof(*devc->submit_times) * NUM_MAX_TRANSFERS);
+	if (!devc->transfers || !devc->transfer_buffers || !devc->submit_times) {
 		sr_err("USB transfers malloc failed.");
+		g_free(devc->transfers);
+		g_free(devc->transfer_buffers);
+		g_free(devc->submit_times);
 		return SR_ERR_MALLOC;
 	}
 
-	timeout = fx2lafw_get_timeout(devc);
-	endpoint = devc->dslogic ? 6 : 2;
-	devc->num_transfers = num_transfers;
+	/*
+	 * The pool keeps its page aligned buffers for the next acquisition,
+	 * unless the samplerate changed their size. Spare buffers replace
+	 * those still held by datafeed consumers.
+	 */
+	if (devc->buffer_pool && devc->pool_buf_size != size) {
+		sr_buffer_pool_free(devc->buffer_pool);
+		devc->buffer_pool = NULL;
+	}
+	if (!devc->buffer_pool) {
+		devc->buffer_pool = sr_buffer_pool_new(size, NUM_MAX_TRANSFERS);
+		devc->pool_buf_size = size;
+	}
+
+	devc->timeout = fx2lafw_get_timeout(devc);
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				endpoint | LIBUSB_ENDPOINT_IN, buf, size,
-				fx2lafw_receive_transfer, (void *)sdi, timeout);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
+		if (fx2lafw_add_transfer(sdi) != SR_OK) {
 			fx2lafw_abort_acquisition(devc);
 			return SR_ERR;
 		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
 	}
 
 	/* Send header packet to the session bus. */
@@ -748,7 +785,7 @@ static int dslogic_trigger_request(const struct sr_dev_inst *sdi)
 	libusb_fill_bulk_transfer(transfer, usb->devhdl, 6 | LIBUSB_ENDPOINT_IN,
 			(unsigned char *)tpos, sizeof(struct dslogic_trigger_pos),
 			dslogic_trigger_receive, (void *)sdi, 0);
-	if ((ret = libusb_submit_transfer(transfer)) < 0) {
+	if ((ret = usb_submit_transfer(sdi->session, transfer)) < 0) {
 		sr_err("Failed to request trigger: %s.", libusb_error_name(ret));
 		libusb_free_transfer(transfer);
 		g_free(tpos);
@@ -337,6 +337,14 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	g_free(devc->transfer_buffers);
+	g_free(devc->submit_times);
+	devc->transfer_buffers = NULL;
+	devc->submit_times = NULL;
+
+	if (devc->num_overruns > 0)
+		sr_warn("%" PRIu64 " transfers failed or timed out, samples "
+			"may be missing.", devc->num_overruns);
 
 	if (devc->stl) {
 		soft_trigger_logic_free(devc->stl);
@@ -344,36 +352,88 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	}
 }
 
+static int transfer_index(struct dev_context *devc,
+		struct libusb_transfer *transfer)
+{
+	unsigned int i;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (devc->transfers[i] == transfer)
+			return i;
+	}
+
+	return -1;
+}
+
 static void free_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	unsigned int i;
+	int i;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	if ((i = transfer_index(devc, transfer)) >= 0) {
+		devc->transfers[i] = NULL;
+		sr_buffer_unref(devc->transfer_buffers[i]);
+		devc->transfer_buffers[i] = NULL;
+	}
+
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
-			break;
-		}
-	}
-
 	devc->submitted_transfers--;
 	if (devc->submitted_transfers == 0)
 		finish_acquisition(sdi);
 }
 
+/* Returns the buffer a transfer receives into. */
+static struct sr_buffer *transfer_buffer(struct dev_context *devc,
+		struct libusb_transfer *transfer)
+{
+	int i;
+
+	if ((i = transfer_index(devc, transfer)) < 0)
+		return NULL;
+
+	return devc->transfer_buffers[i];
+}
+
+/*
+ * Datafeed consumers may still hold the data just sent, so have the
+ * transfer continue in another buffer. Unless a consumer kept it, the
+ * old buffer goes back to the pool and is handed out again right away.
+ */
+static void swap_transfer_buffer(struct dev_context *devc,
+		struct libusb_transfer *transfer)
+{
+	struct sr_buffer *buf;
+	int i;
+
+	if ((i = transfer_index(devc, transfer)) < 0)
+		return;
+
+	sr_buffer_unref(devc->transfer_buffers[i]);
+	buf = sr_buffer_pool_get(devc->buffer_pool);
+	devc->transfer_buffers[i] = buf;
+	transfer->buffer = sr_buffer_data(buf);
+}
+
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
-	int ret;
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	int i, ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	if ((i = transfer_index(devc, transfer)) >= 0)
+		devc->submit_times[i] = g_get_monotonic_time();
+	transfer->timeout = devc->timeout;
+
+	if ((ret = usb_submit_transfer(sdi->session, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
@@ -381,6 +441,103 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
+/**
+ * Allocate a transfer with a buffer from the pool, and submit it.
+ *
+ * @param sdi The device instance. devc->timeout must be set.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The queue is full, or the transfer couldn't be submitted.
+ */
+SR_PRIV int fx2lafw_add_transfer(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	struct sr_buffer *buf;
+	unsigned int i;
+	int endpoint, ret;
+
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	if (devc->num_transfers >= NUM_MAX_TRANSFERS)
+		return SR_ERR;
+
+	endpoint = devc->dslogic ? 6 : 2;
+	buf = sr_buffer_pool_get(devc->buffer_pool);
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, usb->devhdl,
+			endpoint | LIBUSB_ENDPOINT_IN, sr_buffer_data(buf),
+			sr_buffer_size(buf), fx2lafw_receive_transfer,
+			(void *)sdi, devc->timeout);
+	if ((ret = usb_submit_transfer(sdi->session, transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.", libusb_error_name(ret));
+		libusb_free_transfer(transfer);
+		sr_buffer_unref(buf);
+		return SR_ERR;
+	}
+
+	i = devc->num_transfers++;
+	devc->transfers[i] = transfer;
+	devc->transfer_buffers[i] = buf;
+	devc->submit_times[i] = g_get_monotonic_time();
+	devc->submitted_transfers++;
+
+	return SR_OK;
+}
+
+static unsigned int queue_span(struct dev_context *devc,
+		unsigned int num_transfers);
+static unsigned int queue_timeout(struct dev_context *devc,
+		unsigned int num_transfers);
+
+/*
+ * A transfer completes once its buffer is full, so with the queue kept
+ * full its latency is about the span of the queue, the time all its
+ * transfers take to fill. Anything on top is the time the completion
+ * waited to be handled, during which the queue drains. The device runs
+ * out of buffer space once that delay reaches the whole span.
+ *
+ * A delay of half the span counts as late: the span starts out at 300
+ * to 500 ms, while scheduling jitter is a few ms. Give the device more
+ * room then: grow the queue by a quarter, and raise the timeout to
+ * match. The timeout doesn't get in the way, the device completed the
+ * transfer in time.
+ */
+static void check_latency(const struct sr_dev_inst *sdi,
+		struct libusb_transfer *transfer)
+{
+	struct dev_context *devc;
+	unsigned int n, span;
+	int64_t latency;
+	int i;
+
+	devc = sdi->priv;
+
+	if ((i = transfer_index(devc, transfer)) < 0)
+		return;
+
+	latency = (g_get_monotonic_time() - devc->submit_times[i]) / 1000;
+	span = queue_span(devc, devc->submitted_transfers);
+	if (latency < span + span / 2)
+		return;
+
+	devc->num_late_transfers++;
+	if (devc->num_transfers >= NUM_MAX_TRANSFERS)
+		return;
+
+	n = MAX(devc->submitted_transfers / 4, 1);
+	n = MIN(n, NUM_MAX_TRANSFERS - devc->num_transfers);
+	devc->timeout = queue_timeout(devc, devc->submitted_transfers + n);
+	sr_dbg("Transfer took %" PRIi64 " ms, adding %u transfers, timeout "
+		"now %u ms.", latency, n, devc->timeout);
+	while (n--) {
+		if (fx2lafw_add_transfer(sdi) != SR_OK)
+			break;
+	}
+}
+
 SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -391,6 +548,7 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize;
 	int pre_trigger_samples;
+	gboolean data_sent = FALSE;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
@@ -404,6 +562,8 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 		return;
 	}
 
+	sr_trace(SR_TRACE_USB_TRANSFER, transfer->status,
+		transfer->actual_length);
 	sr_dbg("receive_transfer(): status %s received %d bytes.",
 		libusb_error_name(transfer->status), transfer->actual_length);
 
@@ -417,6 +577,8 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 		free_transfer(transfer);
 		return;
 	case LIBUSB_TRANSFER_COMPLETED:
+		check_latency(sdi, transfer);
+		break;
 	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
 		break;
 	default:
@@ -424,6 +586,10 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 		break;
 	}
 
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED
+			|| transfer->actual_length == 0)
+		devc->num_overruns++;
+
 	if (transfer->actual_length == 0 || packet_has_error) {
 		devc->empty_transfer_count++;
 		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
@@ -453,8 +619,10 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 			logic.length = num_samples * unitsize;
 			logic.unitsize = unitsize;
 			logic.data = transfer->buffer;
-			sr_session_send(devc->cb_data, &packet);
+			sr_session_send_buffer(devc->cb_data, &packet,
+					transfer_buffer(devc, transfer));
 			devc->sent_samples += num_samples;
+			data_sent = TRUE;
 		}
 	} else {
 		trigger_offset = soft_trigger_logic_check(devc->stl,
@@ -470,8 +638,10 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 			logic.length = num_samples * unitsize;
 			logic.unitsize = unitsize;
 			logic.data = transfer->buffer + trigger_offset * unitsize;
-			sr_session_send(devc->cb_data, &packet);
+			sr_session_send_buffer(devc->cb_data, &packet,
+					transfer_buffer(devc, transfer));
 			devc->sent_samples += num_samples;
+			data_sent = TRUE;
 
 			devc->trigger_fired = TRUE;
 		}
@@ -480,8 +650,11 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
 		fx2lafw_abort_acquisition(devc);
 		free_transfer(transfer);
-	} else
+	} else {
+		if (data_sent)
+			swap_transfer_buffer(devc, transfer);
 		resubmit_transfer(transfer);
+	}
 }
 
 static unsigned int to_bytes_per_ms(unsigned int samplerate)
@@ -515,13 +688,26 @@ SR_PRIV unsigned int fx2lafw_get_number_of_transfers(struct dev_context *devc)
 	return n;
 }
 
-SR_PRIV unsigned int fx2lafw_get_timeout(struct dev_context *devc)
+/* Time in ms for num_transfers transfers to fill. */
+static unsigned int queue_span(struct dev_context *devc,
+		unsigned int num_transfers)
 {
 	size_t total_size;
+
+	total_size = fx2lafw_get_buffer_size(devc) * num_transfers;
+	return total_size / to_bytes_per_ms(devc->cur_samplerate);
+}
+
+static unsigned int queue_timeout(struct dev_context *devc,
+		unsigned int num_transfers)
+{
 	unsigned int timeout;
 
-	total_size = fx2lafw_get_buffer_size(devc) *
-			fx2lafw_get_number_of_transfers(devc);
-	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
+	timeout = queue_span(devc, num_transfers);
 	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
 }
+
+SR_PRIV unsigned int fx2lafw_get_timeout(struct dev_context *devc)
+{
+	return queue_timeout(devc, fx2lafw_get_number_of_transfers(devc));
+}
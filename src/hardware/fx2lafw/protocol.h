@@ -37,6 +37,8 @@
 
 #define MAX_RENUM_DELAY_MS	3000
 #define NUM_SIMUL_TRANSFERS	32
+/* Upper limit for the transfer queue when it grows under load. */
+#define NUM_MAX_TRANSFERS	128
 #define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
 
 #define FX2LAFW_REQUIRED_VERSION_MAJOR	1
@@ -115,8 +117,21 @@ struct dev_context {
 	int empty_transfer_count;
 
 	void *cb_data;
+	/* Used slots of the transfer arrays, at most NUM_MAX_TRANSFERS. */
 	unsigned int num_transfers;
+	/* Timeout of the transfers in ms, grows with the queue. */
+	unsigned int timeout;
 	struct libusb_transfer **transfers;
+	/* Buffers of the transfers, shared with the session bus. */
+	struct sr_buffer **transfer_buffers;
+	/* When the transfers were submitted, in monotonic time (us). */
+	int64_t *submit_times;
+	/* Kept across acquisitions while the buffer size stays the same. */
+	struct sr_buffer_pool *buffer_pool;
+	size_t pool_buf_size;
+	/* Statistics of the last acquisition. */
+	uint64_t num_overruns;
+	uint64_t num_late_transfers;
 	struct sr_context *ctx;
 
 	/* Is this a DSLogic? */
@@ -131,6 +146,7 @@ SR_PRIV gboolean match_manuf_prod(libusb_device *dev, const char *manufacturer,
 SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di);
 SR_PRIV struct dev_context *fx2lafw_dev_new(void);
 SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc);
+SR_PRIV int fx2lafw_add_transfer(const struct sr_dev_inst *sdi);
 SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transfer);
 SR_PRIV size_t fx2lafw_get_buffer_size(struct dev_context *devc);
 SR_PRIV unsigned int fx2lafw_get_number_of_transfers(struct dev_context *devc);
@@ -259,6 +259,11 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 
 	sr_scpi_source_remove(sdi->session, scpi);
 
+	if (devc->block) {
+		g_byte_array_free(devc->block, TRUE);
+		devc->block = NULL;
+	}
+
 	return SR_OK;
 }
 
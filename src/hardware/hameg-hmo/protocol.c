@@ -386,30 +386,36 @@ static int digital_channel_state_get(struct sr_scpi_dev_inst *scpi,
 				     const struct scope_config *config,
 				     struct scope_state *state)
 {
-	unsigned int i;
-	char command[MAX_COMMAND_SIZE];
-
-	for (i = 0; i < config->digital_channels; i++) {
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_DIG_CHAN_STATE],
-			   i);
-
-		if (sr_scpi_get_bool(scpi, command,
-				     &state->digital_channels[i]) != SR_OK)
-			return SR_ERR;
-	}
-
-	for (i = 0; i < config->digital_pods; i++) {
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_DIG_POD_STATE],
-			   i + 1);
-
-		if (sr_scpi_get_bool(scpi, command,
-				     &state->digital_pods[i]) != SR_OK)
-			return SR_ERR;
-	}
-
-	return SR_OK;
+	unsigned int i, num_commands;
+	char **commands, **responses;
+	int ret;
+
+	/* Query the channels and pods all at once. */
+	num_commands = config->digital_channels + config->digital_pods;
+	commands = g_malloc0_n(num_commands + 1, sizeof(char *));
+	responses = g_malloc0_n(num_commands + 1, sizeof(char *));
+
+	for (i = 0; i < config->digital_channels; i++)
+		commands[i] = g_strdup_printf(
+			(*config->scpi_dialect)[SCPI_CMD_GET_DIG_CHAN_STATE], i);
+	for (i = 0; i < config->digital_pods; i++)
+		commands[config->digital_channels + i] = g_strdup_printf(
+			(*config->scpi_dialect)[SCPI_CMD_GET_DIG_POD_STATE], i + 1);
+
+	ret = sr_scpi_get_strings(scpi, (const char *const *)commands,
+			num_commands, responses);
+
+	for (i = 0; i < config->digital_channels && ret == SR_OK; i++)
+		ret = sr_scpi_parse_bool(responses[i],
+				&state->digital_channels[i]);
+	for (i = 0; i < config->digital_pods && ret == SR_OK; i++)
+		ret = sr_scpi_parse_bool(responses[config->digital_channels + i],
+				&state->digital_pods[i]);
+
+	g_strfreev(commands);
+	g_strfreev(responses);
+
+	return ret == SR_OK ? SR_OK : SR_ERR;
 }
 
 SR_PRIV int hmo_update_sample_rate(const struct sr_dev_inst *sdi)
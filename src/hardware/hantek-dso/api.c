@@ -256,7 +256,16 @@ static int dev_clear(const struct sr_dev_driver *di)
 
 static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
 {
-	return std_init(sr_ctx, di, LOG_PREFIX);
+	struct drv_context *drvc;
+	int ret;
+
+	if ((ret = std_init(sr_ctx, di, LOG_PREFIX)) != SR_OK)
+		return ret;
+
+	drvc = di->context;
+	drvc->usb_event_thread = TRUE;
+
+	return SR_OK;
 }
 
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
@@ -75,7 +75,16 @@ SR_PRIV struct sr_dev_driver lecroy_logicstudio_driver_info;
 
 static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
 {
-	return std_init(sr_ctx, di, LOG_PREFIX);
+	struct drv_context *drvc;
+	int ret;
+
+	if ((ret = std_init(sr_ctx, di, LOG_PREFIX)) != SR_OK)
+		return ret;
+
+	drvc = di->context;
+	drvc->usb_event_thread = TRUE;
+
+	return SR_OK;
 }
 
 static struct sr_dev_inst *create_device(struct sr_dev_driver *di,
@@ -519,13 +528,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 
 	drvc = sdi->driver->context;
 
-	if ((ret = lls_start_acquisition(sdi)) < 0)
+	/* Transfers must be submitted after the event source is in place. */
+	ret = usb_source_add(sdi->session, drvc->sr_ctx, 100,
+		receive_usb_data, drvc);
+	if (ret != SR_OK)
 		return ret;
 
+	if ((ret = lls_start_acquisition(sdi)) < 0) {
+		usb_source_remove(sdi->session, drvc->sr_ctx);
+		return ret;
+	}
+
 	std_session_send_df_header(cb_data, LOG_PREFIX);
 
-	return usb_source_add(sdi->session, drvc->sr_ctx, 100,
-		receive_usb_data, drvc);
+	return SR_OK;
 }
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
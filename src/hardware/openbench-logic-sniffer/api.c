@@ -471,7 +471,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	uint16_t samplecount, readcount, delaycount;
 	uint8_t ols_changrp_mask, arg[4];
 	int num_ols_changrp;
-	int ret, i;
+	int ret, i, flags;
 
 	if (sdi->status != SR_ST_ACTIVE)
 		return SR_ERR_DEV_CLOSED;
@@ -560,15 +560,24 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	if (send_longcommand(serial, CMD_SET_FLAGS, arg) != SR_OK)
 		return SR_ERR;
 
+	/* Reset all operational states. */
+	devc->num_transfers = 0;
+	flags = 0;
+	if (devc->flag_reg & FLAG_RLE)
+		/* Keep the runs as received, don't expand them. */
+		flags |= OLS_DECODER_RLE | OLS_DECODER_RUNS;
+	if (devc->flag_reg & FLAG_DEMUX)
+		flags |= OLS_DECODER_DEMUX;
+	ret = ols_decoder_init(&devc->decoder, (devc->flag_reg >> 2) & 0x0f,
+			flags, devc->limit_samples);
+	if (ret != SR_OK)
+		return ret;
+
 	/* Start acquisition on the device. */
-	if (send_shortcommand(serial, CMD_RUN) != SR_OK)
+	if (send_shortcommand(serial, CMD_RUN) != SR_OK) {
+		ols_decoder_clear(&devc->decoder);
 		return SR_ERR;
-
-	/* Reset all operational states. */
-	devc->rle_count = devc->num_transfers = 0;
-	devc->num_samples = devc->num_bytes = 0;
-	devc->cnt_bytes = devc->cnt_samples = devc->cnt_samples_rle = 0;
-	memset(devc->sample, 0, 4);
+	}
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(cb_data, LOG_PREFIX);
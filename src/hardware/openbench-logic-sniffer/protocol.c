@@ -315,17 +315,64 @@ SR_PRIV int ols_set_samplerate(const struct sr_dev_inst *sdi,
 
 SR_PRIV void abort_acquisition(const struct sr_dev_inst *sdi)
 {
+	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 	struct sr_serial_dev_inst *serial;
 
+	devc = sdi->priv;
 	serial = sdi->conn;
 	serial_source_remove(sdi->session, serial);
+	ols_decoder_clear(&devc->decoder);
 
 	/* Terminate session */
 	packet.type = SR_DF_END;
 	sr_session_send(sdi, &packet);
 }
 
+/*
+ * Send the runs of an RLE mode acquisition as SR_DF_LOGIC_RLE packets,
+ * with the trigger in between.
+ */
+static void send_runs(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct logic_rle *rle;
+	const uint8_t *samples;
+	const uint64_t *lengths;
+	uint64_t pos, trigger_at, n;
+	gboolean trigger_pending;
+	guint i;
+
+	devc = sdi->priv;
+	samples = (const uint8_t *)devc->decoder.run_samples->data;
+	lengths = (const uint64_t *)devc->decoder.run_lengths->data;
+	trigger_pending = devc->trigger_at != -1;
+	trigger_at = trigger_pending ? devc->trigger_at : 0;
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+
+	rle = logic_rle_new(sdi, 4, 4096);
+	pos = 0;
+	/* The OLS sends its sample buffer backwards. */
+	for (i = devc->decoder.run_lengths->len; i-- > 0; ) {
+		n = 0;
+		if (trigger_pending && pos + lengths[i] > trigger_at) {
+			n = trigger_at - pos;
+			logic_rle_add(rle, samples + i * 4, n);
+			logic_rle_flush(rle);
+			sr_session_send(sdi, &packet);
+			trigger_pending = FALSE;
+		}
+		logic_rle_add(rle, samples + i * 4, lengths[i] - n);
+		pos += lengths[i];
+	}
+	logic_rle_flush(rle);
+	if (trigger_pending)
+		sr_session_send(sdi, &packet);
+	logic_rle_free(rle);
+}
+
 SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 {
 	struct dev_context *devc;
@@ -333,178 +380,89 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	struct sr_serial_dev_inst *serial;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint32_t sample;
-	int num_ols_changrp, offset, j;
-	unsigned int i;
-	unsigned char byte;
+	struct ols_decoder *dec;
+	uint8_t *buf;
+	size_t len;
+	int ret;
 
 	(void)fd;
 
 	sdi = cb_data;
 	serial = sdi->conn;
 	devc = sdi->priv;
+	dec = &devc->decoder;
 
 	if (devc->num_transfers == 0 && revents == 0) {
 		/* Ignore timeouts as long as we haven't received anything */
 		return TRUE;
 	}
-
-	if (devc->num_transfers++ == 0) {
-		devc->raw_sample_buf = g_try_malloc(devc->limit_samples * 4);
-		if (!devc->raw_sample_buf) {
-			sr_err("Sample buffer malloc failed.");
-			return FALSE;
-		}
-		/* fill with 1010... for debugging */
-		memset(devc->raw_sample_buf, 0x82, devc->limit_samples * 4);
-	}
-
-	num_ols_changrp = 0;
-	for (i = NUM_CHANNELS; i > 0x02; i /= 2) {
-		if ((devc->flag_reg & i) == 0) {
-			num_ols_changrp++;
-		}
-	}
-
-	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
-		if (serial_read_nonblocking(serial, &byte, 1) != 1)
-			return FALSE;
-		devc->cnt_bytes++;
-
-		/* Ignore it if we've read enough. */
-		if (devc->num_samples >= devc->limit_samples)
+	devc->num_transfers++;
+
+	if (revents == G_IO_IN && dec->num_samples < dec->limit_samples) {
+		/* Drain everything the port has, then decode it in one go. */
+		do {
+			buf = ols_decoder_write_ptr(dec, &len);
+			ret = serial_read_nonblocking(serial, buf, len);
+			sr_trace(SR_TRACE_SERIAL_READ, ret, len);
+			if (ret < 0)
+				return FALSE;
+			ols_decoder_commit(dec, ret);
+			ols_decoder_decode(dec);
+		} while ((size_t)ret == len
+				&& dec->num_samples < dec->limit_samples);
+
+		if (dec->num_samples < dec->limit_samples)
 			return TRUE;
+	}
 
-		devc->sample[devc->num_bytes++] = byte;
-		sr_spew("Received byte 0x%.2x.", byte);
-		if (devc->num_bytes == num_ols_changrp) {
-			devc->cnt_samples++;
-			devc->cnt_samples_rle++;
-			/*
-			 * Got a full sample. Convert from the OLS's little-endian
-			 * sample to the local format.
-			 */
-			sample = devc->sample[0] | (devc->sample[1] << 8) \
-					| (devc->sample[2] << 16) | (devc->sample[3] << 24);
-			sr_dbg("Received sample 0x%.*x.", devc->num_bytes * 2, sample);
-			if (devc->flag_reg & FLAG_RLE) {
-				/*
-				 * In RLE mode the high bit of the sample is the
-				 * "count" flag, meaning this sample is the number
-				 * of times the previous sample occurred.
-				 */
-				if (devc->sample[devc->num_bytes - 1] & 0x80) {
-					/* Clear the high bit. */
-					sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
-					devc->rle_count = sample;
-					devc->cnt_samples_rle += devc->rle_count;
-					sr_dbg("RLE count: %u.", devc->rle_count);
-					devc->num_bytes = 0;
-					return TRUE;
-				}
-			}
-			devc->num_samples += devc->rle_count + 1;
-			if (devc->num_samples > devc->limit_samples) {
-				/* Save us from overrunning the buffer. */
-				devc->rle_count -= devc->num_samples - devc->limit_samples;
-				devc->num_samples = devc->limit_samples;
-			}
-
-			if (num_ols_changrp < 4) {
-				/*
-				 * Some channel groups may have been turned
-				 * off, to speed up transfer between the
-				 * hardware and the PC. Expand that here before
-				 * submitting it over the session bus --
-				 * whatever is listening on the bus will be
-				 * expecting a full 32-bit sample, based on
-				 * the number of channels.
-				 */
-				j = 0;
-				memset(devc->tmp_sample, 0, 4);
-				for (i = 0; i < 4; i++) {
-					if (((devc->flag_reg >> 2) & (1 << i)) == 0) {
-						/*
-						 * This channel group was
-						 * enabled, copy from received
-						 * sample.
-						 */
-						devc->tmp_sample[i] = devc->sample[j++];
-					} else if (devc->flag_reg & FLAG_DEMUX && (i > 2)) {
-						/* group 2 & 3 get added to 0 & 1 */
-						devc->tmp_sample[i - 2] = devc->sample[j++];
-					}
-				}
-				memcpy(devc->sample, devc->tmp_sample, 4);
-				sr_spew("Expanded sample: 0x%.8x.", sample);
-			}
-
-			/*
-			 * the OLS sends its sample buffer backwards.
-			 * store it in reverse order here, so we can dump
-			 * this on the session bus later.
-			 */
-			offset = (devc->limit_samples - devc->num_samples) * 4;
-			for (i = 0; i <= devc->rle_count; i++) {
-				memcpy(devc->raw_sample_buf + offset + (i * 4),
-				       devc->sample, 4);
-			}
-			memset(devc->sample, 0, 4);
-			devc->num_bytes = 0;
-			devc->rle_count = 0;
-		}
-	} else {
+	/*
+	 * This is the main loop telling us a timeout was reached, or
+	 * we've acquired all the samples we asked for -- we're done.
+	 * Send the (properly-ordered) buffer to the frontend.
+	 */
+	sr_dbg("Received %" PRIu64 " bytes, %" PRIu64 " samples, %" PRIu64
+			" decompressed samples.", dec->cnt_bytes,
+			dec->cnt_samples, dec->cnt_samples_rle);
+	if (devc->flag_reg & FLAG_RLE) {
+		send_runs(sdi);
+	} else if (devc->trigger_at != -1) {
 		/*
-		 * This is the main loop telling us a timeout was reached, or
-		 * we've acquired all the samples we asked for -- we're done.
-		 * Send the (properly-ordered) buffer to the frontend.
+		 * A trigger was set up, so we need to tell the frontend
+		 * about it.
 		 */
-		sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
-				devc->cnt_bytes, devc->cnt_samples,
-				devc->cnt_samples_rle);
-		if (devc->trigger_at != -1) {
-			/*
-			 * A trigger was set up, so we need to tell the frontend
-			 * about it.
-			 */
-			if (devc->trigger_at > 0) {
-				/* There are pre-trigger samples, send those first. */
-				packet.type = SR_DF_LOGIC;
-				packet.payload = &logic;
-				logic.length = devc->trigger_at * 4;
-				logic.unitsize = 4;
-				logic.data = devc->raw_sample_buf +
-					(devc->limit_samples - devc->num_samples) * 4;
-				sr_session_send(cb_data, &packet);
-			}
-
-			/* Send the trigger. */
-			packet.type = SR_DF_TRIGGER;
-			sr_session_send(cb_data, &packet);
-
-			/* Send post-trigger samples. */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = (devc->num_samples * 4) - (devc->trigger_at * 4);
-			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf + devc->trigger_at * 4 +
-				(devc->limit_samples - devc->num_samples) * 4;
-			sr_session_send(cb_data, &packet);
-		} else {
-			/* no trigger was used */
+		if (devc->trigger_at > 0) {
+			/* There are pre-trigger samples, send those first. */
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
-			logic.length = devc->num_samples * 4;
+			logic.length = devc->trigger_at * 4;
 			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf +
-				(devc->limit_samples - devc->num_samples) * 4;
+			logic.data = ols_decoder_samples(dec);
 			sr_session_send(cb_data, &packet);
 		}
-		g_free(devc->raw_sample_buf);
 
-		serial_flush(serial);
-		abort_acquisition(sdi);
+		/* Send the trigger. */
+		packet.type = SR_DF_TRIGGER;
+		sr_session_send(cb_data, &packet);
+
+		/* Send post-trigger samples. */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = (dec->num_samples * 4) - (devc->trigger_at * 4);
+		logic.unitsize = 4;
+		logic.data = ols_decoder_samples(dec) + devc->trigger_at * 4;
+		sr_session_send(cb_data, &packet);
+	} else {
+		/* no trigger was used */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = dec->num_samples * 4;
+		logic.unitsize = 4;
+		logic.data = ols_decoder_samples(dec);
+		sr_session_send(cb_data, &packet);
 	}
 
+	serial_flush(serial);
+	abort_acquisition(sdi);
+
 	return TRUE;
 }
@@ -88,17 +88,7 @@ struct dev_context {
 
 	/* Operational states */
 	unsigned int num_transfers;
-	unsigned int num_samples;
-	int num_bytes;
-	int cnt_bytes;
-	int cnt_samples;
-	int cnt_samples_rle;
-
-	/* Temporary variables */
-	unsigned int rle_count;
-	unsigned char sample[4];
-	unsigned char tmp_sample[4];
-	unsigned char *raw_sample_buf;
+	struct ols_decoder decoder;
 };
 
 SR_PRIV extern const char *ols_channel_names[];
@@ -543,7 +543,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	uint8_t pols_changrp_mask, arg[4];
 	uint16_t flag_tmp;
 	int num_pols_changrp, samplespercount;
-	int ret, i;
+	int ret, i, flags;
 
 	if (sdi->status != SR_ST_ACTIVE)
 		return SR_ERR_DEV_CLOSED;
@@ -679,15 +679,25 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	if (write_longcommand(devc, CMD_SET_FLAGS, arg) != SR_OK)
 		return SR_ERR;
 
+	/* Reset all operational states. */
+	devc->num_transfers = 0;
+	flags = 0;
+	if (devc->flag_reg & FLAG_RLE) {
+		flags |= OLS_DECODER_RLE;
+		/* In demux mode the RLE encoder works on pairs of samples. */
+		if (devc->flag_reg & FLAG_DEMUX)
+			flags |= OLS_DECODER_PAIRS;
+	}
+	ret = ols_decoder_init(&devc->decoder, (devc->flag_reg >> 2) & 0x0f,
+			flags, devc->limit_samples);
+	if (ret != SR_OK)
+		return ret;
+
 	/* Start acquisition on the device. */
-	if (write_shortcommand(devc, CMD_RUN) != SR_OK)
+	if (write_shortcommand(devc, CMD_RUN) != SR_OK) {
+		ols_decoder_clear(&devc->decoder);
 		return SR_ERR;
-
-	/* Reset all operational states. */
-	devc->rle_count = devc->num_transfers = 0;
-	devc->num_samples = devc->num_bytes = 0;
-	devc->cnt_bytes = devc->cnt_samples = devc->cnt_samples_rle = 0;
-	memset(devc->sample, 0, 4);
+	}
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(cb_data, LOG_PREFIX);
@@ -714,6 +724,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 	write_shortcommand(devc, CMD_RESET);
 
 	sr_session_source_remove(sdi->session, -1);
+	ols_decoder_clear(&devc->decoder);
 
 	/* Send end packet to the session bus. */
 	sr_dbg("Sending SR_DF_END.");
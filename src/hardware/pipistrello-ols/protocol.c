@@ -391,292 +391,88 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 	struct sr_dev_inst *sdi;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint32_t sample;
-	int num_channels, offset, j;
-	int bytes_read, index;
-	unsigned int i;
-	unsigned char byte;
+	struct ols_decoder *dec;
+	uint8_t *buf;
+	size_t len;
+	int bytes_read;
 
 	(void)fd;
 	(void)revents;
 
 	sdi = cb_data;
 	devc = sdi->priv;
+	dec = &devc->decoder;
+	devc->num_transfers++;
 
-	if (devc->num_transfers++ == 0) {
-		devc->raw_sample_buf = g_try_malloc(devc->limit_samples * 4);
-		if (!devc->raw_sample_buf) {
-			sr_err("Sample buffer malloc failed.");
-			return FALSE;
-		}
-		/* fill with 1010... for debugging */
-		memset(devc->raw_sample_buf, 0x82, devc->limit_samples * 4);
-	}
-
-	if ((devc->num_samples < devc->limit_samples) && (devc->cnt_samples < devc->max_samples)) {
-
-		num_channels = 0;
-		for (i = NUM_CHANNELS; i > 0x02; i /= 2) {
-			if ((devc->flag_reg & i) == 0) {
-				num_channels++;
+	if ((dec->num_samples < dec->limit_samples) && (dec->cnt_samples < devc->max_samples)) {
+		/* Read everything the FTDI has, then decode it in one go. */
+		do {
+			buf = ols_decoder_write_ptr(dec, &len);
+			bytes_read = ftdi_read_data(devc->ftdic, buf, len);
+			if (bytes_read < 0) {
+				sr_err("Failed to read FTDI data (%d): %s.",
+				       bytes_read, ftdi_get_error_string(devc->ftdic));
+				sdi->driver->dev_acquisition_stop(sdi, sdi);
+				return FALSE;
 			}
-		}
+			ols_decoder_commit(dec, bytes_read);
+			ols_decoder_decode(dec);
+		} while ((size_t)bytes_read == len
+				&& dec->num_samples < dec->limit_samples);
 
-		/* Get a block of data. */
-		bytes_read = ftdi_read_data(devc->ftdic, devc->ftdi_buf, FTDI_BUF_SIZE);
-		if (bytes_read < 0) {
-			sr_err("Failed to read FTDI data (%d): %s.",
-			       bytes_read, ftdi_get_error_string(devc->ftdic));
-			sdi->driver->dev_acquisition_stop(sdi, sdi);
-			return FALSE;
-		}
-		if (bytes_read == 0) {
-			sr_spew("Received 0 bytes, nothing to do.");
+		if (dec->num_samples < dec->limit_samples
+				&& dec->cnt_samples < devc->max_samples)
 			return TRUE;
-		}
+	}
 
-		sr_dbg("Received %d bytes", bytes_read);
-
-		index = 0;
-		while (index < bytes_read) {
-			byte = devc->ftdi_buf[index++];
-			devc->cnt_bytes++;
-
-			devc->sample[devc->num_bytes++] = byte;
-			sr_spew("Received byte 0x%.2x.", byte);
-
-			if ((devc->flag_reg & FLAG_DEMUX) && (devc->flag_reg & FLAG_RLE)) {
-				/* RLE in demux mode must be processed differently 
-				* since in this case the RLE encoder is operating on pairs of samples.
-				*/
-				if (devc->num_bytes == num_channels * 2) {
-					devc->cnt_samples += 2;
-					devc->cnt_samples_rle += 2;
-					/*
-					 * Got a sample pair. Convert from the OLS's little-endian
-					 * sample to the local format.
-					 */
-					sample = devc->sample[0] | (devc->sample[1] << 8) \
-							| (devc->sample[2] << 16) | (devc->sample[3] << 24);
-					sr_spew("Received sample pair 0x%.*x.", devc->num_bytes * 2, sample);
-
-					/*
-					 * In RLE mode the high bit of the sample pair is the
-					 * "count" flag, meaning this sample pair is the number
-					 * of times the previous sample pair occurred.
-					 */
-					if (devc->sample[devc->num_bytes - 1] & 0x80) {
-						/* Clear the high bit. */
-						sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
-						devc->rle_count = sample;
-						devc->cnt_samples_rle += devc->rle_count * 2;
-						sr_dbg("RLE count: %u.", devc->rle_count * 2);
-						devc->num_bytes = 0;
-						continue;
-					}
-					devc->num_samples += (devc->rle_count + 1) * 2;
-					if (devc->num_samples > devc->limit_samples) {
-						/* Save us from overrunning the buffer. */
-						devc->rle_count -= (devc->num_samples - devc->limit_samples) / 2;
-						devc->num_samples = devc->limit_samples;
-						index = bytes_read;
-					}
-
-					/*
-					 * Some channel groups may have been turned
-					 * off, to speed up transfer between the
-					 * hardware and the PC. Expand that here before
-					 * submitting it over the session bus --
-					 * whatever is listening on the bus will be
-					 * expecting a full 32-bit sample, based on
-					 * the number of channels.
-					 */
-					j = 0;
-					/* expand first sample */
-					memset(devc->tmp_sample, 0, 4);
-					for (i = 0; i < 2; i++) {
-						if (((devc->flag_reg >> 2) & (1 << i)) == 0) {
-							/*
-							 * This channel group was
-							 * enabled, copy from received
-							 * sample.
-							 */
-							devc->tmp_sample[i] = devc->sample[j++];
-						} 
-					}
-					/* Clear out the most significant bit of the sample */
-					devc->tmp_sample[devc->num_bytes - 1] &= 0x7f;
-					sr_spew("Expanded sample 1: 0x%.2x%.2x%.2x%.2x.",
-						devc->tmp_sample[3], devc->tmp_sample[2],
-						devc->tmp_sample[1], devc->tmp_sample[0]);
-
-					/* expand second sample */
-					memset(devc->tmp_sample2, 0, 4);
-					for (i = 0; i < 2; i++) {
-						if (((devc->flag_reg >> 2) & (1 << i)) == 0) {
-							/*
-							 * This channel group was
-							 * enabled, copy from received
-							 * sample.
-							 */
-							devc->tmp_sample2[i] = devc->sample[j++];
-						} 
-					}
-					/* Clear out the most significant bit of the sample */
-					devc->tmp_sample2[devc->num_bytes - 1] &= 0x7f;
-					sr_spew("Expanded sample 2: 0x%.2x%.2x%.2x%.2x.",
-						devc->tmp_sample2[3], devc->tmp_sample2[2],
-						devc->tmp_sample2[1], devc->tmp_sample2[0]);
-
-					/*
-					 * OLS sends its sample buffer backwards.
-					 * store it in reverse order here, so we can dump
-					 * this on the session bus later.
-					 */
-					offset = (devc->limit_samples - devc->num_samples) * 4;
-					for (i = 0; i <= devc->rle_count; i++) {
-						memcpy(devc->raw_sample_buf + offset + (i * 8),
-									 devc->tmp_sample2, 4);
-						memcpy(devc->raw_sample_buf + offset + (4 + (i * 8)),
-									 devc->tmp_sample, 4);
-					}
-					memset(devc->sample, 0, 4);
-					devc->num_bytes = 0;
-					devc->rle_count = 0;
-				}
-			}
-			else {
-				if (devc->num_bytes == num_channels) {
-					devc->cnt_samples++;
-					devc->cnt_samples_rle++;
-					/*
-					 * Got a full sample. Convert from the OLS's little-endian
-					 * sample to the local format.
-					 */
-					sample = devc->sample[0] | (devc->sample[1] << 8) \
-							| (devc->sample[2] << 16) | (devc->sample[3] << 24);
-					sr_spew("Received sample 0x%.*x.", devc->num_bytes * 2, sample);
-					if (devc->flag_reg & FLAG_RLE) {
-						/*
-						 * In RLE mode the high bit of the sample is the
-						 * "count" flag, meaning this sample is the number
-						 * of times the previous sample occurred.
-						 */
-						if (devc->sample[devc->num_bytes - 1] & 0x80) {
-							/* Clear the high bit. */
-							sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
-							devc->rle_count = sample;
-							devc->cnt_samples_rle += devc->rle_count;
-							sr_dbg("RLE count: %u.", devc->rle_count);
-							devc->num_bytes = 0;
-							continue;
-						}
-					}
-					devc->num_samples += devc->rle_count + 1;
-					if (devc->num_samples > devc->limit_samples) {
-						/* Save us from overrunning the buffer. */
-						devc->rle_count -= devc->num_samples - devc->limit_samples;
-						devc->num_samples = devc->limit_samples;
-						index = bytes_read;
-					}
-
-					if (num_channels < 4) {
-						/*
-						 * Some channel groups may have been turned
-						 * off, to speed up transfer between the
-						 * hardware and the PC. Expand that here before
-						 * submitting it over the session bus --
-						 * whatever is listening on the bus will be
-						 * expecting a full 32-bit sample, based on
-						 * the number of channels.
-						 */
-						j = 0;
-						memset(devc->tmp_sample, 0, 4);
-						for (i = 0; i < 4; i++) {
-							if (((devc->flag_reg >> 2) & (1 << i)) == 0) {
-								/*
-								 * This channel group was
-								 * enabled, copy from received
-								 * sample.
-								 */
-								devc->tmp_sample[i] = devc->sample[j++];
-							} 
-						}
-						memcpy(devc->sample, devc->tmp_sample, 4);
-						sr_spew("Expanded sample: 0x%.8x.", sample);
-					}
-
-					/*
-					 * Pipistrello OLS sends its sample buffer backwards.
-					 * store it in reverse order here, so we can dump
-					 * this on the session bus later.
-					 */
-					offset = (devc->limit_samples - devc->num_samples) * 4;
-					for (i = 0; i <= devc->rle_count; i++) {
-						memcpy(devc->raw_sample_buf + offset + (i * 4),
-									 devc->sample, 4);
-					}
-					memset(devc->sample, 0, 4);
-					devc->num_bytes = 0;
-					devc->rle_count = 0;
-				}
-			}
-		}
-		return TRUE;
-	} else {
-		do {
-			bytes_read = ftdi_read_data(devc->ftdic, devc->ftdi_buf, FTDI_BUF_SIZE);
-		} while (bytes_read > 0);
+	do {
+		bytes_read = ftdi_read_data(devc->ftdic, devc->ftdi_buf, FTDI_BUF_SIZE);
+	} while (bytes_read > 0);
 
+	/*
+	 * We've acquired all the samples we asked for -- we're done.
+	 * Send the (properly-ordered) buffer to the frontend.
+	 */
+	sr_dbg("Received %" PRIu64 " bytes, %" PRIu64 " samples, %" PRIu64
+			" decompressed samples.", dec->cnt_bytes,
+			dec->cnt_samples, dec->cnt_samples_rle);
+	if (devc->trigger_at != -1) {
 		/*
-		 * We've acquired all the samples we asked for -- we're done.
-		 * Send the (properly-ordered) buffer to the frontend.
+		 * A trigger was set up, so we need to tell the frontend
+		 * about it.
 		 */
-		sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
-				devc->cnt_bytes, devc->cnt_samples,
-				devc->cnt_samples_rle);
-		if (devc->trigger_at != -1) {
-			/*
-			 * A trigger was set up, so we need to tell the frontend
-			 * about it.
-			 */
-			if (devc->trigger_at > 0) {
-				/* There are pre-trigger samples, send those first. */
-				packet.type = SR_DF_LOGIC;
-				packet.payload = &logic;
-				logic.length = devc->trigger_at * 4;
-				logic.unitsize = 4;
-				logic.data = devc->raw_sample_buf +
-					(devc->limit_samples - devc->num_samples) * 4;
-				sr_session_send(cb_data, &packet);
-			}
-
-			/* Send the trigger. */
-			packet.type = SR_DF_TRIGGER;
-			sr_session_send(cb_data, &packet);
-
-			/* Send post-trigger samples. */
+		if (devc->trigger_at > 0) {
+			/* There are pre-trigger samples, send those first. */
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
-			logic.length = (devc->num_samples * 4) - (devc->trigger_at * 4);
+			logic.length = devc->trigger_at * 4;
 			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf + devc->trigger_at * 4 +
-				(devc->limit_samples - devc->num_samples) * 4;
-			sr_session_send(cb_data, &packet);
-		} else {
-			/* no trigger was used */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = devc->num_samples * 4;
-			logic.unitsize = 4;
-			logic.data = devc->raw_sample_buf +
-				(devc->limit_samples - devc->num_samples) * 4;
+			logic.data = ols_decoder_samples(dec);
 			sr_session_send(cb_data, &packet);
 		}
-		g_free(devc->raw_sample_buf);
 
-		sdi->driver->dev_acquisition_stop(sdi, cb_data);
+		/* Send the trigger. */
+		packet.type = SR_DF_TRIGGER;
+		sr_session_send(cb_data, &packet);
+
+		/* Send post-trigger samples. */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = (dec->num_samples * 4) - (devc->trigger_at * 4);
+		logic.unitsize = 4;
+		logic.data = ols_decoder_samples(dec) + devc->trigger_at * 4;
+		sr_session_send(cb_data, &packet);
+	} else {
+		/* no trigger was used */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = dec->num_samples * 4;
+		logic.unitsize = 4;
+		logic.data = ols_decoder_samples(dec);
+		sr_session_send(cb_data, &packet);
 	}
 
+	sdi->driver->dev_acquisition_stop(sdi, cb_data);
+
 	return TRUE;
 }
@@ -762,103 +762,125 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
-SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi)
+/* Parse the replies to the queries of rigol_ds_get_dev_cfg(), in order. */
+static int parse_dev_cfg(struct dev_context *devc, char **r)
 {
-	struct dev_context *devc;
-	char *cmd;
-	unsigned int i;
-	int res;
+	unsigned int i, num_analog;
 
-	devc = sdi->priv;
+	num_analog = devc->model->analog_channels;
 
 	/* Analog channel state. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:DISP?", i + 1);
-		res = sr_scpi_get_bool(sdi->conn, cmd, &devc->analog_channels[i]);
-		g_free(cmd);
-		if (res != SR_OK)
+	for (i = 0; i < num_analog; i++)
+		if (sr_scpi_parse_bool(*r++, &devc->analog_channels[i]) != SR_OK)
 			return SR_ERR;
-	}
 	sr_dbg("Current analog channel state:");
-	for (i = 0; i < devc->model->analog_channels; i++)
+	for (i = 0; i < num_analog; i++)
 		sr_dbg("CH%d %s", i + 1, devc->analog_channels[i] ? "on" : "off");
 
 	/* Digital channel state. */
 	if (devc->model->has_digital) {
-		if (sr_scpi_get_bool(sdi->conn,
-				devc->model->series->protocol >= PROTOCOL_V4 ?
-					":LA:STAT?" : ":LA:DISP?",
-				&devc->la_enabled) != SR_OK)
+		if (sr_scpi_parse_bool(*r++, &devc->la_enabled) != SR_OK)
 			return SR_ERR;
 		sr_dbg("Logic analyzer %s, current digital channel state:",
 				devc->la_enabled ? "enabled" : "disabled");
 		for (i = 0; i < ARRAY_SIZE(devc->digital_channels); i++) {
-			cmd = g_strdup_printf(
-				devc->model->series->protocol >= PROTOCOL_V4 ?
-					":LA:DIG%d:DISP?" : ":DIG%d:TURN?", i);
-			res = sr_scpi_get_bool(sdi->conn, cmd, &devc->digital_channels[i]);
-			g_free(cmd);
-			if (res != SR_OK)
+			if (sr_scpi_parse_bool(*r++, &devc->digital_channels[i]) != SR_OK)
 				return SR_ERR;
 			sr_dbg("D%d: %s", i, devc->digital_channels[i] ? "on" : "off");
 		}
 	}
 
 	/* Timebase. */
-	if (sr_scpi_get_float(sdi->conn, ":TIM:SCAL?", &devc->timebase) != SR_OK)
+	if (sr_atof_ascii(*r++, &devc->timebase) != SR_OK)
 		return SR_ERR;
 	sr_dbg("Current timebase %g", devc->timebase);
 
 	/* Vertical gain. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:SCAL?", i + 1);
-		res = sr_scpi_get_float(sdi->conn, cmd, &devc->vdiv[i]);
-		g_free(cmd);
-		if (res != SR_OK)
+	for (i = 0; i < num_analog; i++)
+		if (sr_atof_ascii(*r++, &devc->vdiv[i]) != SR_OK)
 			return SR_ERR;
-	}
 	sr_dbg("Current vertical gain:");
-	for (i = 0; i < devc->model->analog_channels; i++)
+	for (i = 0; i < num_analog; i++)
 		sr_dbg("CH%d %g", i + 1, devc->vdiv[i]);
 
 	/* Vertical offset. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:OFFS?", i + 1);
-		res = sr_scpi_get_float(sdi->conn, cmd, &devc->vert_offset[i]);
-		g_free(cmd);
-		if (res != SR_OK)
+	for (i = 0; i < num_analog; i++)
+		if (sr_atof_ascii(*r++, &devc->vert_offset[i]) != SR_OK)
 			return SR_ERR;
-	}
 	sr_dbg("Current vertical offset:");
-	for (i = 0; i < devc->model->analog_channels; i++)
+	for (i = 0; i < num_analog; i++)
 		sr_dbg("CH%d %g", i + 1, devc->vert_offset[i]);
 
 	/* Coupling. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:COUP?", i + 1);
-		res = sr_scpi_get_string(sdi->conn, cmd, &devc->coupling[i]);
-		g_free(cmd);
-		if (res != SR_OK)
-			return SR_ERR;
+	for (i = 0; i < num_analog; i++) {
+		g_free(devc->coupling[i]);
+		devc->coupling[i] = g_strdup(*r++);
 	}
 	sr_dbg("Current coupling:");
-	for (i = 0; i < devc->model->analog_channels; i++)
+	for (i = 0; i < num_analog; i++)
 		sr_dbg("CH%d %s", i + 1, devc->coupling[i]);
 
 	/* Trigger source. */
-	if (sr_scpi_get_string(sdi->conn, ":TRIG:EDGE:SOUR?", &devc->trigger_source) != SR_OK)
-		return SR_ERR;
+	g_free(devc->trigger_source);
+	devc->trigger_source = g_strdup(*r++);
 	sr_dbg("Current trigger source %s", devc->trigger_source);
 
 	/* Horizontal trigger position. */
-	if (sr_scpi_get_float(sdi->conn, ":TIM:OFFS?", &devc->horiz_triggerpos) != SR_OK)
+	if (sr_atof_ascii(*r++, &devc->horiz_triggerpos) != SR_OK)
 		return SR_ERR;
 	sr_dbg("Current horizontal trigger position %g", devc->horiz_triggerpos);
 
 	/* Trigger slope. */
-	if (sr_scpi_get_string(sdi->conn, ":TRIG:EDGE:SLOP?", &devc->trigger_slope) != SR_OK)
-		return SR_ERR;
+	g_free(devc->trigger_slope);
+	devc->trigger_slope = g_strdup(*r);
 	sr_dbg("Current trigger slope %s", devc->trigger_slope);
 
 	return SR_OK;
 }
+
+SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	GPtrArray *commands;
+	char **responses;
+	unsigned int i, num_analog;
+	int ret;
+
+	devc = sdi->priv;
+	num_analog = devc->model->analog_channels;
+
+	/* Ask for the whole configuration in one batch. */
+	commands = g_ptr_array_new_with_free_func(g_free);
+	for (i = 0; i < num_analog; i++)
+		g_ptr_array_add(commands, g_strdup_printf(":CHAN%d:DISP?", i + 1));
+	if (devc->model->has_digital) {
+		g_ptr_array_add(commands, g_strdup(
+				devc->model->series->protocol >= PROTOCOL_V4 ?
+					":LA:STAT?" : ":LA:DISP?"));
+		for (i = 0; i < ARRAY_SIZE(devc->digital_channels); i++)
+			g_ptr_array_add(commands, g_strdup_printf(
+				devc->model->series->protocol >= PROTOCOL_V4 ?
+					":LA:DIG%d:DISP?" : ":DIG%d:TURN?", i));
+	}
+	g_ptr_array_add(commands, g_strdup(":TIM:SCAL?"));
+	for (i = 0; i < num_analog; i++)
+		g_ptr_array_add(commands, g_strdup_printf(":CHAN%d:SCAL?", i + 1));
+	for (i = 0; i < num_analog; i++)
+		g_ptr_array_add(commands, g_strdup_printf(":CHAN%d:OFFS?", i + 1));
+	for (i = 0; i < num_analog; i++)
+		g_ptr_array_add(commands, g_strdup_printf(":CHAN%d:COUP?", i + 1));
+	g_ptr_array_add(commands, g_strdup(":TRIG:EDGE:SOUR?"));
+	g_ptr_array_add(commands, g_strdup(":TIM:OFFS?"));
+	g_ptr_array_add(commands, g_strdup(":TRIG:EDGE:SLOP?"));
+
+	responses = g_malloc0((commands->len + 1) * sizeof(char *));
+	ret = sr_scpi_get_strings(sdi->conn, (const char *const *)commands->pdata,
+			commands->len, responses);
+	if (ret == SR_OK)
+		ret = parse_dev_cfg(devc, responses);
+
+	g_ptr_array_free(commands, TRUE);
+	g_strfreev(responses);
+
+	return ret == SR_OK ? SR_OK : SR_ERR;
+}
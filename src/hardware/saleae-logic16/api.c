@@ -97,7 +97,16 @@ static const uint64_t samplerates[] = {
 
 static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
 {
-	return std_init(sr_ctx, di, LOG_PREFIX);
+	struct drv_context *drvc;
+	int ret;
+
+	if ((ret = std_init(sr_ctx, di, LOG_PREFIX)) != SR_OK)
+		return ret;
+
+	drvc = di->context;
+	drvc->usb_event_thread = TRUE;
+
+	return SR_OK;
 }
 
 static gboolean check_conf_profile(libusb_device *dev)
@@ -757,6 +766,10 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return ret;
 	}
 
+	/* Transfers must be submitted after the event source is in place. */
+	devc->ctx = drvc->sr_ctx;
+	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, (void *)sdi);
+
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
 		if (!(buf = g_try_malloc(size))) {
@@ -764,6 +777,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 			if (devc->submitted_transfers)
 				abort_acquisition(devc);
 			else {
+				usb_source_remove(sdi->session, devc->ctx);
 				g_free(devc->transfers);
 				g_free(devc->convbuffer);
 			}
@@ -773,11 +787,13 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
 				2 | LIBUSB_ENDPOINT_IN, buf, size,
 				logic16_receive_transfer, (void *)sdi, timeout);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		if ((ret = usb_submit_transfer(sdi->session, transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
 			g_free(buf);
+			if (!devc->submitted_transfers)
+				usb_source_remove(sdi->session, devc->ctx);
 			abort_acquisition(devc);
 			return SR_ERR;
 		}
@@ -785,10 +801,6 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		devc->submitted_transfers++;
 	}
 
-	devc->ctx = drvc->sr_ctx;
-
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, (void *)sdi);
-
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(cb_data, LOG_PREFIX);
 
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The device sends the samples channel by channel: one little endian
+ * 16-bit word per enabled channel, holding 16 consecutive samples of that
+ * channel with the first sample in the MSB. A group of such words, one
+ * per enabled channel, is a 16x16 bit matrix that is transposed into 16
+ * logic samples of 2 bytes.
+ */
+
+#include <config.h>
+#include <stdint.h>
+#include <string.h>
+#include <glib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "protocol.h"
+
+#ifdef __SSE2__
+
+/*
+ * Transpose the rows (one per logic channel) with SSE2: movemask collects
+ * the top bit of all 16 bytes, which is one sample of 8 channel bits from
+ * each half of the rows. Adding a vector to itself moves the next sample
+ * into the top bits.
+ */
+static void transpose_group(const uint16_t *rows, uint8_t *dest)
+{
+	__m128i r0, r1, lo, hi, mask;
+	uint16_t sample;
+	int i;
+
+	r0 = _mm_loadu_si128((const __m128i *)rows);
+	r1 = _mm_loadu_si128((const __m128i *)(rows + 8));
+	mask = _mm_set1_epi16(0xff);
+	lo = _mm_packus_epi16(_mm_and_si128(r0, mask), _mm_and_si128(r1, mask));
+	hi = _mm_packus_epi16(_mm_srli_epi16(r0, 8), _mm_srli_epi16(r1, 8));
+
+	for (i = 0; i < 8; i++) {
+		sample = _mm_movemask_epi8(hi);
+		memcpy(dest + 2 * i, &sample, 2);
+		hi = _mm_add_epi8(hi, hi);
+	}
+	for (i = 8; i < 16; i++) {
+		sample = _mm_movemask_epi8(lo);
+		memcpy(dest + 2 * i, &sample, 2);
+		lo = _mm_add_epi8(lo, lo);
+	}
+}
+
+#else
+
+/* Transpose an 8x8 bit matrix, one row per byte (Hacker's Delight 7-3). */
+static uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x = x ^ t ^ (t << 28);
+
+	return x;
+}
+
+/* Transpose the rows in four 8x8 blocks. */
+static void transpose_group(const uint16_t *rows, uint8_t *dest)
+{
+	uint64_t lo[2], hi[2];
+	uint16_t sample;
+	int i, k;
+
+	lo[0] = lo[1] = hi[0] = hi[1] = 0;
+	for (i = 0; i < 16; i++) {
+		lo[i / 8] |= (uint64_t)(rows[i] & 0xff) << (8 * (i % 8));
+		hi[i / 8] |= (uint64_t)(rows[i] >> 8) << (8 * (i % 8));
+	}
+	for (i = 0; i < 2; i++) {
+		lo[i] = transpose8(lo[i]);
+		hi[i] = transpose8(hi[i]);
+	}
+
+	/* Byte k of a block now holds bit k of the rows, the first sample is bit 15. */
+	for (i = 0; i < 16; i++) {
+		k = 15 - i;
+		if (k >= 8)
+			sample = ((hi[0] >> (8 * (k - 8))) & 0xff)
+				| (((hi[1] >> (8 * (k - 8))) & 0xff) << 8);
+		else
+			sample = ((lo[0] >> (8 * k)) & 0xff)
+				| (((lo[1] >> (8 * k)) & 0xff) << 8);
+		memcpy(dest + 2 * i, &sample, 2);
+	}
+}
+
+#endif
+
+/**
+ * Convert whole groups of channel words into logic samples.
+ *
+ * @param src num_groups * num_channels words from the device.
+ * @param dest Buffer for num_groups * 16 samples of 2 bytes.
+ * @param num_groups Number of groups to convert.
+ * @param channel_masks The bit of each enabled channel in a sample.
+ * @param num_channels Number of enabled channels, 1 to 16.
+ */
+SR_PRIV void logic16_transpose(const uint8_t *src, uint8_t *dest,
+		size_t num_groups, const uint16_t *channel_masks, int num_channels)
+{
+	uint16_t rows[16];
+	int row[16];
+	size_t g;
+	int c;
+
+	for (c = 0; c < num_channels; c++)
+		row[c] = g_bit_nth_lsf(channel_masks[c], -1);
+
+	memset(rows, 0, sizeof(rows));
+	for (g = 0; g < num_groups; g++) {
+		for (c = 0; c < num_channels; c++)
+			rows[row[c]] = RL16(src + 2 * c);
+		transpose_group(rows, dest);
+		src += 2 * num_channels;
+		dest += 16 * 2;
+	}
+}
+
+/* Add words of a group that is split across transfers, bit by bit. */
+static void add_words(struct dev_context *devc, const uint8_t *src,
+		size_t count)
+{
+	uint16_t sample, channel_mask;
+	int i;
+
+	while (count--) {
+		sample = RL16(src);
+		src += 2;
+
+		channel_mask = devc->channel_masks[devc->cur_channel++];
+
+		for (i = 15; i >= 0; --i, sample >>= 1)
+			if (sample & 1)
+				devc->channel_data[i] |= channel_mask;
+	}
+}
+
+/**
+ * Convert the data of a transfer into logic samples.
+ *
+ * A group of channel words may be split across transfers, its start is
+ * kept in devc->channel_data until the rest arrives.
+ *
+ * @return The number of samples written to dest.
+ */
+SR_PRIV size_t logic16_convert_sample_data(struct dev_context *devc,
+		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt)
+{
+	size_t ret, n, num_groups;
+
+	srccnt /= 2;
+	ret = 0;
+
+	/* Finish the group started in the previous transfer. */
+	if (devc->cur_channel > 0) {
+		n = MIN(srccnt, (size_t)(devc->num_channels - devc->cur_channel));
+		add_words(devc, src, n);
+		src += 2 * n;
+		srccnt -= n;
+		if (devc->cur_channel < devc->num_channels)
+			return 0;
+		devc->cur_channel = 0;
+		if (destcnt < 16 * 2) {
+			sr_err("Conversion buffer too small!");
+			return 0;
+		}
+		memcpy(dest, devc->channel_data, 16 * 2);
+		memset(devc->channel_data, 0, 16 * 2);
+		dest += 16 * 2;
+		destcnt -= 16 * 2;
+		ret += 16;
+	}
+
+	num_groups = srccnt / devc->num_channels;
+	if (num_groups > destcnt / (16 * 2)) {
+		sr_err("Conversion buffer too small!");
+		num_groups = destcnt / (16 * 2);
+		srccnt = num_groups * devc->num_channels;
+	}
+	logic16_transpose(src, dest, num_groups, devc->channel_masks,
+			devc->num_channels);
+	src += 2 * num_groups * devc->num_channels;
+	srccnt -= num_groups * devc->num_channels;
+	ret += 16 * num_groups;
+
+	/* Keep the start of an incomplete group for the next transfer. */
+	add_words(devc, src, srccnt);
+
+	return ret;
+}
@@ -805,9 +805,12 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+
+	if ((ret = usb_submit_transfer(sdi->session, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	free_transfer(transfer);
@@ -816,48 +819,6 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
-static size_t convert_sample_data(struct dev_context *devc,
-		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt)
-{
-	uint16_t *channel_data;
-	int i, cur_channel;
-	size_t ret = 0;
-	uint16_t sample, channel_mask;
-
-	srccnt /= 2;
-
-	channel_data = devc->channel_data;
-	cur_channel = devc->cur_channel;
-
-	while (srccnt--) {
-		sample = src[0] | (src[1] << 8);
-		src += 2;
-
-		channel_mask = devc->channel_masks[cur_channel];
-
-		for (i = 15; i >= 0; --i, sample >>= 1)
-			if (sample & 1)
-				channel_data[i] |= channel_mask;
-
-		if (++cur_channel == devc->num_channels) {
-			cur_channel = 0;
-			if (destcnt < 16 * 2) {
-				sr_err("Conversion buffer too small!");
-				break;
-			}
-			memcpy(dest, channel_data, 16 * 2);
-			memset(channel_data, 0, 16 * 2);
-			dest += 16 * 2;
-			ret += 16;
-			destcnt -= 16 * 2;
-		}
-	}
-
-	devc->cur_channel = cur_channel;
-
-	return ret;
-}
-
 SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transfer)
 {
 	gboolean packet_has_error = FALSE;
@@ -922,7 +883,7 @@ SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transf
 		devc->empty_transfer_count = 0;
 	}
 
-	new_samples = convert_sample_data(devc, devc->convbuffer,
+	new_samples = logic16_convert_sample_data(devc, devc->convbuffer,
 			devc->convbuffer_size, transfer->buffer, transfer->actual_length);
 
 	if (new_samples > 0) {
@@ -104,4 +104,9 @@ SR_PRIV int logic16_abort_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi);
 SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transfer);
 
+SR_PRIV void logic16_transpose(const uint8_t *src, uint8_t *dest,
+		size_t num_groups, const uint16_t *channel_masks, int num_channels);
+SR_PRIV size_t logic16_convert_sample_data(struct dev_context *devc,
+		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt);
+
 #endif
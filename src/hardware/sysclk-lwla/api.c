@@ -65,7 +65,16 @@ static const char *const signal_edge_names[] = {
  */
 static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
 {
-	return std_init(sr_ctx, di, LOG_PREFIX);
+	struct drv_context *drvc;
+	int ret;
+
+	if ((ret = std_init(sr_ctx, di, LOG_PREFIX)) != SR_OK)
+		return ret;
+
+	drvc = di->context;
+	drvc->usb_event_thread = TRUE;
+
+	return SR_OK;
 }
 
 /* Create a new sigrok device instance for the indicated LWLA model.
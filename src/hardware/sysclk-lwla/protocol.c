@@ -24,12 +24,14 @@
 
 /* Submit an already filled-in USB transfer.
  */
-static int submit_transfer(struct dev_context *devc,
+static int submit_transfer(const struct sr_dev_inst *sdi,
 			   struct libusb_transfer *xfer)
 {
+	struct dev_context *devc;
 	int ret;
 
-	ret = libusb_submit_transfer(xfer);
+	devc = sdi->priv;
+	ret = usb_submit_transfer(sdi->session, xfer);
 
 	if (ret != 0) {
 		sr_err("Submit transfer failed: %s.", libusb_error_name(ret));
@@ -120,7 +122,7 @@ static int submit_request(const struct sr_dev_inst *sdi,
 			next_reg_write(acq);
 	}
 
-	return submit_transfer(devc, acq->xfer_out);
+	return submit_transfer(sdi, acq->xfer_out);
 }
 
 /* Evaluate and act on the response to a capture status request.
@@ -345,7 +347,7 @@ static void LIBUSB_CALL transfer_out_completed(struct libusb_transfer *transfer)
 
 	/* If this was a read request, wait for the response. */
 	if ((devc->state & STATE_EXPECT_RESPONSE) != 0) {
-		submit_transfer(devc, acq->xfer_in);
+		submit_transfer(sdi, acq->xfer_in);
 		return;
 	}
 	if (acq->reg_seq_pos < acq->reg_seq_len)
@@ -354,7 +356,7 @@ static void LIBUSB_CALL transfer_out_completed(struct libusb_transfer *transfer)
 	/* Repeat until all queued registers have been written. */
 	if (acq->reg_seq_pos < acq->reg_seq_len && !devc->cancel_requested) {
 		next_reg_write(acq);
-		submit_transfer(devc, acq->xfer_out);
+		submit_transfer(sdi, acq->xfer_out);
 		return;
 	}
 
@@ -423,7 +425,7 @@ static void LIBUSB_CALL transfer_in_completed(struct libusb_transfer *transfer)
 		/* Repeat until all queued registers have been read. */
 		if (++acq->reg_seq_pos < acq->reg_seq_len) {
 			next_reg_read(acq);
-			submit_transfer(devc, acq->xfer_out);
+			submit_transfer(sdi, acq->xfer_out);
 			return;
 		}
 	}
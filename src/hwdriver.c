@@ -171,6 +171,18 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Equivalent circuit model", NULL},
 	{SR_CONF_OVER_TEMPERATURE_PROTECTION_ACTIVE, SR_T_BOOL, "otp_active",
 		"Over-temperature protection active", NULL},
+	{SR_CONF_OVERRUNS, SR_T_UINT64, "overruns",
+		"Overruns", NULL},
+	{SR_CONF_LATE_TRANSFERS, SR_T_UINT64, "late_transfers",
+		"Late transfers", NULL},
+	{SR_CONF_READ_LAG, SR_T_UINT64, "read_lag",
+		"Read lag", NULL},
+	{SR_CONF_UNPACED, SR_T_BOOL, "unpaced",
+		"Unpaced", NULL},
+	{SR_CONF_PACKET_SIZE, SR_T_UINT64, "packet_size",
+		"Packet size", NULL},
+	{SR_CONF_ACHIEVED_SAMPLERATE, SR_T_UINT64, "achieved_samplerate",
+		"Achieved samplerate", NULL},
 
 	/* Special stuff */
 	{SR_CONF_SESSIONFILE, SR_T_STRING, "sessionfile",
@@ -185,6 +197,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Data source", NULL},
 	{SR_CONF_PROBE_FACTOR, SR_T_UINT64, "probe_factor",
 		"Probe factor", NULL},
+	{SR_CONF_CAPTURE_OFFSET, SR_T_UINT64, "capture_offset",
+		"Capture offset", NULL},
 
 	/* Acquisition modes, sample limiting */
 	{SR_CONF_LIMIT_MSEC, SR_T_UINT64, "limit_time",
@@ -29,19 +29,21 @@
 
 #define LOG_PREFIX "input/binary"
 
-#define MAX_CHUNK_SIZE        4096
+#define DEFAULT_CHUNK_SIZE    (4 * 1024 * 1024)
 #define DEFAULT_NUM_CHANNELS  8
 #define DEFAULT_SAMPLERATE    0
 
 struct context {
 	gboolean started;
 	uint64_t samplerate;
+	/* Maximum packet size in bytes, a multiple of the unit size. */
+	uint64_t chunk_size;
 };
 
 static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
-	int num_channels, i;
+	int num_channels, unitsize, i;
 	char name[16];
 
 	num_channels = g_variant_get_int32(g_hash_table_lookup(options, "numchannels"));
@@ -54,6 +56,9 @@ static int init(struct sr_input *in, GHashTable *options)
 	in->priv = inc = g_malloc0(sizeof(struct context));
 
 	inc->samplerate = g_variant_get_uint64(g_hash_table_lookup(options, "samplerate"));
+	unitsize = (num_channels + 7) / 8;
+	inc->chunk_size = g_variant_get_uint64(g_hash_table_lookup(options, "chunksize"));
+	inc->chunk_size = MAX(inc->chunk_size / unitsize, 1) * unitsize;
 
 	for (i = 0; i < num_channels; i++) {
 		snprintf(name, 16, "%d", i);
@@ -63,66 +68,117 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static void send_header(struct sr_input *in)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
-	struct sr_datafeed_logic logic;
 	struct sr_config *src;
 	struct context *inc;
-	gsize chunk_size, i;
-	int chunk;
 
 	inc = in->priv;
-	if (!inc->started) {
-		std_session_send_df_header(in->sdi, LOG_PREFIX);
-
-		if (inc->samplerate) {
-			packet.type = SR_DF_META;
-			packet.payload = &meta;
-			src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
-			meta.config = g_slist_append(NULL, src);
-			sr_session_send(in->sdi, &packet);
-			g_slist_free(meta.config);
-			sr_config_free(src);
-		}
-
-		inc->started = TRUE;
+	if (inc->started)
+		return;
+
+	std_session_send_df_header(in->sdi, LOG_PREFIX);
+
+	if (inc->samplerate) {
+		packet.type = SR_DF_META;
+		packet.payload = &meta;
+		src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
+		meta.config = g_slist_append(NULL, src);
+		sr_session_send(in->sdi, &packet);
+		g_slist_free(meta.config);
+		sr_config_free(src);
 	}
 
+	inc->started = TRUE;
+}
+
+/*
+ * Send the complete samples in data as logic packets, and return the
+ * number of bytes sent. The packets point into buf if it isn't NULL.
+ */
+static gsize send_data(struct sr_input *in, const char *data, gsize len,
+		struct sr_buffer *buf)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct context *inc;
+	gsize chunk_size, chunk, i;
+
+	inc = in->priv;
+	send_header(in);
+
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
 	logic.unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
 
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = len / logic.unitsize * logic.unitsize;
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
-		chunk = MIN(MAX_CHUNK_SIZE, chunk_size - i);
+		logic.data = (char *)data + i;
+		chunk = MIN(inc->chunk_size, chunk_size - i);
 		logic.length = chunk;
-		sr_session_send(in->sdi, &packet);
+		sr_session_send_buffer(in->sdi, &packet, buf);
+	}
+
+	return chunk_size;
+}
+
+/*
+ * Send the data stashed in in->buf, followed by the new data. The new
+ * data is sent in place, only an incomplete sample at its end is stashed
+ * for next time.
+ */
+static int process_buffer(struct sr_input *in, const char *data, gsize len)
+{
+	gsize unitsize, offset, n;
+
+	unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
+	offset = 0;
+
+	if (in->buf->len > 0) {
+		/* Complete the stashed sample first. */
+		n = MIN((unitsize - in->buf->len % unitsize) % unitsize, len);
+		g_string_append_len(in->buf, data, n);
+		offset = n;
+		n = send_data(in, in->buf->str, in->buf->len, NULL);
+		g_string_erase(in->buf, 0, n);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+
+	if (in->buf->len == 0)
+		offset += send_data(in, data + offset, len - offset, NULL);
+	g_string_append_len(in->buf, data + offset, len - offset);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	int ret;
+	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, buf->str, buf->len);
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	return process_buffer(in, buf->str, buf->len);
+}
 
+static int receive_buffer(struct sr_input *in, struct sr_buffer *buf,
+		size_t *offset)
+{
 	if (!in->sdi_ready) {
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	*offset += send_data(in, (char *)sr_buffer_data(buf) + *offset,
+			sr_buffer_size(buf) - *offset, buf);
 
-	return ret;
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -132,7 +188,7 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL, 0);
 	else
 		ret = SR_OK;
 
@@ -148,6 +204,7 @@ static int end(struct sr_input *in)
 static struct sr_option options[] = {
 	{ "numchannels", "Number of channels", "Number of channels", NULL, NULL },
 	{ "samplerate", "Sample rate", "Sample rate", NULL, NULL },
+	{ "chunksize", "Chunk size", "Maximum number of bytes per packet", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -156,6 +213,7 @@ static const struct sr_option *get_options(void)
 	if (!options[0].def) {
 		options[0].def = g_variant_ref_sink(g_variant_new_int32(DEFAULT_NUM_CHANNELS));
 		options[1].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_SAMPLERATE));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_CHUNK_SIZE));
 	}
 
 	return options;
@@ -169,5 +227,6 @@ SR_PRIV struct sr_input_module input_binary = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_buffer = receive_buffer,
 	.end = end,
 };
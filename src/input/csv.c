@@ -67,6 +67,16 @@
  *                than 0. The default line number to start processing is 1.
  */
 
+/* Size of the SR_DF_LOGIC packets sent. */
+#define OUT_BUFFER_SIZE (1024 * 1024)
+
+/*
+ * Buffers of at least twice this many bytes are split into line ranges
+ * that are parsed by up to NUM_THREADS threads.
+ */
+#define MIN_RANGE_SIZE (256 * 1024)
+#define NUM_THREADS 4
+
 /* Single column formats. */
 enum {
 	FORMAT_BIN,
@@ -74,6 +84,32 @@ enum {
 	FORMAT_OCT
 };
 
+struct context;
+
+/* Parses a range of lines into samples. */
+struct parser {
+	struct context *inc;
+	GThread *thread;
+
+	/* The lines to parse. */
+	const char *buf;
+	size_t len;
+
+	/* Number of the line before the range, and of the lines in it. */
+	size_t first_line;
+	size_t num_lines;
+
+	/* Don't log errors, when the range is parsed in a worker thread. */
+	gboolean quiet;
+
+	/* The samples, and the space allocated for them. */
+	uint8_t *samples;
+	size_t num_samples;
+	size_t samples_size;
+
+	int ret;
+};
+
 struct context {
 	gboolean started;
 
@@ -123,14 +159,19 @@ struct context {
 	/* Format sample data is stored in single column mode. */
 	int format;
 
-	/* Size of the sample buffer. */
+	/* Size of a sample. */
 	size_t sample_buffer_size;
 
-	/* Buffer to store sample data. */
-	uint8_t *sample_buffer;
-
 	/* Current line number. */
 	size_t line_number;
+
+	/* Samples collected for the next SR_DF_LOGIC packet. */
+	uint8_t *out_buffer;
+	size_t out_samples;
+	size_t out_max_samples;
+
+	/* Parsers for the line ranges of a buffer, see parse_lines(). */
+	struct parser parsers[NUM_THREADS];
 };
 
 static void strip_comment(char *buf, const GString *prefix)
@@ -144,29 +185,63 @@ static void strip_comment(char *buf, const GString *prefix)
 		*ptr = '\0';
 }
 
-static int parse_binstr(const char *str, struct context *inc)
+/* Find str in the len bytes at buf, without relying on a terminating NUL. */
+static const char *find_str(const char *buf, size_t len, const GString *str)
+{
+	const char *p, *end;
+
+	if (len < str->len)
+		return NULL;
+
+	/* Columns are short, a loop beats calling memchr(). */
+	end = buf + len - str->len + 1;
+	for (p = buf; p < end; p++) {
+		if (*p == str->str[0] && (str->len == 1
+				|| !memcmp(p, str->str, str->len)))
+			return p;
+	}
+
+	return NULL;
+}
+
+/* Strip leading and trailing whitespace, like g_strstrip(). */
+static const char *strip_len(const char *str, size_t *len)
 {
-	gsize i, j, length;
+	while (*len && g_ascii_isspace(str[*len - 1]))
+		(*len)--;
+	while (*len && g_ascii_isspace(*str)) {
+		str++;
+		(*len)--;
+	}
+
+	return str;
+}
 
-	length = strlen(str);
+/* Errors are only logged when they can't be reported again later. */
+#define parse_err(quiet, ...) do { \
+		if (!(quiet)) \
+			sr_err(__VA_ARGS__); \
+	} while (0)
+
+static int parse_binstr(const char *str, gsize length, uint8_t *sample,
+		struct context *inc, size_t line_number, gboolean quiet)
+{
+	gsize i, j;
 
 	if (!length) {
-		sr_err("Column %u in line %zu is empty.", inc->single_column,
-			inc->line_number);
+		parse_err(quiet, "Column %u in line %zu is empty.",
+			inc->single_column, line_number);
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, (inc->num_channels + 7) >> 3);
-
 	i = inc->first_channel;
 
 	for (j = 0; i < length && j < inc->num_channels; i++, j++) {
 		if (str[length - i - 1] == '1') {
-			inc->sample_buffer[j / 8] |= (1 << (j % 8));
+			sample[j / 8] |= (1 << (j % 8));
 		} else if (str[length - i - 1] != '0') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			parse_err(quiet, "Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, line_number);
 			return SR_ERR;
 		}
 	}
@@ -174,23 +249,19 @@ static int parse_binstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_hexstr(const char *str, struct context *inc)
+static int parse_hexstr(const char *str, gsize length, uint8_t *sample,
+		struct context *inc, size_t line_number, gboolean quiet)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
-		sr_err("Column %u in line %zu is empty.", inc->single_column,
-			inc->line_number);
+		parse_err(quiet, "Column %u in line %zu is empty.",
+			inc->single_column, line_number);
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, (inc->num_channels + 7) >> 3);
-
 	/* Calculate the position of the first hexadecimal digit. */
 	i = inc->first_channel / 4;
 
@@ -198,8 +269,8 @@ static int parse_hexstr(const char *str, struct context *inc)
 		c = str[length - i - 1];
 
 		if (!g_ascii_isxdigit(c)) {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			parse_err(quiet, "Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, line_number);
 			return SR_ERR;
 		}
 
@@ -209,7 +280,7 @@ static int parse_hexstr(const char *str, struct context *inc)
 
 		for (; j < inc->num_channels && k < 4; k++) {
 			if (value & (1 << k))
-				inc->sample_buffer[j / 8] |= (1 << (j % 8));
+				sample[j / 8] |= (1 << (j % 8));
 
 			j++;
 		}
@@ -218,23 +289,19 @@ static int parse_hexstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_octstr(const char *str, struct context *inc)
+static int parse_octstr(const char *str, gsize length, uint8_t *sample,
+		struct context *inc, size_t line_number, gboolean quiet)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
-		sr_err("Column %u in line %zu is empty.", inc->single_column,
-			inc->line_number);
+		parse_err(quiet, "Column %u in line %zu is empty.",
+			inc->single_column, line_number);
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, (inc->num_channels + 7) >> 3);
-
 	/* Calculate the position of the first octal digit. */
 	i = inc->first_channel / 3;
 
@@ -242,8 +309,8 @@ static int parse_octstr(const char *str, struct context *inc)
 		c = str[length - i - 1];
 
 		if (c < '0' || c > '7') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			parse_err(quiet, "Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, line_number);
 			return SR_ERR;
 		}
 
@@ -253,7 +320,7 @@ static int parse_octstr(const char *str, struct context *inc)
 
 		for (; j < inc->num_channels && k < 3; k++) {
 			if (value & (1 << k))
-				inc->sample_buffer[j / 8] |= (1 << (j % 8));
+				sample[j / 8] |= (1 << (j % 8));
 
 			j++;
 		}
@@ -310,32 +377,28 @@ static char **parse_line(char *buf, struct context *inc, int max_columns)
 	return columns;
 }
 
-static int parse_multi_columns(char **columns, struct context *inc)
+static int parse_multi_column(const char *str, gsize length, gsize i,
+		uint8_t *sample, struct context *inc, size_t line_number,
+		gboolean quiet)
 {
-	gsize i;
-
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, (inc->num_channels + 7) >> 3);
-
-	for (i = 0; i < inc->num_channels; i++) {
-		if (columns[i][0] == '1') {
-			inc->sample_buffer[i / 8] |= (1 << (i % 8));
-		} else if (!strlen(columns[i])) {
-			sr_err("Column %zu in line %zu is empty.",
-				inc->first_channel + i, inc->line_number);
-			return SR_ERR;
-		} else if (columns[i][0] != '0') {
-			sr_err("Invalid value '%s' in column %zu in line %zu.",
-				columns[i], inc->first_channel + i,
-				inc->line_number);
-			return SR_ERR;
-		}
+	if (!length) {
+		parse_err(quiet, "Column %zu in line %zu is empty.",
+			inc->first_channel + i, line_number);
+		return SR_ERR;
+	} else if (str[0] != '0' && str[0] != '1') {
+		parse_err(quiet, "Invalid value '%.*s' in column %zu in line %zu.",
+			(int)length, str, inc->first_channel + i, line_number);
+		return SR_ERR;
 	}
 
+	/* Without a branch on the value, which is hard to predict. */
+	sample[i / 8] |= (str[0] - '0') << (i % 8);
+
 	return SR_OK;
 }
 
-static int parse_single_column(const char *column, struct context *inc)
+static int parse_single_column(const char *str, gsize length, uint8_t *sample,
+		struct context *inc, size_t line_number, gboolean quiet)
 {
 	int res;
 
@@ -343,36 +406,269 @@ static int parse_single_column(const char *column, struct context *inc)
 
 	switch (inc->format) {
 	case FORMAT_BIN:
-		res = parse_binstr(column, inc);
+		res = parse_binstr(str, length, sample, inc, line_number, quiet);
 		break;
 	case FORMAT_HEX:
-		res = parse_hexstr(column, inc);
+		res = parse_hexstr(str, length, sample, inc, line_number, quiet);
 		break;
 	case FORMAT_OCT:
-		res = parse_octstr(column, inc);
+		res = parse_octstr(str, length, sample, inc, line_number, quiet);
 		break;
 	}
 
 	return res;
 }
 
-static int send_samples(const struct sr_dev_inst *sdi, uint8_t *buffer,
-		gsize buffer_size, gsize count)
+/*
+ * Length of a line without its comment and line termination. A line is
+ * skipped if this is 0.
+ */
+static size_t line_length(const struct context *inc, const char *line,
+		size_t len)
+{
+	const char *comment;
+
+	if (len && line[len - 1] == '\r')
+		len--;
+	if (inc->comment->len && (comment = find_str(line, len, inc->comment)))
+		len = comment - line;
+
+	return len;
+}
+
+/*
+ * Parse the columns of a line in place into a sample, which must be
+ * cleared by the caller.
+ */
+static int parse_columns(struct context *inc, const char *line, size_t len,
+		uint8_t *sample, size_t line_number, gboolean quiet)
+{
+	const char *end, *delim, *column;
+	gsize n, k, max_columns, column_len;
+	int ret;
+
+	if (inc->multi_column_mode)
+		max_columns = inc->num_channels;
+	else
+		max_columns = 1;
+
+	end = line + len;
+	n = k = 0;
+	while (k < max_columns) {
+		delim = find_str(line, end - line, inc->delimiter);
+		if (n >= inc->first_column) {
+			column_len = (delim ? delim : end) - line;
+			column = strip_len(line, &column_len);
+			if (inc->multi_column_mode)
+				ret = parse_multi_column(column, column_len, k,
+					sample, inc, line_number, quiet);
+			else
+				ret = parse_single_column(column, column_len,
+					sample, inc, line_number, quiet);
+			if (ret != SR_OK)
+				return ret;
+			k++;
+		}
+		if (!delim)
+			break;
+		line = delim + inc->delimiter->len;
+		n++;
+	}
+
+	if (!k) {
+		parse_err(quiet, "Column %u in line %zu is out of bounds.",
+			inc->first_column, line_number);
+		return SR_ERR;
+	}
+	/*
+	 * Ensure that the number of channels does not exceed the number
+	 * of columns in multi column mode.
+	 */
+	if (k < max_columns) {
+		parse_err(quiet, "Not enough columns for desired number of channels in line %zu.",
+			line_number);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/* Parse the lines in a range into samples. */
+static int parse_lines(struct parser *p)
 {
+	struct context *inc;
+	const char *line, *next, *end;
+	uint8_t *sample;
+	size_t len, max_samples, line_number;
+	char term;
+
+	inc = p->inc;
+	term = inc->termination[strlen(inc->termination) - 1];
+
+	/* Every line but the last has a termination character. */
+	max_samples = p->len / 2 + 1;
+	if (p->samples_size < max_samples * inc->sample_buffer_size) {
+		g_free(p->samples);
+		p->samples_size = max_samples * inc->sample_buffer_size;
+		p->samples = g_malloc(p->samples_size);
+	}
+
+	p->num_samples = 0;
+	line_number = p->first_line;
+	end = p->buf + p->len;
+	for (line = p->buf; line < end; line = next) {
+		if ((next = memchr(line, term, end - line)))
+			next++;
+		else
+			next = end;
+		line_number++;
+
+		len = line_length(inc, line, next - line - (next[-1] == term));
+		if (!len)
+			continue;
+
+		sample = p->samples + p->num_samples * inc->sample_buffer_size;
+		memset(sample, 0, inc->sample_buffer_size);
+		p->ret = parse_columns(inc, line, len, sample, line_number,
+				p->quiet);
+		if (p->ret != SR_OK)
+			return p->ret;
+		p->num_samples++;
+	}
+	p->num_lines = line_number - p->first_line;
+
+	return p->ret = SR_OK;
+}
+
+static gpointer parser_thread(gpointer data)
+{
+	parse_lines(data);
+
+	return NULL;
+}
+
+static int flush_samples(const struct sr_input *in)
+{
+	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	int res;
-	gsize i;
+	int ret;
+
+	inc = in->priv;
+	if (!inc->out_samples)
+		return SR_OK;
 
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
-	logic.unitsize = buffer_size;
-	logic.length = buffer_size;
-	logic.data = buffer;
+	logic.unitsize = inc->sample_buffer_size;
+	logic.length = inc->out_samples * inc->sample_buffer_size;
+	logic.data = inc->out_buffer;
+	inc->out_samples = 0;
+
+	if ((ret = sr_session_send(in->sdi, &packet)) != SR_OK)
+		sr_err("Sending samples failed.");
+
+	return ret;
+}
+
+/* Collect samples, and send them once a packet is full. */
+static int add_samples(const struct sr_input *in, const uint8_t *samples,
+		size_t count)
+{
+	struct context *inc;
+	size_t n;
+	int ret;
+
+	inc = in->priv;
+	if (!inc->out_buffer) {
+		inc->out_max_samples = MAX(OUT_BUFFER_SIZE / inc->sample_buffer_size, 1);
+		inc->out_buffer = g_malloc(inc->out_max_samples * inc->sample_buffer_size);
+	}
+
+	while (count) {
+		n = MIN(count, inc->out_max_samples - inc->out_samples);
+		memcpy(inc->out_buffer + inc->out_samples * inc->sample_buffer_size,
+			samples, n * inc->sample_buffer_size);
+		inc->out_samples += n;
+		samples += n * inc->sample_buffer_size;
+		count -= n;
+		if (inc->out_samples == inc->out_max_samples) {
+			if ((ret = flush_samples(in)) != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Parse complete lines. Large buffers are split into line ranges, each
+ * parsed in a thread of its own.
+ */
+static int parse_range(const struct sr_input *in, const char *buf, size_t len)
+{
+	struct context *inc;
+	struct parser *p;
+	const char *start, *next;
+	size_t num_ranges, i;
+	char term;
+	int ret;
 
-	for (i = 0; i < count; i++) {
-		if ((res = sr_session_send(sdi, &packet)) != SR_OK)
-			return res;
+	inc = in->priv;
+	term = inc->termination[strlen(inc->termination) - 1];
+
+	num_ranges = 1;
+	if (len >= 2 * MIN_RANGE_SIZE)
+		num_ranges = MIN(NUM_THREADS, len / MIN_RANGE_SIZE);
+
+	start = buf;
+	for (i = 0; i < num_ranges; i++) {
+		p = &inc->parsers[i];
+		p->inc = inc;
+		p->quiet = num_ranges > 1;
+		p->first_line = inc->line_number;
+		p->buf = start;
+		if (i == num_ranges - 1) {
+			next = buf + len;
+		} else {
+			next = buf + (i + 1) * (len / num_ranges);
+			if (next < start)
+				next = start;
+			if ((next = memchr(next, term, buf + len - next)))
+				next++;
+			else
+				next = buf + len;
+		}
+		p->len = next - start;
+		start = next;
+	}
+
+	for (i = 1; i < num_ranges; i++)
+		inc->parsers[i].thread = g_thread_try_new("csv-parser",
+				parser_thread, &inc->parsers[i], NULL);
+	parse_lines(&inc->parsers[0]);
+	for (i = 1; i < num_ranges; i++) {
+		/* Ranges without a thread are parsed here. */
+		if (inc->parsers[i].thread)
+			g_thread_join(inc->parsers[i].thread);
+		else
+			parse_lines(&inc->parsers[i]);
+	}
+
+	for (i = 0; i < num_ranges; i++) {
+		p = &inc->parsers[i];
+		if (p->ret != SR_OK) {
+			if (p->quiet) {
+				/* Parse again, to report the error with its line number. */
+				p->quiet = FALSE;
+				p->first_line = inc->line_number;
+				parse_lines(p);
+			}
+			return SR_ERR;
+		}
+		inc->line_number += p->num_lines;
+		if ((ret = add_samples(in, p->samples, p->num_samples)) != SR_OK)
+			return ret;
 	}
 
 	return SR_OK;
@@ -446,46 +742,53 @@ static int init(struct sr_input *in, GHashTable *options)
 
 static const char *get_line_termination(GString *buf)
 {
-	const char *term;
+	const char *term, *p;
 
 	term = NULL;
 	if (g_strstr_len(buf->str, buf->len, "\r\n"))
 		term = "\r\n";
 	else if (memchr(buf->str, '\n', buf->len))
 		term = "\n";
-	else if (memchr(buf->str, '\r', buf->len))
+	else if ((p = memchr(buf->str, '\r', buf->len))
+			&& p < buf->str + buf->len - 1)
+		/* A '\r' at the end may be followed by '\n'. */
 		term = "\r";
 
 	return term;
 }
 
-static int initial_parse(const struct sr_input *in, GString *buf)
+static int initial_parse(const struct sr_input *in, GString *buf,
+		const char *termination)
 {
 	struct context *inc;
 	GString *channel_name;
 	unsigned int num_columns, i;
-	size_t line_number, l;
+	size_t line_number;
 	int ret;
-	char **lines, **columns;
+	char *line, *next, **columns;
 
 	ret = SR_OK;
 	inc = in->priv;
 	columns = NULL;
 
+	/* Only the lines up to the first proper one are looked at. */
 	line_number = 0;
-	lines = g_strsplit_set(buf->str, "\r\n", 0);
-	for (l = 0; lines[l]; l++) {
+	for (line = buf->str; line; line = next) {
+		if ((next = strstr(line, termination))) {
+			*next = '\0';
+			next += strlen(termination);
+		}
 		line_number++;
 		if (inc->start_line > line_number) {
 			sr_spew("Line %zu skipped.", line_number);
 			continue;
 		}
-		if (lines[l][0] == '\0') {
+		if (line[0] == '\0') {
 			sr_spew("Blank line %zu skipped.", line_number);
 			continue;
 		}
-		strip_comment(lines[l], inc->comment);
-		if (lines[l][0] == '\0') {
+		strip_comment(line, inc->comment);
+		if (line[0] == '\0') {
 			sr_spew("Comment-only line %zu skipped.", line_number);
 			continue;
 		}
@@ -493,7 +796,7 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 		/* Reached first proper line. */
 		break;
 	}
-	if (!lines[l]) {
+	if (!line) {
 		/* Not enough data for a proper line yet. */
 		ret = SR_ERR_NA;
 		goto out;
@@ -503,7 +806,7 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	 * In order to determine the number of columns parse the current line
 	 * without limiting the number of columns.
 	 */
-	if (!(columns = parse_line(lines[l], inc, -1))) {
+	if (!(columns = parse_line(line, inc, -1))) {
 		sr_err("Error while parsing line %zu.", line_number);
 		ret = SR_ERR;
 		goto out;
@@ -556,12 +859,10 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	 * channels.
 	 */
 	inc->sample_buffer_size = (inc->num_channels + 7) >> 3;
-	inc->sample_buffer = g_malloc(inc->sample_buffer_size);
 
 out:
 	if (columns)
 		g_strfreev(columns);
-	g_strfreev(lines);
 
 	return ret;
 }
@@ -570,7 +871,7 @@ static int initial_receive(const struct sr_input *in)
 {
 	struct context *inc;
 	GString *new_buf;
-	int len, ret;
+	int ret;
 	char *p;
 	const char *termination;
 
@@ -583,32 +884,67 @@ static int initial_receive(const struct sr_input *in)
 	if (!(p = g_strrstr_len(in->buf->str, in->buf->len, termination)))
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
-	len = p - in->buf->str - 1;
-	new_buf = g_string_new_len(in->buf->str, len);
-	g_string_append_c(new_buf, '\0');
-
-	inc->termination = g_strdup(termination);
+	new_buf = g_string_new_len(in->buf->str, p - in->buf->str);
 
 	if (in->buf->str[0] != '\0')
-		ret = initial_parse(in, new_buf);
+		ret = initial_parse(in, new_buf, termination);
 	else
 		ret = SR_OK;
 
+	/* Lines are only parsed once the channels are known. */
+	if (ret == SR_OK)
+		inc->termination = g_strdup(termination);
+
 	g_string_free(new_buf, TRUE);
 
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Skip the lines before the start line, and the header line. */
+static size_t skip_lines(struct context *inc, const char *buf, size_t len)
+{
+	const char *line, *next, *end;
+	char term;
+
+	term = inc->termination[strlen(inc->termination) - 1];
+	end = buf + len;
+	for (line = buf; line < end; line = next) {
+		if (!inc->header && inc->line_number + 1 >= inc->start_line)
+			break;
+		if ((next = memchr(line, term, end - line)))
+			next++;
+		else
+			next = end;
+		inc->line_number++;
+
+		if (inc->line_number < inc->start_line) {
+			sr_spew("Line %zu skipped.", inc->line_number);
+			continue;
+		}
+		if (!line_length(inc, line, next - line - (next[-1] == term))) {
+			sr_spew("Blank or comment-only line %zu skipped.",
+				inc->line_number);
+			continue;
+		}
+
+		/* Its content was used as the channel names. */
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header = FALSE;
+	}
+
+	return line - buf;
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
 	struct context *inc;
-	gsize num_columns;
 	uint64_t samplerate;
-	int max_columns, ret, l;
-	char *p, **lines, **columns;
+	size_t pos, len;
+	char *p;
+	int ret;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -628,84 +964,19 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	if (!(p = g_strrstr_len(in->buf->str, in->buf->len, inc->termination)))
-		/* Don't have a full line. */
-		return SR_ERR;
-
-	*p = '\0';
-	g_strstrip(in->buf->str);
-
-	/* Limit the number of columns to parse. */
-	if (inc->multi_column_mode)
-		max_columns = inc->num_channels;
-	else
-		max_columns = 1;
-
-	ret = SR_OK;
-	lines = g_strsplit_set(in->buf->str, "\r\n", 0);
-	for (l = 0; lines[l]; l++) {
-		inc->line_number++;
-		if (lines[l][0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Remove trailing comment. */
-		strip_comment(lines[l], inc->comment);
-		if (lines[l][0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->header) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header = FALSE;
-			continue;
-		}
-
-		if (!(columns = parse_line(lines[l], inc, max_columns))) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (!num_columns) {
-			sr_err("Column %u in line %zu is out of bounds.",
-				inc->first_column, inc->line_number);
-			g_strfreev(columns);
-			return SR_ERR;
-		}
-		/*
-		 * Ensure that the number of channels does not exceed the number
-		 * of columns in multi column mode.
-		 */
-		if (inc->multi_column_mode && num_columns < inc->num_channels) {
-			sr_err("Not enough columns for desired number of channels in line %zu.",
-				inc->line_number);
-			g_strfreev(columns);
-			return SR_ERR;
-		}
-
-		if (inc->multi_column_mode)
-			ret = parse_multi_columns(columns, inc);
-		else
-			ret = parse_single_column(columns[0], inc);
-		if (ret != SR_OK) {
-			g_strfreev(columns);
-			return SR_ERR;
-		}
-
-		/* Send sample data to the session bus. */
-		ret = send_samples(in->sdi, inc->sample_buffer,
-			inc->sample_buffer_size, 1);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			return SR_ERR;
-		}
-		g_strfreev(columns);
+	/* Parse complete lines only, unless this is the end of the input. */
+	if (is_eof) {
+		len = in->buf->len;
+	} else {
+		if (!(p = g_strrstr_len(in->buf->str, in->buf->len, inc->termination)))
+			/* Don't have a full line. */
+			return SR_OK;
+		len = p - in->buf->str + strlen(inc->termination);
 	}
-	g_strfreev(lines);
-	g_string_erase(in->buf, 0, p - in->buf->str + 1);
+
+	pos = skip_lines(inc, in->buf->str, len);
+	ret = parse_range(in, in->buf->str + pos, len - pos);
+	g_string_erase(in->buf, 0, len);
 
 	return ret;
 }
@@ -730,7 +1001,7 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	ret = process_buffer(in, FALSE);
 
 	return ret;
 }
@@ -742,12 +1013,15 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, TRUE);
 	else
 		ret = SR_OK;
 
 	inc = in->priv;
 	if (inc->started) {
+		if (ret == SR_OK)
+			ret = flush_samples(in);
+
 		/* End of stream. */
 		packet.type = SR_DF_END;
 		sr_session_send(in->sdi, &packet);
@@ -759,6 +1033,7 @@ static int end(struct sr_input *in)
 static void cleanup(struct sr_input *in)
 {
 	struct context *inc;
+	int i;
 
 	inc = in->priv;
 
@@ -769,7 +1044,9 @@ static void cleanup(struct sr_input *in)
 		g_string_free(inc->comment, TRUE);
 
 	g_free(inc->termination);
-	g_free(inc->sample_buffer);
+	g_free(inc->out_buffer);
+	for (i = 0; i < NUM_THREADS; i++)
+		g_free(inc->parsers[i].samples);
 }
 
 static struct sr_option options[] = {
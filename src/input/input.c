@@ -20,6 +20,12 @@
 #include <config.h>
 #include <string.h>
 #include <errno.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -29,6 +35,9 @@
 #define LOG_PREFIX "input"
 /** @endcond */
 
+/* Size of the pieces sr_input_load_file() passes to receive(). */
+#define LOAD_CHUNK_SIZE (4 * 1024 * 1024)
+
 /**
  * @file
  *
@@ -545,6 +554,178 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+#ifdef HAVE_SYS_MMAN_H
+struct file_mapping {
+	void *addr;
+	size_t len;
+};
+
+static void file_mapping_free(void *data)
+{
+	struct file_mapping *map;
+
+	map = data;
+	munmap(map->addr, map->len);
+	g_free(map);
+}
+
+/* Map a file into a buffer, or return NULL if it can't be mapped. */
+static struct sr_buffer *file_map(const char *filename)
+{
+	struct file_mapping *map;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	if ((fd = g_open(filename, O_RDONLY, 0)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0
+			|| (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return NULL;
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		sr_dbg("Failed to map %s: %s", filename, g_strerror(errno));
+		return NULL;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	map = g_malloc(sizeof(struct file_mapping));
+	map->addr = addr;
+	map->len = st.st_size;
+
+	return sr_buffer_wrap_full(addr, map->len, file_mapping_free, map);
+}
+#endif
+
+static struct sr_buffer *file_load(const char *filename, uint64_t flags)
+{
+	struct sr_buffer *buf;
+	GError *error;
+	gchar *contents;
+	gsize len;
+
+#ifdef HAVE_SYS_MMAN_H
+	if (!(flags & SR_INPUT_LOAD_COPY) && (buf = file_map(filename)))
+		return buf;
+#else
+	(void)flags;
+#endif
+
+	error = NULL;
+	if (!g_file_get_contents(filename, &contents, &len, &error)) {
+		sr_err("Failed to read %s: %s", filename, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	buf = sr_buffer_wrap(contents, len, g_free);
+
+	return buf;
+}
+
+/* Add the device instance to the session as soon as it is ready. */
+static int dev_inst_attach(const struct sr_input *in,
+		struct sr_session *session)
+{
+	if (!in->sdi_ready || in->sdi->session)
+		return SR_OK;
+
+	return sr_session_dev_add(session, in->sdi);
+}
+
+/**
+ * Feed a whole file to the specified input instance.
+ *
+ * This is an alternative to calling sr_input_send() and sr_input_end()
+ * with the contents of a file, for input instances that haven't been fed
+ * any data yet. The file is mapped into memory where possible, and read
+ * sequentially from there. Modules for bulk formats parse the mapping in
+ * place, and send packets which point straight into it; the mapping stays
+ * around as long as datafeed consumers hold a reference to such a packet's
+ * buffer (see sr_packet_buffer_get()). Other modules get the file in
+ * pieces through their usual path.
+ *
+ * The mapping is not a copy: if the file is changed while packets point
+ * into it, their data changes too, and if it is truncated, accessing
+ * their data past the new end raises SIGBUS. Callers which can't rule
+ * that out, for example because consumers hold on to buffers after this
+ * returns, should pass SR_INPUT_LOAD_COPY to read the file into memory.
+ *
+ * The input instance's device instance is added to the session as soon
+ * as it is ready, unless it is in a session already. Datafeed callbacks
+ * must be registered with the session beforehand.
+ *
+ * @param in The input instance. Must not be NULL.
+ * @param filename The file to load. Must not be NULL.
+ * @param session The session to send the data to. Must not be NULL.
+ * @param flags Bitwise OR of sr_input_load_flag values, or 0.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The file could not be read.
+ * @retval other Error code of the input module.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_input_load_file(const struct sr_input *in,
+		const char *filename, struct sr_session *session, uint64_t flags)
+{
+	struct sr_input *inst;
+	struct sr_buffer *buf;
+	GString *chunk;
+	const char *data;
+	size_t size, offset, prev_offset;
+	gboolean prev_ready;
+	int ret;
+
+	if (!in || !filename || !session)
+		return SR_ERR_ARG;
+
+	if (!(buf = file_load(filename, flags)))
+		return SR_ERR;
+	data = sr_buffer_data(buf);
+	size = sr_buffer_size(buf);
+	sr_dbg("Loading %zu bytes from %s with %s module.",
+		size, filename, in->module->id);
+
+	inst = (struct sr_input *)in;
+	offset = 0;
+	ret = SR_OK;
+	if (in->module->receive_buffer) {
+		/* Go on as long as the module makes progress. */
+		do {
+			prev_offset = offset;
+			prev_ready = in->sdi_ready;
+			ret = in->module->receive_buffer(inst, buf, &offset);
+			if (ret == SR_OK)
+				ret = dev_inst_attach(in, session);
+		} while (ret == SR_OK && offset < size
+			&& (offset != prev_offset || in->sdi_ready != prev_ready));
+	} else {
+		while (ret == SR_OK && offset < size) {
+			chunk = g_string_new_len(data + offset,
+				MIN(LOAD_CHUNK_SIZE, size - offset));
+			offset += chunk->len;
+			ret = in->module->receive(inst, chunk);
+			g_string_free(chunk, TRUE);
+			if (ret == SR_OK)
+				ret = dev_inst_attach(in, session);
+		}
+	}
+
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	else
+		sr_err("Failed to load %s: %s.", filename, sr_strerror(ret));
+	sr_buffer_unref(buf);
+
+	return ret;
+}
+
 /**
  * Signal the input module no more data will come.
  *
@@ -31,7 +31,7 @@
 #define LOG_PREFIX "input/raw_analog"
 
 /* How many bytes at a time to process and send to the session bus. */
-#define CHUNK_SIZE 4096
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
 #define DEFAULT_NUM_CHANNELS  1
 #define DEFAULT_SAMPLERATE    0
 
@@ -40,6 +40,8 @@ struct context {
 	int fmt_index;
 	uint64_t samplerate;
 	int samplesize;
+	/* Maximum number of samples per packet. */
+	uint32_t chunk_samples;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
@@ -80,7 +82,8 @@ static int parse_format_string(const char *format)
 	return -1;
 }
 
-static void init_context(struct context *inc, const struct sample_format *fmt, GSList *channels)
+static void init_context(struct context *inc, const struct sample_format *fmt,
+		gboolean normalize, GSList *channels)
 {
 	inc->packet.type = SR_DF_ANALOG;
 	inc->packet.payload = &inc->analog;
@@ -92,6 +95,12 @@ static void init_context(struct context *inc, const struct sample_format *fmt, G
 	inc->analog.spec = &inc->spec;
 
 	memcpy(&inc->encoding, &fmt->encoding, sizeof(inc->encoding));
+	if (!normalize && !inc->encoding.is_float) {
+		/* Leave integer samples as they are. */
+		inc->encoding.scale.p = inc->encoding.scale.q = 1;
+		inc->encoding.offset.p = 0;
+		inc->encoding.offset.q = 1;
+	}
 
 	inc->meaning.mq = 0;
 	inc->meaning.unit = 0;
@@ -108,6 +117,8 @@ static int init(struct sr_input *in, GHashTable *options)
 	char channelname[8];
 	const char *format;
 	int fmt_index;
+	uint64_t chunk_size;
+	gboolean normalize;
 
 	num_channels = g_variant_get_int32(g_hash_table_lookup(options, "numchannels"));
 	if (num_channels < 1) {
@@ -136,83 +147,132 @@ static int init(struct sr_input *in, GHashTable *options)
 
 	inc->samplerate = g_variant_get_uint64(g_hash_table_lookup(options, "samplerate"));
 	inc->samplesize = sample_formats[fmt_index].encoding.unitsize * num_channels;
-	init_context(inc, &sample_formats[fmt_index], in->sdi->channels);
+	chunk_size = g_variant_get_uint64(g_hash_table_lookup(options, "chunksize"));
+	/* Packets must stay addressable by a 32-bit byte count. */
+	inc->chunk_samples = CLAMP(chunk_size / inc->samplesize, 1,
+			G_MAXUINT32 / inc->samplesize);
+	normalize = g_variant_get_boolean(g_hash_table_lookup(options, "normalize"));
+	init_context(inc, &sample_formats[fmt_index], normalize, in->sdi->channels);
 
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static void send_header(struct sr_input *in)
 {
 	struct context *inc;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_packet packet;
 	struct sr_config *src;
-	unsigned int offset, chunk_size;
 
 	inc = in->priv;
-	if (!inc->started) {
-		std_session_send_df_header(in->sdi, LOG_PREFIX);
-
-		if (inc->samplerate) {
-			packet.type = SR_DF_META;
-			packet.payload = &meta;
-			src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
-			meta.config = g_slist_append(NULL, src);
-			sr_session_send(in->sdi, &packet);
-			g_slist_free(meta.config);
-			sr_config_free(src);
-		}
+	if (inc->started)
+		return;
+
+	std_session_send_df_header(in->sdi, LOG_PREFIX);
 
-		inc->started = TRUE;
+	if (inc->samplerate) {
+		packet.type = SR_DF_META;
+		packet.payload = &meta;
+		src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
+		meta.config = g_slist_append(NULL, src);
+		sr_session_send(in->sdi, &packet);
+		g_slist_free(meta.config);
+		sr_config_free(src);
 	}
 
+	inc->started = TRUE;
+}
+
+/*
+ * Send the complete samples in data as analog packets, and return the
+ * number of bytes sent. The packets point into buf if it isn't NULL.
+ */
+static size_t send_data(struct sr_input *in, const char *data, size_t len,
+		struct sr_buffer *buf)
+{
+	struct context *inc;
+	size_t offset, chunk_size;
+
+	inc = in->priv;
+	send_header(in);
+
 	/* Round down to the last channels * unitsize boundary. */
-	inc->analog.num_samples = CHUNK_SIZE / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
+	inc->analog.num_samples = inc->chunk_samples;
+	chunk_size = (size_t)inc->analog.num_samples * inc->samplesize;
 	offset = 0;
 
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
+	while ((offset + chunk_size) < len) {
+		inc->analog.data = (char *)data + offset;
+		sr_session_send_buffer(in->sdi, &inc->packet, buf);
 		offset += chunk_size;
 	}
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
+	inc->analog.num_samples = (len - offset) / inc->samplesize;
+	chunk_size = (size_t)inc->analog.num_samples * inc->samplesize;
 	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
+		inc->analog.data = (char *)data + offset;
+		sr_session_send_buffer(in->sdi, &inc->packet, buf);
 		offset += chunk_size;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else {
-		g_string_truncate(in->buf, 0);
+	return offset;
+}
+
+/*
+ * Send the data stashed in in->buf, followed by the new data. The new
+ * data is sent in place, only an incomplete sample at its end is stashed
+ * for next time.
+ */
+static int process_buffer(struct sr_input *in, const char *data, size_t len)
+{
+	struct context *inc;
+	size_t offset, n;
+
+	inc = in->priv;
+	offset = 0;
+
+	if (in->buf->len > 0) {
+		/* Complete the stashed sample first. */
+		n = MIN((inc->samplesize - in->buf->len % inc->samplesize)
+			% inc->samplesize, len);
+		g_string_append_len(in->buf, data, n);
+		offset = n;
+		n = send_data(in, in->buf->str, in->buf->len, NULL);
+		g_string_erase(in->buf, 0, n);
 	}
 
+	if (in->buf->len == 0)
+		offset += send_data(in, data + offset, len - offset, NULL);
+	g_string_append_len(in->buf, data + offset, len - offset);
+
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	int ret;
+	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, buf->str, buf->len);
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	return process_buffer(in, buf->str, buf->len);
+}
 
+static int receive_buffer(struct sr_input *in, struct sr_buffer *buf,
+		size_t *offset)
+{
 	if (!in->sdi_ready) {
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	*offset += send_data(in, (char *)sr_buffer_data(buf) + *offset,
+			sr_buffer_size(buf) - *offset, buf);
 
-	return ret;
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -222,7 +282,7 @@ static int end(struct sr_input *in)
 	int ret;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, NULL, 0);
 	else
 		ret = SR_OK;
 
@@ -239,6 +299,8 @@ static struct sr_option options[] = {
 	{ "numchannels", "Number of channels", "Number of channels", NULL, NULL },
 	{ "samplerate", "Sample rate", "Sample rate", NULL, NULL },
 	{ "format", "Format", "Numeric format", NULL, NULL },
+	{ "chunksize", "Chunk size", "Maximum number of bytes per packet", NULL, NULL },
+	{ "normalize", "Normalize", "Scale integer samples to the range -1..1", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -252,6 +314,8 @@ static const struct sr_option *get_options(void)
 			options[2].values = g_slist_append(options[2].values,
 				g_variant_ref_sink(g_variant_new_string(sample_formats[i].fmt_name)));
 		}
+		options[3].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_CHUNK_SIZE));
+		options[4].def = g_variant_ref_sink(g_variant_new_boolean(TRUE));
 	}
 
 	return options;
@@ -265,6 +329,8 @@ static void cleanup(struct sr_input *in)
 	g_variant_unref(options[0].def);
 	g_variant_unref(options[1].def);
 	g_variant_unref(options[2].def);
+	g_variant_unref(options[3].def);
+	g_variant_unref(options[4].def);
 	g_slist_free_full(options[2].values, (GDestroyNotify)g_variant_unref);
 	g_free(inc);
 	in->priv = NULL;
@@ -278,6 +344,7 @@ SR_PRIV struct sr_input_module input_raw_analog = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_buffer = receive_buffer,
 	.end = end,
 	.cleanup = cleanup,
 };
@@ -45,16 +45,18 @@
  * Based on Verilog standard IEEE Std 1364-2001 Version C
  *
  * Supported features:
- * - $var with 'wire' and 'reg' types of scalar variables
+ * - $var with 'wire', 'reg' and 'integer' types of scalar and vector
+ *   variables, a vector of n bits maps to n channels, LSB first
+ * - $var with 'real' type, mapped to one channel which is high when
+ *   the value is nonzero
  * - $timescale definition for samplerate
  * - multiple character variable identifiers
+ * - $dumpvars initial value declaration
  *
  * Most important unsupported features:
- * - vector variables (bit vectors etc.)
- * - analog, integer and real number variables
- * - $dumpvars initial value declaration
- * - $scope namespaces
- * - more than 64 channels
+ * - analog channels for real number variables
+ * - $scope namespaces, variables with the same identifier in different
+ *   scopes are aliases and map to the same channels
  */
 
 #include <config.h>
@@ -68,7 +70,20 @@
 #define LOG_PREFIX "input/vcd"
 
 #define DEFAULT_NUM_CHANNELS 8
-#define CHUNKSIZE (1024 * 1024)
+/* Number of runs collected before they are sent as one packet. */
+#define MAX_RUNS 4096
+
+/* Identifiers consist of the printable ASCII characters '!' to '~'. */
+#define ID_CHARS ('~' - '!' + 1)
+#define IS_ID_CHAR(c) ((c) >= '!' && (c) <= '~')
+
+struct vcd_channel {
+	gchar *name;
+	gchar *identifier;
+	/* First channel of the variable, for its least significant bit. */
+	unsigned int channel;
+	unsigned int width;
+};
 
 struct context {
 	gboolean started;
@@ -80,16 +95,18 @@ struct context {
 	unsigned compress;
 	int64_t skip;
 	gboolean skip_until_end;
+	uint64_t prev_timestamp;
 	GSList *channels;
+	/*
+	 * Identifier lookup: direct tables for the common one and two
+	 * character identifiers, a hash table for longer ones.
+	 */
+	struct vcd_channel **ids1;
+	struct vcd_channel **ids2;
+	GHashTable *ids;
 	size_t bytes_per_sample;
-	size_t samples_in_buffer;
-	uint8_t *buffer;
 	uint8_t *current_levels;
-};
-
-struct vcd_channel {
-	gchar *name;
-	gchar *identifier;
+	struct logic_rle *rle;
 };
 
 /*
@@ -126,10 +143,10 @@ static gboolean parse_section(GString *buf, gchar **name, gchar **contents)
 		pos++;
 
 	/* Read the content. */
-	while (pos < buf->len - 4 && strncmp(buf->str + pos, "$end", 4))
+	while (pos + 4 <= buf->len && strncmp(buf->str + pos, "$end", 4))
 		g_string_append_c(scontent, buf->str[pos++]);
 
-	if (sname->len && pos < buf->len - 4 && !strncmp(buf->str + pos, "$end", 4)) {
+	if (sname->len && pos + 4 <= buf->len && !strncmp(buf->str + pos, "$end", 4)) {
 		status = TRUE;
 		pos += 4;
 		while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
@@ -167,13 +184,106 @@ static void remove_empty_parts(gchar **parts)
 	*dest = NULL;
 }
 
+/* Table slot for a one or two character identifier, NULL for others. */
+static struct vcd_channel **id_slot(struct context *inc, const char *id,
+		size_t len)
+{
+	if (len == 1 && IS_ID_CHAR(id[0]))
+		return &inc->ids1[id[0] - '!'];
+	if (len == 2 && IS_ID_CHAR(id[0]) && IS_ID_CHAR(id[1]))
+		return &inc->ids2[(id[0] - '!') * ID_CHARS + id[1] - '!'];
+
+	return NULL;
+}
+
+static struct vcd_channel *find_channel(struct context *inc, const char *id,
+		size_t len)
+{
+	struct vcd_channel **slot, *vcd_ch;
+	char key[32], *dup;
+
+	if ((slot = id_slot(inc, id, len)))
+		return *slot;
+
+	if (len < sizeof(key)) {
+		memcpy(key, id, len);
+		key[len] = '\0';
+		return g_hash_table_lookup(inc->ids, key);
+	}
+	dup = g_strndup(id, len);
+	vcd_ch = g_hash_table_lookup(inc->ids, dup);
+	g_free(dup);
+
+	return vcd_ch;
+}
+
+/* Add a channel for each bit of a $var, split into its parts. */
+static void add_var(struct context *inc, gchar **parts)
+{
+	struct vcd_channel *vcd_ch, **slot;
+	unsigned int width;
+	gboolean real;
+	long size;
+
+	if (g_strv_length(parts) < 4) {
+		sr_warn("$var section should have at least 4 items");
+		return;
+	}
+
+	real = g_strcmp0(parts[0], "real") == 0;
+	if (!real && g_strcmp0(parts[0], "reg") != 0
+			&& g_strcmp0(parts[0], "wire") != 0
+			&& g_strcmp0(parts[0], "integer") != 0) {
+		sr_info("Unsupported signal type: '%s'", parts[0]);
+		return;
+	}
+
+	size = strtol(parts[1], NULL, 10);
+	if (size < 1 || size > G_MAXINT) {
+		sr_info("Unsupported signal size: '%s'", parts[1]);
+		return;
+	}
+	width = real ? 1 : size;
+
+	if (find_channel(inc, parts[2], strlen(parts[2]))) {
+		sr_dbg("'%s' is an alias of identifier '%s'.", parts[3], parts[2]);
+		return;
+	}
+
+	if (width > inc->maxchannels - inc->channelcount) {
+		sr_warn("Skipping '%s' because only %d channels requested.",
+				parts[3], inc->maxchannels);
+		return;
+	}
+
+	if (width == 1)
+		sr_info("Channel %d is '%s' identified by '%s'.",
+				inc->channelcount, parts[3], parts[2]);
+	else
+		sr_info("Channels %d-%d are '%s' identified by '%s'.",
+				inc->channelcount, inc->channelcount + width - 1,
+				parts[3], parts[2]);
+
+	vcd_ch = g_malloc(sizeof(struct vcd_channel));
+	vcd_ch->identifier = g_strdup(parts[2]);
+	vcd_ch->name = g_strdup(parts[3]);
+	vcd_ch->channel = inc->channelcount;
+	vcd_ch->width = width;
+	inc->channels = g_slist_append(inc->channels, vcd_ch);
+	inc->channelcount += width;
+
+	if ((slot = id_slot(inc, vcd_ch->identifier, strlen(vcd_ch->identifier))))
+		*slot = vcd_ch;
+	else
+		g_hash_table_insert(inc->ids, vcd_ch->identifier, vcd_ch);
+}
+
 /*
  * Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
  */
 static gboolean parse_header(const struct sr_input *in, GString *buf)
 {
-	struct vcd_channel *vcd_ch;
 	uint64_t p, q;
 	struct context *inc;
 	gboolean status;
@@ -206,29 +316,10 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 				sr_err("Parsing timescale failed.");
 			}
 		} else if (g_strcmp0(name, "var") == 0) {
-			/* Format: $var type size identifier reference $end */
+			/* Format: $var type size identifier reference [range] $end */
 			parts = g_strsplit_set(contents, " \r\n\t", 0);
 			remove_empty_parts(parts);
-
-			if (g_strv_length(parts) != 4)
-				sr_warn("$var section should have 4 items");
-			else if (g_strcmp0(parts[0], "reg") != 0 && g_strcmp0(parts[0], "wire") != 0)
-				sr_info("Unsupported signal type: '%s'", parts[0]);
-			else if (strtol(parts[1], NULL, 10) != 1)
-				sr_info("Unsupported signal size: '%s'", parts[1]);
-			else if (inc->channelcount >= inc->maxchannels)
-				sr_warn("Skipping '%s' because only %d channels requested.",
-						parts[3], inc->maxchannels);
-			else {
-				sr_info("Channel %d is '%s' identified by '%s'.",
-						inc->channelcount, parts[3], parts[2]);
-				vcd_ch = g_malloc(sizeof(struct vcd_channel));
-				vcd_ch->identifier = g_strdup(parts[2]);
-				vcd_ch->name = g_strdup(parts[3]);
-				inc->channels = g_slist_append(inc->channels, vcd_ch);
-				inc->channelcount++;
-			}
-
+			add_var(inc, parts);
 			g_strfreev(parts);
 		}
 
@@ -247,6 +338,7 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	 */
 	inc->bytes_per_sample = (inc->channelcount + 7) / 8;
 	inc->current_levels = g_malloc0(inc->bytes_per_sample);
+	inc->rle = logic_rle_new(in->sdi, inc->bytes_per_sample, MAX_RUNS);
 
 	inc->got_header = status;
 
@@ -274,171 +366,213 @@ static int format_match(GHashTable *metadata)
 	return status ? SR_OK : SR_ERR;
 }
 
-/* Send all accumulated bytes from inc->buffer. */
-static void send_buffer(const struct sr_input *in)
+/* Add count copies of the current sample. */
+static void add_samples(const struct sr_input *in, uint64_t count)
 {
 	struct context *inc;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
 
 	inc = in->priv;
+	if (inc->bytes_per_sample > 0)
+		logic_rle_add(inc->rle, inc->current_levels, count);
+}
 
-	if (inc->samples_in_buffer == 0)
-		return;
-
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->bytes_per_sample;
-	logic.data = inc->buffer;
-	logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
-	sr_session_send(in->sdi, &packet);
-	inc->samples_in_buffer = 0;
+static void set_bit(uint8_t *levels, unsigned int channel, gboolean bit)
+{
+	if (bit)
+		levels[channel / 8] |= (uint8_t)1 << (channel % 8);
+	else
+		levels[channel / 8] &= ~((uint8_t)1 << (channel % 8));
 }
 
 /*
- * Add N copies of the current sample to buffer.
- * When the buffer fills up, automatically send it.
+ * Apply a value change. The value is a scalar value character, or a
+ * binary vector value (most significant bit first, extended with zeros
+ * to the width of the variable) or real value behind its 'b' or 'r'.
+ * x and z states show as low.
  */
-static void add_samples(const struct sr_input *in, size_t count)
+static void set_value(struct context *inc, const char *value,
+		const char *value_end, const char *id, const char *id_end)
+{
+	struct vcd_channel *vcd_ch;
+	unsigned int i;
+	size_t len;
+
+	if (!(vcd_ch = find_channel(inc, id, id_end - id))) {
+		sr_dbg("Did not find channel for identifier '%.*s'.",
+				(int)(id_end - id), id);
+		return;
+	}
+
+	switch (*value) {
+	case 'b':
+	case 'B':
+		value++;
+		break;
+	case 'r':
+	case 'R':
+		/* Real values show as high when nonzero. */
+		value = g_ascii_strtod(value + 1, NULL) != 0 ? "1" : "0";
+		value_end = value + 1;
+		break;
+	}
+
+	len = value_end - value;
+	if (vcd_ch->width == 1) {
+		set_bit(inc->current_levels, vcd_ch->channel,
+				len > 0 && value[len - 1] == '1');
+		return;
+	}
+	for (i = 0; i < vcd_ch->width; i++)
+		set_bit(inc->current_levels, vcd_ch->channel + i,
+				i < len && value[len - 1 - i] == '1');
+}
+
+static void new_timestamp(const struct sr_input *in, uint64_t timestamp)
 {
 	struct context *inc;
-	size_t samples_per_chunk;
-	size_t space_left, i;
-	uint8_t *p;
 
 	inc = in->priv;
-	samples_per_chunk = CHUNKSIZE / inc->bytes_per_sample;
-
-	while (count) {
-		space_left = samples_per_chunk - inc->samples_in_buffer;
 
-		if (space_left > count)
-			space_left = count;
+	if (inc->downsample > 1)
+		timestamp /= inc->downsample;
 
-		p = inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample;
-		for (i = 0; i < space_left; i++) {
-			memcpy(p, inc->current_levels, inc->bytes_per_sample);
-			p += inc->bytes_per_sample;
-			inc->samples_in_buffer++;
-			count--;
+	/*
+	 * Skip < 0 => skip until first timestamp.
+	 * Skip = 0 => don't skip
+	 * Skip > 0 => skip until timestamp >= skip.
+	 */
+	if (inc->skip < 0) {
+		inc->skip = timestamp;
+		inc->prev_timestamp = timestamp;
+	} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
+		inc->prev_timestamp = inc->skip;
+	} else if (timestamp <= inc->prev_timestamp) {
+		/*
+		 * Ignore repeated timestamps (e.g. sigrok outputs these),
+		 * and ones going back in time.
+		 */
+	} else {
+		if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
+			/* Compress long idle periods */
+			inc->prev_timestamp = timestamp - inc->compress;
 		}
 
-		if (inc->samples_in_buffer == samples_per_chunk)
-			send_buffer(in);
+		/* Generate samples from prev_timestamp up to timestamp - 1. */
+		add_samples(in, timestamp - inc->prev_timestamp);
+		inc->prev_timestamp = timestamp;
 	}
 }
 
-/* Parse a set of lines from the data section. */
-static void parse_contents(const struct sr_input *in, char *data)
+/*
+ * Find the next whitespace-delimited token. A token at the end of the
+ * buffer may be cut off, it only counts if this is the last buffer.
+ */
+static gboolean next_token(const char **p, const char *end, gboolean last,
+		const char **tok, const char **tok_end)
+{
+	const char *s, *e;
+
+	for (s = *p; s < end && g_ascii_isspace(*s); s++);
+	for (e = s; e < end && !g_ascii_isspace(*e); e++);
+	if (s == e || (e == end && !last))
+		return FALSE;
+
+	*tok = s;
+	*p = *tok_end = e;
+
+	return TRUE;
+}
+
+static gboolean token_is(const char *tok, const char *tok_end, const char *s)
+{
+	size_t len;
+
+	len = strlen(s);
+
+	return (size_t)(tok_end - tok) == len && !memcmp(tok, s, len);
+}
+
+/*
+ * Parse value changes from the data section, in a single pass over the
+ * buffer. A statement cut off at the end of the buffer is left for the
+ * next call, unless this is the last buffer.
+ *
+ * Returns the number of bytes parsed.
+ */
+static size_t parse_contents(const struct sr_input *in, const char *buf,
+		size_t len, gboolean last)
 {
 	struct context *inc;
-	struct vcd_channel *vcd_ch;
-	GSList *l;
-	uint64_t timestamp, prev_timestamp;
-	unsigned int bit, i, j;
-	char **tokens;
+	const char *p, *end, *stmt, *tok, *tok_end, *id, *id_end, *s;
+	uint64_t timestamp;
 
 	inc = in->priv;
-	prev_timestamp = 0;
-
-	/* Read one space-delimited token at a time. */
-	tokens = g_strsplit_set(data, " \t\r\n", 0);
-	remove_empty_parts(tokens);
-	for (i = 0; tokens[i]; i++) {
+	p = buf;
+	end = buf + len;
+	for (stmt = p; next_token(&p, end, last, &tok, &tok_end); stmt = p) {
 		if (inc->skip_until_end) {
-			if (!strcmp(tokens[i], "$end")) {
-				/* Done with unhandled/unknown section. */
+			/* Done with unhandled/unknown section. */
+			if (token_is(tok, tok_end, "$end"))
 				inc->skip_until_end = FALSE;
-				break;
-			}
+			continue;
 		}
-		if (tokens[i][0] == '#' && g_ascii_isdigit(tokens[i][1])) {
-			/* Numeric value beginning with # is a new timestamp value */
-			timestamp = strtoull(tokens[i] + 1, NULL, 10);
 
-			if (inc->downsample > 1)
-				timestamp /= inc->downsample;
-
-			/*
-			 * Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (inc->skip < 0) {
-				inc->skip = timestamp;
-				prev_timestamp = timestamp;
-			} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
-				prev_timestamp = inc->skip;
-			} else if (timestamp == prev_timestamp) {
-				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
-			} else {
-				if (inc->compress != 0 && timestamp - prev_timestamp > inc->compress) {
-					/* Compress long idle periods */
-					prev_timestamp = timestamp - inc->compress;
-				}
-
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
-
-				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				add_samples(in, timestamp - prev_timestamp);
-				prev_timestamp = timestamp;
-			}
-		} else if (tokens[i][0] == '$' && tokens[i][1] != '\0') {
+		switch (*tok) {
+		case '#':
+			/* Numeric value beginning with # is a new timestamp value */
+			timestamp = 0;
+			for (s = tok + 1; s < tok_end && g_ascii_isdigit(*s); s++)
+				timestamp = timestamp * 10 + (*s - '0');
+			if (s == tok + 1 || s < tok_end)
+				break;
+			new_timestamp(in, timestamp);
+			continue;
+		case '$':
+			if (tok_end - tok == 1)
+				break;
 			/*
 			 * This is probably a $dumpvars, $comment or similar.
-			 * $dump* contain useful data.
+			 * $dump* contain useful data, parse their contents
+			 * as normally. Ignore anything else until $end.
 			 */
-			if (g_strcmp0(tokens[i], "$dumpvars") == 0
-					|| g_strcmp0(tokens[i], "$dumpon") == 0
-					|| g_strcmp0(tokens[i], "$dumpoff") == 0
-					|| g_strcmp0(tokens[i], "$end") == 0) {
-				/* Ignore, parse contents as normally. */
-			} else {
-				/* Ignore this and future lines until $end. */
+			if (!token_is(tok, tok_end, "$dumpvars")
+					&& !token_is(tok, tok_end, "$dumpall")
+					&& !token_is(tok, tok_end, "$dumpon")
+					&& !token_is(tok, tok_end, "$dumpoff")
+					&& !token_is(tok, tok_end, "$end"))
 				inc->skip_until_end = TRUE;
-				break;
-			}
-		} else if (strchr("bBrR", tokens[i][0]) != NULL) {
-			/* A vector value, not supported yet. */
-			break;
-		} else if (strchr("01xXzZ", tokens[i][0]) != NULL) {
-			/* A new 1-bit sample value */
-			bit = (tokens[i][0] == '1');
-
+			continue;
+		case '0':
+		case '1':
+		case 'x':
+		case 'X':
+		case 'z':
+		case 'Z':
 			/*
-			 * The identifier is either the next character, or, if
-			 * there was whitespace after the bit, the next token.
+			 * A new 1-bit sample value. The identifier is either
+			 * the next character, or, if there was whitespace
+			 * after the bit, the next token.
 			 */
-			if (tokens[i][1] == '\0') {
-				if (!tokens[++i])
-					/* Missing identifier */
-					continue;
-			} else {
-				for (j = 1; tokens[i][j]; j++)
-					tokens[i][j - 1] = tokens[i][j];
-				tokens[i][j - 1] = '\0';
-			}
-
-			for (j = 0, l = inc->channels; j < inc->channelcount && l; j++, l = l->next) {
-				vcd_ch = l->data;
-				if (g_strcmp0(tokens[i], vcd_ch->identifier) == 0) {
-					/* Found our channel */
-					size_t byte_idx = (j / 8);
-					size_t bit_idx = j - 8 * byte_idx;
-					if (bit)
-						inc->current_levels[byte_idx] |= (uint8_t)1 << bit_idx;
-					else
-						inc->current_levels[byte_idx] &= ~((uint8_t)1 << bit_idx);
-					break;
-				}
+			if (tok_end - tok > 1) {
+				set_value(inc, tok, tok + 1, tok + 1, tok_end);
+				continue;
 			}
-			if (j == inc->channelcount)
-				sr_dbg("Did not find channel for identifier '%s'.", tokens[i]);
-		} else {
-			sr_warn("Skipping unknown token '%s'.", tokens[i]);
+			/* Fall through. */
+		case 'b':
+		case 'B':
+		case 'r':
+		case 'R':
+			/* A value, followed by the identifier. */
+			if (!next_token(&p, end, last, &id, &id_end))
+				return stmt - buf;
+			set_value(inc, tok, tok_end, id, id_end);
+			continue;
 		}
+
+		sr_warn("Skipping unknown token '%.*s'.", (int)(tok_end - tok), tok);
 	}
-	g_strfreev(tokens);
+
+	return p - buf;
 }
 
 static int init(struct sr_input *in, GHashTable *options)
@@ -466,7 +600,9 @@ static int init(struct sr_input *in, GHashTable *options)
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = inc;
 
-	inc->buffer = g_malloc(CHUNKSIZE);
+	inc->ids1 = g_malloc0(ID_CHARS * sizeof(struct vcd_channel *));
+	inc->ids2 = g_malloc0(ID_CHARS * ID_CHARS * sizeof(struct vcd_channel *));
+	inc->ids = g_hash_table_new(g_str_hash, g_str_equal);
 
 	for (i = 0; i < num_channels; i++) {
 		snprintf(name, 16, "%d", i);
@@ -484,7 +620,7 @@ static gboolean have_header(GString *buf)
 	if (!(p = g_strstr_len(buf->str, buf->len, "$enddefinitions")))
 		return FALSE;
 	pos = p - buf->str + 15;
-	while (pos < buf->len - 4 && g_ascii_isspace(buf->str[pos]))
+	while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
 		pos++;
 	if (!strncmp(buf->str + pos, "$end", 4))
 		return TRUE;
@@ -492,14 +628,14 @@ static gboolean have_header(GString *buf)
 	return FALSE;
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, gboolean last)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
 	struct context *inc;
 	uint64_t samplerate;
-	char *p;
+	size_t len;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -517,13 +653,8 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	while ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
-		*p = '\0';
-		g_strstrip(in->buf->str);
-		if (in->buf->str[0] != '\0')
-			parse_contents(in, in->buf->str);
-		g_string_erase(in->buf, 0, p - in->buf->str + 1);
-	}
+	len = parse_contents(in, in->buf->str, in->buf->len, last);
+	g_string_erase(in->buf, 0, len);
 
 	return SR_OK;
 }
@@ -548,7 +679,7 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	ret = process_buffer(in, FALSE);
 
 	return ret;
 }
@@ -562,12 +693,13 @@ static int end(struct sr_input *in)
 	inc = in->priv;
 
 	if (in->sdi_ready)
-		ret = process_buffer(in);
+		ret = process_buffer(in, TRUE);
 	else
 		ret = SR_OK;
 
 	/* Send any samples that haven't been sent yet. */
-	send_buffer(in);
+	if (inc->rle)
+		logic_rle_flush(inc->rle);
 
 	if (inc->started) {
 		packet.type = SR_DF_END;
@@ -582,11 +714,18 @@ static void cleanup(struct sr_input *in)
 	struct context *inc;
 
 	inc = in->priv;
+	g_hash_table_destroy(inc->ids);
+	inc->ids = NULL;
+	g_free(inc->ids1);
+	inc->ids1 = NULL;
+	g_free(inc->ids2);
+	inc->ids2 = NULL;
 	g_slist_free_full(inc->channels, free_channel);
-	g_free(inc->buffer);
-	inc->buffer = NULL;
+	inc->channels = NULL;
 	g_free(inc->current_levels);
 	inc->current_levels = NULL;
+	logic_rle_free(inc->rle);
+	inc->rle = NULL;
 }
 
 static struct sr_option options[] = {
@@ -31,7 +31,7 @@
 #define LOG_PREFIX "input/wav"
 
 /* How many bytes at a time to process and send to the session bus. */
-#define CHUNK_SIZE 4096
+#define CHUNK_SIZE (4 * 1024 * 1024)
 
 /* Minimum size of header + 1 8-bit mono PCM sample. */
 #define MIN_DATA_CHUNK_OFFSET    45
@@ -51,6 +51,11 @@ struct context {
 	int num_channels;
 	int unitsize;
 	gboolean found_data;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 };
 
 static int parse_wav_header(GString *buf, struct context *inc)
@@ -156,155 +161,198 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int find_data_chunk(GString *buf, int initial_offset)
+/*
+ * Return the offset of the samples in the "data" chunk, 0 if more data
+ * is needed to find it, or -1 if there is no such chunk.
+ */
+static int find_data_chunk(const char *buf, size_t len, size_t initial_offset)
 {
-	unsigned int offset, i;
+	uint64_t offset;
+	unsigned int i;
 
 	offset = initial_offset;
-	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, buf->len)) {
-		if (!memcmp(buf->str + offset, "data", 4))
+	while (offset <= MAX_DATA_CHUNK_OFFSET && offset + 8 <= len) {
+		if (!memcmp(buf + offset, "data", 4))
 			/* Skip into the samples. */
 			return offset + 8;
 		for (i = 0; i < 4; i++) {
-			if (!isalnum(buf->str[offset + i])
-					&& !isblank(buf->str[offset + i]))
+			if (!isalnum(buf[offset + i])
+					&& !isblank(buf[offset + i]))
 				/* Doesn't look like a chunk ID. */
 				return -1;
 		}
 		/* Skip past this chunk. */
-		offset += 8 + RL32(buf->str + offset + 4);
+		offset += 8 + RL32(buf + offset + 4);
 	}
 
 	if (offset > MAX_DATA_CHUNK_OFFSET)
 		return -1;
 
-	return offset;
+	return 0;
 }
 
-static void send_chunk(const struct sr_input *in, int offset, int num_samples)
+/*
+ * Set up the device instance and the analog packets from the header.
+ * The samples are sent in the file's own encoding.
+ */
+static int setup_dev_inst(struct sr_input *in, GString *header)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
 	struct context *inc;
-	float fdata[CHUNK_SIZE];
-	int total_samples, samplenum;
-	char *s, *d;
+	struct sr_analog_encoding *enc;
+	char channelname[8];
+	int ret;
 
 	inc = in->priv;
+	if ((ret = parse_wav_header(header, inc)) != SR_OK)
+		return ret;
 
-	s = in->buf->str + offset;
-	d = (char *)fdata;
-	memset(fdata, 0, CHUNK_SIZE);
-	total_samples = num_samples * inc->num_channels;
-	for (samplenum = 0; samplenum < total_samples; samplenum++) {
-		if (inc->fmt_code == WAVE_FORMAT_PCM_) {
-			switch (inc->unitsize) {
-			case 1:
-				/* 8-bit PCM samples are unsigned. */
-				fdata[samplenum] = *(uint8_t*)(s) / (float)255;
-				break;
-			case 2:
-				fdata[samplenum] = RL16S(s) / (float)INT16_MAX;
-				break;
-			case 4:
-				fdata[samplenum] = RL32S(s) / (float)INT32_MAX;
-				break;
-			}
-		} else {
-			/* BINARY32 float */
-#ifdef WORDS_BIGENDIAN
-			int i;
-			for (i = 0; i < inc->unitsize; i++)
-				d[i] = s[inc->unitsize - 1 - i];
-#else
-			memcpy(d, s, inc->unitsize);
-#endif
-		}
-		s += inc->unitsize;
-		d += inc->unitsize;
+	for (int i = 0; i < inc->num_channels; i++) {
+		snprintf(channelname, 8, "CH%d", i + 1);
+		sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
 	}
-	packet.type = SR_DF_ANALOG_OLD;
-	packet.payload = &analog;
-	analog.channels = in->sdi->channels;
-	analog.num_samples = num_samples;
-	analog.mq = 0;
-	analog.mqflags = 0;
-	analog.unit = 0;
-	analog.data = fdata;
-	sr_session_send(in->sdi, &packet);
+
+	inc->packet.type = SR_DF_ANALOG;
+	inc->packet.payload = &inc->analog;
+	inc->analog.encoding = &inc->encoding;
+	inc->analog.meaning = &inc->meaning;
+	inc->analog.spec = &inc->spec;
+
+	enc = &inc->encoding;
+	enc->unitsize = inc->unitsize;
+	enc->is_float = inc->fmt_code == WAVE_FORMAT_IEEE_FLOAT_;
+	/* 8-bit PCM samples are unsigned. */
+	enc->is_signed = enc->is_float || inc->unitsize > 1;
+	enc->is_bigendian = FALSE;
+	enc->digits = 0;
+	enc->is_digits_decimal = TRUE;
+	enc->scale.p = 1;
+	if (enc->is_float)
+		enc->scale.q = 1;
+	else if (inc->unitsize == 1)
+		enc->scale.q = UINT8_MAX;
+	else if (inc->unitsize == 2)
+		enc->scale.q = INT16_MAX;
+	else
+		enc->scale.q = INT32_MAX;
+	enc->offset.p = 0;
+	enc->offset.q = 1;
+
+	inc->meaning.mq = 0;
+	inc->meaning.unit = 0;
+	inc->meaning.mqflags = 0;
+	inc->meaning.channels = in->sdi->channels;
+
+	inc->spec.spec_digits = 0;
+
+	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static void send_header(struct sr_input *in)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	int offset, chunk_samples, total_samples, processed, max_chunk_samples;
-	int num_samples, i;
 
 	inc = in->priv;
-	if (!inc->started) {
-		std_session_send_df_header(in->sdi, LOG_PREFIX);
+	if (inc->started)
+		return;
 
-		packet.type = SR_DF_META;
-		packet.payload = &meta;
-		src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
-		meta.config = g_slist_append(NULL, src);
-		sr_session_send(in->sdi, &packet);
-		g_slist_free(meta.config);
-		sr_config_free(src);
+	std_session_send_df_header(in->sdi, LOG_PREFIX);
 
-		inc->started = TRUE;
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
+	meta.config = g_slist_append(NULL, src);
+	sr_session_send(in->sdi, &packet);
+	g_slist_free(meta.config);
+	sr_config_free(src);
+
+	inc->started = TRUE;
+}
+
+/*
+ * Send the complete samples in data as analog packets, and return the
+ * number of bytes sent. The packets point into buf if it isn't NULL.
+ */
+static size_t send_data(struct sr_input *in, const char *data, size_t len,
+		struct sr_buffer *buf)
+{
+	struct context *inc;
+	size_t offset, total_samples, max_chunk_samples, num_samples;
+
+	inc = in->priv;
+
+	total_samples = len / inc->samplesize;
+	max_chunk_samples = MAX(CHUNK_SIZE / inc->samplesize, 1);
+	offset = 0;
+	while (total_samples > 0) {
+		num_samples = MIN(total_samples, max_chunk_samples);
+		inc->analog.data = (char *)data + offset;
+		inc->analog.num_samples = num_samples;
+		sr_session_send_buffer(in->sdi, &inc->packet, buf);
+		offset += num_samples * inc->samplesize;
+		total_samples -= num_samples;
 	}
 
+	return offset;
+}
+
+/*
+ * Send the data stashed in in->buf, followed by the new data. The new
+ * data is sent in place, only an incomplete sample at its end is stashed
+ * for next time.
+ */
+static int process_buffer(struct sr_input *in, const char *data, size_t len)
+{
+	struct context *inc;
+	size_t offset, n;
+	int data_offset;
+
+	inc = in->priv;
+	send_header(in);
+
 	if (!inc->found_data) {
+		g_string_append_len(in->buf, data, len);
+		len = 0;
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
-		offset = find_data_chunk(in->buf, i);
-		if (offset < 0) {
-			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
-				sr_err("Couldn't find data chunk.");
-				return SR_ERR;
-			}
+		data_offset = find_data_chunk(in->buf->str, in->buf->len,
+				20 + RL32(in->buf->str + 16));
+		if (data_offset < 0) {
+			sr_err("Couldn't find data chunk.");
+			return SR_ERR;
 		}
+		if (data_offset == 0)
+			/* Not enough data yet. */
+			return SR_OK;
+		g_string_erase(in->buf, 0, data_offset);
 		inc->found_data = TRUE;
-	} else
-		offset = 0;
-
-	/* Round off up to the last channels * unitsize boundary. */
-	chunk_samples = (in->buf->len - offset) / inc->samplesize;
-	max_chunk_samples = CHUNK_SIZE / inc->samplesize;
-	processed = 0;
-	total_samples = chunk_samples;
-	while (processed < total_samples) {
-		if (chunk_samples > max_chunk_samples)
-			num_samples = max_chunk_samples;
-		else
-			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
-		offset += num_samples * inc->samplesize;
-		chunk_samples -= num_samples;
-		processed += num_samples;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else
-		g_string_truncate(in->buf, 0);
+	offset = 0;
+	if (in->buf->len > 0) {
+		/* Complete the stashed sample first. */
+		n = MIN((inc->samplesize - in->buf->len % inc->samplesize)
+			% inc->samplesize, len);
+		g_string_append_len(in->buf, data, n);
+		offset = n;
+		n = send_data(in, in->buf->str, in->buf->len, NULL);
+		g_string_erase(in->buf, 0, n);
+	}
+
+	if (in->buf->len == 0)
+		offset += send_data(in, data + offset, len - offset, NULL);
+	g_string_append_len(in->buf, data + offset, len - offset);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
-	struct context *inc;
 	int ret;
-	char channelname[8];
+
+	if (in->sdi_ready)
+		return process_buffer(in, buf->str, buf->len);
 
 	g_string_append_len(in->buf, buf->str, buf->len);
 
@@ -316,27 +364,61 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
+	if ((ret = setup_dev_inst(in, in->buf)) == SR_ERR_NA)
+		/* Not enough data yet. */
+		return SR_OK;
+	else if (ret != SR_OK)
+		return ret;
+
+	/* sdi is ready, notify frontend. */
+	in->sdi_ready = TRUE;
+
+	return SR_OK;
+}
+
+static int receive_buffer(struct sr_input *in, struct sr_buffer *buf,
+		size_t *offset)
+{
+	struct context *inc;
+	GString *header;
+	const char *data;
+	size_t size;
+	int ret, data_offset;
+
 	inc = in->priv;
+	data = sr_buffer_data(buf);
+	size = sr_buffer_size(buf);
+
 	if (!in->sdi_ready) {
-		if ((ret = parse_wav_header(in->buf, inc)) == SR_ERR_NA)
-			/* Not enough data yet. */
-			return SR_OK;
-		else if (ret != SR_OK)
+		header = g_string_new_len(data, MIN(size, MAX_DATA_CHUNK_OFFSET));
+		ret = setup_dev_inst(in, header);
+		g_string_free(header, TRUE);
+		if (ret == SR_ERR_NA) {
+			sr_err("File too short.");
+			return SR_ERR_DATA;
+		} else if (ret != SR_OK) {
 			return ret;
-
-		for (int i = 0; i < inc->num_channels; i++) {
-			snprintf(channelname, 8, "CH%d", i + 1);
-			sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
 		}
-
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	send_header(in);
 
-	return ret;
+	if (!inc->found_data) {
+		data_offset = find_data_chunk(data, size, 20 + RL32(data + 16));
+		if (data_offset <= 0) {
+			sr_err("Couldn't find data chunk.");
+			return SR_ERR_DATA;
+		}
+		*offset = data_offset;
+		inc->found_data = TRUE;
+	}
+
+	*offset += send_data(in, data + *offset, size - *offset, buf);
+
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -345,12 +427,17 @@ static int end(struct sr_input *in)
 	struct context *inc;
 	int ret;
 
-	if (in->sdi_ready)
-		ret = process_buffer(in);
-	else
+	inc = in->priv;
+	if (in->sdi_ready) {
+		ret = process_buffer(in, NULL, 0);
+		if (ret == SR_OK && !inc->found_data) {
+			sr_err("Couldn't find data chunk.");
+			ret = SR_ERR_DATA;
+		}
+	} else {
 		ret = SR_OK;
+	}
 
-	inc = in->priv;
 	if (inc->started) {
 		packet.type = SR_DF_END;
 		sr_session_send(in->sdi, &packet);
@@ -368,5 +455,6 @@ SR_PRIV struct sr_input_module input_wav = {
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_buffer = receive_buffer,
 	.end = end,
 };
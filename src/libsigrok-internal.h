@@ -393,6 +393,25 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Process data from a whole input file held in a buffer.
+	 *
+	 * sr_input_load_file() uses this instead of receive() where it is
+	 * available. The module parses the data at @a offset in place and
+	 * moves @a offset past what it has processed. Packets may point into
+	 * the buffer, when sent with sr_session_send_buffer().
+	 *
+	 * Like receive(), this returns early when the device instance has
+	 * just become ready, and is then called again.
+	 *
+	 * This function is optional.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_buffer) (struct sr_input *in, struct sr_buffer *buf,
+			size_t *offset);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -520,6 +539,24 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but the output is appended to <code>out</code>,
+	 * which the caller owns and reuses for many packets. This saves an
+	 * allocation per packet, and lets output go to a file in large
+	 * writes (see sr_output_send_sink()).
+	 *
+	 * A module implements either this or receive().
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param out The string to append the output to. Never NULL.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*append) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet, GString *out);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -651,6 +688,11 @@ struct drv_context {
 	/** sigrok context */
 	struct sr_context *sr_ctx;
 	GSList *instances;
+	/**
+	 * Whether the driver submits all its USB transfers through
+	 * usb_submit_transfer(), so it can run with the USB event thread.
+	 */
+	gboolean usb_event_thread;
 };
 
 /*--- log.c -----------------------------------------------------------------*/
@@ -666,12 +708,35 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 SR_PRIV int sr_log(int loglevel, const char *format, ...) G_GNUC_PRINTF(2, 3);
 #endif
 
+/* The current loglevel, see sr_log_loglevel_set(). */
+extern SR_PRIV int sr_cur_loglevel;
+
+/*
+ * Whether messages of a loglevel are shown. The logging helpers check this
+ * before evaluating their arguments, so disabled messages cost no call.
+ */
+#define sr_log_enabled(loglevel) G_UNLIKELY((loglevel) <= sr_cur_loglevel)
+
+#define sr_log_if(loglevel, ...) \
+	(sr_log_enabled(loglevel) ? sr_log(loglevel, __VA_ARGS__) : SR_OK)
+
 /* Message logging helpers with subsystem-specific prefix string. */
-#define sr_spew(...)	sr_log(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_dbg(...)	sr_log(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
-#define sr_info(...)	sr_log(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_warn(...)	sr_log(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_err(...)	sr_log(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_spew(...)	sr_log_if(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_dbg(...)	sr_log_if(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_info(...)	sr_log_if(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_warn(...)	sr_log_if(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_err(...)	sr_log_if(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
+
+/*--- trace.c ---------------------------------------------------------------*/
+
+/* Whether tracing is enabled, see sr_trace_set(). */
+extern SR_PRIV int sr_trace_active;
+
+/* Record a trace event, if tracing is enabled. */
+#define sr_trace(id, arg1, arg2) do { \
+	if (G_UNLIKELY(sr_trace_active)) \
+		sr_trace_record(id, arg1, arg2); \
+} while (0)
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -758,6 +823,8 @@ SR_PRIV void sr_config_free(struct sr_config *src);
 
 /*--- session.c -------------------------------------------------------------*/
 
+struct session_bus;
+
 struct sr_session {
 	/** Context this session exists in. */
 	struct sr_context *ctx;
@@ -788,6 +855,15 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/** Asynchronous datafeed bus, NULL if packets are sent inline. */
+	struct session_bus *bus;
+	/** Whether datafeed callbacks receive SR_DF_LOGIC_RLE packets. */
+	gboolean logic_rle;
+	/** Whether libusb events are handled by a separate thread. */
+	gboolean usb_thread;
+	/** Error of the first device which failed during the acquisition. */
+	int acq_error;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -796,6 +872,8 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 		void *key);
 SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 		void *key, GSource *source);
+SR_PRIV void sr_session_acquisition_failed(struct sr_session *session,
+		int error);
 SR_PRIV int sr_session_fd_source_add(struct sr_session *session,
 		void *key, gintptr fd, int events, int timeout,
 		sr_receive_data_callback cb, void *cb_data);
@@ -816,11 +894,18 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
 SR_PRIV void sr_packet_free(struct sr_datafeed_packet *packet);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+SR_PRIV struct sr_buffer *sr_buffer_wrap_full(void *data, size_t size,
+		GDestroyNotify notify, void *notify_data);
+
 /*--- session_file.c --------------------------------------------------------*/
 
 #if !HAVE_ZIP_DISCARD
@@ -839,6 +924,7 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_meaning *meaning,
                            struct sr_analog_spec *spec,
                            int digits);
+SR_PRIV void sr_analog_kernels_init(void);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -882,13 +968,29 @@ SR_PRIV int sr_atoi(const char *str, int *ret);
 SR_PRIV int sr_atod(const char *str, double *ret);
 SR_PRIV int sr_atof(const char *str, float *ret);
 SR_PRIV int sr_atof_ascii(const char *str, float *ret);
+SR_PRIV int sr_atod_ascii_len(const char *str, size_t len, double *ret);
+
+/* Buffer size for sr_ftoa(), enough for "-1.23456789e-45". */
+#define SR_FTOA_BUFSIZE 24
+
+SR_PRIV int sr_ftoa(char *buf, float value);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+/* Per-stage masks compiled by soft_trigger_logic_new(). */
+enum {
+	SOFT_TRIGGER_MASK_ZERO,
+	SOFT_TRIGGER_MASK_ONE,
+	SOFT_TRIGGER_MASK_RISING,
+	SOFT_TRIGGER_MASK_FALLING,
+	SOFT_TRIGGER_MASK_EDGE,
+	SOFT_TRIGGER_NUM_MASKS,
+};
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
+	gboolean have_prev;
 	int unitsize;
 	int cur_stage;
 	uint8_t *prev_sample;
@@ -896,6 +998,16 @@ struct soft_trigger_logic {
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* Number of trigger stages; valid is FALSE if one has no matches. */
+	int num_stages;
+	gboolean valid;
+	/* 64-bit words per sample, and num_stages * NUM_MASKS * num_words masks. */
+	int num_words;
+	uint64_t *masks;
+	/* Whether a stage needs the previous sample (edge matches). */
+	gboolean *stage_edges;
+	/* Stage 0 masks replicated over 16 bytes, for unitsize 1/2/4/8. */
+	uint8_t scan_masks[SOFT_TRIGGER_NUM_MASKS][16];
 };
 
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
@@ -905,6 +1017,76 @@ SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
 
+/*--- logic_rle.c -----------------------------------------------------------*/
+
+/* Collects runs and sends them as SR_DF_LOGIC_RLE packets. */
+struct logic_rle {
+	const struct sr_dev_inst *sdi;
+	uint16_t unitsize;
+	uint64_t max_runs;
+	uint64_t num_runs;
+	uint8_t *samples;
+	uint64_t *lengths;
+};
+
+SR_PRIV uint64_t logic_rle_num_samples(const struct sr_datafeed_logic_rle *rle);
+SR_PRIV uint64_t logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t *run, uint64_t *offset, uint8_t *buf, uint64_t max_samples);
+SR_PRIV struct logic_rle *logic_rle_new(const struct sr_dev_inst *sdi,
+		uint16_t unitsize, uint64_t max_runs);
+SR_PRIV void logic_rle_free(struct logic_rle *rle);
+SR_PRIV int logic_rle_add(struct logic_rle *rle, const uint8_t *sample,
+		uint64_t count);
+SR_PRIV int logic_rle_add_samples(struct logic_rle *rle, const uint8_t *buf,
+		uint64_t num_samples);
+SR_PRIV int logic_rle_flush(struct logic_rle *rle);
+
+/*--- ols_decoder.c ---------------------------------------------------------*/
+
+#define OLS_DECODER_RING_SIZE (64 * 1024)
+
+/* Flags for ols_decoder_init(). */
+enum {
+	/* Units with the top bit set are run lengths. */
+	OLS_DECODER_RLE = 1 << 0,
+	/* Demux mode of the OLS: a disabled group 3 takes the place of group 1. */
+	OLS_DECODER_DEMUX = 1 << 1,
+	/* Each unit holds two samples of groups 0 and 1 (Pipistrello demux RLE). */
+	OLS_DECODER_PAIRS = 1 << 2,
+	/* Keep the runs as received instead of expanding them. */
+	OLS_DECODER_RUNS = 1 << 3,
+};
+
+/* Decodes the sample data sent by (Pipistrello) OLS devices. */
+struct ols_decoder {
+	unsigned int unit_size;
+	unsigned int samples_per_unit;
+	/* Unit byte of each sample byte, or -1 for zero. */
+	int8_t map[8];
+	gboolean rle;
+	uint64_t limit_samples;
+	/* Samples, filled from the end, or runs in received order. */
+	uint8_t *samples;
+	GArray *run_samples;
+	GArray *run_lengths;
+	uint64_t num_samples;
+	uint32_t rle_count;
+	uint64_t cnt_bytes;
+	uint64_t cnt_samples;
+	uint64_t cnt_samples_rle;
+	size_t head;
+	size_t tail;
+	uint8_t ring[OLS_DECODER_RING_SIZE];
+};
+
+SR_PRIV int ols_decoder_init(struct ols_decoder *dec, int group_disable,
+		int flags, uint64_t limit_samples);
+SR_PRIV void ols_decoder_clear(struct ols_decoder *dec);
+SR_PRIV uint8_t *ols_decoder_write_ptr(struct ols_decoder *dec, size_t *len);
+SR_PRIV void ols_decoder_commit(struct ols_decoder *dec, size_t len);
+SR_PRIV void ols_decoder_decode(struct ols_decoder *dec);
+SR_PRIV uint8_t *ols_decoder_samples(const struct ols_decoder *dec);
+
 /*--- hardware/serial.c -----------------------------------------------------*/
 
 #ifdef HAVE_LIBSERIALPORT
@@ -968,6 +1150,9 @@ SR_PRIV void sr_usb_close(struct sr_usb_dev_inst *usb);
 SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
+SR_PRIV int usb_submit_transfer(struct sr_session *session,
+		struct libusb_transfer *transfer);
+SR_PRIV gboolean usb_event_thread_supported(const struct sr_dev_inst *sdi);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
 #endif
 
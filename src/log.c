@@ -41,8 +41,11 @@
  * @{
  */
 
-/* Currently selected libsigrok loglevel. Default: SR_LOG_WARN. */
-static int cur_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
+/*
+ * Currently selected libsigrok loglevel. Default: SR_LOG_WARN.
+ * The logging helpers in libsigrok-internal.h check it inline.
+ */
+SR_PRIV int sr_cur_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
 
 /* Function prototype. */
 static int sr_logv(void *cb_data, int loglevel, const char *format,
@@ -89,7 +92,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
 	if (loglevel >= LOGLEVEL_TIMESTAMP && sr_log_start_time == 0)
 		sr_log_start_time = g_get_monotonic_time();
 
-	cur_loglevel = loglevel;
+	sr_cur_loglevel = loglevel;
 
 	sr_dbg("libsigrok loglevel set to %d.", loglevel);
 
@@ -105,7 +108,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
  */
 SR_API int sr_log_loglevel_get(void)
 {
-	return cur_loglevel;
+	return sr_cur_loglevel;
 }
 
 /**
@@ -169,10 +172,10 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	(void)cb_data;
 
 	/* Only output messages of at least the selected loglevel(s). */
-	if (loglevel > cur_loglevel)
+	if (loglevel > sr_cur_loglevel)
 		return SR_OK;
 
-	if (cur_loglevel >= LOGLEVEL_TIMESTAMP) {
+	if (sr_cur_loglevel >= LOGLEVEL_TIMESTAMP) {
 		elapsed_us = g_get_monotonic_time() - sr_log_start_time;
 
 		minutes = elapsed_us / G_TIME_SPAN_MINUTE;
@@ -199,6 +202,10 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 	int ret;
 	va_list args;
 
+	/* Only output messages of at least the selected loglevel(s). */
+	if (loglevel > sr_cur_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
 	va_end(args);
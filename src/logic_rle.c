@@ -0,0 +1,219 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "logic-rle"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Helpers for run-length encoded logic packets (SR_DF_LOGIC_RLE).
+ */
+
+/** Total number of samples in a run-length encoded logic packet. */
+SR_PRIV uint64_t logic_rle_num_samples(const struct sr_datafeed_logic_rle *rle)
+{
+	uint64_t i, num_samples;
+
+	num_samples = 0;
+	for (i = 0; i < rle->num_runs; i++)
+		num_samples += rle->lengths[i];
+
+	return num_samples;
+}
+
+/* Fill buf with count copies of a sample, doubling the filled part. */
+static void fill_samples(uint8_t *buf, const uint8_t *sample,
+		uint16_t unitsize, uint64_t count)
+{
+	uint64_t done, n;
+
+	if (count == 0)
+		return;
+
+	if (unitsize == 1) {
+		memset(buf, sample[0], count);
+		return;
+	}
+
+	memcpy(buf, sample, unitsize);
+	for (done = 1; done < count; done += n) {
+		n = MIN(done, count - done);
+		memcpy(buf + done * unitsize, buf, n * unitsize);
+	}
+}
+
+/**
+ * Expand a run-length encoded logic packet into plain samples.
+ *
+ * Expansion starts at sample @a offset of run @a run. Both are advanced
+ * past the expanded samples, so the packet can be expanded piecewise into
+ * a buffer of fixed size.
+ *
+ * @param rle The packet payload.
+ * @param run Index of the current run.
+ * @param offset Offset into the current run.
+ * @param buf Buffer for at least max_samples * unitsize bytes.
+ * @param max_samples Maximum number of samples to expand.
+ *
+ * @return Number of samples written to buf, 0 once the packet is done.
+ */
+SR_PRIV uint64_t logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t *run, uint64_t *offset, uint8_t *buf, uint64_t max_samples)
+{
+	const uint8_t *samples;
+	uint64_t done, n;
+
+	samples = rle->samples;
+	done = 0;
+	while (done < max_samples && *run < rle->num_runs) {
+		n = MIN(rle->lengths[*run] - *offset, max_samples - done);
+		fill_samples(buf + done * rle->unitsize,
+				samples + *run * rle->unitsize, rle->unitsize, n);
+		done += n;
+		*offset += n;
+		if (*offset == rle->lengths[*run]) {
+			(*run)++;
+			*offset = 0;
+		}
+	}
+
+	return done;
+}
+
+/**
+ * Create a collector for run-length encoded logic data.
+ *
+ * @param sdi The device instance the packets are sent for.
+ * @param unitsize Number of bytes per sample.
+ * @param max_runs Number of runs collected before a packet is sent.
+ *
+ * @return The new collector. Must be freed with logic_rle_free().
+ */
+SR_PRIV struct logic_rle *logic_rle_new(const struct sr_dev_inst *sdi,
+		uint16_t unitsize, uint64_t max_runs)
+{
+	struct logic_rle *rle;
+
+	rle = g_malloc0(sizeof(struct logic_rle));
+	rle->sdi = sdi;
+	rle->unitsize = unitsize;
+	rle->max_runs = MAX(max_runs, 1);
+	rle->samples = g_malloc(rle->max_runs * unitsize);
+	rle->lengths = g_malloc(rle->max_runs * sizeof(uint64_t));
+
+	return rle;
+}
+
+/** Free a collector. Runs not yet sent are discarded. */
+SR_PRIV void logic_rle_free(struct logic_rle *rle)
+{
+	if (!rle)
+		return;
+
+	g_free(rle->samples);
+	g_free(rle->lengths);
+	g_free(rle);
+}
+
+/**
+ * Append count repetitions of a sample.
+ *
+ * A run of the same sample as the previous one is merged into it. Once
+ * max_runs runs are collected, they are sent as one packet.
+ */
+SR_PRIV int logic_rle_add(struct logic_rle *rle, const uint8_t *sample,
+		uint64_t count)
+{
+	uint8_t *last;
+	int ret;
+
+	if (count == 0)
+		return SR_OK;
+
+	if (rle->num_runs > 0) {
+		last = rle->samples + (rle->num_runs - 1) * rle->unitsize;
+		if (!memcmp(last, sample, rle->unitsize)) {
+			rle->lengths[rle->num_runs - 1] += count;
+			return SR_OK;
+		}
+	}
+
+	if (rle->num_runs == rle->max_runs) {
+		if ((ret = logic_rle_flush(rle)) != SR_OK)
+			return ret;
+	}
+
+	memcpy(rle->samples + rle->num_runs * rle->unitsize, sample,
+			rle->unitsize);
+	rle->lengths[rle->num_runs] = count;
+	rle->num_runs++;
+
+	return SR_OK;
+}
+
+/** Append plain samples, compressing them into runs. */
+SR_PRIV int logic_rle_add_samples(struct logic_rle *rle, const uint8_t *buf,
+		uint64_t num_samples)
+{
+	uint64_t i, start;
+	uint16_t unitsize;
+	int ret;
+
+	unitsize = rle->unitsize;
+	for (start = 0; start < num_samples; start = i) {
+		for (i = start + 1; i < num_samples; i++) {
+			if (memcmp(buf + i * unitsize, buf + start * unitsize,
+					unitsize))
+				break;
+		}
+		ret = logic_rle_add(rle, buf + start * unitsize, i - start);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/** Send the collected runs, if any, as an SR_DF_LOGIC_RLE packet. */
+SR_PRIV int logic_rle_flush(struct logic_rle *rle)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_rle payload;
+	int ret;
+
+	if (rle->num_runs == 0)
+		return SR_OK;
+
+	payload.num_runs = rle->num_runs;
+	payload.unitsize = rle->unitsize;
+	payload.samples = rle->samples;
+	payload.lengths = rle->lengths;
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &payload;
+	ret = sr_session_send(rle->sdi, &packet);
+	rle->num_runs = 0;
+
+	return ret;
+}
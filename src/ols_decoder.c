@@ -0,0 +1,247 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "ols-decoder"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Sample decoder shared by the OLS and Pipistrello OLS drivers.
+ *
+ * The devices send their sample memory backwards, as little endian units
+ * of one byte per enabled channel group. In RLE mode, a unit with the top
+ * bit of its last byte set is the number of times the next unit repeats.
+ * Received bytes are collected in a ring buffer, and all whole units in it
+ * are decoded at once into 4-byte samples, which are stored from the end
+ * of the sample buffer towards its start.
+ */
+
+#define RING_MASK (OLS_DECODER_RING_SIZE - 1)
+
+/**
+ * Set up a decoder for an acquisition.
+ *
+ * @param dec The decoder.
+ * @param group_disable The channel group disable bits of the flag
+ *                      register, bit 0 is group 0.
+ * @param flags OLS_DECODER_RLE, OLS_DECODER_DEMUX, OLS_DECODER_PAIRS and
+ *              OLS_DECODER_RUNS.
+ * @param limit_samples The number of samples to keep.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_MALLOC The sample buffer could not be allocated.
+ */
+SR_PRIV int ols_decoder_init(struct ols_decoder *dec, int group_disable,
+		int flags, uint64_t limit_samples)
+{
+	int i, j, num_groups;
+
+	if (!dec || limit_samples == 0)
+		return SR_ERR_ARG;
+	if ((flags & OLS_DECODER_PAIRS) && (flags & OLS_DECODER_RUNS))
+		return SR_ERR_ARG;
+
+	memset(dec, 0, sizeof(*dec));
+	dec->rle = (flags & OLS_DECODER_RLE) != 0;
+	dec->limit_samples = limit_samples;
+	memset(dec->map, -1, sizeof(dec->map));
+
+	if (flags & OLS_DECODER_PAIRS) {
+		/*
+		 * Two samples of channel groups 0 and 1 per unit. The second
+		 * one goes first, as the buffer is filled backwards.
+		 */
+		dec->samples_per_unit = 2;
+		j = 0;
+		for (i = 0; i < 8; i++)
+			if (!(group_disable & (1 << (i % 4))) && i % 4 < 2)
+				dec->map[(i + 4) % 8] = j++;
+		num_groups = j;
+	} else {
+		dec->samples_per_unit = 1;
+		j = 0;
+		for (i = 0; i < 4; i++) {
+			if (!(group_disable & (1 << i)))
+				dec->map[i] = j++;
+			else if ((flags & OLS_DECODER_DEMUX) && i > 2)
+				/* Group 3 is added to group 1. */
+				dec->map[i - 2] = j++;
+		}
+		num_groups = 0;
+		for (i = 0; i < 4; i++)
+			if (!(group_disable & (1 << i)))
+				num_groups++;
+		/* Bytes beyond the unit read as zero. */
+		for (i = 0; i < 4; i++)
+			if (dec->map[i] >= num_groups)
+				dec->map[i] = -1;
+	}
+	dec->unit_size = num_groups;
+	if (dec->unit_size == 0)
+		return SR_ERR_ARG;
+
+	if (flags & OLS_DECODER_RUNS) {
+		dec->run_samples = g_array_new(FALSE, FALSE, 4);
+		dec->run_lengths = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	} else {
+		dec->samples = g_try_malloc(limit_samples * 4);
+		if (!dec->samples) {
+			sr_err("Sample buffer malloc failed.");
+			return SR_ERR_MALLOC;
+		}
+	}
+
+	return SR_OK;
+}
+
+/** Free the buffers of a decoder. It can be called more than once. */
+SR_PRIV void ols_decoder_clear(struct ols_decoder *dec)
+{
+	g_free(dec->samples);
+	dec->samples = NULL;
+	if (dec->run_samples)
+		g_array_free(dec->run_samples, TRUE);
+	if (dec->run_lengths)
+		g_array_free(dec->run_lengths, TRUE);
+	dec->run_samples = dec->run_lengths = NULL;
+}
+
+/**
+ * Get the free space in the ring buffer, to read bytes into.
+ *
+ * @param dec The decoder.
+ * @param len Returns the number of contiguous free bytes.
+ *
+ * @return The start of the free space.
+ */
+SR_PRIV uint8_t *ols_decoder_write_ptr(struct ols_decoder *dec, size_t *len)
+{
+	size_t head;
+
+	head = dec->head & RING_MASK;
+	*len = MIN(OLS_DECODER_RING_SIZE - (dec->head - dec->tail),
+			OLS_DECODER_RING_SIZE - head);
+
+	return dec->ring + head;
+}
+
+/** Add len bytes read to ols_decoder_write_ptr() to the ring buffer. */
+SR_PRIV void ols_decoder_commit(struct ols_decoder *dec, size_t len)
+{
+	dec->head += len;
+	dec->cnt_bytes += len;
+}
+
+/* Store n samples of the pattern in front of the samples stored so far. */
+static void store_samples(struct ols_decoder *dec, const uint8_t *pattern,
+		uint64_t n)
+{
+	uint8_t *dest;
+	uint64_t i;
+
+	if (dec->run_samples) {
+		/* Runs are put in order when they are sent. */
+		g_array_append_vals(dec->run_samples, pattern, 1);
+		g_array_append_val(dec->run_lengths, n);
+		return;
+	}
+
+	dest = dec->samples + (dec->limit_samples - dec->num_samples) * 4;
+	if (dec->samples_per_unit == 1) {
+		for (i = 0; i < n; i++)
+			memcpy(dest + i * 4, pattern, 4);
+	} else {
+		for (i = 0; i < n; i++)
+			memcpy(dest + i * 4, pattern + (i & 1) * 4, 4);
+	}
+}
+
+/**
+ * Decode all whole units in the ring buffer.
+ *
+ * Once limit_samples samples have been stored, further bytes are dropped.
+ */
+SR_PRIV void ols_decoder_decode(struct ols_decoder *dec)
+{
+	uint8_t tmp[4], pattern[8];
+	const uint8_t *unit;
+	size_t tail, first;
+	uint64_t n;
+	uint32_t count;
+	unsigned int i, unit_size, num_bytes;
+
+	unit_size = dec->unit_size;
+	num_bytes = dec->samples_per_unit * 4;
+
+	while (dec->head - dec->tail >= unit_size) {
+		if (dec->num_samples >= dec->limit_samples) {
+			dec->tail = dec->head;
+			break;
+		}
+
+		tail = dec->tail & RING_MASK;
+		if (tail + unit_size <= OLS_DECODER_RING_SIZE) {
+			unit = dec->ring + tail;
+		} else {
+			/* The unit wraps around the end of the ring. */
+			first = OLS_DECODER_RING_SIZE - tail;
+			memcpy(tmp, dec->ring + tail, first);
+			memcpy(tmp + first, dec->ring, unit_size - first);
+			unit = tmp;
+		}
+		dec->tail += unit_size;
+		dec->cnt_samples += dec->samples_per_unit;
+		dec->cnt_samples_rle += dec->samples_per_unit;
+
+		if (dec->rle && (unit[unit_size - 1] & 0x80)) {
+			count = 0;
+			for (i = unit_size; i-- > 0; )
+				count = (count << 8) | unit[i];
+			dec->rle_count = count & ~(0x80u << (unit_size - 1) * 8);
+			dec->cnt_samples_rle += (uint64_t)dec->rle_count
+				* dec->samples_per_unit;
+			continue;
+		}
+
+		for (i = 0; i < num_bytes; i++)
+			pattern[i] = dec->map[i] >= 0 ? unit[dec->map[i]] : 0;
+
+		n = ((uint64_t)dec->rle_count + 1) * dec->samples_per_unit;
+		/* Save us from overrunning the buffer. */
+		n = MIN(n, dec->limit_samples - dec->num_samples);
+		dec->num_samples += n;
+		store_samples(dec, pattern, n);
+		dec->rle_count = 0;
+	}
+}
+
+/**
+ * Get the stored samples, in order. There are num_samples of them.
+ */
+SR_PRIV uint8_t *ols_decoder_samples(const struct ols_decoder *dec)
+{
+	return dec->samples + (dec->limit_samples - dec->num_samples) * 4;
+}
@@ -27,6 +27,22 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Longest text written by write_u64(). */
+#define SAMPLENUM_MAXLEN 20
+
+/*
+ * A run of columns in a logic row. Logic columns of channels in the same
+ * byte of a sample are written by a lookup in a table of the text for
+ * each value of that byte, with the separators. Analog columns stay empty,
+ * only their separators are written. Every table entry is 16 bytes long,
+ * so it is copied as a whole and the next group overwrites the rest.
+ */
+struct column_group {
+	unsigned int byte;
+	unsigned int len;
+	char (*text)[16];
+};
+
 struct context {
 	unsigned int num_enabled_channels;
 	uint64_t samplerate;
@@ -34,6 +50,19 @@ struct context {
 	gboolean header_done;
 	struct sr_channel **channels;
 
+	/* Logic rows, including the newline, and the bytes of a sample used. */
+	struct column_group *groups;
+	unsigned int num_groups;
+	unsigned int row_len;
+	unsigned int unitsize;
+
+	/* Only write the samples that differ in the enabled channels. */
+	gboolean changes_only;
+	uint8_t *mask;
+	uint8_t *prev_sample;
+	uint64_t samplenum;
+	uint64_t last_written;
+
 	/* For analog measurements split into frames, not packets. */
 	struct sr_channel **analog_channels;
 	float *analog_vals; /* Analog values stored until the end of the frame. */
@@ -47,12 +76,58 @@ struct context {
  *  - Option to (not) print metadata as comments.
  *  - Option to specify the comment character(s), e.g. # or ; or C/C++-style.
  *  - Option to (not) print samplenumber / time as extra column.
- *  - Option to "compress" output (only print changed samples, VCD-like).
  *  - Option to print comma-separated bits, or whole bytes/words (for 8/16
  *    channel LAs) as ASCII/hex etc. etc.
  *  - Trigger support.
  */
 
+/* Set up the column groups of logic rows, and the mask of the channels. */
+static void init_groups(struct context *ctx)
+{
+	struct column_group *g;
+	struct sr_channel *ch;
+	unsigned int i, v, byte, bit;
+
+	for (i = 0; i < ctx->num_enabled_channels; i++) {
+		ch = ctx->channels[i];
+		if (ch->type == SR_CHANNEL_LOGIC)
+			ctx->unitsize = MAX(ctx->unitsize, (unsigned int)ch->index / 8 + 1);
+	}
+	ctx->groups = g_malloc0(sizeof(struct column_group)
+			* ctx->num_enabled_channels);
+	ctx->mask = g_malloc0(MAX(ctx->unitsize, 1));
+	ctx->prev_sample = g_malloc0(MAX(ctx->unitsize, 1));
+
+	g = NULL;
+	for (i = 0; i < ctx->num_enabled_channels; i++) {
+		ch = ctx->channels[i];
+		if (ch->type != SR_CHANNEL_LOGIC) {
+			if (!g || g->text)
+				g = &ctx->groups[ctx->num_groups++];
+			g->len++;
+			continue;
+		}
+		byte = ch->index / 8;
+		bit = ch->index % 8;
+		if (!g || !g->text || g->byte != byte || g->len == 16) {
+			g = &ctx->groups[ctx->num_groups++];
+			g->byte = byte;
+			g->text = g_malloc0(256 * sizeof(*g->text));
+		}
+		for (v = 0; v < 256; v++) {
+			g->text[v][g->len] = '0' + ((v >> bit) & 1);
+			g->text[v][g->len + 1] = ctx->separator;
+		}
+		g->len += 2;
+		ctx->mask[byte] |= 1 << bit;
+	}
+
+	for (i = 0; i < ctx->num_groups; i++)
+		ctx->row_len += ctx->groups[i].len;
+	/* The last separator becomes the newline. */
+	ctx->row_len = MAX(ctx->row_len, 1);
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -60,14 +135,14 @@ static int init(struct sr_output *o, GHashTable *options)
 	GSList *l;
 	int i, j;
 
-	(void)options;
-
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	ctx = g_malloc0(sizeof(struct context));
 	o->priv = ctx;
 	ctx->separator = ',';
+	ctx->changes_only = g_variant_get_boolean(
+			g_hash_table_lookup(options, "changes"));
 
 	/* Get the number of channels, and the unitsize. */
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -99,6 +174,8 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	}
 
+	init_groups(ctx);
+
 	return SR_OK;
 }
 
@@ -149,19 +226,153 @@ static GString *gen_header(const struct sr_output *o)
 		g_string_append_printf(header, "; Samplerate: %s\n", samplerate_s);
 		g_free(samplerate_s);
 	}
+	if (ctx->changes_only)
+		g_string_append(header, "; Changed samples only, "
+				"the first column is the sample number\n");
 
 	return header;
 }
 
-static void init_output(GString **out, struct context *ctx,
+static void init_output(GString *out, struct context *ctx,
 			const struct sr_output *o)
 {
+	GString *header;
+
 	if (!ctx->header_done) {
-		*out = gen_header(o);
+		header = gen_header(o);
+		g_string_append_len(out, header->str, header->len);
+		g_string_free(header, TRUE);
 		ctx->header_done = TRUE;
+	}
+}
+
+/* Write n in decimal, without a terminating NUL. */
+static char *write_u64(char *p, uint64_t n)
+{
+	char digits[SAMPLENUM_MAXLEN];
+	int i;
+
+	i = 0;
+	do {
+		digits[i++] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	while (i)
+		*p++ = digits[--i];
+
+	return p;
+}
+
+/* Write the row of a logic sample. Up to 16 bytes after it are clobbered. */
+static char *write_logic_row(const struct context *ctx, char *p,
+		const uint8_t *sample)
+{
+	const struct column_group *g;
+	char *row;
+	unsigned int i;
+
+	row = p;
+	for (i = 0; i < ctx->num_groups; i++) {
+		g = &ctx->groups[i];
+		if (g->text)
+			memcpy(p, g->text[sample[g->byte]], 16);
+		else
+			memset(p, ctx->separator, g->len);
+		p += g->len;
+	}
+	p = row + ctx->row_len;
+	p[-1] = '\n';
+
+	return p;
+}
+
+static gboolean sample_changed(const struct context *ctx,
+		const uint8_t *prev, const uint8_t *sample)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->unitsize; i++) {
+		if ((prev[i] ^ sample[i]) & ctx->mask[i])
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Make room for len more bytes at p, which may move. */
+static char *reserve(GString *out, char *p, size_t len)
+{
+	size_t pos;
+
+	pos = p - out->str;
+	if (pos + len > out->len) {
+		g_string_set_size(out, MAX(2 * out->len, pos + len));
+		p = out->str + pos;
+	}
+
+	return p;
+}
+
+static char *write_changed_row(struct context *ctx, GString *out, char *p,
+		const uint8_t *sample, uint64_t samplenum)
+{
+	p = reserve(out, p, SAMPLENUM_MAXLEN + 1 + ctx->row_len + 16);
+	p = write_u64(p, samplenum);
+	*p++ = ctx->separator;
+	p = write_logic_row(ctx, p, sample);
+	ctx->last_written = samplenum;
+
+	return p;
+}
+
+static int write_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data, *sample, *prev;
+	uint64_t i, num_samples;
+	char *p;
+
+	if (logic->unitsize < ctx->unitsize) {
+		sr_err("Unitsize %d is too small for the enabled channels.",
+			logic->unitsize);
+		return SR_ERR_ARG;
+	}
+	data = logic->data;
+	num_samples = logic->length / logic->unitsize;
+	if (!num_samples)
+		return SR_OK;
+
+	p = out->str + out->len;
+	if (!ctx->changes_only) {
+		p = reserve(out, p, num_samples * ctx->row_len + 16);
+		for (i = 0; i < num_samples; i++)
+			p = write_logic_row(ctx, p, data + i * logic->unitsize);
 	} else {
-		*out = g_string_sized_new(512);
+		prev = ctx->samplenum ? ctx->prev_sample : NULL;
+		for (i = 0; i < num_samples; i++) {
+			sample = data + i * logic->unitsize;
+			if (prev && !sample_changed(ctx, prev, sample))
+				continue;
+			p = write_changed_row(ctx, out, p, sample,
+					ctx->samplenum + i);
+			prev = sample;
+		}
+		memcpy(ctx->prev_sample, data + (num_samples - 1) * logic->unitsize,
+				ctx->unitsize);
 	}
+	g_string_truncate(out, p - out->str);
+	ctx->samplenum += num_samples;
+
+	return SR_OK;
+}
+
+static void append_float(GString *out, float value)
+{
+	char buf[SR_FTOA_BUFSIZE];
+	int len;
+
+	len = sr_ftoa(buf, value);
+	g_string_append_len(out, buf, len);
 }
 
 static void handle_analog_frame(struct context *ctx, GSList *channels,
@@ -187,8 +398,8 @@ static void handle_analog_frame(struct context *ctx, GSList *channels,
 	}
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int append(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
@@ -199,12 +410,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	float *data;
 	GSList *l, *channels;
 	struct context *ctx;
-	int idx;
 	uint64_t i, j, k, nums, numch;
-	gchar *p, c;
+	char *p;
 	int ret = SR_OK;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -236,37 +445,19 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		init_output(out, ctx, o);
 
 		for (i = 0, j = 0; i < ctx->num_enabled_channels; i++) {
-			if (ctx->channels[i]->type == SR_CHANNEL_ANALOG) {
-				g_string_append_printf(*out, "%f",
-							ctx->analog_vals[j++]);
-			}
-			g_string_append_c(*out, ctx->separator);
+			if (ctx->channels[i]->type == SR_CHANNEL_ANALOG)
+				append_float(out, ctx->analog_vals[j++]);
+			g_string_append_c(out, ctx->separator);
 		}
-		g_string_truncate(*out, (*out)->len - 1);
-		g_string_append_printf(*out, "\n");
+		g_string_truncate(out, out->len - 1);
+		g_string_append_printf(out, "\n");
 
 		ctx->inframe = FALSE;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
 		init_output(out, ctx, o);
-
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				if (ctx->channels[j]->type == SR_CHANNEL_LOGIC) {
-					idx = ctx->channels[j]->index;
-					p = logic->data + i + idx / 8;
-					c = *p & (1 << (idx % 8));
-					g_string_append_c(*out, c ? '1' : '0');
-				}
-				g_string_append_c(*out, ctx->separator);
-			}
-			if (j) {
-				/* Drop last separator. */
-				g_string_truncate(*out, (*out)->len - 1);
-			}
-			g_string_append_printf(*out, "\n");
-		}
+		ret = write_logic(ctx, out, logic);
 		break;
 	case SR_DF_ANALOG_OLD:
 	case SR_DF_ANALOG:
@@ -284,12 +475,16 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			num_samples = analog->num_samples;
 			data = g_malloc(sizeof(float) * num_samples * numch);
 			ret = sr_analog_to_float(analog, data);
-			if (ret != SR_OK)
+			if (ret != SR_OK) {
+				g_free(data);
 				return ret;
+			}
 		}
 
 		if (ctx->inframe) {
 			handle_analog_frame(ctx, channels, num_samples, data);
+			if (packet->type == SR_DF_ANALOG)
+				g_free(data);
 			break;
 		}
 
@@ -308,17 +503,27 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 					if (!l)
 						l = channels;
 
-					if (ctx->channels[j] == l->data) {
-						g_string_append_printf(*out,
-							"%f", data[k++]);
-					}
+					if (ctx->channels[j] == l->data)
+						append_float(out, data[k++]);
 
 					l = l->next;
 				}
-				g_string_append_c(*out, ctx->separator);
+				g_string_append_c(out, ctx->separator);
 			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append_printf(*out, "\n");
+			g_string_truncate(out, out->len - 1);
+			g_string_append_printf(out, "\n");
+		}
+		if (packet->type == SR_DF_ANALOG)
+			g_free(data);
+		break;
+	case SR_DF_END:
+		/* Show where the capture ends, if the last sample was dropped. */
+		if (ctx->changes_only && ctx->samplenum
+				&& ctx->last_written != ctx->samplenum - 1) {
+			init_output(out, ctx, o);
+			p = write_changed_row(ctx, out, out->str + out->len,
+					ctx->prev_sample, ctx->samplenum - 1);
+			g_string_truncate(out, p - out->str);
 		}
 		break;
 	}
@@ -329,12 +534,18 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	if (o->priv) {
 		ctx = o->priv;
+		for (i = 0; i < ctx->num_groups; i++)
+			g_free(ctx->groups[i].text);
+		g_free(ctx->groups);
+		g_free(ctx->mask);
+		g_free(ctx->prev_sample);
 		g_free(ctx->channels);
 		g_free(ctx->analog_channels);
 		g_free(ctx->analog_vals);
@@ -345,14 +556,27 @@ static int cleanup(struct sr_output *o)
 	return SR_OK;
 }
 
+static struct sr_option options[] = {
+	{ "changes", "Changes only", "Only write samples that differ from the previous one, with their sample number", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+
+	return options;
+}
+
 SR_PRIV struct sr_output_module output_csv = {
 	.id = "csv",
 	.name = "CSV",
 	.desc = "Comma-separated values",
 	.exts = (const char*[]){"csv", NULL},
 	.flags = 0,
-	.options = NULL,
+	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.append = append,
 	.cleanup = cleanup,
 };
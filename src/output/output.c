@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -26,6 +28,16 @@
 #define LOG_PREFIX "output"
 /** @endcond */
 
+/* Output gathered by a file descriptor sink before it is written. */
+#define SINK_FLUSH_SIZE (256 * 1024)
+
+struct sr_output_sink {
+	/* Output not yet taken by the caller, or not yet written. */
+	GString *buf;
+	/* File descriptor the output is written to, or -1. */
+	int fd;
+};
+
 /**
  * @file
  *
@@ -49,6 +61,11 @@
  * Output modules generate a newly allocated GString. The caller is then
  * expected to free this with g_string_free() when finished with it.
  *
+ * Alternatively, the output can go to an output sink, see
+ * sr_output_send_sink(). A sink either gathers the output in a string
+ * which the caller reuses, or writes it to a file descriptor in large
+ * pieces, without allocating anything per packet.
+ *
  * @{
  */
 
@@ -323,18 +340,271 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/* Number of samples per SR_DF_LOGIC packet expanded from SR_DF_LOGIC_RLE. */
+#define RLE_EXPAND_CHUNK (64 * 1024)
+
+/* Pass a packet to a module, appending its output to out. */
+static int module_append(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	GString *chunk_out;
+	int ret;
+
+	if (o->module->append)
+		return o->module->append(o, packet, out);
+
+	chunk_out = NULL;
+	ret = o->module->receive(o, packet, &chunk_out);
+	if (chunk_out) {
+		g_string_append_len(out, chunk_out->str, chunk_out->len);
+		g_string_free(chunk_out, TRUE);
+	}
+
+	return ret;
+}
+
+/* Pass a run-length encoded packet to a module as logic packets. */
+static int send_expanded(const struct sr_output *o,
+		const struct sr_datafeed_logic_rle *rle, GString *out)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t run, offset, num_samples;
+	int ret;
+
+	num_samples = MIN(logic_rle_num_samples(rle), RLE_EXPAND_CHUNK);
+	if (num_samples == 0)
+		return SR_OK;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	logic.data = g_malloc(num_samples * rle->unitsize);
+	run = offset = 0;
+	ret = SR_OK;
+	while ((logic.length = logic_rle_expand(rle, &run, &offset,
+			logic.data, num_samples) * rle->unitsize)) {
+		if ((ret = module_append(o, &packet, out)) != SR_OK)
+			break;
+	}
+	g_free(logic.data);
+
+	return ret;
+}
+
+/* Pass a packet to a module, expanding it if needed. */
+static int output_append(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	if (packet->type == SR_DF_LOGIC_RLE
+			&& !(o->module->flags & SR_OUTPUT_LOGIC_RLE))
+		return send_expanded(o, packet->payload, out);
+
+	return module_append(o, packet, out);
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * SR_DF_LOGIC_RLE packets are expanded into SR_DF_LOGIC packets for
+ * modules without the SR_OUTPUT_LOGIC_RLE flag.
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	GString *buf;
+	int ret;
+
+	if (!o->module->append && (packet->type != SR_DF_LOGIC_RLE
+			|| (o->module->flags & SR_OUTPUT_LOGIC_RLE)))
+		return o->module->receive(o, packet, out);
+
+	buf = g_string_sized_new(512);
+	ret = output_append(o, packet, buf);
+	if (buf->len > 0) {
+		*out = buf;
+	} else {
+		*out = NULL;
+		g_string_free(buf, TRUE);
+	}
+
+	return ret;
+}
+
+/**
+ * Create an output sink which gathers output in a string.
+ *
+ * The caller takes the output from the string returned by
+ * sr_output_sink_buffer_get() as it likes, and truncates it afterwards.
+ * Its memory is kept for more output.
+ *
+ * @return A new sink. Must be freed with sr_output_sink_free().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new(void)
+{
+	struct sr_output_sink *sink;
+
+	sink = g_malloc0(sizeof(struct sr_output_sink));
+	sink->buf = g_string_sized_new(SINK_FLUSH_SIZE);
+	sink->fd = -1;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which writes output to a file descriptor.
+ *
+ * Output is written once 256 KiB have been gathered, after an SR_DF_END
+ * packet, and by sr_output_sink_flush().
+ *
+ * @param fd The file descriptor to write to. It isn't closed by the sink.
+ *
+ * @return A new sink, or NULL if @a fd is invalid. Must be freed with
+ *         sr_output_sink_free().
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd)
+{
+	struct sr_output_sink *sink;
+
+	if (fd < 0)
+		return NULL;
+
+	sink = sr_output_sink_new();
+	sink->fd = fd;
+
+	return sink;
+}
+
+/**
+ * Get the string in which an output sink gathers output.
+ *
+ * @param sink The sink. Must not be NULL.
+ *
+ * @return The string, which remains owned by the sink. For a file
+ *         descriptor sink, it holds the output not yet written.
+ *
+ * @since 0.5.0
+ */
+SR_API GString *sr_output_sink_buffer_get(struct sr_output_sink *sink)
+{
+	return sink->buf;
+}
+
+/**
+ * Write the output gathered by a file descriptor sink.
+ *
+ * Does nothing for other sinks.
+ *
+ * @param sink The sink. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The output could not be written. What was not
+ *         written is kept.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink)
+{
+	gsize done;
+	gssize n;
+
+	if (!sink)
+		return SR_ERR_ARG;
+
+	if (sink->fd < 0)
+		return SR_OK;
+
+	done = 0;
+	while (done < sink->buf->len) {
+		n = write(sink->fd, sink->buf->str + done, sink->buf->len - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			sr_err("Failed to write output: %s.", g_strerror(errno));
+			g_string_erase(sink->buf, 0, done);
+			return SR_ERR_IO;
+		}
+		done += n;
+	}
+	g_string_truncate(sink->buf, 0);
+
+	return SR_OK;
+}
+
+/**
+ * Free an output sink, writing any output it still holds.
+ *
+ * @param sink The sink.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The remaining output could not be written.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_output_sink_free(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+
+	ret = sr_output_sink_flush(sink);
+	g_string_free(sink->buf, TRUE);
+	g_free(sink);
+
+	return ret;
+}
+
+/**
+ * Send a packet to the specified output instance, with the output going
+ * to a sink.
+ *
+ * Output modules which support it append their output to the sink
+ * directly. Other modules' output is copied there.
+ *
+ * SR_DF_LOGIC_RLE packets are expanded into SR_DF_LOGIC packets for
+ * modules without the SR_OUTPUT_LOGIC_RLE flag.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param packet The packet. Must not be NULL.
+ * @param sink The sink to send the output to. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The output could not be written.
+ * @retval other Error code of the output module.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!o || !packet || !sink)
+		return SR_ERR_ARG;
+
+	ret = output_append(o, packet, sink->buf);
+
+	if (sink->fd >= 0 && (sink->buf->len >= SINK_FLUSH_SIZE
+			|| packet->type == SR_DF_END)) {
+		if (sr_output_sink_flush(sink) != SR_OK && ret == SR_OK)
+			ret = SR_ERR_IO;
+	}
+
+	return ret;
 }
 
 /**
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <zip.h>
@@ -29,18 +30,43 @@
 
 #define LOG_PREFIX "output/srzip"
 
+/* Default size of the logic data chunks written in streaming mode. */
+#define DEFAULT_CHUNKSIZE (4 * 1024 * 1024)
+
 struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
+
+	/*
+	 * Streaming mode: the archive stays open for the whole acquisition.
+	 * Logic data is coalesced into chunk_buf and every full chunk is
+	 * written out to a temporary file, which the archive entries refer
+	 * to. libzip only reads the chunks back (once) when the archive is
+	 * closed at the end of the stream, so the file is a valid session
+	 * only after SR_DF_END. With a flush interval, the archive is also
+	 * closed and reopened that often, which writes out and compresses
+	 * the chunks so far.
+	 */
+	gboolean stream;
+	uint64_t chunksize;
+	int64_t flush_interval;
+	struct zip *archive;
+	char *metabuf;
+	char *tmpname;
+	FILE *tmpfile;
+	uint64_t tmp_offset;
+	unsigned int chunk_num;
+	int unitsize;
+	uint8_t *chunk_buf;
+	uint64_t chunk_fill;
+	int64_t last_checkpoint;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -48,23 +74,28 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->stream = g_variant_get_boolean(g_hash_table_lookup(options,
+			"stream"));
+	outc->chunksize = g_variant_get_uint64(g_hash_table_lookup(options,
+			"chunksize"));
+	outc->flush_interval = g_variant_get_uint32(g_hash_table_lookup(options,
+			"flush-interval")) * (int64_t)1000;
+	if (outc->chunksize == 0)
+		outc->chunksize = DEFAULT_CHUNKSIZE;
 	o->priv = outc;
 
 	return SR_OK;
 }
 
-static int zip_create(const struct sr_output *o)
+static GKeyFile *metadata_new(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
 	struct sr_channel *ch;
 	GVariant *gvar;
 	GKeyFile *meta;
 	GSList *l;
 	const char *devgroup;
-	char *s, *metabuf;
-	gsize metalen;
+	char *s;
 
 	outc = o->priv;
 
@@ -74,23 +105,6 @@ static int zip_create(const struct sr_output *o)
 		g_variant_unref(gvar);
 	}
 
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	g_unlink(outc->filename);
-	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
-	if (!zipfile)
-		return SR_ERR;
-
-	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
-	if (zip_add(zipfile, "version", versrc) < 0) {
-		sr_err("Error saving version into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(versrc);
-		zip_discard(zipfile);
-		return SR_ERR;
-	}
-
-	/* init "metadata" */
 	meta = g_key_file_new();
 
 	g_key_file_set_string(meta, "global", "sigrok version",
@@ -114,6 +128,39 @@ static int zip_create(const struct sr_output *o)
 			g_free(s);
 		}
 	}
+
+	return meta;
+}
+
+static int zip_create(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip *zipfile;
+	struct zip_source *versrc, *metasrc;
+	GKeyFile *meta;
+	char *metabuf;
+	gsize metalen;
+
+	outc = o->priv;
+
+	/* Quietly delete it first, libzip wants replace ops otherwise. */
+	g_unlink(outc->filename);
+	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
+	if (!zipfile)
+		return SR_ERR;
+
+	/* "version" */
+	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
+	if (zip_add(zipfile, "version", versrc) < 0) {
+		sr_err("Error saving version into zipfile: %s",
+			zip_strerror(zipfile));
+		zip_source_free(versrc);
+		zip_discard(zipfile);
+		return SR_ERR;
+	}
+
+	/* init "metadata" */
+	meta = metadata_new(o);
 	metabuf = g_key_file_to_data(meta, &metalen, NULL);
 	g_key_file_free(meta);
 
@@ -255,12 +302,336 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 	return SR_OK;
 }
 
+static void stream_discard(struct out_context *outc)
+{
+	if (outc->archive) {
+		zip_discard(outc->archive);
+		outc->archive = NULL;
+	}
+	if (outc->tmpfile) {
+		fclose(outc->tmpfile);
+		outc->tmpfile = NULL;
+	}
+	if (outc->tmpname) {
+		g_unlink(outc->tmpname);
+		g_free(outc->tmpname);
+		outc->tmpname = NULL;
+	}
+	g_free(outc->metabuf);
+	outc->metabuf = NULL;
+	g_free(outc->chunk_buf);
+	outc->chunk_buf = NULL;
+	outc->chunk_fill = 0;
+}
+
+static int stream_open(const struct sr_output *o, int unitsize)
+{
+	struct out_context *outc;
+	struct zip_source *versrc, *metasrc;
+	GKeyFile *meta;
+	gsize metalen;
+	int fd;
+
+	outc = o->priv;
+
+	/* Quietly delete it first, libzip wants replace ops otherwise. */
+	g_unlink(outc->filename);
+	if (!(outc->archive = zip_open(outc->filename, ZIP_CREATE, NULL))) {
+		sr_err("Failed to create session file '%s'.", outc->filename);
+		return SR_ERR;
+	}
+
+	/*
+	 * Keep the temporary file next to the archive, so that libzip
+	 * does not have to copy the data across filesystems.
+	 */
+	outc->tmpname = g_strdup_printf("%s.XXXXXX", outc->filename);
+	if ((fd = g_mkstemp(outc->tmpname)) < 0
+			|| !(outc->tmpfile = fdopen(fd, "wb"))) {
+		sr_err("Failed to create temporary file '%s': %s",
+			outc->tmpname, g_strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		stream_discard(outc);
+		return SR_ERR_IO;
+	}
+
+	versrc = zip_source_buffer(outc->archive, "2", 1, FALSE);
+	if (zip_add(outc->archive, "version", versrc) < 0) {
+		sr_err("Error saving version into zipfile: %s",
+			zip_strerror(outc->archive));
+		zip_source_free(versrc);
+		stream_discard(outc);
+		return SR_ERR;
+	}
+
+	/* The buffer must stay around until the archive is closed. */
+	meta = metadata_new(o);
+	g_key_file_set_integer(meta, "device 1", "unitsize", unitsize);
+	outc->metabuf = g_key_file_to_data(meta, &metalen, NULL);
+	g_key_file_free(meta);
+
+	metasrc = zip_source_buffer(outc->archive, outc->metabuf, metalen, FALSE);
+	if (zip_add(outc->archive, "metadata", metasrc) < 0) {
+		sr_err("Error saving metadata into zipfile: %s",
+			zip_strerror(outc->archive));
+		zip_source_free(metasrc);
+		stream_discard(outc);
+		return SR_ERR;
+	}
+
+	/* Chunks must hold a whole number of samples. */
+	outc->unitsize = unitsize;
+	outc->chunksize -= outc->chunksize % unitsize;
+	if (outc->chunksize == 0)
+		outc->chunksize = unitsize;
+	outc->chunk_buf = g_malloc(outc->chunksize);
+	outc->chunk_fill = 0;
+	outc->chunk_num = 1;
+	outc->tmp_offset = 0;
+	outc->last_checkpoint = g_get_monotonic_time();
+
+	return SR_OK;
+}
+
+/* Write out the pending chunk and add it to the archive. */
+static int stream_flush(struct out_context *outc)
+{
+	struct zip_source *logicsrc;
+	char *chunkname;
+	int64_t ret;
+
+	if (outc->chunk_fill == 0)
+		return SR_OK;
+
+	if (fwrite(outc->chunk_buf, 1, outc->chunk_fill, outc->tmpfile)
+			!= outc->chunk_fill) {
+		sr_err("Failed to write to temporary file '%s': %s",
+			outc->tmpname, g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	/* libzip reads the chunk back from the file, not the stdio buffer. */
+	if (fflush(outc->tmpfile) != 0) {
+		sr_err("Failed to flush temporary file '%s': %s",
+			outc->tmpname, g_strerror(errno));
+		return SR_ERR_IO;
+	}
+
+	logicsrc = zip_source_file(outc->archive, outc->tmpname,
+			outc->tmp_offset, outc->chunk_fill);
+	if (!logicsrc) {
+		sr_err("Failed to create chunk source: %s",
+			zip_strerror(outc->archive));
+		return SR_ERR;
+	}
+	chunkname = g_strdup_printf("logic-1-%u", outc->chunk_num);
+	ret = zip_add(outc->archive, chunkname, logicsrc);
+	g_free(chunkname);
+	if (ret < 0) {
+		sr_err("Failed to add chunk 'logic-1-%u': %s",
+			outc->chunk_num, zip_strerror(outc->archive));
+		zip_source_free(logicsrc);
+		return SR_ERR;
+	}
+
+	outc->chunk_num++;
+	outc->tmp_offset += outc->chunk_fill;
+	outc->chunk_fill = 0;
+
+	return SR_OK;
+}
+
+/*
+ * Write out the pending chunk and close the archive, so that the file
+ * holds a valid session with all data so far. libzip replaces the file
+ * only once the new one is complete. The archive is then opened again
+ * for the chunks to come, and the temporary file starts over.
+ */
+static int stream_checkpoint(struct out_context *outc)
+{
+	int ret;
+
+	outc->last_checkpoint = g_get_monotonic_time();
+	if ((ret = stream_flush(outc)) != SR_OK)
+		return ret;
+	if (outc->tmp_offset == 0)
+		/* Nothing new since the last checkpoint. */
+		return SR_OK;
+
+	if (zip_close(outc->archive) < 0) {
+		sr_err("Error saving session file: %s",
+			zip_strerror(outc->archive));
+		return SR_ERR;
+	}
+	if (!(outc->archive = zip_open(outc->filename, 0, NULL))) {
+		sr_err("Failed to reopen session file '%s'.", outc->filename);
+		return SR_ERR;
+	}
+
+	if (ftruncate(fileno(outc->tmpfile), 0) != 0
+			|| fseek(outc->tmpfile, 0, SEEK_SET) != 0) {
+		sr_err("Failed to truncate temporary file '%s': %s",
+			outc->tmpname, g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	outc->tmp_offset = 0;
+
+	return SR_OK;
+}
+
+static int stream_append(struct out_context *outc, const uint8_t *buf,
+		uint16_t unitsize, uint64_t length)
+{
+	uint64_t count;
+	int ret;
+
+	if (unitsize != outc->unitsize) {
+		sr_err("Unit size changed from %d to %d during acquisition.",
+			outc->unitsize, unitsize);
+		return SR_ERR_DATA;
+	}
+	if (length % unitsize != 0) {
+		sr_warn("Chunk size %" PRIu64 " not a multiple of the"
+			" unit size %d.", length, unitsize);
+	}
+
+	while (length > 0) {
+		count = MIN(length, outc->chunksize - outc->chunk_fill);
+		memcpy(outc->chunk_buf + outc->chunk_fill, buf, count);
+		outc->chunk_fill += count;
+		buf += count;
+		length -= count;
+		if (outc->chunk_fill == outc->chunksize)
+			if ((ret = stream_flush(outc)) != SR_OK)
+				return ret;
+	}
+
+	if (outc->flush_interval > 0 && g_get_monotonic_time()
+			- outc->last_checkpoint >= outc->flush_interval)
+		return stream_checkpoint(outc);
+
+	return SR_OK;
+}
+
+/* Like stream_append(), but runs are expanded right into the chunk. */
+static int stream_append_rle(struct out_context *outc,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	uint64_t run, offset, count;
+	int ret;
+
+	if (rle->unitsize != outc->unitsize) {
+		sr_err("Unit size changed from %d to %d during acquisition.",
+			outc->unitsize, rle->unitsize);
+		return SR_ERR_DATA;
+	}
+
+	run = offset = 0;
+	while ((count = logic_rle_expand(rle, &run, &offset,
+			outc->chunk_buf + outc->chunk_fill,
+			(outc->chunksize - outc->chunk_fill) / rle->unitsize))) {
+		outc->chunk_fill += count * rle->unitsize;
+		if (outc->chunk_fill == outc->chunksize)
+			if ((ret = stream_flush(outc)) != SR_OK)
+				return ret;
+	}
+
+	if (outc->flush_interval > 0 && g_get_monotonic_time()
+			- outc->last_checkpoint >= outc->flush_interval)
+		return stream_checkpoint(outc);
+
+	return SR_OK;
+}
+
+/* Expand runs into chunks of at most chunksize bytes, one entry each. */
+static int zip_append_rle(const struct sr_output *o,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	struct out_context *outc;
+	uint64_t run, offset, max_samples, count;
+	uint8_t *buf;
+	int ret;
+
+	outc = o->priv;
+	max_samples = MAX(outc->chunksize / rle->unitsize, 1);
+	max_samples = MIN(max_samples, logic_rle_num_samples(rle));
+	buf = g_malloc(max_samples * rle->unitsize);
+	run = offset = 0;
+	ret = SR_OK;
+	while (ret == SR_OK && (count = logic_rle_expand(rle, &run, &offset,
+			buf, max_samples)))
+		ret = zip_append(o, buf, rle->unitsize, count * rle->unitsize);
+	g_free(buf);
+
+	return ret;
+}
+
+/* Write out all pending data and close the archive. */
+static int stream_close(struct out_context *outc)
+{
+	int ret;
+
+	if ((ret = stream_flush(outc)) != SR_OK) {
+		stream_discard(outc);
+		return ret;
+	}
+
+	/* libzip reads the chunks back through its own file handle. */
+	if (fclose(outc->tmpfile) != 0) {
+		outc->tmpfile = NULL;
+		sr_err("Failed to write to temporary file '%s': %s",
+			outc->tmpname, g_strerror(errno));
+		stream_discard(outc);
+		return SR_ERR_IO;
+	}
+	outc->tmpfile = NULL;
+
+	if (zip_close(outc->archive) < 0) {
+		sr_err("Error saving session file: %s",
+			zip_strerror(outc->archive));
+		stream_discard(outc);
+		return SR_ERR;
+	}
+	outc->archive = NULL;
+	stream_discard(outc);
+
+	return SR_OK;
+}
+
+/* Create the archive on the first logic data. */
+static int archive_open(const struct sr_output *o, uint16_t unitsize)
+{
+	struct out_context *outc;
+	int ret;
+
+	outc = o->priv;
+	if (outc->stream) {
+		if (!outc->archive && !outc->zip_created) {
+			if ((ret = stream_open(o, unitsize)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		if (!outc->archive)
+			return SR_ERR;
+		return SR_OK;
+	}
+
+	if (!outc->zip_created) {
+		if ((ret = zip_create(o)) != SR_OK)
+			return ret;
+		outc->zip_created = TRUE;
+	}
+
+	return SR_OK;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_config *src;
 	GSList *l;
 
@@ -281,29 +652,58 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		}
 		break;
 	case SR_DF_LOGIC:
-		if (!outc->zip_created) {
-			if ((ret = zip_create(o)) != SR_OK)
-				return ret;
-			outc->zip_created = TRUE;
-		}
 		logic = packet->payload;
+		if ((ret = archive_open(o, logic->unitsize)) != SR_OK)
+			return ret;
+		if (outc->stream) {
+			ret = stream_append(outc, logic->data,
+					logic->unitsize, logic->length);
+			if (ret != SR_OK)
+				stream_discard(outc);
+			return ret;
+		}
 		ret = zip_append(o, logic->data, logic->unitsize, logic->length);
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_LOGIC_RLE:
+		logic_rle = packet->payload;
+		if (logic_rle->num_runs == 0)
+			break;
+		if ((ret = archive_open(o, logic_rle->unitsize)) != SR_OK)
+			return ret;
+		if (outc->stream) {
+			ret = stream_append_rle(outc, logic_rle);
+			if (ret != SR_OK)
+				stream_discard(outc);
+			return ret;
+		}
+		if ((ret = zip_append_rle(o, logic_rle)) != SR_OK)
+			return ret;
+		break;
+	case SR_DF_END:
+		if (outc->archive)
+			return stream_close(outc);
+		break;
 	}
 
 	return SR_OK;
 }
 
 static struct sr_option options[] = {
+	{ "stream", "Stream", "Keep the archive open for the whole acquisition", NULL, NULL },
+	{ "chunksize", "Chunk size", "Size of the logic data chunks in bytes (streaming only)", NULL, NULL },
+	{ "flush-interval", "Flush interval", "Write out a valid session file at least every N ms, 0 to disable (streaming only)", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
-	if (!options[0].def)
-		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(TRUE));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_CHUNKSIZE));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(0));
+	}
 
 	return options;
 }
@@ -313,7 +713,9 @@ static int cleanup(struct sr_output *o)
 	struct out_context *outc;
 
 	outc = o->priv;
-	g_variant_unref(options[0].def);
+	/* The stream may have been cut off without SR_DF_END. */
+	if (outc->archive)
+		stream_close(outc);
 	g_free(outc->filename);
 	g_free(outc);
 	o->priv = NULL;
@@ -326,7 +728,7 @@ SR_PRIV struct sr_output_module output_srzip = {
 	.name = "srzip",
 	.desc = "srzip session file",
 	.exts = (const char*[]){"sr", NULL},
-	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING | SR_OUTPUT_LOGIC_RLE,
 	.options = get_options,
 	.init = init,
 	.receive = receive,
@@ -22,21 +22,36 @@
 #include <config.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/vcd"
 
+/* Longest timestamp: '#', 20 digits. */
+#define MAX_TIMESTAMP_LEN 21
+
 struct context {
 	int num_enabled_channels;
-	GArray *channelindices;
 	uint8_t *prevsample;
 	gboolean header_done;
 	int period;
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+
+	/* Set up for the unitsize of the logic data. */
+	int unitsize;
+	/* Bits of the enabled channels. */
+	uint8_t *chmask;
+	/* The same, replicated over 16 bytes if unitsize divides 16. */
+	uint8_t wide_mask[16];
+	gboolean have_wide_mask;
+	/* VCD identifier per bit of the sample. */
+	char *ids;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -137,15 +152,15 @@ static GString *gen_header(const struct sr_output *o)
 	/* scope */
 	g_string_append_printf(header, "$scope module %s $end\n", PACKAGE_NAME);
 
-	/* Wires / channels */
-	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
+	/* Wires / channels, identified like in the value changes. */
+	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->type != SR_CHANNEL_LOGIC)
 			continue;
 		if (!ch->enabled)
 			continue;
 		g_string_append_printf(header, "$var wire 1 %c %s $end\n",
-				(char)('!' + i), ch->name);
+				(char)('!' + i++), ch->name);
 	}
 
 	g_string_append(header, "$upscope $end\n$enddefinitions $end\n");
@@ -153,20 +168,250 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+/* Set up the channel masks and identifiers for a unitsize. */
+static void setup_unitsize(struct context *ctx, int unitsize)
+{
+	int p, index, i;
+
+	g_free(ctx->prevsample);
+	g_free(ctx->chmask);
+	g_free(ctx->ids);
+	ctx->unitsize = unitsize;
+	ctx->prevsample = g_malloc0(unitsize);
+	ctx->chmask = g_malloc0(unitsize);
+	ctx->ids = g_malloc0(unitsize * 8);
+
+	for (p = 0; p < ctx->num_enabled_channels; p++) {
+		index = ctx->channel_index[p];
+		if (index >= unitsize * 8)
+			continue;
+		ctx->chmask[index / 8] |= 1 << (index % 8);
+		ctx->ids[index] = '!' + p;
+	}
+
+	ctx->have_wide_mask = 16 % unitsize == 0;
+	if (ctx->have_wide_mask) {
+		for (i = 0; i < 16; i++)
+			ctx->wide_mask[i] = ctx->chmask[i % unitsize];
+	}
+}
+
+/* Make room for need more bytes at p, growing the string if needed. */
+static char *out_reserve(GString *out, char *p, char **limit, size_t need)
+{
+	size_t pos;
+
+	if ((size_t)(*limit - p) >= need)
+		return p;
+
+	pos = p - out->str;
+	g_string_set_size(out, MAX(out->len * 2, pos + need));
+	*limit = out->str + out->len;
+
+	return out->str + pos;
+}
+
+/* Sample time in units of the timescale, rounded to the nearest unit. */
+static uint64_t timestamp(const struct context *ctx, uint64_t samplecount)
+{
+	uint64_t q, r;
+
+	if (ctx->samplerate == 0)
+		return samplecount;
+
+	q = samplecount / ctx->samplerate;
+	r = samplecount % ctx->samplerate;
+
+	return q * ctx->period
+		+ (r * ctx->period + ctx->samplerate / 2) / ctx->samplerate;
+}
+
+static char *write_uint(char *p, uint64_t value)
+{
+	char digits[20];
+	int n;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n > 0)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+/*
+ * Write the timestamp and the channels which changed from prev to sample,
+ * or all channels if prev is NULL.
+ */
+static char *write_changes(const struct context *ctx, char *p,
+		const uint8_t *sample, const uint8_t *prev, uint64_t samplecount)
+{
+	unsigned int diff;
+	int b, bit;
+
+	*p++ = '#';
+	p = write_uint(p, timestamp(ctx, samplecount));
+	for (b = 0; b < ctx->unitsize; b++) {
+		diff = ctx->chmask[b];
+		if (prev)
+			diff &= sample[b] ^ prev[b];
+		while (diff) {
+			bit = g_bit_nth_lsf(diff, -1);
+			diff &= diff - 1;
+			*p++ = ' ';
+			*p++ = '0' + ((sample[b] >> bit) & 1);
+			*p++ = ctx->ids[b * 8 + bit];
+		}
+	}
+	*p++ = '\n';
+
+	return p;
+}
+
+static gboolean sample_changed(const struct context *ctx,
+		const uint8_t *sample, const uint8_t *prev)
+{
+	int b;
+
+	for (b = 0; b < ctx->unitsize; b++) {
+		if ((sample[b] ^ prev[b]) & ctx->chmask[b])
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Index of the lowest non-zero byte of a word. */
+static int first_byte(uint64_t x)
+{
+	if ((uint32_t)x)
+		return g_bit_nth_lsf((uint32_t)x, -1) / 8;
+
+	return 4 + g_bit_nth_lsf((uint32_t)(x >> 32), -1) / 8;
+}
+
+/*
+ * Find the first sample from i on which differs from the sample before
+ * it in an enabled channel, or n if there is none. Needs i >= 1.
+ *
+ * Unchanged samples are skipped in bulk, by XORing 16 (SSE2) or 8 bytes
+ * of samples against the same bytes one sample earlier.
+ */
+static uint64_t next_change(const struct context *ctx, const uint8_t *buf,
+		uint64_t i, uint64_t n)
+{
+	uint64_t x, m;
+	int unitsize;
+
+	unitsize = ctx->unitsize;
+	if (ctx->have_wide_mask) {
+#ifdef __SSE2__
+		__m128i vm, zero, v;
+		int bits;
+
+		vm = _mm_loadu_si128((const __m128i *)ctx->wide_mask);
+		zero = _mm_setzero_si128();
+		while ((i + 16 / unitsize) <= n) {
+			v = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i *)(buf + i * unitsize)),
+				_mm_loadu_si128((const __m128i *)(buf + (i - 1) * unitsize)));
+			v = _mm_and_si128(v, vm);
+			bits = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) ^ 0xffff;
+			if (bits)
+				return i + g_bit_nth_lsf(bits, -1) / unitsize;
+			i += 16 / unitsize;
+		}
+#endif
+		if (unitsize <= 8) {
+			m = RL64(ctx->wide_mask);
+			while ((i + 8 / unitsize) <= n) {
+				x = (RL64(buf + i * unitsize)
+					^ RL64(buf + (i - 1) * unitsize)) & m;
+				if (x)
+					return i + first_byte(x) / unitsize;
+				i += 8 / unitsize;
+			}
+		}
+	}
+
+	for (; i < n; i++) {
+		if (sample_changed(ctx, buf + i * unitsize,
+				buf + (i - 1) * unitsize))
+			break;
+	}
+
+	return i;
+}
+
+/* Encode num_samples samples, or one sample lasting for num_samples. */
+static void encode(struct context *ctx, GString *out, const uint8_t *data,
+		uint64_t num_samples, gboolean run)
+{
+	const uint8_t *prev;
+	char *p, *limit;
+	size_t max_line;
+	uint64_t i, n;
+
+	if (num_samples == 0)
+		return;
+
+	max_line = MAX_TIMESTAMP_LEN + 3 * ctx->num_enabled_channels + 1;
+	p = limit = out->str + out->len;
+
+	/* VCD only contains deltas/changes of signals. */
+	prev = ctx->samplecount > 0 ? ctx->prevsample : NULL;
+	if (prev ? sample_changed(ctx, data, prev)
+			: ctx->num_enabled_channels > 0) {
+		p = out_reserve(out, p, &limit, max_line);
+		p = write_changes(ctx, p, data, prev, ctx->samplecount);
+	}
+
+	n = run ? 1 : num_samples;
+	for (i = 1; (i = next_change(ctx, data, i, n)) < n; i++) {
+		p = out_reserve(out, p, &limit, max_line);
+		p = write_changes(ctx, p, data + i * ctx->unitsize,
+				data + (i - 1) * ctx->unitsize, ctx->samplecount + i);
+	}
+	g_string_truncate(out, p - out->str);
+
+	memcpy(ctx->prevsample, data + (n - 1) * ctx->unitsize, ctx->unitsize);
+	ctx->samplecount += num_samples;
+}
+
+static void start_data(const struct sr_output *o, GString *out,
+		uint16_t unitsize)
+{
+	struct context *ctx;
+	GString *header;
+
+	ctx = o->priv;
+	if (!ctx->header_done) {
+		header = gen_header(o);
+		g_string_append_len(out, header->str, header->len);
+		g_string_free(header, TRUE);
+		ctx->header_done = TRUE;
+	}
+
+	/* Can't set this up until we know the stream's unitsize. */
+	if (unitsize != ctx->unitsize)
+		setup_unitsize(ctx, unitsize);
+}
+
+static int append(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	unsigned int i;
-	int p, curbit, prevbit, index;
-	uint8_t *sample;
-	gboolean timestamp_written;
+	uint64_t i;
+	char *p;
 
-	*out = NULL;
 	if (!o || !o->priv)
 		return SR_ERR_BUG;
 	ctx = o->priv;
@@ -183,61 +428,31 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-
-		if (!ctx->header_done) {
-			*out = gen_header(o);
-			ctx->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
-		}
-
-		if (!ctx->prevsample) {
-			/* Can't allocate this until we know the stream's unitsize. */
-			ctx->prevsample = g_malloc0(logic->unitsize);
-		}
-
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			sample = logic->data + i;
-			timestamp_written = FALSE;
-
-			for (p = 0; p < ctx->num_enabled_channels; p++) {
-				index = ctx->channel_index[p];
-
-				curbit = ((unsigned)sample[index / 8]
-						>> (index % 8)) & 1;
-				prevbit = ((unsigned)ctx->prevsample[index / 8]
-						>> (index % 8)) & 1;
-
-				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
-					continue;
-
-				/* Output timestamp of subsequent signal changes. */
-				if (!timestamp_written)
-					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
-
-				/* Output which signal changed to which value. */
-				g_string_append_c(*out, ' ');
-				g_string_append_c(*out, '0' + curbit);
-				g_string_append_c(*out, '!' + p);
-
-				timestamp_written = TRUE;
-			}
-
-			if (timestamp_written)
-				g_string_append_c(*out, '\n');
-
-			ctx->samplecount++;
-			memcpy(ctx->prevsample, sample, logic->unitsize);
-		}
+		if (logic->unitsize == 0)
+			break;
+		start_data(o, out, logic->unitsize);
+		encode(ctx, out, logic->data, logic->length / logic->unitsize,
+				FALSE);
+		break;
+	case SR_DF_LOGIC_RLE:
+		/* Only the first sample of a run can change anything. */
+		logic_rle = packet->payload;
+		if (logic_rle->unitsize == 0)
+			break;
+		start_data(o, out, logic_rle->unitsize);
+		for (i = 0; i < logic_rle->num_runs; i++)
+			encode(ctx, out, (uint8_t *)logic_rle->samples
+					+ i * logic_rle->unitsize,
+					logic_rle->lengths[i], TRUE);
 		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
-		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		g_string_set_size(out, out->len + MAX_TIMESTAMP_LEN + 1);
+		p = out->str + out->len - (MAX_TIMESTAMP_LEN + 1);
+		*p++ = '#';
+		p = write_uint(p, timestamp(ctx, ctx->samplecount));
+		*p++ = '\n';
+		g_string_truncate(out, p - out->str);
 		break;
 	}
 
@@ -253,6 +468,8 @@ static int cleanup(struct sr_output *o)
 
 	ctx = o->priv;
 	g_free(ctx->prevsample);
+	g_free(ctx->chmask);
+	g_free(ctx->ids);
 	g_free(ctx->channel_index);
 	g_free(ctx);
 
@@ -264,9 +481,9 @@ struct sr_output_module output_vcd = {
 	.name = "VCD",
 	.desc = "Value Change Dump",
 	.exts = (const char*[]){"vcd", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.append = append,
 	.cleanup = cleanup,
 };
@@ -39,6 +39,7 @@ struct out_context {
 	float *fdata;
 };
 
+/* Grow the channel buffers to size samples, keeping what's in them. */
 static int realloc_chanbufs(const struct sr_output *o, int size)
 {
 	struct out_context *outc;
@@ -50,7 +51,6 @@ static int realloc_chanbufs(const struct sr_output *o, int size)
 			sr_err("Unable to allocate enough output buffer memory.");
 			return SR_ERR;
 		}
-		outc->chanbuf_used[i] = 0;
 	}
 	outc->chanbuf_size = size;
 
@@ -61,26 +61,24 @@ static int flush_chanbufs(const struct sr_output *o, GString *out)
 {
 	struct out_context *outc;
 	int num_samples, i, j;
-	char *buf, *bufp;
+	char *bufp;
+	gsize len;
 
 	outc = o->priv;
 
 	/* Any one of them will do. */
 	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
-	}
 
-	bufp = buf;
+	/* Interleave the channels straight into the output. */
+	len = out->len;
+	g_string_set_size(out, len + 4 * num_samples * outc->num_channels);
+	bufp = out->str + len;
 	for (i = 0; i < num_samples; i++) {
 		for (j = 0; j < outc->num_channels; j++) {
 			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
 			bufp += 4;
 		}
 	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
 
 	for (i = 0; i < outc->num_channels; i++)
 		outc->chanbuf_used[i] = 0;
@@ -232,8 +230,8 @@ static int check_chanbuf_size(const struct sr_output *o)
 	return size;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static int append(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString *out)
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
@@ -244,11 +242,11 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	GSList *l;
 	const GSList *channels;
 	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
+	int num_channels, num_samples, size, used, *chan_idx, idx, i, j, ret;
 	float *data;
 	uint8_t *buf;
+	GString *header;
 
-	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
 		return SR_ERR_ARG;
 
@@ -265,10 +263,11 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	case SR_DF_ANALOG_OLD:
 	case SR_DF_ANALOG:
 		if (!outc->header_done) {
-			*out = gen_header(o);
+			header = gen_header(o);
+			g_string_append_len(out, header->str, header->len);
+			g_string_free(header, TRUE);
 			outc->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
+		}
 
 		analog_old = packet->payload;
 		analog = packet->payload;
@@ -299,8 +298,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			return SR_ERR;
 		}
 
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog_old->num_samples) != SR_OK)
+		/* Samples from earlier packets may still be waiting. */
+		used = 0;
+		for (i = 0; i < outc->num_channels; i++)
+			used = MAX(used, outc->chanbuf_used[i]);
+		if (used + num_samples > outc->chanbuf_size) {
+			if (realloc_chanbufs(o, used + num_samples) != SR_OK)
 				return SR_ERR_MALLOC;
 		}
 
@@ -325,14 +328,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 		size = check_chanbuf_size(o);
 		if (size > MIN_DATA_CHUNK_SAMPLES)
-			if (flush_chanbufs(o, *out) != SR_OK)
+			if (flush_chanbufs(o, out) != SR_OK)
 				return SR_ERR;
 		break;
 	case SR_DF_END:
 		size = check_chanbuf_size(o);
 		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
-			if (flush_chanbufs(o, *out) != SR_OK)
+			if (flush_chanbufs(o, out) != SR_OK)
 				return SR_ERR;
 		}
 		break;
@@ -381,6 +383,6 @@ SR_PRIV struct sr_output_module output_wav = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.append = append,
 	.cleanup = cleanup,
 };
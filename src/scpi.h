@@ -84,10 +84,18 @@ struct sr_scpi_dev_inst {
 	int (*send)(void *priv, const char *command);
 	int (*read_begin)(void *priv);
 	int (*read_data)(void *priv, char *buf, int maxlen);
+	/*
+	 * Optional: read binary data as it comes, with large reads straight
+	 * into buf. Transports whose read_data() is binary safe and already
+	 * reads into buf leave it NULL.
+	 */
+	int (*read_raw)(void *priv, char *buf, int maxlen);
 	int (*read_complete)(void *priv);
 	int (*close)(struct sr_scpi_dev_inst *scpi);
 	void (*free)(void *priv);
 	unsigned int read_timeout_ms;
+	/* Set once the device failed to answer a compound query. */
+	gboolean no_compound_queries;
 	void *priv;
 	/* Only used for quirk workarounds, notably the Rigol DS1000 series. */
 	uint64_t firmware_version;
@@ -128,10 +136,16 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 			const char *command, GArray **scpi_response);
 SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 			const char *command, GArray **scpi_response);
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			const char *const *commands, int num_commands,
+			char **scpi_responses);
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray **scpi_response);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
 
+SR_PRIV int sr_scpi_parse_bool(const char *str, gboolean *ret);
 SR_PRIV const char *sr_vendor_alias(const char *raw_vendor);
 SR_PRIV const char *scpi_cmd_get(const struct scpi_command *cmdtable, int command);
 SR_PRIV int scpi_cmd(const struct sr_dev_inst *sdi,
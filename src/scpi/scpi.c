@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <glib.h>
+#include <limits.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -29,6 +30,15 @@
 #define SCPI_READ_RETRIES 100
 #define SCPI_READ_RETRY_TIMEOUT_US (10 * 1000)
 
+/* Size of the reads for text responses. */
+#define SCPI_READ_CHUNK_SIZE 4096
+
+/* Longest compound query sent by sr_scpi_get_strings(). */
+#define SCPI_COMPOUND_MAX_LENGTH 256
+
+/* Initial allocation for the data of a definite length block. */
+#define SCPI_BLOCK_READ_SIZE (1024 * 1024)
+
 /**
  * Parse a string representation of a boolean-like value into a gboolean.
  * Similar to sr_parse_boolstring but rejects strings which do not represent
@@ -40,7 +50,7 @@
  *
  * @return SR_OK on success, SR_ERR on failure.
  */
-static int parse_strict_bool(const char *str, gboolean *ret)
+SR_PRIV int sr_scpi_parse_bool(const char *str, gboolean *ret)
 {
 	if (!str)
 		return SR_ERR_ARG;
@@ -385,8 +395,8 @@ SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi)
 SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 			       const char *command, char **scpi_response)
 {
-	char buf[256];
 	int len;
+	gsize oldlen;
 	GString *response;
 	gint64 laststart;
 	unsigned int elapsed_ms;
@@ -400,12 +410,16 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 
 	laststart = g_get_monotonic_time();
 
-	response = g_string_new("");
+	response = g_string_sized_new(SCPI_READ_CHUNK_SIZE);
 
 	*scpi_response = NULL;
 
 	while (!sr_scpi_read_complete(scpi)) {
-		len = sr_scpi_read_data(scpi, buf, sizeof(buf));
+		/* Read straight into the string, which keeps its allocation. */
+		oldlen = response->len;
+		g_string_set_size(response, oldlen + SCPI_READ_CHUNK_SIZE);
+		len = sr_scpi_read_data(scpi, response->str + oldlen,
+				SCPI_READ_CHUNK_SIZE);
 		if (len < 0) {
 			sr_err("Incompletely read SCPI response.");
 			g_string_free(response, TRUE);
@@ -413,7 +427,7 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 		} else if (len > 0) {
 		        laststart = g_get_monotonic_time();
 		}
-		g_string_append_len(response, buf, len);
+		g_string_truncate(response, oldlen + len);
 		elapsed_ms = (g_get_monotonic_time() - laststart) / 1000;
 		if (elapsed_ms >= scpi->read_timeout_ms) {
 			sr_err("Timed out waiting for SCPI response.");
@@ -460,7 +474,7 @@ SR_PRIV int sr_scpi_get_bool(struct sr_scpi_dev_inst *scpi,
 	if (ret != SR_OK && !response)
 		return ret;
 
-	if (parse_strict_bool(response, scpi_response) == SR_OK)
+	if (sr_scpi_parse_bool(response, scpi_response) == SR_OK)
 		ret = SR_OK;
 	else
 		ret = SR_ERR_DATA;
@@ -589,6 +603,137 @@ SR_PRIV int sr_scpi_get_opc(struct sr_scpi_dev_inst *scpi)
 	return SR_ERR;
 }
 
+/* Parse a float of a list, for scpi_get_values(). */
+static int scpi_parse_float(const char *str, size_t len, void *value)
+{
+	double tmp;
+
+	if (sr_atod_ascii_len(str, len, &tmp) != SR_OK)
+		return SR_ERR;
+	*(float *)value = tmp;
+
+	return SR_OK;
+}
+
+/*
+ * Parse an unsigned 8 bit integer of a list, like sr_atoi() does, but
+ * reject values which don't fit rather than truncate them.
+ */
+static int scpi_parse_uint8(const char *str, size_t len, void *value)
+{
+	const char *p, *end;
+	gboolean neg;
+	long tmp;
+
+	p = str;
+	end = str + len;
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	neg = FALSE;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+	if (p == end || !g_ascii_isdigit(*p)) {
+		/* As with strtol(), only an empty string reads as 0. */
+		if (len > 0)
+			return SR_ERR;
+	}
+	for (tmp = 0; p < end && g_ascii_isdigit(*p); p++) {
+		tmp = tmp * 10 + (*p - '0');
+		if (tmp > UINT8_MAX || (neg && tmp != 0))
+			return SR_ERR;
+	}
+	if (p != end)
+		return SR_ERR;
+	*(uint8_t *)value = tmp;
+
+	return SR_OK;
+}
+
+/*
+ * Send a SCPI command and parse the reply as comma separated values,
+ * appending them to the array.
+ *
+ * The values are parsed straight out of the read buffer as soon as they
+ * are complete, so the response is never held as a whole, and neither it
+ * nor its values are copied into strings of their own.
+ *
+ * Returns SR_ERR_DATA if values didn't parse, which are left out, and
+ * SR_ERR if the response couldn't be read.
+ */
+static int scpi_get_values(struct sr_scpi_dev_inst *scpi, const char *command,
+		int (*parse)(const char *str, size_t len, void *value),
+		GArray *array)
+{
+	char buf[SCPI_READ_CHUNK_SIZE], value[8];
+	const char *start, *comma, *end;
+	size_t fill;
+	int len, ret;
+	gboolean have_commas;
+	gint64 laststart;
+	unsigned int elapsed_ms;
+
+	if (command)
+		if (sr_scpi_send(scpi, command) != SR_OK)
+			return SR_ERR;
+
+	if (sr_scpi_read_begin(scpi) != SR_OK)
+		return SR_ERR;
+
+	laststart = g_get_monotonic_time();
+
+	ret = SR_OK;
+	fill = 0;
+	have_commas = FALSE;
+	while (!sr_scpi_read_complete(scpi)) {
+		if (fill == sizeof(buf)) {
+			sr_err("Value in SCPI response is too long.");
+			return SR_ERR;
+		}
+		len = sr_scpi_read_data(scpi, buf + fill, sizeof(buf) - fill);
+		if (len < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		} else if (len > 0) {
+			laststart = g_get_monotonic_time();
+		}
+		elapsed_ms = (g_get_monotonic_time() - laststart) / 1000;
+		if (elapsed_ms >= scpi->read_timeout_ms) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR;
+		}
+
+		/* Parse the values which are complete. */
+		start = buf;
+		end = buf + fill + len;
+		while ((comma = memchr(start, ',', end - start))) {
+			if (parse(start, comma - start, value) == SR_OK)
+				g_array_append_vals(array, value, 1);
+			else
+				ret = SR_ERR_DATA;
+			start = comma + 1;
+			have_commas = TRUE;
+		}
+
+		/* Keep the start of the next one. */
+		fill = end - start;
+		memmove(buf, start, fill);
+	}
+
+	/* The last value ends with the response, without its terminator. */
+	if (fill >= 1 && buf[fill - 1] == '\n')
+		fill--;
+	if (fill >= 1 && buf[fill - 1] == '\r')
+		fill--;
+	if (fill > 0 || have_commas) {
+		if (parse(buf, fill, value) == SR_OK)
+			g_array_append_vals(array, value, 1);
+		else
+			ret = SR_ERR_DATA;
+	}
+
+	return ret;
+}
+
 /**
  * Send a SCPI command, read the reply, parse it as comma separated list of
  * floats and store the as an result in scpi_response.
@@ -606,39 +751,16 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GArray **scpi_response)
 {
 	int ret;
-	float tmp;
-	char *response;
-	gchar **ptr, **tokens;
 	GArray *response_array;
 
-	response = NULL;
-	tokens = NULL;
-
-	ret = sr_scpi_get_string(scpi, command, &response);
-	if (ret != SR_OK && !response)
-		return ret;
-
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
-
 	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), 256);
 
-	while (*ptr) {
-		if (sr_atof_ascii(*ptr, &tmp) == SR_OK)
-			response_array = g_array_append_val(response_array,
-							    tmp);
-		else
-			ret = SR_ERR_DATA;
-
-		ptr++;
-	}
-	g_strfreev(tokens);
-	g_free(response);
+	ret = scpi_get_values(scpi, command, scpi_parse_float, response_array);
 
-	if (ret != SR_OK && response_array->len == 0) {
+	if (ret == SR_ERR || (ret != SR_OK && response_array->len == 0)) {
 		g_array_free(response_array, TRUE);
 		*scpi_response = NULL;
-		return SR_ERR_DATA;
+		return ret == SR_ERR ? SR_ERR : SR_ERR_DATA;
 	}
 
 	*scpi_response = response_array;
@@ -655,51 +777,337 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
  * @param scpi_response Pointer where to store the parsed result.
  *
  * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
- *         error or upon no response. The allocated response must be freed by
- *         the caller in the case of an SR_OK as well as in the case of
- *         parsing error.
+ *         error or upon no response. A value outside 0 to 255 is a parsing
+ *         error. The allocated response must be freed by the caller in the
+ *         case of an SR_OK as well as in the case of parsing error.
  */
 SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GArray **scpi_response)
 {
-	int tmp, ret;
-	char *response;
-	gchar **ptr, **tokens;
+	int ret;
 	GArray *response_array;
 
-	response = NULL;
-	tokens = NULL;
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t), 256);
 
-	ret = sr_scpi_get_string(scpi, command, &response);
-	if (ret != SR_OK && !response)
-		return ret;
+	ret = scpi_get_values(scpi, command, scpi_parse_uint8, response_array);
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
+	if (ret == SR_ERR || response_array->len == 0) {
+		g_array_free(response_array, TRUE);
+		*scpi_response = NULL;
+		return ret == SR_ERR ? SR_ERR : SR_ERR_DATA;
+	}
 
-	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t), 256);
+	*scpi_response = response_array;
 
-	while (*ptr) {
-		if (sr_atoi(*ptr, &tmp) == SR_OK)
-			response_array = g_array_append_val(response_array,
-							    tmp);
-		else
-			ret = SR_ERR_DATA;
+	return ret;
+}
 
-		ptr++;
+/*
+ * Split a response to a compound query at the semicolons between its
+ * replies, leaving those in quoted strings alone.
+ */
+static GPtrArray *scpi_split_response(const char *response)
+{
+	GPtrArray *replies;
+	const char *start, *p;
+	char quote;
+
+	replies = g_ptr_array_new_with_free_func(g_free);
+	quote = 0;
+	for (start = p = response; ; p++) {
+		if (quote) {
+			if (*p == quote)
+				quote = 0;
+			else if (!*p)
+				break;
+		} else if (*p == '"' || *p == '\'') {
+			quote = *p;
+		} else if (*p == ';' || !*p) {
+			g_ptr_array_add(replies, g_strndup(start, p - start));
+			if (!*p)
+				break;
+			start = p + 1;
+		}
 	}
-	g_strfreev(tokens);
+
+	return replies;
+}
+
+/*
+ * Send the queries as one compound message and read the replies. Some
+ * devices answer each query on a line of its own, so lines are read until
+ * all replies are in, or until the device has nothing more to say. This
+ * leaves nothing pending in either case. Returns SR_ERR_NA if the number
+ * of replies doesn't match.
+ */
+static int scpi_get_compound(struct sr_scpi_dev_inst *scpi,
+		const char *const *commands, int num_commands,
+		char **scpi_responses)
+{
+	GString *message;
+	GPtrArray *replies, *more;
+	char *response;
+	int i, ret;
+
+	message = g_string_sized_new(SCPI_COMPOUND_MAX_LENGTH);
+	for (i = 0; i < num_commands; i++) {
+		if (i > 0) {
+			g_string_append_c(message, ';');
+			/* Start over at the root of the command tree. */
+			if (commands[i][0] != ':' && commands[i][0] != '*')
+				g_string_append_c(message, ':');
+		}
+		g_string_append(message, commands[i]);
+	}
+
+	ret = sr_scpi_get_string(scpi, message->str, &response);
+	g_string_free(message, TRUE);
+	if (ret != SR_OK)
+		return ret;
+
+	replies = scpi_split_response(response);
 	g_free(response);
+	while ((int)replies->len < num_commands
+			&& sr_scpi_get_string(scpi, NULL, &response) == SR_OK) {
+		more = scpi_split_response(response);
+		g_free(response);
+		for (i = 0; i < (int)more->len; i++) {
+			g_ptr_array_add(replies, more->pdata[i]);
+			more->pdata[i] = NULL;
+		}
+		g_ptr_array_free(more, TRUE);
+	}
+	if ((int)replies->len != num_commands) {
+		g_ptr_array_free(replies, TRUE);
+		return SR_ERR_NA;
+	}
 
-	if (response_array->len == 0) {
-		g_array_free(response_array, TRUE);
-		*scpi_response = NULL;
+	for (i = 0; i < num_commands; i++) {
+		scpi_responses[i] = replies->pdata[i];
+		replies->pdata[i] = NULL;
+	}
+	g_ptr_array_free(replies, TRUE);
+
+	return SR_OK;
+}
+
+/**
+ * Send several SCPI queries and receive their replies, in as few round
+ * trips as possible.
+ *
+ * The queries are joined into compound messages like "A?;:B?;*C?", which
+ * an IEEE 488.2 device answers with a single response, its replies
+ * separated by semicolons. Replies on separate lines are accepted too. If
+ * a device doesn't give the right number of replies, or no response at
+ * all, the queries are sent one by one instead, and so are those of later
+ * calls on the device. Such a device costs one read timeout, once.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param commands The queries, without terminators or semicolons.
+ * @param num_commands The number of queries.
+ * @param scpi_responses Array of num_commands pointers where to store the
+ *                       replies. Replies which weren't received are NULL.
+ *                       All of them must be freed by the caller with
+ *                       g_free(), also upon failure.
+ *
+ * @return SR_OK upon success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+		const char *const *commands, int num_commands,
+		char **scpi_responses)
+{
+	int first, last, i, ret;
+	size_t len;
+
+	for (i = 0; i < num_commands; i++)
+		scpi_responses[i] = NULL;
+
+	for (first = 0; first < num_commands; first = last) {
+		/* Batch as many queries as fit into one message. */
+		len = strlen(commands[first]);
+		for (last = first + 1; last < num_commands; last++) {
+			len += strlen(commands[last]) + 2;
+			if (len > SCPI_COMPOUND_MAX_LENGTH)
+				break;
+		}
+
+		if (!scpi->no_compound_queries && last - first > 1) {
+			ret = scpi_get_compound(scpi, commands + first,
+					last - first, scpi_responses + first);
+			if (ret == SR_OK)
+				continue;
+			/* Real transport errors show up again below. */
+			sr_dbg("Device doesn't support compound queries.");
+			scpi->no_compound_queries = TRUE;
+		}
+
+		for (i = first; i < last; i++) {
+			ret = sr_scpi_get_string(scpi, commands[i],
+					&scpi_responses[i]);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+/* Read binary data, with the transport's raw read if it has one. */
+static int scpi_read_raw(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen)
+{
+	if (scpi->read_raw)
+		return scpi->read_raw(scpi->priv, buf, maxlen);
+
+	return scpi->read_data(scpi->priv, buf, maxlen);
+}
+
+/* Read exactly len bytes of a response into buf. */
+static int scpi_read_exact(struct sr_scpi_dev_inst *scpi, char *buf, size_t len)
+{
+	size_t pos;
+	int ret;
+	gint64 laststart;
+	unsigned int elapsed_ms;
+
+	laststart = g_get_monotonic_time();
+
+	for (pos = 0; pos < len; ) {
+		ret = scpi_read_raw(scpi, buf + pos, MIN(len - pos, INT_MAX));
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		} else if (ret > 0) {
+			pos += ret;
+			laststart = g_get_monotonic_time();
+			continue;
+		}
+		elapsed_ms = (g_get_monotonic_time() - laststart) / 1000;
+		if (elapsed_ms >= scpi->read_timeout_ms) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR_TIMEOUT;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Read the rest of a response, usually just its terminator. It is appended
+ * to data, or dropped if data is NULL.
+ */
+static int scpi_read_rest(struct sr_scpi_dev_inst *scpi, GByteArray *data)
+{
+	char buf[256];
+	int len;
+	gint64 laststart;
+	unsigned int elapsed_ms;
+
+	laststart = g_get_monotonic_time();
+
+	while (!sr_scpi_read_complete(scpi)) {
+		len = sr_scpi_read_data(scpi, buf, sizeof(buf));
+		if (len < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		} else if (len > 0) {
+			laststart = g_get_monotonic_time();
+			if (data)
+				g_byte_array_append(data, (const guint8 *)buf, len);
+		}
+		elapsed_ms = (g_get_monotonic_time() - laststart) / 1000;
+		if (elapsed_ms >= scpi->read_timeout_ms) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR_TIMEOUT;
+		}
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send a SCPI command, read the reply as an IEEE 488.2 block and store its
+ * data in scpi_response.
+ *
+ * A definite length block is '#', a digit n, n digits of the data length,
+ * and the data. The header is parsed once, and the data is read straight
+ * into the array, in reads as large as the transport allows. The array
+ * grows as the data arrives rather than to the declared length, so a
+ * corrupt header can't make it allocate more than twice what is received.
+ * An indefinite length block, "#0", takes up the rest of the response.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param scpi_response Pointer where to store the data. If it points to
+ *                      an array from an earlier call, that array is reused,
+ *                      so that repeated reads don't allocate again.
+ *                      Otherwise it must point to NULL.
+ *
+ * @return SR_OK upon success, SR_ERR* on failure. The array must be freed
+ *         by the caller in either case, unless it is still NULL.
+ */
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			      const char *command, GByteArray **scpi_response)
+{
+	char header[9];
+	int num_digits, i, ret;
+	guint len, pos, n;
+	GByteArray *response;
+
+	if (command)
+		if (sr_scpi_send(scpi, command) != SR_OK)
+			return SR_ERR;
+
+	if (sr_scpi_read_begin(scpi) != SR_OK)
+		return SR_ERR;
+
+	if (!*scpi_response)
+		*scpi_response = g_byte_array_new();
+	response = *scpi_response;
+	g_byte_array_set_size(response, 0);
+
+	if ((ret = scpi_read_exact(scpi, header, 2)) != SR_OK)
+		return ret;
+	if (header[0] != '#' || !g_ascii_isdigit(header[1])) {
+		sr_err("SCPI response is not a block.");
+		scpi_read_rest(scpi, NULL);
 		return SR_ERR_DATA;
 	}
 
-	*scpi_response = response_array;
+	num_digits = header[1] - '0';
+	if (num_digits == 0) {
+		/* Indefinite length, up to the terminating linefeed. */
+		if ((ret = scpi_read_rest(scpi, response)) != SR_OK)
+			return ret;
+		if (response->len >= 1 && response->data[response->len - 1] == '\n')
+			g_byte_array_set_size(response, response->len - 1);
+		return SR_OK;
+	}
 
-	return ret;
+	if ((ret = scpi_read_exact(scpi, header, num_digits)) != SR_OK)
+		return ret;
+	len = 0;
+	for (i = 0; i < num_digits; i++) {
+		if (!g_ascii_isdigit(header[i])) {
+			sr_err("Invalid SCPI block length '%.*s'.",
+				num_digits, header);
+			scpi_read_rest(scpi, NULL);
+			return SR_ERR_DATA;
+		}
+		len = len * 10 + header[i] - '0';
+	}
+
+	sr_spew("Reading SCPI block of %u bytes.", len);
+
+	/* Grow the array as the data comes in, doubling it each time. */
+	for (pos = 0; pos < len; pos += n) {
+		n = MIN(len - pos, MAX(pos, SCPI_BLOCK_READ_SIZE));
+		g_byte_array_set_size(response, pos + n);
+		ret = scpi_read_exact(scpi, (char *)response->data + pos, n);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return scpi_read_rest(scpi, NULL);
 }
 
 /**
@@ -196,6 +196,27 @@ static int scpi_serial_read_data(void *priv, char *buf, int maxlen)
 	return 0;
 }
 
+static int scpi_serial_read_raw(void *priv, char *buf, int maxlen)
+{
+	struct scpi_serial *sscpi = priv;
+	int len;
+
+	/* Return what is left in the buffer first, newlines included. */
+	if (sscpi->read < sscpi->count) {
+		len = MIN((int)(sscpi->count - sscpi->read), maxlen);
+		memcpy(buf, sscpi->buffer + sscpi->read, len);
+		sscpi->read += len;
+		if (sscpi->read == sscpi->count) {
+			sscpi->count = 0;
+			sscpi->read = 0;
+		}
+		return len;
+	}
+
+	/* Then read past the buffer, straight into buf. */
+	return serial_read_nonblocking(sscpi->serial, buf, maxlen);
+}
+
 static int scpi_serial_read_complete(void *priv)
 {
 	struct scpi_serial *sscpi = priv;
@@ -235,6 +256,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_serial_dev = {
 	.send          = scpi_serial_send,
 	.read_begin    = scpi_serial_read_begin,
 	.read_data     = scpi_serial_read_data,
+	.read_raw      = scpi_serial_read_raw,
 	.read_complete = scpi_serial_read_complete,
 	.close         = scpi_serial_close,
 	.free          = scpi_serial_free,
@@ -27,6 +27,7 @@
 
 #define MAX_TRANSFER_LENGTH 2048
 #define TRANSFER_TIMEOUT 1000
+#define BULK_IN_PACKET_SIZE 512
 
 struct scpi_usbtmc_libusb {
 	struct sr_context *ctx;
@@ -610,6 +611,36 @@ static int scpi_usbtmc_libusb_read_data(void *priv, char *buf, int maxlen)
 	return read_length;
 }
 
+static int scpi_usbtmc_libusb_read_raw(void *priv, char *buf, int maxlen)
+{
+	struct scpi_usbtmc_libusb *uscpi = priv;
+	struct sr_usb_dev_inst *usb = uscpi->usb;
+	int size, ret, transferred;
+
+	/*
+	 * Once the buffer is empty, transfer whole packets of the rest of
+	 * the message straight into buf. The size is a multiple of both the
+	 * full and the high speed packet size, so the transfer can't end in
+	 * the middle of a packet, and stays within the message.
+	 */
+	size = MIN(maxlen, uscpi->remaining_length) & ~(BULK_IN_PACKET_SIZE - 1);
+	if (uscpi->response_bytes_read < uscpi->response_length || size == 0)
+		return scpi_usbtmc_libusb_read_data(priv, buf, maxlen);
+
+	ret = libusb_bulk_transfer(usb->devhdl, uscpi->bulk_in_ep,
+	                           (unsigned char *)buf, size, &transferred,
+	                           TRANSFER_TIMEOUT);
+	if (ret < 0) {
+		sr_err("USBTMC bulk in transfer error: %s.",
+		       libusb_error_name(ret));
+		return SR_ERR;
+	}
+
+	uscpi->remaining_length -= transferred;
+
+	return transferred;
+}
+
 static int scpi_usbtmc_libusb_read_complete(void *priv)
 {
 	struct scpi_usbtmc_libusb *uscpi = priv;
@@ -664,6 +695,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev = {
 	.send          = scpi_usbtmc_libusb_send,
 	.read_begin    = scpi_usbtmc_libusb_read_begin,
 	.read_data     = scpi_usbtmc_libusb_read_data,
+	.read_raw      = scpi_usbtmc_libusb_read_raw,
 	.read_complete = scpi_usbtmc_libusb_read_complete,
 	.close         = scpi_usbtmc_libusb_close,
 	.free          = scpi_usbtmc_libusb_free,
@@ -51,6 +51,50 @@ struct datafeed_callback {
 	void *cb_data;
 };
 
+/** Packet waiting in the asynchronous datafeed bus. */
+struct bus_entry {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+	/* Buffer holding the packet's sample data, or NULL. */
+	struct sr_buffer *buffer;
+	/* Monotonic time the packet was queued at. */
+	int64_t time;
+};
+
+/** Bounded packet queue between sr_session_send() and the thread which
+ * runs the transforms and datafeed callbacks.
+ * @internal
+ */
+struct session_bus {
+	GMutex mutex;
+	GCond not_empty;
+	GCond not_full;
+
+	/* Ring of size entries, count of them valid starting at head. */
+	struct bus_entry *ring;
+	unsigned int size;
+	unsigned int head;
+	unsigned int count;
+
+	/* Drop data packets instead of blocking when the ring is full. */
+	gboolean drop;
+	/* Set to have the dispatch thread exit once the ring is empty. */
+	gboolean quit;
+	GThread *thread;
+
+	struct sr_session_bus_stats stats;
+};
+
+/* Buffer holding the sample data of the packet being dispatched. */
+static GPrivate current_buffer = G_PRIVATE_INIT(NULL);
+
+static int bus_start(struct sr_session *session);
+static void bus_stop(struct sr_session *session);
+static void bus_free(struct session_bus *bus);
+static int packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy, void *data);
+static void packet_free(struct sr_datafeed_packet *packet, gboolean free_data);
+
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
  * @internal
@@ -258,6 +302,9 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	sr_session_datafeed_callback_remove_all(session);
 
+	bus_stop(session);
+	bus_free(session->bus);
+
 	g_hash_table_unref(session->event_sources);
 
 	g_mutex_clear(&session->main_mutex);
@@ -350,6 +397,16 @@ SR_API int sr_session_dev_add(struct sr_session *session,
 		return SR_ERR_BUG;
 	}
 
+#ifdef HAVE_LIBUSB_1_0
+	/* The USB event thread may already be running. */
+	if (session->running && session->usb_thread
+			&& !usb_event_thread_supported(sdi)) {
+		sr_err("%s: driver doesn't support the USB event thread",
+		       __func__);
+		return SR_ERR;
+	}
+#endif
+
 	session->devs = g_slist_append(session->devs, sdi);
 	sdi->session = session;
 
@@ -505,6 +562,182 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Set up asynchronous delivery of the datafeed of a session.
+ *
+ * By default, transforms and datafeed callbacks run inline in the thread
+ * sending a packet, which usually is the thread handling the device I/O.
+ * In asynchronous mode, sr_session_send() copies the packet into a bounded
+ * queue and returns; a dispatch thread started along with the session
+ * runs the transforms and callbacks, in the order the packets were sent.
+ * The queue is drained before the session is reported as stopped.
+ *
+ * When the queue is full, the sender blocks until there is room again.
+ * If @a drop is TRUE, logic and analog packets are dropped (and counted)
+ * instead, so slow consumers cannot stall the acquisition. Other packets
+ * are never dropped.
+ *
+ * @param session The session to use. Must not be NULL. Must not be running.
+ * @param queue_size Maximum number of packets waiting in the queue, or 0
+ *                   to run the transforms and callbacks inline again.
+ * @param drop Whether to drop data packets when the queue is full.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_async_set(struct sr_session *session,
+		unsigned int queue_size, gboolean drop)
+{
+	struct session_bus *bus;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (session->running) {
+		sr_err("Cannot change the datafeed bus of a running session.");
+		return SR_ERR;
+	}
+
+	bus_free(session->bus);
+	session->bus = NULL;
+
+	if (queue_size == 0)
+		return SR_OK;
+
+	bus = g_malloc0(sizeof(struct session_bus));
+	g_mutex_init(&bus->mutex);
+	g_cond_init(&bus->not_empty);
+	g_cond_init(&bus->not_full);
+	bus->ring = g_malloc0(sizeof(struct bus_entry) * queue_size);
+	bus->size = queue_size;
+	bus->drop = drop;
+	session->bus = bus;
+
+	return SR_OK;
+}
+
+/**
+ * Get the statistics of the asynchronous datafeed bus of a session.
+ *
+ * The statistics are reset when the session is started, and remain
+ * available after it stopped. This function may be called from any thread.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Pointer to a struct which will be filled in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The session does not use an asynchronous datafeed bus.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_bus_stats_get(struct sr_session *session,
+		struct sr_session_bus_stats *stats)
+{
+	struct session_bus *bus;
+
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	if (!(bus = session->bus))
+		return SR_ERR_NA;
+
+	g_mutex_lock(&bus->mutex);
+	*stats = bus->stats;
+	g_mutex_unlock(&bus->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Set whether the datafeed callbacks of a session receive run-length
+ * encoded logic packets.
+ *
+ * Some drivers send logic data as SR_DF_LOGIC_RLE packets, which cost
+ * memory and time in proportion to the number of transitions rather than
+ * samples. By default, such packets are expanded into SR_DF_LOGIC packets
+ * before they reach the datafeed callbacks. A frontend which handles
+ * SR_DF_LOGIC_RLE packets, e.g. by passing them to sr_output_send(), can
+ * disable the expansion. Packets are still expanded while transforms are
+ * set up.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to receive SR_DF_LOGIC_RLE packets.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_logic_rle_set(struct sr_session *session,
+		gboolean enable)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (session->running) {
+		sr_err("Cannot change the datafeed of a running session.");
+		return SR_ERR;
+	}
+
+	session->logic_rle = enable;
+
+	return SR_OK;
+}
+
+/**
+ * Set whether libusb events of a session are handled by a separate thread.
+ *
+ * By default, USB transfers are reaped by the session main loop, so a
+ * slow datafeed callback delays the resubmission of transfers and may
+ * make the device overrun. With the USB event thread enabled, a thread
+ * of its own waits for libusb events and queues the completed transfers,
+ * which are then handed to the drivers in the session thread. If the
+ * session holds a USB device whose driver doesn't support the thread,
+ * events are handled in the main loop as before, and such devices can't
+ * be added while the session is running.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to handle libusb events in a separate thread.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR_NA libsigrok was built without libusb.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_usb_thread_set(struct sr_session *session,
+		gboolean enable)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+#ifndef HAVE_LIBUSB_1_0
+	if (enable)
+		return SR_ERR_NA;
+#endif
+
+	if (session->running) {
+		sr_err("Cannot change USB event handling of a running session.");
+		return SR_ERR;
+	}
+
+	session->usb_thread = enable;
+
+	return SR_OK;
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -689,6 +922,9 @@ static gboolean delayed_stop_check(void *data)
 	if (g_hash_table_size(session->event_sources) != 0)
 		return G_SOURCE_REMOVE;
 
+	/* Deliver whatever is still queued before reporting the stop. */
+	bus_stop(session);
+
 	session->running = FALSE;
 	unset_main_context(session);
 
@@ -808,7 +1044,14 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	sr_info("Starting.");
 
+	ret = bus_start(session);
+	if (ret != SR_OK) {
+		unset_main_context(session);
+		return ret;
+	}
+
 	session->running = TRUE;
+	session->acq_error = SR_OK;
 
 	/* Have all devices start acquisition. */
 	for (l = session->devs; l; l = l->next) {
@@ -832,6 +1075,7 @@ SR_API int sr_session_start(struct sr_session *session)
 		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
+		bus_stop(session);
 		session->running = FALSE;
 
 		unset_main_context(session);
@@ -859,6 +1103,8 @@ SR_API int sr_session_start(struct sr_session *session)
  * @retval SR_OK Success.
  * @retval SR_ERR_ARG Invalid session passed.
  * @retval SR_ERR Other error.
+ * @retval other The error of a device which failed during the acquisition,
+ *               so the data it sent is incomplete.
  *
  * @since 0.4.0
  */
@@ -893,7 +1139,24 @@ SR_API int sr_session_run(struct sr_session *session)
 	g_main_loop_unref(session->main_loop);
 	session->main_loop = NULL;
 
-	return SR_OK;
+	return session->acq_error;
+}
+
+/**
+ * Report that a device failed during the acquisition. The device still
+ * ends its data feed with SR_DF_END as usual, sr_session_run() then
+ * returns the error of the first device which failed.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param error The error, an SR_ERR* code.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_acquisition_failed(struct sr_session *session,
+		int error)
+{
+	if (session->acq_error == SR_OK)
+		session->acq_error = error;
 }
 
 static gboolean session_stop_sync(void *user_data)
@@ -1034,6 +1297,7 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *logic_rle;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1070,12 +1334,309 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_RLE:
+		logic_rle = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_RLE packet (%" PRIu64 " runs, "
+		       "unitsize = %d).", logic_rle->num_runs, logic_rle->unitsize);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
+/* Number of samples per SR_DF_LOGIC packet expanded from SR_DF_LOGIC_RLE. */
+#define RLE_EXPAND_CHUNK (64 * 1024)
+
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+
+/* Dispatch a run-length encoded packet as a series of logic packets. */
+static int dispatch_expanded(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_buffer *buf, *prev_buf;
+	uint64_t run, offset, num_samples;
+	int ret;
+
+	num_samples = MIN(logic_rle_num_samples(rle), RLE_EXPAND_CHUNK);
+	if (num_samples == 0)
+		return SR_OK;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	prev_buf = g_private_get(&current_buffer);
+	run = offset = 0;
+	ret = SR_OK;
+	while (ret == SR_OK) {
+		/* Consumers may keep a reference, so use a new buffer each time. */
+		buf = sr_buffer_new(num_samples * rle->unitsize);
+		logic.data = sr_buffer_data(buf);
+		logic.length = logic_rle_expand(rle, &run, &offset,
+				logic.data, num_samples) * rle->unitsize;
+		if (logic.length > 0) {
+			g_private_set(&current_buffer, buf);
+			ret = session_dispatch(sdi, &packet);
+		}
+		sr_buffer_unref(buf);
+		if (logic.length == 0)
+			break;
+	}
+	g_private_set(&current_buffer, prev_buf);
+
+	return ret;
+}
+
+/* Run the transforms and datafeed callbacks on a packet. */
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+	struct sr_datafeed_packet *packet_in, *packet_out;
+	struct sr_transform *t;
+	int ret;
+
+	/*
+	 * Transforms only know plain logic packets, and so do frontends
+	 * which didn't ask for run-length encoded ones.
+	 */
+	if (packet->type == SR_DF_LOGIC_RLE && (!sdi->session->logic_rle
+			|| sdi->session->transforms))
+		return dispatch_expanded(sdi, packet->payload);
+
+	/*
+	 * Pass the packet to the first transform module. If that returns
+	 * another packet (instead of NULL), pass that packet to the next
+	 * transform module in the list, and so on.
+	 */
+	packet_in = (struct sr_datafeed_packet *)packet;
+	for (l = sdi->session->transforms; l; l = l->next) {
+		t = l->data;
+		sr_spew("Running transform module '%s'.", t->module->id);
+		ret = t->module->receive(t, packet_in, &packet_out);
+		if (ret < 0) {
+			sr_err("Error while running transform module: %d.", ret);
+			return SR_ERR;
+		}
+		if (!packet_out) {
+			/*
+			 * If any of the transforms don't return an output
+			 * packet, abort.
+			 */
+			sr_spew("Transform module didn't return a packet, aborting.");
+			return SR_OK;
+		} else {
+			/*
+			 * Use this transform module's output packet as input
+			 * for the next transform module.
+			 */
+			packet_in = packet_out;
+		}
+	}
+	packet = packet_in;
+
+	/*
+	 * If the last transform did output a packet, pass it to all datafeed
+	 * callbacks.
+	 */
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		if (sr_log_enabled(SR_LOG_DBG))
+			datafeed_dump(packet);
+		cb_struct = l->data;
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	}
+
+	return SR_OK;
+}
+
+/* Dispatch thread of the asynchronous datafeed bus. */
+static gpointer bus_thread(gpointer data)
+{
+	struct session_bus *bus;
+	struct bus_entry entry;
+	uint64_t latency;
+
+	bus = data;
+
+	g_mutex_lock(&bus->mutex);
+	for (;;) {
+		while (bus->count == 0 && !bus->quit)
+			g_cond_wait(&bus->not_empty, &bus->mutex);
+		if (bus->count == 0)
+			break;
+
+		entry = bus->ring[bus->head];
+		bus->head = (bus->head + 1) % bus->size;
+		bus->count--;
+		bus->stats.queue_depth = bus->count;
+		latency = g_get_monotonic_time() - entry.time;
+		if (latency > bus->stats.max_latency)
+			bus->stats.max_latency = latency;
+		g_cond_signal(&bus->not_full);
+		g_mutex_unlock(&bus->mutex);
+
+		g_private_set(&current_buffer, entry.buffer);
+		session_dispatch(entry.sdi, entry.packet);
+		g_private_set(&current_buffer, NULL);
+		packet_free(entry.packet, !entry.buffer);
+		sr_buffer_unref(entry.buffer);
+
+		g_mutex_lock(&bus->mutex);
+	}
+	g_mutex_unlock(&bus->mutex);
+
+	return NULL;
+}
+
+/* Returns the sample data of a packet and its size, or NULL. */
+static const void *packet_data(const struct sr_datafeed_packet *packet,
+		size_t *size)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		*size = logic->length;
+		return logic->data;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		*size = analog->encoding->unitsize * analog->num_samples;
+		return analog->data;
+	default:
+		*size = 0;
+		return NULL;
+	}
+}
+
+/*
+ * Queue a packet for the dispatch thread. Sample data in buf is shared,
+ * other sample data is copied into a new buffer.
+ */
+static int bus_push(struct session_bus *bus, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	struct sr_datafeed_packet *copy;
+	struct bus_entry *entry;
+	const void *data;
+	void *shared;
+	size_t size;
+	gboolean droppable;
+	int ret;
+
+	droppable = bus->drop && (packet->type == SR_DF_LOGIC
+			|| packet->type == SR_DF_ANALOG
+			|| packet->type == SR_DF_LOGIC_RLE);
+
+	g_mutex_lock(&bus->mutex);
+	if (droppable && bus->count == bus->size) {
+		bus->stats.dropped++;
+		g_mutex_unlock(&bus->mutex);
+		return SR_OK;
+	}
+	g_mutex_unlock(&bus->mutex);
+
+	shared = NULL;
+	if ((data = packet_data(packet, &size))) {
+		if (buf) {
+			buf = sr_buffer_ref(buf);
+			shared = (void *)data;
+		} else {
+			buf = sr_buffer_new(size);
+			shared = sr_buffer_data(buf);
+			memcpy(shared, data, size);
+		}
+	} else {
+		buf = NULL;
+	}
+
+	if ((ret = packet_copy(packet, &copy, shared)) != SR_OK) {
+		sr_buffer_unref(buf);
+		return ret;
+	}
+
+	g_mutex_lock(&bus->mutex);
+	while (bus->count == bus->size) {
+		if (droppable) {
+			bus->stats.dropped++;
+			g_mutex_unlock(&bus->mutex);
+			packet_free(copy, FALSE);
+			sr_buffer_unref(buf);
+			return SR_OK;
+		}
+		g_cond_wait(&bus->not_full, &bus->mutex);
+	}
+	entry = &bus->ring[(bus->head + bus->count) % bus->size];
+	entry->sdi = sdi;
+	entry->packet = copy;
+	entry->buffer = buf;
+	entry->time = g_get_monotonic_time();
+	bus->count++;
+	bus->stats.queued++;
+	bus->stats.queue_depth = bus->count;
+	if (bus->count > bus->stats.max_queue_depth)
+		bus->stats.max_queue_depth = bus->count;
+	g_cond_signal(&bus->not_empty);
+	g_mutex_unlock(&bus->mutex);
+
+	return SR_OK;
+}
+
+static int bus_start(struct sr_session *session)
+{
+	struct session_bus *bus;
+	GThread *thread;
+
+	if (!(bus = session->bus))
+		return SR_OK;
+
+	memset(&bus->stats, 0, sizeof(bus->stats));
+	bus->quit = FALSE;
+	thread = g_thread_try_new("sr-session-bus", bus_thread, bus, NULL);
+	if (!thread) {
+		sr_err("Failed to start the datafeed bus thread.");
+		return SR_ERR;
+	}
+	g_atomic_pointer_set(&bus->thread, thread);
+
+	return SR_OK;
+}
+
+/* Wait for the dispatch thread to deliver all queued packets and exit. */
+static void bus_stop(struct sr_session *session)
+{
+	struct session_bus *bus;
+	GThread *thread;
+
+	if (!(bus = session->bus) || !(thread = bus->thread))
+		return;
+
+	g_mutex_lock(&bus->mutex);
+	bus->quit = TRUE;
+	g_cond_signal(&bus->not_empty);
+	g_mutex_unlock(&bus->mutex);
+
+	g_thread_join(thread);
+	g_atomic_pointer_set(&bus->thread, NULL);
+}
+
+static void bus_free(struct session_bus *bus)
+{
+	if (!bus)
+		return;
+
+	g_cond_clear(&bus->not_full);
+	g_cond_clear(&bus->not_empty);
+	g_mutex_clear(&bus->mutex);
+	g_free(bus->ring);
+	g_free(bus);
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1092,10 +1653,33 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
-	struct sr_datafeed_packet *packet_in, *packet_out;
-	struct sr_transform *t;
+	return sr_session_send_buffer(sdi, packet, NULL);
+}
+
+/**
+ * Send a packet whose sample data lives in a reference-counted buffer.
+ *
+ * Datafeed consumers, and the asynchronous datafeed bus, can then keep
+ * a reference to the buffer instead of copying the data. The caller keeps
+ * its own reference, and must not modify the data while it is shared;
+ * drivers typically get a fresh buffer from a pool for the next transfer.
+ *
+ * @param sdi The device instance sending the packet.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buf The buffer holding the packet's sample data, or NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	struct session_bus *bus;
+	struct sr_buffer *prev_buf;
+	GThread *thread;
+	size_t size;
 	int ret;
 
 	if (!sdi) {
@@ -1147,52 +1731,80 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		meaning.mqflags = analog_old->mqflags;
 		meaning.channels = analog_old->channels;
 		spec.spec_digits = 0;
-		return sr_session_send(sdi, &new_packet);
+		return sr_session_send_buffer(sdi, &new_packet, buf);
 	}
 
-	/*
-	 * Pass the packet to the first transform module. If that returns
-	 * another packet (instead of NULL), pass that packet to the next
-	 * transform module in the list, and so on.
-	 */
-	packet_in = (struct sr_datafeed_packet *)packet;
-	for (l = sdi->session->transforms; l; l = l->next) {
-		t = l->data;
-		sr_spew("Running transform module '%s'.", t->module->id);
-		ret = t->module->receive(t, packet_in, &packet_out);
-		if (ret < 0) {
-			sr_err("Error while running transform module: %d.", ret);
-			return SR_ERR;
-		}
-		if (!packet_out) {
-			/*
-			 * If any of the transforms don't return an output
-			 * packet, abort.
-			 */
-			sr_spew("Transform module didn't return a packet, aborting.");
-			return SR_OK;
-		} else {
-			/*
-			 * Use this transform module's output packet as input
-			 * for the next transform module.
-			 */
-			packet_in = packet_out;
-		}
+	if (G_UNLIKELY(sr_trace_active)) {
+		packet_data(packet, &size);
+		sr_trace_record(SR_TRACE_SESSION_SEND, packet->type, size);
 	}
-	packet = packet_in;
 
-	/*
-	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
-	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	bus = sdi->session->bus;
+	if (bus) {
+		thread = g_atomic_pointer_get(&bus->thread);
+		/* Packets sent from the dispatch thread itself go inline. */
+		if (thread && thread != g_thread_self())
+			return bus_push(bus, sdi, packet, buf);
 	}
 
-	return SR_OK;
+	prev_buf = g_private_get(&current_buffer);
+	g_private_set(&current_buffer, buf);
+	ret = session_dispatch(sdi, packet);
+	g_private_set(&current_buffer, prev_buf);
+
+	return ret;
+}
+
+/**
+ * Get a reference to the sample data of a datafeed packet.
+ *
+ * This lets a datafeed callback keep the sample data of a logic or analog
+ * packet after it returns. If the driver sent the data in a buffer, a
+ * reference to that buffer is returned and nothing is copied. Otherwise,
+ * the data is copied into a new buffer if @a copy is TRUE.
+ *
+ * Must be called from within the datafeed callback receiving @a packet.
+ *
+ * @param packet The packet. Must not be NULL.
+ * @param data Will be set to the packet's sample data within the returned
+ *             buffer. Must not be NULL.
+ * @param copy Whether to copy the data if it is not held in a buffer.
+ *
+ * @return A buffer reference which must be released with sr_buffer_unref(),
+ *         or NULL if the packet has no sample data, or it would have to be
+ *         copied and @a copy is FALSE.
+ *
+ * @since 0.5.0
+ */
+SR_API struct sr_buffer *sr_packet_buffer_get(
+		const struct sr_datafeed_packet *packet, void **data, gboolean copy)
+{
+	struct sr_buffer *buf;
+	const uint8_t *start, *bufdata;
+	size_t size;
+
+	if (!packet || !data)
+		return NULL;
+
+	if (!(start = packet_data(packet, &size)))
+		return NULL;
+
+	buf = g_private_get(&current_buffer);
+	bufdata = sr_buffer_data(buf);
+	if (buf && start >= bufdata
+			&& start + size <= bufdata + sr_buffer_size(buf)) {
+		*data = (void *)start;
+		return sr_buffer_ref(buf);
+	}
+
+	if (!copy)
+		return NULL;
+
+	buf = sr_buffer_new(size);
+	*data = sr_buffer_data(buf);
+	memcpy(*data, start, size);
+
+	return buf;
 }
 
 /**
@@ -1493,6 +2105,13 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 
 SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy)
+{
+	return packet_copy(packet, copy, NULL);
+}
+
+/* Copy a packet; sample data is copied too, unless data is given. */
+static int packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy, void *data)
 {
 	const struct sr_datafeed_meta *meta;
 	struct sr_datafeed_meta *meta_copy;
@@ -1502,6 +2121,8 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_analog_old *analog_old_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
+	const struct sr_datafeed_logic_rle *logic_rle;
+	struct sr_datafeed_logic_rle *logic_rle_copy;
 	uint8_t *payload;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
@@ -1510,6 +2131,8 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1520,20 +2143,25 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		logic_copy = g_malloc(sizeof(logic));
+		logic_copy = g_malloc(sizeof(struct sr_datafeed_logic));
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		if (data) {
+			logic_copy->data = data;
+		} else {
+			logic_copy->data = g_malloc(logic->length);
+			memcpy(logic_copy->data, logic->data, logic->length);
+		}
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG_OLD:
 		analog_old = packet->payload;
-		analog_old_copy = g_malloc(sizeof(analog_old));
+		analog_old_copy = g_malloc(sizeof(struct sr_datafeed_analog_old));
 		analog_old_copy->channels = g_slist_copy(analog_old->channels);
 		analog_old_copy->num_samples = analog_old->num_samples;
 		analog_old_copy->mq = analog_old->mq;
@@ -1546,11 +2174,15 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		analog_copy = g_malloc(sizeof(analog));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		analog_copy = g_malloc(sizeof(struct sr_datafeed_analog));
+		if (data) {
+			analog_copy->data = data;
+		} else {
+			analog_copy->data = g_malloc(
+					analog->encoding->unitsize * analog->num_samples);
+			memcpy(analog_copy->data, analog->data,
+					analog->encoding->unitsize * analog->num_samples);
+		}
 		analog_copy->num_samples = analog->num_samples;
 		analog_copy->encoding = g_memdup(analog->encoding,
 				sizeof(struct sr_analog_encoding));
@@ -1562,6 +2194,17 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 				sizeof(struct sr_analog_spec));
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_LOGIC_RLE:
+		logic_rle = packet->payload;
+		logic_rle_copy = g_malloc(sizeof(struct sr_datafeed_logic_rle));
+		logic_rle_copy->num_runs = logic_rle->num_runs;
+		logic_rle_copy->unitsize = logic_rle->unitsize;
+		logic_rle_copy->samples = g_memdup(logic_rle->samples,
+				logic_rle->num_runs * logic_rle->unitsize);
+		logic_rle_copy->lengths = g_memdup(logic_rle->lengths,
+				logic_rle->num_runs * sizeof(uint64_t));
+		(*copy)->payload = logic_rle_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 		return SR_ERR;
@@ -1571,17 +2214,26 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 }
 
 void sr_packet_free(struct sr_datafeed_packet *packet)
+{
+	packet_free(packet, TRUE);
+}
+
+/* Free a packet; sample data is left alone unless free_data is TRUE. */
+static void packet_free(struct sr_datafeed_packet *packet, gboolean free_data)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	struct sr_config *src;
 	GSList *l;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1600,7 +2252,8 @@ void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
+		if (free_data)
+			g_free(logic->data);
 		g_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG_OLD:
@@ -1611,13 +2264,21 @@ void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
+		if (free_data)
+			g_free(analog->data);
 		g_free(analog->encoding);
 		g_slist_free(analog->meaning->channels);
 		g_free(analog->meaning);
 		g_free(analog->spec);
 		g_free((void *)packet->payload);
 		break;
+	case SR_DF_LOGIC_RLE:
+		/* Runs are always copied. */
+		logic_rle = packet->payload;
+		g_free(logic_rle->samples);
+		g_free(logic_rle->lengths);
+		g_free((void *)packet->payload);
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 	}
@@ -18,6 +18,9 @@
  */
 
 #include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -34,114 +37,430 @@
 #define CHUNKSIZE (512 * 1024)
 /** @endcond */
 
+/* Number of threads decompressing chunks of the capture file. */
+#define NUM_THREADS 4
+/* Number of payloads read ahead per chunk. */
+#define MAX_AHEAD 4
+
 SR_PRIV struct sr_dev_driver session_driver_info;
 
+/* A chunk of the capture file, "logic-1" or "logic-1-<num>". */
+struct chunk_info {
+	zip_uint64_t index;
+	int num;
+	uint64_t first_sample;
+	uint64_t num_samples;
+};
+
+struct read_block {
+	struct sr_buffer *buf;
+	size_t length;
+};
+
+/* Blocks read from one chunk, waiting to be sent. */
+struct chunk_job {
+	GQueue blocks;
+	gboolean done;
+};
+
+/*
+ * Reads the capture file ahead of the session. Each thread opens the
+ * archive on its own and takes the next chunk not taken yet; the session
+ * thread sends the blocks of one chunk after the other.
+ */
+struct session_reader {
+	GMutex mutex;
+	GCond cond;
+	GThread *threads[NUM_THREADS];
+	int num_threads;
+	struct sr_buffer_pool *pool;
+	char *sessionfile;
+	int unitsize;
+	const struct chunk_info *chunks;
+	struct chunk_job *jobs;
+	unsigned int num_jobs;
+	/* Next chunk to read, and the one being sent. */
+	unsigned int next_job;
+	unsigned int cur_job;
+	/* Bytes to skip at the start of the first chunk. */
+	uint64_t skip;
+	gboolean stop;
+	gboolean error;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
-	struct zip *archive;
-	struct zip_file *capfile;
-	int bytes_read;
 	uint64_t samplerate;
 	int unitsize;
 	int num_channels;
-	int cur_chunk;
+	/* Chunk index, built on first use. */
+	GArray *chunks;
+	uint64_t total_samples;
+	uint64_t offset;
+	uint64_t limit_samples;
+	uint64_t samples_left;
+	struct session_reader *reader;
 	gboolean finished;
 };
 
 static const uint32_t devopts[] = {
 	SR_CONF_CAPTUREFILE | SR_CONF_SET,
 	SR_CONF_CAPTURE_UNITSIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_CAPTURE_OFFSET | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_NUM_LOGIC_CHANNELS | SR_CONF_SET,
+	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
 };
 
-static gboolean stream_session_data(struct sr_dev_inst *sdi)
+static gint chunk_cmp(gconstpointer a, gconstpointer b)
 {
-	struct session_vdev *vdev;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
+	const struct chunk_info *ca = a, *cb = b;
+
+	return ca->num - cb->num;
+}
+
+static void index_free(struct session_vdev *vdev)
+{
+	if (vdev->chunks)
+		g_array_free(vdev->chunks, TRUE);
+	vdev->chunks = NULL;
+	vdev->total_samples = 0;
+}
+
+/*
+ * Build the chunk index from the zip directory: the capture file is
+ * either a single entry named after it, or chunks numbered from 1.
+ */
+static int index_build(struct session_vdev *vdev)
+{
+	struct zip *archive;
 	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[16];
-	void *buf;
+	struct chunk_info chunk, *c;
+	const char *name;
+	char *end;
+	zip_int64_t num_entries, i;
+	size_t len;
+	unsigned int n;
+	int ret;
 
-	got_data = FALSE;
-	vdev = sdi->priv;
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->cur_chunk == 0) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, 15, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
+	if (vdev->chunks)
+		return SR_OK;
+
+	if (!vdev->sessionfile || !vdev->capturefile || vdev->unitsize <= 0) {
+		sr_err("Session file, capture file or unit size missing.");
+		return SR_ERR;
+	}
+
+	if (!(archive = zip_open(vdev->sessionfile, 0, &ret))) {
+		sr_err("Failed to open session file '%s': "
+		       "zip error %d.", vdev->sessionfile, ret);
+		return SR_ERR;
+	}
+
+	vdev->chunks = g_array_new(FALSE, FALSE, sizeof(struct chunk_info));
+	len = strlen(vdev->capturefile);
+	num_entries = zip_get_num_entries(archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		name = zip_get_name(archive, i, 0);
+		if (!name || strncmp(name, vdev->capturefile, len))
+			continue;
+		if (name[len] == '\0') {
+			chunk.num = 0;
+		} else if (name[len] == '-' && g_ascii_isdigit(name[len + 1])) {
+			chunk.num = strtol(name + len + 1, &end, 10);
+			if (*end != '\0' || chunk.num <= 0)
+				continue;
 		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, 15, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else {
-				/* We got all the chunks, finish up. */
-				return FALSE;
+			continue;
+		}
+		if (zip_stat_index(archive, i, 0, &zs) < 0)
+			continue;
+		chunk.index = i;
+		chunk.first_sample = 0;
+		chunk.num_samples = zs.size / vdev->unitsize;
+		if (zs.size % vdev->unitsize != 0)
+			sr_warn("Size of %s not a multiple of the unit size %d.",
+				name, vdev->unitsize);
+		g_array_append_val(vdev->chunks, chunk);
+	}
+	zip_discard(archive);
+
+	g_array_sort(vdev->chunks, chunk_cmp);
+
+	/* An unchunked capture file takes precedence, like before. */
+	if (vdev->chunks->len > 0
+			&& g_array_index(vdev->chunks, struct chunk_info, 0).num == 0)
+		g_array_set_size(vdev->chunks, 1);
+
+	/* Chunks end at the first one missing. */
+	for (n = 0; n < vdev->chunks->len; n++) {
+		c = &g_array_index(vdev->chunks, struct chunk_info, n);
+		if (c->num != 0 && c->num != (int)n + 1) {
+			g_array_set_size(vdev->chunks, n);
+			break;
+		}
+		c->first_sample = vdev->total_samples;
+		vdev->total_samples += c->num_samples;
+	}
+
+	if (vdev->chunks->len == 0) {
+		sr_err("No capture file '%s' in " "session file '%s'.",
+				vdev->capturefile, vdev->sessionfile);
+		index_free(vdev);
+		return SR_ERR;
+	}
+
+	sr_dbg("Capture file %s has %u chunk(s), %" PRIu64 " samples.",
+		vdev->capturefile, vdev->chunks->len, vdev->total_samples);
+
+	return SR_OK;
+}
+
+/* Give up reading, the session thread stops at the next block. */
+static void reader_fail(struct session_reader *rd)
+{
+	g_mutex_lock(&rd->mutex);
+	rd->error = TRUE;
+	g_cond_broadcast(&rd->cond);
+	g_mutex_unlock(&rd->mutex);
+}
+
+/* Read one chunk into blocks, as far ahead as the session allows. */
+static void read_chunk(struct session_reader *rd, struct zip *archive,
+		unsigned int j)
+{
+	struct chunk_job *job;
+	struct read_block *block;
+	struct zip_file *zf;
+	struct sr_buffer *buf;
+	zip_int64_t ret;
+	uint64_t skip;
+	size_t size;
+	gboolean stop;
+
+	job = &rd->jobs[j];
+	size = CHUNKSIZE / rd->unitsize * rd->unitsize;
+
+	if (!(zf = zip_fopen_index(archive, rd->chunks[j].index, 0))) {
+		sr_err("Failed to open chunk %d: %s", rd->chunks[j].num,
+			zip_strerror(archive));
+		reader_fail(rd);
+		return;
+	}
+
+	buf = sr_buffer_pool_get(rd->pool);
+
+	/*
+	 * Compressed entries can't be seeked into, skip to the first
+	 * sample the hard way. That costs at most one chunk.
+	 */
+	for (skip = j == 0 ? rd->skip : 0; skip > 0; skip -= ret) {
+		if ((ret = zip_fread(zf, sr_buffer_data(buf),
+				MIN(skip, size))) <= 0) {
+			sr_err("Failed to read chunk %d: %s", rd->chunks[j].num,
+				ret < 0 ? zip_file_strerror(zf) : "too short");
+			reader_fail(rd);
+			sr_buffer_unref(buf);
+			zip_fclose(zf);
+			return;
+		}
+	}
+
+	while (TRUE) {
+		g_mutex_lock(&rd->mutex);
+		while (!rd->stop && job->blocks.length >= MAX_AHEAD)
+			g_cond_wait(&rd->cond, &rd->mutex);
+		stop = rd->stop;
+		g_mutex_unlock(&rd->mutex);
+		if (stop)
+			break;
+
+		ret = zip_fread(zf, sr_buffer_data(buf), size);
+		if (ret <= 0) {
+			if (ret < 0) {
+				sr_err("Failed to read chunk %d: %s",
+					rd->chunks[j].num, zip_file_strerror(zf));
+				reader_fail(rd);
 			}
+			break;
+		}
+		if (ret % rd->unitsize != 0)
+			sr_warn("Read size %" PRId64 " not a multiple of the"
+				" unit size %d.", (int64_t)ret, rd->unitsize);
+
+		block = g_malloc(sizeof(struct read_block));
+		block->buf = buf;
+		block->length = ret;
+		g_mutex_lock(&rd->mutex);
+		g_queue_push_tail(&job->blocks, block);
+		g_cond_broadcast(&rd->cond);
+		g_mutex_unlock(&rd->mutex);
+
+		buf = sr_buffer_pool_get(rd->pool);
+	}
+
+	sr_buffer_unref(buf);
+	zip_fclose(zf);
+}
+
+static gpointer reader_thread(gpointer data)
+{
+	struct session_reader *rd;
+	struct zip *archive;
+	unsigned int j;
+	int ret;
+
+	rd = data;
+	if (!(archive = zip_open(rd->sessionfile, 0, &ret))) {
+		sr_err("Failed to open session file '%s': "
+		       "zip error %d.", rd->sessionfile, ret);
+		reader_fail(rd);
+		return NULL;
+	}
+
+	while (TRUE) {
+		g_mutex_lock(&rd->mutex);
+		if (rd->stop || rd->error || rd->next_job == rd->num_jobs) {
+			g_mutex_unlock(&rd->mutex);
+			break;
 		}
+		j = rd->next_job++;
+		g_mutex_unlock(&rd->mutex);
+
+		read_chunk(rd, archive, j);
+
+		g_mutex_lock(&rd->mutex);
+		rd->jobs[j].done = TRUE;
+		g_cond_broadcast(&rd->cond);
+		g_mutex_unlock(&rd->mutex);
 	}
 
-	buf = g_malloc(CHUNKSIZE);
-
-	ret = zip_fread(vdev->capfile, buf,
-			CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	if (ret > 0) {
-		if (ret % vdev->unitsize != 0)
-			sr_warn("Read size %d not a multiple of the"
-				" unit size %d.", ret, vdev->unitsize);
-		got_data = TRUE;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = ret;
-		logic.unitsize = vdev->unitsize;
-		logic.data = buf;
-		vdev->bytes_read += ret;
-		sr_session_send(sdi, &packet);
-	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+	zip_discard(archive);
+
+	return NULL;
+}
+
+static void reader_free(struct session_reader *rd)
+{
+	struct read_block *block;
+	unsigned int j;
+	int i;
+
+	if (!rd)
+		return;
+
+	g_mutex_lock(&rd->mutex);
+	rd->stop = TRUE;
+	g_cond_broadcast(&rd->cond);
+	g_mutex_unlock(&rd->mutex);
+	for (i = 0; i < rd->num_threads; i++)
+		g_thread_join(rd->threads[i]);
+
+	for (j = 0; j < rd->num_jobs; j++) {
+		while ((block = g_queue_pop_head(&rd->jobs[j].blocks))) {
+			sr_buffer_unref(block->buf);
+			g_free(block);
+		}
+	}
+	sr_buffer_pool_free(rd->pool);
+	g_free(rd->jobs);
+	g_free(rd->sessionfile);
+	g_cond_clear(&rd->cond);
+	g_mutex_clear(&rd->mutex);
+	g_free(rd);
+}
+
+/* Start reading the capture file from its first chunk onwards. */
+static struct session_reader *reader_new(const struct session_vdev *vdev,
+		unsigned int first_chunk, uint64_t skip)
+{
+	struct session_reader *rd;
+	char name[16];
+	int i;
+
+	rd = g_malloc0(sizeof(struct session_reader));
+	g_mutex_init(&rd->mutex);
+	g_cond_init(&rd->cond);
+	rd->sessionfile = g_strdup(vdev->sessionfile);
+	rd->unitsize = vdev->unitsize;
+	rd->chunks = &g_array_index(vdev->chunks, struct chunk_info, first_chunk);
+	rd->num_jobs = vdev->chunks->len - first_chunk;
+	rd->jobs = g_malloc0(rd->num_jobs * sizeof(struct chunk_job));
+	rd->skip = skip;
+	rd->pool = sr_buffer_pool_new(CHUNKSIZE, NUM_THREADS * (MAX_AHEAD + 1));
+
+	for (i = 0; i < NUM_THREADS && (unsigned int)i < rd->num_jobs; i++) {
+		snprintf(name, sizeof(name), "sr-session-rd%d", i);
+		if (!(rd->threads[i] = g_thread_try_new(name, reader_thread,
+				rd, NULL))) {
+			sr_err("Failed to start a reader thread.");
+			break;
+		}
+		rd->num_threads++;
+	}
+
+	if (rd->num_threads == 0) {
+		reader_free(rd);
+		return NULL;
+	}
+
+	return rd;
+}
+
+/* Wait for the next block, NULL once all chunks are done. */
+static struct read_block *reader_next(struct session_reader *rd)
+{
+	struct read_block *block;
+	struct chunk_job *job;
+
+	block = NULL;
+	g_mutex_lock(&rd->mutex);
+	while (!rd->error && rd->cur_job < rd->num_jobs) {
+		job = &rd->jobs[rd->cur_job];
+		if ((block = g_queue_pop_head(&job->blocks))) {
+			g_cond_broadcast(&rd->cond);
+			break;
 		}
+		if (job->done)
+			rd->cur_job++;
+		else
+			g_cond_wait(&rd->cond, &rd->mutex);
 	}
-	g_free(buf);
+	g_mutex_unlock(&rd->mutex);
+
+	return block;
+}
+
+static gboolean stream_session_data(struct sr_dev_inst *sdi)
+{
+	struct session_vdev *vdev;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct read_block *block;
+	uint64_t num_samples;
+
+	vdev = sdi->priv;
+	if (vdev->samples_left == 0)
+		return FALSE;
+	if (!(block = reader_next(vdev->reader)))
+		return FALSE;
+
+	num_samples = MIN(block->length / vdev->unitsize, vdev->samples_left);
+	vdev->samples_left -= num_samples;
 
-	return got_data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = num_samples * vdev->unitsize;
+	logic.unitsize = vdev->unitsize;
+	logic.data = sr_buffer_data(block->buf);
+	sr_session_send_buffer(sdi, &packet, block->buf);
+
+	sr_buffer_unref(block->buf);
+	g_free(block);
+
+	return TRUE;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -149,6 +468,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 	struct sr_dev_inst *sdi;
 	struct session_vdev *vdev;
 	struct sr_datafeed_packet packet;
+	gboolean error;
 
 	(void)fd;
 	(void)revents;
@@ -161,14 +481,18 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
+	g_mutex_lock(&vdev->reader->mutex);
+	error = vdev->reader->error;
+	g_mutex_unlock(&vdev->reader->mutex);
+	if (error) {
+		sr_err("Failed to read capture file %s, %" PRIu64
+			" samples not sent.", vdev->capturefile,
+			vdev->samples_left);
+		sr_session_acquisition_failed(sdi->session, SR_ERR_IO);
 	}
+
+	reader_free(vdev->reader);
+	vdev->reader = NULL;
 	packet.type = SR_DF_END;
 	packet.payload = NULL;
 	sr_session_send(sdi, &packet);
@@ -214,7 +538,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
-	const struct session_vdev *const vdev = sdi->priv;
+	struct session_vdev *vdev = sdi->priv;
+
+	reader_free(vdev->reader);
+	index_free(vdev);
 	g_free(vdev->sessionfile);
 	g_free(vdev->capturefile);
 
@@ -243,6 +570,20 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_CAPTURE_OFFSET:
+		*data = g_variant_new_uint64(vdev->offset);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		/* Without a limit, the samples from the offset to the end. */
+		if (vdev->limit_samples) {
+			*data = g_variant_new_uint64(vdev->limit_samples);
+			break;
+		}
+		if (index_build(vdev) != SR_OK)
+			return SR_ERR;
+		*data = g_variant_new_uint64(vdev->total_samples
+				- MIN(vdev->offset, vdev->total_samples));
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -267,15 +608,24 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	case SR_CONF_SESSIONFILE:
 		g_free(vdev->sessionfile);
 		vdev->sessionfile = g_strdup(g_variant_get_string(data, NULL));
+		index_free(vdev);
 		sr_info("Setting sessionfile to '%s'.", vdev->sessionfile);
 		break;
 	case SR_CONF_CAPTUREFILE:
 		g_free(vdev->capturefile);
 		vdev->capturefile = g_strdup(g_variant_get_string(data, NULL));
+		index_free(vdev);
 		sr_info("Setting capturefile to '%s'.", vdev->capturefile);
 		break;
 	case SR_CONF_CAPTURE_UNITSIZE:
 		vdev->unitsize = g_variant_get_uint64(data);
+		index_free(vdev);
+		break;
+	case SR_CONF_CAPTURE_OFFSET:
+		vdev->offset = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		vdev->limit_samples = g_variant_get_uint64(data);
 		break;
 	case SR_CONF_NUM_LOGIC_CHANNELS:
 		vdev->num_channels = g_variant_get_int32(data);
@@ -308,23 +658,49 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct session_vdev *vdev;
-	int ret;
+	const struct chunk_info *chunk;
+	unsigned int first, last, mid;
 
 	(void)cb_data;
 
 	vdev = sdi->priv;
-	vdev->bytes_read = 0;
-	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
-	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
-		sr_err("Failed to open session file '%s': "
-		       "zip error %d.", vdev->sessionfile, ret);
+	if (index_build(vdev) != SR_OK)
 		return SR_ERR;
+
+	if (vdev->offset >= vdev->total_samples) {
+		sr_err("Offset %" PRIu64 " is past the end of the capture "
+			"(%" PRIu64 " samples).", vdev->offset,
+			vdev->total_samples);
+		return SR_ERR_ARG;
+	}
+
+	/* Find the chunk holding the first sample to send. */
+	first = 0;
+	last = vdev->chunks->len - 1;
+	while (first < last) {
+		mid = (first + last + 1) / 2;
+		chunk = &g_array_index(vdev->chunks, struct chunk_info, mid);
+		if (chunk->first_sample <= vdev->offset)
+			first = mid;
+		else
+			last = mid - 1;
 	}
+	chunk = &g_array_index(vdev->chunks, struct chunk_info, first);
+
+	vdev->samples_left = vdev->total_samples - vdev->offset;
+	if (vdev->limit_samples)
+		vdev->samples_left = MIN(vdev->samples_left, vdev->limit_samples);
+
+	reader_free(vdev->reader);
+	vdev->reader = reader_new(vdev, first,
+			(vdev->offset - chunk->first_sample) * vdev->unitsize);
+	if (!vdev->reader)
+		return SR_ERR;
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(sdi, LOG_PREFIX);
@@ -19,6 +19,9 @@
 
 #include <config.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -26,6 +29,94 @@
 #define LOG_PREFIX "soft-trigger"
 /* @endcond */
 
+/*
+ * Trigger stages are compiled into bit masks over the sample, one set of
+ * masks per stage. A sample x (with previous sample p) fails a stage if
+ * any of these bits is set:
+ *
+ *   (x & zero) | (~x & one) | ((p | ~x) & rising) |
+ *   ((~p | x) & falling) | (~(p ^ x) & edge)
+ *
+ * This lets a whole sample be checked a 64-bit word at a time, and stage 0
+ * be scanned 16 bytes at a time with SSE2 for the common unit sizes.
+ */
+
+static uint64_t *stage_mask(const struct soft_trigger_logic *stl,
+		int stage, int mask)
+{
+	return stl->masks + (stage * SOFT_TRIGGER_NUM_MASKS + mask)
+			* stl->num_words;
+}
+
+static void compile_stages(struct soft_trigger_logic *stl)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l, *m;
+	uint64_t bit, *masks;
+	int s, i, b, mask, idx;
+
+	stl->num_stages = g_slist_length(stl->trigger->stages);
+	stl->num_words = (stl->unitsize + 7) / 8;
+	stl->masks = g_malloc0(sizeof(uint64_t) * stl->num_words
+			* SOFT_TRIGGER_NUM_MASKS * MAX(stl->num_stages, 1));
+	stl->stage_edges = g_malloc0(sizeof(gboolean) * MAX(stl->num_stages, 1));
+	stl->valid = stl->num_stages > 0;
+
+	for (l = stl->trigger->stages, s = 0; l; l = l->next, s++) {
+		stage = l->data;
+		if (!stage->matches)
+			/* No matches supplied, client error. */
+			stl->valid = FALSE;
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			if (!match->channel->enabled)
+				/* Ignore disabled channels with a trigger. */
+				continue;
+			idx = match->channel->index;
+			if (idx < 0 || idx >= stl->unitsize * 8)
+				continue;
+			bit = (uint64_t)1 << (idx % 64);
+			switch (match->match) {
+			case SR_TRIGGER_ZERO:
+				mask = SOFT_TRIGGER_MASK_ZERO;
+				break;
+			case SR_TRIGGER_ONE:
+				mask = SOFT_TRIGGER_MASK_ONE;
+				break;
+			case SR_TRIGGER_RISING:
+				mask = SOFT_TRIGGER_MASK_RISING;
+				break;
+			case SR_TRIGGER_FALLING:
+				mask = SOFT_TRIGGER_MASK_FALLING;
+				break;
+			case SR_TRIGGER_EDGE:
+				mask = SOFT_TRIGGER_MASK_EDGE;
+				break;
+			default:
+				/* Can never match on a logic channel. */
+				stage_mask(stl, s, SOFT_TRIGGER_MASK_ZERO)[idx / 64] |= bit;
+				mask = SOFT_TRIGGER_MASK_ONE;
+				break;
+			}
+			stage_mask(stl, s, mask)[idx / 64] |= bit;
+			if (mask >= SOFT_TRIGGER_MASK_RISING)
+				stl->stage_edges[s] = TRUE;
+		}
+	}
+
+	/* Replicate the stage 0 masks for the vectorized scan. */
+	if (stl->num_stages == 0 || stl->unitsize > 8)
+		return;
+	for (mask = 0; mask < SOFT_TRIGGER_NUM_MASKS; mask++) {
+		masks = stage_mask(stl, 0, mask);
+		for (i = 0; i < 16; i++) {
+			b = i % stl->unitsize;
+			stl->scan_masks[mask][i] = masks[0] >> (8 * b);
+		}
+	}
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -46,11 +137,15 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	compile_stages(stl);
+
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	g_free(stl->stage_edges);
+	g_free(stl->masks);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -114,36 +209,152 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+/* Fetch 64-bit word w of a sample, channel 0 in bit 0 of word 0. */
+static inline uint64_t sample_word(const uint8_t *sample, int unitsize, int w)
+{
+	uint64_t word;
+	int i, n;
+
+	sample += w * 8;
+	n = MIN(unitsize - w * 8, 8);
+	if (n == 8)
+		return RL64(sample);
+	word = 0;
+	for (i = 0; i < n; i++)
+		word |= (uint64_t)sample[i] << (8 * i);
+
+	return word;
+}
+
+static gboolean stage_match(const struct soft_trigger_logic *stl, int stage,
+		const uint8_t *sample, const uint8_t *prev)
 {
-	int bit, prev_bit;
-	gboolean result;
-
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	const uint64_t *zero, *one, *rising, *falling, *edge;
+	uint64_t x, p;
+	int w;
+
+	if (stl->stage_edges[stage] && !prev)
+		/* First sample, don't have enough for an edge match yet. */
+		return FALSE;
+
+	zero = stage_mask(stl, stage, SOFT_TRIGGER_MASK_ZERO);
+	one = stage_mask(stl, stage, SOFT_TRIGGER_MASK_ONE);
+	rising = stage_mask(stl, stage, SOFT_TRIGGER_MASK_RISING);
+	falling = stage_mask(stl, stage, SOFT_TRIGGER_MASK_FALLING);
+	edge = stage_mask(stl, stage, SOFT_TRIGGER_MASK_EDGE);
+
+	for (w = 0; w < stl->num_words; w++) {
+		x = sample_word(sample, stl->unitsize, w);
+		if ((x & zero[w]) | (~x & one[w]))
+			return FALSE;
+		if (!stl->stage_edges[stage])
+			continue;
+		p = sample_word(prev, stl->unitsize, w);
+		if (((p | ~x) & rising[w]) | ((~p | x) & falling[w])
+				| (~(p ^ x) & edge[w]))
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
 	}
 
-	return result;
+	return TRUE;
+}
+
+#ifdef __SSE2__
+/*
+ * Scan 16 bytes at a time for the first sample matching stage 0. Needs
+ * unitsize 1, 2, 4 or 8 and start >= unitsize, so that the previous
+ * samples can be loaded from buf. Returns the byte offset of the match,
+ * or the offset where the scalar scan has to take over.
+ */
+static int scan_stage0_sse2(const struct soft_trigger_logic *stl,
+		const uint8_t *buf, int start, int len, gboolean *found)
+{
+	__m128i zero, one, rising, falling, edge, x, p, fail;
+	unsigned int lanes, bits;
+	int i, unitsize;
+
+	unitsize = stl->unitsize;
+	if (unitsize == 1)
+		lanes = 0xffff;
+	else if (unitsize == 2)
+		lanes = 0x5555;
+	else if (unitsize == 4)
+		lanes = 0x1111;
+	else
+		lanes = 0x0101;
+
+	zero = _mm_loadu_si128((const __m128i *)stl->scan_masks[SOFT_TRIGGER_MASK_ZERO]);
+	one = _mm_loadu_si128((const __m128i *)stl->scan_masks[SOFT_TRIGGER_MASK_ONE]);
+	rising = _mm_loadu_si128((const __m128i *)stl->scan_masks[SOFT_TRIGGER_MASK_RISING]);
+	falling = _mm_loadu_si128((const __m128i *)stl->scan_masks[SOFT_TRIGGER_MASK_FALLING]);
+	edge = _mm_loadu_si128((const __m128i *)stl->scan_masks[SOFT_TRIGGER_MASK_EDGE]);
+
+	*found = FALSE;
+	for (i = start; i + 16 <= len; i += 16) {
+		x = _mm_loadu_si128((const __m128i *)(buf + i));
+		fail = _mm_or_si128(_mm_and_si128(x, zero),
+				_mm_andnot_si128(x, one));
+		if (stl->stage_edges[0]) {
+			p = _mm_loadu_si128((const __m128i *)(buf + i - unitsize));
+			fail = _mm_or_si128(fail, _mm_or_si128(
+				_mm_and_si128(p, rising), _mm_andnot_si128(x, rising)));
+			fail = _mm_or_si128(fail, _mm_or_si128(
+				_mm_andnot_si128(p, falling), _mm_and_si128(x, falling)));
+			fail = _mm_or_si128(fail,
+				_mm_andnot_si128(_mm_xor_si128(p, x), edge));
+		}
+		/* One bit per byte that passed, folded to one bit per sample. */
+		bits = _mm_movemask_epi8(_mm_cmpeq_epi8(fail, _mm_setzero_si128()));
+		if (unitsize >= 2)
+			bits &= bits >> 1;
+		if (unitsize >= 4)
+			bits &= bits >> 2;
+		if (unitsize >= 8)
+			bits &= bits >> 4;
+		bits &= lanes;
+		if (bits) {
+			*found = TRUE;
+			return i + g_bit_nth_lsf(bits, -1);
+		}
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Returns the byte offset within buf of the first sample at or after
+ * start matching stage 0, or -1 if there is none.
+ */
+static int scan_stage0(struct soft_trigger_logic *stl,
+		const uint8_t *buf, int start, int len)
+{
+	int i, unitsize;
+
+	unitsize = stl->unitsize;
+	i = start;
+	if (i == 0 && i + unitsize <= len) {
+		if (stage_match(stl, 0, buf,
+				stl->have_prev ? stl->prev_sample : NULL))
+			return 0;
+		i += unitsize;
+	}
+
+#ifdef __SSE2__
+	if (unitsize == 1 || unitsize == 2 || unitsize == 4 || unitsize == 8) {
+		gboolean found;
+
+		i = scan_stage0_sse2(stl, buf, i, len, &found);
+		if (found)
+			return i;
+	}
+#endif
+
+	for (; i + unitsize <= len; i += unitsize) {
+		if (stage_match(stl, 0, buf + i, buf + i - unitsize))
+			return i;
+	}
+
+	return -1;
 }
 
 /* Returns the offset (in samples) within buf of where the trigger
@@ -152,71 +363,76 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
-	int offset;
-	int i;
-	gboolean match_found;
+	const uint8_t *prev;
+	int unitsize, offset, i;
 
-	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
-			/* No matches supplied, client error. */
-			return SR_ERR_ARG;
+	if (!stl->valid)
+		/* No matches supplied, client error. */
+		return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+	unitsize = stl->unitsize;
+	len -= len % unitsize;
+	offset = -1;
+	i = 0;
+	while (i < len) {
+		if (stl->cur_stage == 0) {
+			i = scan_stage0(stl, buf, i, len);
+			if (i < 0)
 				break;
+		} else {
+			if (i > 0)
+				prev = buf + i - unitsize;
+			else
+				prev = stl->have_prev ? stl->prev_sample : NULL;
+			if (!stage_match(stl, stl->cur_stage, buf + i, prev)) {
+				/*
+				 * We had a match at an earlier stage, but failed on
+				 * the current stage. However, we may have a match on
+				 * this stage in the next bit -- trigger on 0001 will
+				 * fail on seeing 00001, so we need to go back to
+				 * stage 0 -- but at the next sample from the one
+				 * that matched originally.
+				 */
+				i = i / unitsize - stl->cur_stage;
+				if (i < -1)
+					i = -1; /* Oops, went back past this buffer. */
+				i = (i + 1) * unitsize;
+				/* Reset trigger stage. */
+				stl->cur_stage = 0;
+				continue;
 			}
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
-		if (match_found) {
-			/* Matched on the current stage. */
-			if (l_stage->next) {
-				/* Advance to next stage. */
-				stl->cur_stage++;
-			} else {
-				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
-				pre_trigger_send(stl, pre_trigger_samples);
-
-				/* Fire trigger. */
-				offset = i / stl->unitsize;
-
-				packet.type = SR_DF_TRIGGER;
-				packet.payload = NULL;
-				sr_session_send(stl->sdi, &packet);
-				break;
-			}
-		} else if (stl->cur_stage > 0) {
-			/*
-			 * We had a match at an earlier stage, but failed on the
-			 * current stage. However, we may have a match on this
-			 * stage in the next bit -- trigger on 0001 will fail on
-			 * seeing 00001, so we need to go back to stage 0 -- but
-			 * at the next sample from the one that matched originally,
-			 * which the counter increment at the end of the loop
-			 * takes care of.
-			 */
-			i -= stl->cur_stage * stl->unitsize;
-			if (i < -1)
-				i = -1; /* Oops, went back past this buffer. */
-			/* Reset trigger stage. */
-			stl->cur_stage = 0;
+
+		/* Matched on the current stage. */
+		if (stl->cur_stage + 1 < stl->num_stages) {
+			/* Advance to next stage. */
+			stl->cur_stage++;
+			i += unitsize;
+			continue;
 		}
+
+		/* Matched on last stage, send pre-trigger data. */
+		memcpy(stl->prev_sample, buf + i, unitsize);
+		stl->have_prev = TRUE;
+		pre_trigger_append(stl, buf, i);
+		pre_trigger_send(stl, pre_trigger_samples);
+
+		/* Fire trigger. */
+		offset = i / unitsize;
+
+		packet.type = SR_DF_TRIGGER;
+		packet.payload = NULL;
+		sr_session_send(stl->sdi, &packet);
+		break;
 	}
 
-	if (offset == -1)
+	if (offset == -1) {
+		if (len > 0) {
+			memcpy(stl->prev_sample, buf + len - unitsize, unitsize);
+			stl->have_prev = TRUE;
+		}
 		pre_trigger_append(stl, buf, len);
+	}
 
 	return offset;
 }
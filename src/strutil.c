@@ -24,6 +24,7 @@
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
+#include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -211,6 +212,320 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	return SR_OK;
 }
 
+/* Powers of ten that are exact in a double. */
+static const double exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* Reciprocals for the loop in sr_ftoa(), only rounded once. */
+static const double inv_pow10[] = {
+	1e0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8,
+};
+
+/* Return 2^e for a normal double, without a call to ldexp(). */
+static double pow2(int e)
+{
+	uint64_t bits;
+	double d;
+
+	bits = (uint64_t)(e + 1023) << 52;
+	memcpy(&d, &bits, sizeof(d));
+
+	return d;
+}
+
+/* Return v * 10^k, rounded at most three times. */
+static double scale_pow10(double v, int k)
+{
+	while (k > 22) {
+		v *= exact_pow10[22];
+		k -= 22;
+	}
+	while (k < -22) {
+		v /= exact_pow10[22];
+		k += 22;
+	}
+
+	return k >= 0 ? v * exact_pow10[k] : v / exact_pow10[-k];
+}
+
+/*
+ * Whether the scaled decimal c lies within the scaled bounds (slo, shi):
+ * 1 if it clearly does, 0 if it clearly doesn't and -1 if it is too close
+ * to a bound to tell, given the rounding errors of scale_pow10().
+ */
+static int in_interval(double c, double slo, double shi)
+{
+	const double eps = 1e-12;
+
+	if (c > slo * (1 + eps) && c < shi * (1 - eps))
+		return 1;
+	if (c > slo * (1 - eps) && c < shi * (1 + eps))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Decide the cases in_interval() can't for the decimal c * 10^-k, with
+ * c < 2^30. The quotient c / 10^k is correctly rounded and the product
+ * c * 10^-k is exact, so the result is only ambiguous if the quotient
+ * rounds to a bound. A decimal exactly on a bound reads back as the
+ * value if its mantissa is even.
+ */
+static int in_interval_exact(double c, int k, double lo, double hi,
+		gboolean even)
+{
+	double d;
+
+	if (k < -9 || k > 12)
+		return -1;
+
+	d = k >= 0 ? c / exact_pow10[k] : c * exact_pow10[-k];
+	if (d > lo && d < hi)
+		return 1;
+	if (d != lo && d != hi)
+		return 0;
+
+	/* The bounds have 25 significant bits, so this product is exact. */
+	if (k > 0 && d * exact_pow10[k] != c)
+		return -1;
+
+	return even;
+}
+
+/**
+ * @private
+ *
+ * Format a float with the fewest significant digits that read back as
+ * the same value, like "%g" does with enough precision.
+ *
+ * Values from 1e-4 to 1e9 are written without an exponent, as with
+ * "%.9g". The decimal point is always '.', regardless of the locale.
+ *
+ * @param buf Buffer of at least SR_FTOA_BUFSIZE bytes.
+ * @param value The value to format.
+ *
+ * @return The length of the string written to buf.
+ */
+SR_PRIV int sr_ftoa(char *buf, float value)
+{
+	char digits[12], *p;
+	uint32_t bits, mant, m;
+	double v, lo, hi, sv, slo, shi, unit, t, c, cand[2];
+	int exp2, e2, e10, prec, k, n, x, i;
+
+	p = buf;
+	memcpy(&bits, &value, sizeof(bits));
+	if (bits >> 31)
+		*p++ = '-';
+	exp2 = (bits >> 23) & 0xff;
+	mant = bits & 0x7fffff;
+
+	if (exp2 == 0xff) {
+		strcpy(p, mant ? "nan" : "inf");
+		return p + 3 - buf;
+	}
+	if (exp2 == 0 && mant == 0) {
+		strcpy(p, "0");
+		return p + 1 - buf;
+	}
+
+	/*
+	 * Every decimal strictly between the midpoints to the neighbouring
+	 * floats reads back as value. The midpoints are exact in a double.
+	 */
+	v = fabs((double)value);
+	hi = v + pow2(MAX(exp2, 1) - 151);
+	if (mant == 0 && exp2 > 1)
+		lo = v - pow2(exp2 - 152);
+	else
+		lo = v - pow2(MAX(exp2, 1) - 151);
+
+	/*
+	 * Scale value and bounds to 9 significant digits. The estimate of
+	 * the decimal exponent from the binary one is at most one too low.
+	 */
+	if (exp2 == 0)
+		frexp(v, &e2);
+	else
+		e2 = exp2 - 126;
+	e10 = (int)((e2 - 1) * 0.30102999566398120 + 100) - 100;
+	sv = scale_pow10(v, 8 - e10);
+	if (sv >= 1e9)
+		sv = scale_pow10(v, 8 - ++e10);
+	slo = scale_pow10(lo, 8 - e10);
+	shi = scale_pow10(hi, 8 - e10);
+
+	/*
+	 * Most values are short decimals, and come out of rounding to 9
+	 * digits with trailing zeros. Decimals with up to 6 digits are
+	 * further apart than the bounds, so one inside is the shortest.
+	 */
+	m = (uint32_t)(sv + 0.5);
+	for (prec = 9; prec > 1 && m % 10 == 0; prec--)
+		m /= 10;
+	if (prec <= 6 && in_interval(m * exact_pow10[9 - prec], slo, shi) == 1) {
+		k = prec - 1 - e10;
+		goto digits;
+	}
+
+	/* Try the nearest decimals with 1 to 9 significant digits. */
+	for (prec = 1; prec <= 9; prec++) {
+		k = prec - 1 - e10;
+		unit = exact_pow10[9 - prec];
+		t = sv * inv_pow10[9 - prec];
+		c = (double)(uint64_t)t;
+		cand[0] = t - c < 0.5 ? c : c + 1;
+		cand[1] = t - c < 0.5 ? c + 1 : c;
+		for (i = 0; i < 2; i++) {
+			n = in_interval(cand[i] * unit, slo, shi);
+			if (n < 0)
+				n = in_interval_exact(cand[i], k, lo, hi,
+						!(mant & 1));
+			if (n)
+				break;
+		}
+		if (n == 1)
+			break;
+		if (n < 0 || prec == 9) {
+			/* Too close to call, 9 digits always read back. */
+			g_ascii_formatd(p, SR_FTOA_BUFSIZE - 1, "%.9g", v);
+			return p + strlen(p) - buf;
+		}
+	}
+	m = (uint32_t)cand[i];
+
+digits:
+	/* Digits of m without trailing zeros, and the exponent of the first. */
+	for (n = 0; m; m /= 10)
+		digits[n++] = '0' + m % 10;
+	x = n - 1 - k;
+	for (i = 0; digits[i] == '0'; i++)
+		;
+
+	if (x < -4 || x >= 9) {
+		*p++ = digits[--n];
+		if (n > i)
+			*p++ = '.';
+		while (n > i)
+			*p++ = digits[--n];
+		p += sprintf(p, "e%c%02d", x < 0 ? '-' : '+', ABS(x));
+	} else if (x < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		while (++x < 0)
+			*p++ = '0';
+		while (n > i)
+			*p++ = digits[--n];
+	} else {
+		for (; x >= 0; x--)
+			*p++ = n > i ? digits[--n] : '0';
+		if (n > i)
+			*p++ = '.';
+		while (n > i)
+			*p++ = digits[--n];
+	}
+	*p = '\0';
+
+	return p - buf;
+}
+
+/**
+ * @private
+ *
+ * Convert the first len characters of str to a double, like sr_atod(),
+ * but always with '.' as the decimal point. str needn't be terminated.
+ *
+ * Decimals of up to 15 significant digits and with exponents such that
+ * the value is a product or quotient of two exact doubles, which covers
+ * what instruments send, are converted without a copy or a call to
+ * strtod(). That makes this suitable for parsing long lists of values in
+ * place.
+ *
+ * @param str The string representation to convert.
+ * @param len The length of the representation.
+ * @param ret Pointer to double where the result of the conversion will be stored.
+ *
+ * @retval SR_OK Conversion successful.
+ * @retval SR_ERR Failure.
+ */
+SR_PRIV int sr_atod_ascii_len(const char *str, size_t len, double *ret)
+{
+	char buf[64], *endptr;
+	const char *p, *end;
+	uint64_t mant;
+	int num_digits, exp10, e;
+	gboolean neg, exp_neg, have_digits;
+	double tmp;
+
+	p = str;
+	end = str + len;
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	neg = FALSE;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+
+	mant = 0;
+	num_digits = exp10 = 0;
+	have_digits = FALSE;
+	for (; p < end && g_ascii_isdigit(*p); p++) {
+		have_digits = TRUE;
+		mant = mant * 10 + (*p - '0');
+		num_digits += mant != 0;
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && g_ascii_isdigit(*p); p++) {
+			have_digits = TRUE;
+			mant = mant * 10 + (*p - '0');
+			num_digits += mant != 0;
+			exp10--;
+		}
+	}
+	if (have_digits && p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		exp_neg = FALSE;
+		if (p < end && (*p == '-' || *p == '+'))
+			exp_neg = *p++ == '-';
+		/* Leave exponents without digits to strtod(). */
+		have_digits = p < end && g_ascii_isdigit(*p);
+		for (e = 0; p < end && g_ascii_isdigit(*p) && e < 1000; p++)
+			e = e * 10 + (*p - '0');
+		exp10 += exp_neg ? -e : e;
+	}
+
+	/* The mantissa and the power of ten are exact, so is the result. */
+	if (have_digits && p == end && num_digits <= 15
+			&& exp10 >= -22 && exp10 <= 22) {
+		tmp = exp10 >= 0 ? mant * exact_pow10[exp10]
+			: mant / exact_pow10[-exp10];
+		*ret = neg ? -tmp : tmp;
+		return SR_OK;
+	}
+
+	/* Anything else, like "inf" or long mantissas, goes the usual way. */
+	if (len >= sizeof(buf)) {
+		errno = EINVAL;
+		return SR_ERR;
+	}
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+
+	errno = 0;
+	tmp = g_ascii_strtod(buf, &endptr);
+
+	if (!endptr || *endptr || errno) {
+		if (!errno)
+			errno = EINVAL;
+		return SR_ERR;
+	}
+
+	*ret = tmp;
+	return SR_OK;
+}
+
 /**
  * Convert a numeric value value to its "natural" string representation
  * in SI units.
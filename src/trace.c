@@ -0,0 +1,328 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "trace"
+/** @endcond */
+
+/* Number of events kept per thread, a power of two. */
+#define TRACE_RING_SIZE 16384
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+/**
+ * @file
+ *
+ * Recording events of hot code paths into per-thread trace rings.
+ */
+
+/**
+ * @defgroup grp_trace Tracing
+ *
+ * Recording events of hot code paths into per-thread trace rings.
+ *
+ * Log messages are too slow for per-transfer events, and change the timing
+ * they are meant to show. A trace event is just a timestamp, an event ID
+ * and two integers, written into a ring of the recording thread without
+ * any locking. While tracing is disabled, a trace point costs a single
+ * test. The most recent events of all threads can be fetched or dumped
+ * to a file, e.g. after an overrun.
+ *
+ * @{
+ */
+
+struct trace_ring {
+	/* Number of events recorded, only written by the owning thread. */
+	gint head;
+	/* Whether the ring has wrapped around. */
+	gboolean full;
+	/* Value of head at the last sr_trace_clear(). */
+	guint cleared;
+	uint32_t thread;
+	struct sr_trace_event events[TRACE_RING_SIZE];
+};
+
+SR_PRIV int sr_trace_active = 0;
+
+static GPrivate thread_ring = G_PRIVATE_INIT(NULL);
+/* Rings of all threads which have recorded events, and the fields below. */
+static GMutex rings_mutex;
+static GSList *rings;
+static uint32_t num_rings;
+
+static const char *trace_event_names[] = {
+	[SR_TRACE_SESSION_SEND] = "session_send",
+	[SR_TRACE_USB_TRANSFER] = "usb_transfer",
+	[SR_TRACE_SERIAL_READ] = "serial_read",
+};
+
+/*
+ * Rings are never freed: threads may exit without notice, and their most
+ * recent events are often the interesting ones.
+ */
+static struct trace_ring *ring_new(void)
+{
+	struct trace_ring *ring;
+
+	ring = g_malloc0(sizeof(struct trace_ring));
+	g_mutex_lock(&rings_mutex);
+	ring->thread = num_rings++;
+	rings = g_slist_prepend(rings, ring);
+	g_mutex_unlock(&rings_mutex);
+	g_private_set(&thread_ring, ring);
+
+	return ring;
+}
+
+/*
+ * Append the events of a ring to an array. The owning thread may keep
+ * recording, events it may have overwritten while they were copied are
+ * dropped.
+ */
+static void ring_copy(const struct trace_ring *ring, GArray *array)
+{
+	guint head, head2, n, i, drop, start;
+
+	head = g_atomic_int_get(&ring->head);
+	n = ring->full ? TRACE_RING_SIZE : head;
+	n = MIN(n, head - ring->cleared);
+	start = array->len;
+	for (i = head - n; i != head; i++)
+		g_array_append_vals(array, &ring->events[i & TRACE_RING_MASK], 1);
+
+	/* The slot of the event being recorded counts as overwritten. */
+	head2 = g_atomic_int_get(&ring->head);
+	drop = head2 - head + 1;
+	drop = drop > TRACE_RING_SIZE - n ? drop - (TRACE_RING_SIZE - n) : 0;
+	g_array_remove_range(array, start, MIN(drop, n));
+}
+
+static gint event_compare(gconstpointer a, gconstpointer b)
+{
+	const struct sr_trace_event *ea, *eb;
+
+	ea = a;
+	eb = b;
+	if (ea->time != eb->time)
+		return ea->time < eb->time ? -1 : 1;
+	if (ea->thread != eb->thread)
+		return ea->thread < eb->thread ? -1 : 1;
+
+	return 0;
+}
+
+/**
+ * Enable or disable the recording of trace events.
+ *
+ * Tracing is disabled by default.
+ *
+ * @param enable TRUE to record events.
+ *
+ * @return SR_OK.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_trace_set(gboolean enable)
+{
+	g_atomic_int_set(&sr_trace_active, enable ? 1 : 0);
+	sr_dbg("Tracing %s.", enable ? "enabled" : "disabled");
+
+	return SR_OK;
+}
+
+/**
+ * Get whether trace events are recorded.
+ *
+ * @return TRUE if tracing is enabled.
+ *
+ * @since 0.5.0
+ */
+SR_API gboolean sr_trace_get(void)
+{
+	return g_atomic_int_get(&sr_trace_active) != 0;
+}
+
+/**
+ * Record a trace event, if tracing is enabled.
+ *
+ * The event goes into a ring of the calling thread, which keeps its most
+ * recent 16384 events. This function may be called from any thread.
+ *
+ * @param id The event ID. Applications may use IDs from SR_TRACE_USER on.
+ * @param arg1 First event-specific argument.
+ * @param arg2 Second event-specific argument.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_trace_record(uint32_t id, int64_t arg1, int64_t arg2)
+{
+	struct trace_ring *ring;
+	struct sr_trace_event *ev;
+	guint head;
+
+	if (!g_atomic_int_get(&sr_trace_active))
+		return;
+
+	if (!(ring = g_private_get(&thread_ring)))
+		ring = ring_new();
+
+	head = ring->head;
+	ev = &ring->events[head & TRACE_RING_MASK];
+	ev->time = g_get_monotonic_time();
+	ev->id = id;
+	ev->thread = ring->thread;
+	ev->arg1 = arg1;
+	ev->arg2 = arg2;
+	if (head == TRACE_RING_SIZE - 1)
+		ring->full = TRUE;
+	/* Publish the event. */
+	g_atomic_int_set(&ring->head, head + 1);
+}
+
+/**
+ * Get the recorded trace events of all threads.
+ *
+ * Recording may go on meanwhile.
+ *
+ * @param events Will be set to a newly allocated array of the events,
+ *               oldest first, or NULL if there are none. Must be freed
+ *               with g_free(). Must not be NULL.
+ * @param num_events Will be set to the number of events. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_trace_events_get(struct sr_trace_event **events,
+		size_t *num_events)
+{
+	GArray *array;
+	GSList *l;
+
+	if (!events || !num_events)
+		return SR_ERR_ARG;
+
+	array = g_array_new(FALSE, FALSE, sizeof(struct sr_trace_event));
+	g_mutex_lock(&rings_mutex);
+	for (l = rings; l; l = l->next)
+		ring_copy(l->data, array);
+	g_mutex_unlock(&rings_mutex);
+	g_array_sort(array, event_compare);
+
+	*num_events = array->len;
+	*events = (struct sr_trace_event *)g_array_free(array, array->len == 0);
+
+	return SR_OK;
+}
+
+/**
+ * Discard all trace events recorded so far.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_trace_clear(void)
+{
+	struct trace_ring *ring;
+	GSList *l;
+
+	g_mutex_lock(&rings_mutex);
+	for (l = rings; l; l = l->next) {
+		ring = l->data;
+		ring->cleared = g_atomic_int_get(&ring->head);
+	}
+	g_mutex_unlock(&rings_mutex);
+}
+
+/**
+ * Write the recorded trace events of all threads to a text file.
+ *
+ * Each line holds the time in microseconds since the first event, the
+ * thread number, the event name (or its ID if it has none) and the two
+ * arguments.
+ *
+ * @param filename The file to write. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The file could not be written.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_trace_dump(const char *filename)
+{
+	struct sr_trace_event *events, *ev;
+	size_t num_events, i;
+	const char *name;
+	FILE *f;
+
+	if (!filename)
+		return SR_ERR_ARG;
+
+	if (!(f = g_fopen(filename, "w"))) {
+		sr_err("Failed to open '%s': %s.", filename, g_strerror(errno));
+		return SR_ERR;
+	}
+
+	sr_trace_events_get(&events, &num_events);
+	fprintf(f, "# time_us thread event arg1 arg2\n");
+	for (i = 0; i < num_events; i++) {
+		ev = &events[i];
+		fprintf(f, "%" PRIi64 " %" PRIu32 " ",
+				ev->time - events[0].time, ev->thread);
+		if ((name = sr_trace_event_name(ev->id)))
+			fputs(name, f);
+		else
+			fprintf(f, "%" PRIu32, ev->id);
+		fprintf(f, " %" PRIi64 " %" PRIi64 "\n", ev->arg1, ev->arg2);
+	}
+	g_free(events);
+
+	if (ferror(f) | fclose(f)) {
+		sr_err("Failed to write '%s'.", filename);
+		return SR_ERR;
+	}
+	sr_dbg("Wrote %zu trace events to '%s'.", num_events, filename);
+
+	return SR_OK;
+}
+
+/**
+ * Get the name of a trace event ID.
+ *
+ * @param id The event ID.
+ *
+ * @return The name, or NULL for IDs of applications and unknown IDs.
+ *
+ * @since 0.5.0
+ */
+SR_API const char *sr_trace_event_name(uint32_t id)
+{
+	if (id >= ARRAY_SIZE(trace_event_names))
+		return NULL;
+
+	return trace_event_names[id];
+}
+
+/** @} */
@@ -37,6 +37,43 @@
 typedef int libusb_os_handle;
 #endif
 
+/* How long the event thread waits for events before it checks for stop. */
+#define EVENT_THREAD_TIMEOUT_US 100000
+
+struct usb_event_thread;
+
+/** A transfer submitted while an event thread handles libusb events.
+ * @internal
+ */
+struct usb_deferred_transfer {
+	struct usb_deferred_transfer *next;
+	struct usb_event_thread *thread;
+	struct libusb_transfer *transfer;
+	/* The driver's callback and data, restored before it is called. */
+	libusb_transfer_cb_fn callback;
+	void *user_data;
+};
+
+/** Thread handling libusb events on behalf of a USB event source.
+ * @internal
+ */
+struct usb_event_thread {
+	/* One reference for the source, one per deferred transfer. */
+	gint refcount;
+	GThread *thread;
+	gint stop;
+	struct libusb_context *usb_ctx;
+	/* Context of the session main loop, woken up on completions. */
+	GMainContext *main_context;
+	/*
+	 * Completed transfers, most recent first. The event thread pushes
+	 * them, the session thread takes the whole list at once.
+	 */
+	gpointer completed;
+	/* Set once the source is gone, callbacks are then run directly. */
+	gint detached;
+};
+
 /** Custom GLib event source for libusb I/O.
  * @internal
  */
@@ -51,8 +88,150 @@ struct usb_source {
 
 	struct libusb_context *usb_ctx;
 	GPtrArray *pollfds;
+
+	/* Thread handling libusb events, or NULL to do it in the main loop. */
+	struct usb_event_thread *event_thread;
+	/* Set if a device of the session doesn't support the event thread. */
+	gboolean no_event_thread;
 };
 
+static void usb_event_thread_unref(struct usb_event_thread *et)
+{
+	if (g_atomic_int_dec_and_test(&et->refcount))
+		g_free(et);
+}
+
+/* Hand a deferred transfer back to the driver. */
+static void usb_deferred_run(struct usb_deferred_transfer *dt)
+{
+	struct libusb_transfer *transfer;
+
+	transfer = dt->transfer;
+	transfer->callback = dt->callback;
+	transfer->user_data = dt->user_data;
+	usb_event_thread_unref(dt->thread);
+	g_slice_free(struct usb_deferred_transfer, dt);
+
+	transfer->callback(transfer);
+}
+
+/* Completion callback of deferred transfers, run by the event thread. */
+static void LIBUSB_CALL usb_deferred_done(struct libusb_transfer *transfer)
+{
+	struct usb_deferred_transfer *dt;
+	struct usb_event_thread *et;
+	gpointer head;
+
+	dt = transfer->user_data;
+	et = dt->thread;
+
+	if (g_atomic_int_get(&et->detached)) {
+		usb_deferred_run(dt);
+		return;
+	}
+
+	do {
+		head = g_atomic_pointer_get(&et->completed);
+		dt->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange(&et->completed,
+			head, dt));
+
+	g_main_context_wakeup(et->main_context);
+}
+
+/*
+ * Take the completed transfers in the order they completed, and call
+ * their callbacks. Returns the number of transfers handled.
+ */
+static unsigned int usb_event_thread_dispatch(struct usb_event_thread *et)
+{
+	struct usb_deferred_transfer *dt, *next, *list;
+	gpointer head;
+	unsigned int count;
+
+	do {
+		head = g_atomic_pointer_get(&et->completed);
+	} while (head && !g_atomic_pointer_compare_and_exchange(&et->completed,
+			head, NULL));
+
+	list = NULL;
+	for (dt = head; dt; dt = next) {
+		next = dt->next;
+		dt->next = list;
+		list = dt;
+	}
+
+	count = 0;
+	for (dt = list; dt; dt = next) {
+		next = dt->next;
+		usb_deferred_run(dt);
+		count++;
+	}
+
+	return count;
+}
+
+static gpointer usb_event_thread_run(gpointer data)
+{
+	struct usb_event_thread *et;
+	struct timeval tv;
+
+	et = data;
+
+	while (!g_atomic_int_get(&et->stop)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = EVENT_THREAD_TIMEOUT_US;
+		libusb_handle_events_timeout_completed(et->usb_ctx, &tv,
+				&et->stop);
+	}
+
+	return NULL;
+}
+
+/*
+ * Move libusb event handling of a source to a new thread. The libusb
+ * FDs are no longer polled by the main loop.
+ */
+static void usb_event_thread_start(struct usb_source *usource)
+{
+	struct usb_event_thread *et;
+	GPollFD *pollfd;
+	unsigned int i;
+
+	libusb_set_pollfd_notifiers(usource->usb_ctx, NULL, NULL, NULL);
+	for (i = 0; i < usource->pollfds->len; i++) {
+		pollfd = g_ptr_array_index(usource->pollfds, i);
+		g_source_remove_poll(&usource->base, pollfd);
+	}
+	g_ptr_array_set_size(usource->pollfds, 0);
+
+	et = g_malloc0(sizeof(struct usb_event_thread));
+	et->refcount = 1;
+	et->usb_ctx = usource->usb_ctx;
+	et->main_context = g_source_get_context(&usource->base);
+	et->thread = g_thread_new("sr-usb-events", usb_event_thread_run, et);
+	usource->event_thread = et;
+
+	sr_dbg("Handling libusb events in a separate thread.");
+}
+
+/*
+ * Stop the event thread. Transfers which complete later have their
+ * callbacks called right away, by whoever handles libusb events.
+ */
+static void usb_event_thread_stop(struct usb_event_thread *et)
+{
+	g_atomic_int_set(&et->stop, 1);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	libusb_interrupt_event_handler(et->usb_ctx);
+#endif
+	g_thread_join(et->thread);
+
+	g_atomic_int_set(&et->detached, 1);
+	usb_event_thread_dispatch(et);
+	usb_event_thread_unref(et);
+}
+
 /** USB event source prepare() method.
  */
 static gboolean usb_source_prepare(GSource *source, int *timeout)
@@ -65,7 +244,17 @@ static gboolean usb_source_prepare(GSource *source, int *timeout)
 
 	usource = (struct usb_source *)source;
 
-	ret = libusb_get_next_timeout(usource->usb_ctx, &usb_timeout);
+	if (usource->event_thread
+			&& g_atomic_pointer_get(&usource->event_thread->completed)) {
+		*timeout = 0;
+		return TRUE;
+	}
+
+	/* The event thread takes care of libusb timeouts. */
+	if (usource->event_thread)
+		ret = 0;
+	else
+		ret = libusb_get_next_timeout(usource->usb_ctx, &usb_timeout);
 	if (G_UNLIKELY(ret < 0)) {
 		sr_err("Failed to get libusb timeout: %s",
 			libusb_error_name(ret));
@@ -104,6 +293,10 @@ static gboolean usb_source_check(GSource *source)
 	usource = (struct usb_source *)source;
 	revents = 0;
 
+	if (usource->event_thread
+			&& g_atomic_pointer_get(&usource->event_thread->completed))
+		return TRUE;
+
 	for (i = 0; i < usource->pollfds->len; i++) {
 		pollfd = g_ptr_array_index(usource->pollfds, i);
 		revents |= pollfd->revents;
@@ -135,6 +328,15 @@ static gboolean usb_source_dispatch(GSource *source,
 		revents |= pollfd->revents;
 	}
 
+	/* Completions handed over by the event thread count as I/O. */
+	if (usource->event_thread
+			&& usb_event_thread_dispatch(usource->event_thread) > 0) {
+		revents |= G_IO_IN;
+		/* A transfer callback may have ended the acquisition. */
+		if (g_source_is_destroyed(source))
+			return G_SOURCE_REMOVE;
+	}
+
 	if (!callback) {
 		sr_err("Callback not set, cannot dispatch event.");
 		return G_SOURCE_REMOVE;
@@ -163,6 +365,11 @@ static void usb_source_finalize(GSource *source)
 
 	libusb_set_pollfd_notifiers(usource->usb_ctx, NULL, NULL, NULL);
 
+	if (usource->event_thread) {
+		usb_event_thread_stop(usource->event_thread);
+		usource->event_thread = NULL;
+	}
+
 	g_ptr_array_unref(usource->pollfds);
 	usource->pollfds = NULL;
 
@@ -472,6 +679,100 @@ SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx
 	return sr_session_source_remove_internal(session, ctx->libusb_ctx);
 }
 
+/**
+ * Submit a transfer on behalf of a session.
+ *
+ * This is a drop-in replacement for libusb_submit_transfer(). If the
+ * session has the USB event thread enabled (see sr_session_usb_thread_set())
+ * and a USB event source installed, the first submission moves libusb
+ * event handling to a separate thread. The thread reaps completed
+ * transfers and hands them to the session thread, where the callback of
+ * the transfer is called as usual.
+ *
+ * Drivers must submit all their transfers through this function after
+ * usb_source_add(), and none before it, since the callbacks of other
+ * transfers would be called from the event thread. Such drivers set
+ * usb_event_thread in their driver context. The thread isn't started
+ * while the session holds a USB device of any other driver.
+ *
+ * @param session The session, may be NULL.
+ * @param transfer The filled in transfer.
+ *
+ * @return 0 on success, or a libusb error code.
+ */
+SR_PRIV int usb_submit_transfer(struct sr_session *session,
+		struct libusb_transfer *transfer)
+{
+	struct usb_source *usource;
+	struct usb_deferred_transfer *dt;
+	struct usb_event_thread *et;
+	GSList *l;
+	int ret;
+
+	usource = NULL;
+	if (session && session->usb_thread)
+		usource = g_hash_table_lookup(session->event_sources,
+				session->ctx->libusb_ctx);
+	if (!usource || g_source_is_destroyed(&usource->base)
+			|| usource->no_event_thread)
+		return libusb_submit_transfer(transfer);
+
+	if (!usource->event_thread) {
+		for (l = session->devs; l; l = l->next) {
+			if (!usb_event_thread_supported(l->data))
+				break;
+		}
+		if (l) {
+			sr_dbg("Not all USB drivers in the session support "
+				"the event thread, handling events in the "
+				"main loop.");
+			usource->no_event_thread = TRUE;
+			return libusb_submit_transfer(transfer);
+		}
+		usb_event_thread_start(usource);
+	}
+	et = usource->event_thread;
+
+	dt = g_slice_new(struct usb_deferred_transfer);
+	dt->next = NULL;
+	dt->thread = et;
+	dt->transfer = transfer;
+	dt->callback = transfer->callback;
+	dt->user_data = transfer->user_data;
+	g_atomic_int_inc(&et->refcount);
+
+	transfer->callback = usb_deferred_done;
+	transfer->user_data = dt;
+	if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		transfer->callback = dt->callback;
+		transfer->user_data = dt->user_data;
+		usb_event_thread_unref(et);
+		g_slice_free(struct usb_deferred_transfer, dt);
+	}
+
+	return ret;
+}
+
+/**
+ * Check whether a device can run while the USB event thread handles
+ * libusb events, see usb_submit_transfer().
+ *
+ * @param sdi The device instance.
+ *
+ * @return FALSE if the device uses libusb through a driver which doesn't
+ *         submit its transfers through usb_submit_transfer(), else TRUE.
+ */
+SR_PRIV gboolean usb_event_thread_supported(const struct sr_dev_inst *sdi)
+{
+	struct drv_context *drvc;
+
+	if (!sdi->driver || sdi->inst_type != SR_INST_USB)
+		return TRUE;
+	drvc = sdi->driver->context;
+
+	return drvc && drvc->usb_event_thread;
+}
+
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 {
 	uint8_t port_numbers[8];
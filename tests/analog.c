@@ -124,6 +124,163 @@ START_TEST(test_analog_to_float_null)
 }
 END_TEST
 
+/* Store v at buf in the given integer encoding. */
+static void put_int(uint8_t *buf, int64_t v, int unitsize, gboolean bigendian)
+{
+	int i;
+
+	for (i = 0; i < unitsize; i++)
+		buf[bigendian ? unitsize - 1 - i : i] = (uint64_t)v >> (8 * i);
+}
+
+/* Sample i of a test signal that covers the full range of the encoding. */
+static int64_t test_value(unsigned int i, int unitsize, gboolean is_signed)
+{
+	int64_t min, max;
+
+	max = (1LL << (8 * unitsize - (is_signed ? 1 : 0))) - 1;
+	min = is_signed ? -max - 1 : 0;
+	switch (i % 4) {
+	case 0:
+		return min + i;
+	case 1:
+		return max - i;
+	case 2:
+		return (min + max) / 2 + i;
+	}
+
+	return min + (int64_t)i * 37 % (max - min + 1);
+}
+
+START_TEST(test_analog_to_float_int)
+{
+	static const unsigned int counts[] = { 1, 7, 8, 15, 16, 33, 100 };
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	uint8_t data[4 * 100];
+	float fout[100 + 1];
+	unsigned int i, c;
+	int unitsize, is_signed, bigendian, ret;
+	double expected;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.data = data;
+	meaning.channels = g_slist_append(NULL, &ch);
+	encoding.is_float = FALSE;
+	encoding.scale.p = 1;
+	encoding.scale.q = 4;
+	encoding.offset.p = -3;
+	encoding.offset.q = 1;
+
+	for (unitsize = 1; unitsize <= 4; unitsize *= 2)
+	for (is_signed = 0; is_signed <= 1; is_signed++)
+	for (bigendian = 0; bigendian <= 1; bigendian++)
+	for (c = 0; c < ARRAY_SIZE(counts); c++) {
+		encoding.unitsize = unitsize;
+		encoding.is_signed = is_signed;
+		encoding.is_bigendian = bigendian;
+		analog.num_samples = counts[c];
+		for (i = 0; i < counts[c]; i++)
+			put_int(data + i * unitsize,
+				test_value(i, unitsize, is_signed),
+				unitsize, bigendian);
+		fout[counts[c]] = 19;
+		ret = sr_analog_to_float(&analog, fout);
+		fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+		for (i = 0; i < counts[c]; i++) {
+			expected = test_value(i, unitsize, is_signed) / 4.0 - 3;
+			fail_unless(fabs(fout[i] - expected) <= fabs(expected) * 1e-6,
+				"unitsize %d signed %d bigendian %d sample %u: "
+				"%f != %f", unitsize, is_signed, bigendian, i,
+				fout[i], expected);
+		}
+		fail_unless(fout[counts[c]] == 19, "Wrote past the end.");
+	}
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+START_TEST(test_analog_to_float_swapped)
+{
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	union { float f; uint32_t u; } v;
+	uint32_t data[21];
+	float fout[21];
+	unsigned int i;
+	int ret;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.data = data;
+	analog.num_samples = ARRAY_SIZE(data);
+	meaning.channels = g_slist_append(NULL, &ch);
+	encoding.is_bigendian = !encoding.is_bigendian;
+	encoding.scale.p = 2;
+
+	for (i = 0; i < ARRAY_SIZE(data); i++) {
+		v.f = i * 1.5 - 7;
+		data[i] = GUINT32_SWAP_LE_BE(v.u);
+	}
+	ret = sr_analog_to_float(&analog, fout);
+	fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		fail_unless(fout[i] == (float)((i * 1.5 - 7) * 2),
+			"Sample %u: %f != %f", i, fout[i], (i * 1.5 - 7) * 2);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+START_TEST(test_analog_to_float_channels)
+{
+	struct sr_channel ch[3];
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int16_t data[3 * 5000];
+	float *fout[3];
+	unsigned int i, c, num_channels;
+	int ret;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.data = data;
+	analog.num_samples = 5000;
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+	encoding.unitsize = sizeof(int16_t);
+	for (c = 0; c < 3; c++)
+		fout[c] = g_malloc(sizeof(float) * analog.num_samples);
+
+	for (num_channels = 1; num_channels <= 3; num_channels++) {
+		meaning.channels = NULL;
+		for (c = 0; c < num_channels; c++)
+			meaning.channels = g_slist_append(meaning.channels, &ch[c]);
+		for (i = 0; i < analog.num_samples * num_channels; i++)
+			data[i] = (i % num_channels) * 10000 - (int)(i / num_channels);
+		ret = sr_analog_to_float_channels(&analog, fout);
+		fail_unless(ret == SR_OK,
+			"sr_analog_to_float_channels() failed: %d.", ret);
+		for (c = 0; c < num_channels; c++) {
+			for (i = 0; i < analog.num_samples; i++)
+				fail_unless(fout[c][i] == c * 10000.0f - i,
+					"Channel %u sample %u: %f", c, i, fout[c][i]);
+		}
+		g_slist_free(meaning.channels);
+	}
+
+	for (c = 0; c < 3; c++)
+		g_free(fout[c]);
+}
+END_TEST
+
 START_TEST(test_analog_unit_to_string)
 {
 	int ret;
@@ -212,5 +369,13 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_set_rational_null);
 	suite_add_tcase(s, tc);
 
+	/* Through sr_init(), so the kernels picked for this CPU are used. */
+	tc = tcase_create("analog_to_float_kernels");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_analog_to_float_int);
+	tcase_add_test(tc, test_analog_to_float_swapped);
+	tcase_add_test(tc, test_analog_to_float_channels);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,233 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Output module microbenchmark. Not part of "make check", build and run it
+ * with "make benchmarks && ./tests/bench_output".
+ *
+ * Feeds the same synthetic capture to each output module three times:
+ * through sr_output_send(), which returns a new string per packet, through
+ * a sink gathering the output in a reused string, and through a sink
+ * writing to /dev/null. Prints the output throughput of each, and checks
+ * that the first two produce the same amount of output.
+ */
+
+#include <config.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define BENCH_SAMPLES (4 * 1000 * 1000)
+#define BENCH_CHUNK (64 * 1024)
+#define BENCH_LOGIC_CHANNELS 8
+#define BENCH_ANALOG_CHANNELS 2
+
+enum bench_mode {
+	MODE_SEND,
+	MODE_BUFFER,
+	MODE_FD,
+};
+
+static const char *logic_modules[] = { "vcd", "csv", "hex", "bits", "ascii" };
+static const char *analog_modules[] = { "wav", "csv" };
+
+struct bench_data {
+	struct sr_dev_inst *sdi;
+	gboolean analog;
+	uint8_t *logic_data;
+	float *analog_data;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+static void bench_data_init(struct bench_data *bd, gboolean analog)
+{
+	char name[8];
+	int i, num_channels;
+
+	memset(bd, 0, sizeof(*bd));
+	bd->analog = analog;
+	bd->sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	num_channels = analog ? BENCH_ANALOG_CHANNELS : BENCH_LOGIC_CHANNELS;
+	for (i = 0; i < num_channels; i++) {
+		g_snprintf(name, sizeof(name), "%s%d", analog ? "A" : "D", i);
+		sr_dev_inst_channel_add(bd->sdi, i, analog
+			? SR_CHANNEL_ANALOG : SR_CHANNEL_LOGIC, name);
+	}
+
+	srand(1);
+	if (!analog) {
+		/* A clock, a slower bus and some idle channels. */
+		bd->logic_data = g_malloc(BENCH_CHUNK);
+		for (i = 0; i < BENCH_CHUNK; i++)
+			bd->logic_data[i] = (i & 1) | ((rand() % 16 == 0) << 1)
+				| ((i / 64) & 0x3c);
+		return;
+	}
+
+	bd->analog_data = g_malloc(sizeof(float) * BENCH_CHUNK
+			* BENCH_ANALOG_CHANNELS);
+	for (i = 0; i < BENCH_CHUNK * BENCH_ANALOG_CHANNELS; i++)
+		bd->analog_data[i] = (rand() % 2000 - 1000) / 1000.0;
+	bd->encoding.unitsize = sizeof(float);
+	bd->encoding.is_signed = TRUE;
+	bd->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	bd->encoding.is_bigendian = TRUE;
+#endif
+	bd->encoding.is_digits_decimal = TRUE;
+	bd->encoding.scale.p = bd->encoding.scale.q = 1;
+	bd->encoding.offset.q = 1;
+	bd->meaning.mq = SR_MQ_VOLTAGE;
+	bd->meaning.unit = SR_UNIT_VOLT;
+	bd->meaning.channels = sr_dev_inst_channels_get(bd->sdi);
+}
+
+static void bench_data_free(struct bench_data *bd)
+{
+	g_free(bd->logic_data);
+	g_free(bd->analog_data);
+	/* There's no public way to free a user device, it is left alone. */
+}
+
+/*
+ * Run a module over the whole capture. Returns the number of output bytes,
+ * which aren't counted when writing to a file.
+ */
+static uint64_t run(const char *id, struct bench_data *bd,
+		enum bench_mode mode, int64_t *elapsed)
+{
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	GString *out;
+	uint64_t pos, out_bytes;
+	int64_t start;
+	int fd;
+
+	if (bd->analog) {
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.data = bd->analog_data;
+		analog.num_samples = BENCH_CHUNK;
+		analog.encoding = &bd->encoding;
+		analog.meaning = &bd->meaning;
+		analog.spec = &bd->spec;
+	} else {
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = 1;
+		logic.length = BENCH_CHUNK;
+		logic.data = bd->logic_data;
+	}
+
+	o = sr_output_new(sr_output_find((char *)id), NULL, bd->sdi, NULL);
+	if (!o) {
+		fprintf(stderr, "Couldn't create '%s' output.\n", id);
+		exit(1);
+	}
+
+	fd = -1;
+	sink = NULL;
+	if (mode == MODE_BUFFER) {
+		sink = sr_output_sink_new();
+	} else if (mode == MODE_FD) {
+		fd = open("/dev/null", O_WRONLY);
+		sink = sr_output_sink_new_fd(fd);
+	}
+
+	out_bytes = 0;
+	start = g_get_monotonic_time();
+	for (pos = 0; pos < BENCH_SAMPLES; pos += BENCH_CHUNK) {
+		if (mode == MODE_SEND) {
+			sr_output_send(o, &packet, &out);
+			if (out) {
+				out_bytes += out->len;
+				g_string_free(out, TRUE);
+			}
+		} else if (mode == MODE_BUFFER) {
+			sr_output_send_sink(o, &packet, sink);
+			/* Take the output, like a caller would. */
+			out = sr_output_sink_buffer_get(sink);
+			out_bytes += out->len;
+			g_string_truncate(out, 0);
+		} else {
+			sr_output_send_sink(o, &packet, sink);
+		}
+	}
+	if (sink)
+		sr_output_sink_free(sink);
+	*elapsed = g_get_monotonic_time() - start;
+
+	sr_output_free(o);
+	if (fd >= 0)
+		close(fd);
+
+	return out_bytes;
+}
+
+static int run_module(const char *id, struct bench_data *bd)
+{
+	static const char *mode_names[] = { "send", "buffer", "fd" };
+	uint64_t out_bytes[3];
+	int64_t t[3];
+	int mode;
+
+	for (mode = MODE_SEND; mode <= MODE_FD; mode++)
+		out_bytes[mode] = run(id, bd, mode, &t[mode]);
+
+	printf("%-6s %-6s %8.1f MB ", id, bd->analog ? "analog" : "logic",
+		(double)out_bytes[MODE_SEND] / 1000000);
+	for (mode = MODE_SEND; mode <= MODE_FD; mode++)
+		printf("  %s %7.1f MB/s", mode_names[mode],
+			(double)out_bytes[MODE_SEND] / MAX(t[mode], 1));
+	printf("\n");
+
+	if (out_bytes[MODE_BUFFER] != out_bytes[MODE_SEND]) {
+		fprintf(stderr, "%s: the output sizes differ.\n", id);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct bench_data bd;
+	unsigned int i;
+	int ret;
+
+	ret = 0;
+	bench_data_init(&bd, FALSE);
+	for (i = 0; i < G_N_ELEMENTS(logic_modules); i++)
+		ret |= run_module(logic_modules[i], &bd);
+	bench_data_free(&bd);
+
+	bench_data_init(&bd, TRUE);
+	for (i = 0; i < G_N_ELEMENTS(analog_modules); i++)
+		ret |= run_module(analog_modules[i], &bd);
+	bench_data_free(&bd);
+
+	return ret;
+}
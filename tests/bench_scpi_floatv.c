@@ -0,0 +1,152 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SCPI float list microbenchmark. Not part of "make check", build and run
+ * it with "make benchmarks && ./tests/bench_scpi_floatv".
+ *
+ * Reads an ASCII waveform of 1M values from the mock SCPI transport with
+ * sr_scpi_get_floatv() and with a copy of the previous split-and-convert
+ * parser, checks that both give the same values and prints the throughput
+ * of each.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+#include "scpi_mock.h"
+
+#define BENCH_VALUES (1000 * 1000)
+#define BENCH_READ_SIZE (64 * 1024)
+#define BENCH_RUNS 5
+
+/* The previous sr_scpi_get_floatv(), for reference. */
+static int ref_get_floatv(struct sr_scpi_dev_inst *scpi,
+		const char *command, GArray **scpi_response)
+{
+	int ret;
+	float tmp;
+	char *response;
+	gchar **ptr, **tokens;
+	GArray *response_array;
+
+	response = NULL;
+	tokens = NULL;
+
+	ret = sr_scpi_get_string(scpi, command, &response);
+	if (ret != SR_OK && !response)
+		return ret;
+
+	tokens = g_strsplit(response, ",", 0);
+	ptr = tokens;
+
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), 256);
+
+	while (*ptr) {
+		if (sr_atof_ascii(*ptr, &tmp) == SR_OK)
+			response_array = g_array_append_val(response_array,
+							    tmp);
+		else
+			ret = SR_ERR_DATA;
+
+		ptr++;
+	}
+	g_strfreev(tokens);
+	g_free(response);
+
+	if (ret != SR_OK && response_array->len == 0) {
+		g_array_free(response_array, TRUE);
+		*scpi_response = NULL;
+		return SR_ERR_DATA;
+	}
+
+	*scpi_response = response_array;
+
+	return ret;
+}
+
+static gint64 run(struct sr_scpi_dev_inst *scpi,
+		int (*get_floatv)(struct sr_scpi_dev_inst *scpi,
+			const char *command, GArray **scpi_response),
+		GArray **data)
+{
+	gint64 start, best;
+	int i;
+
+	best = G_MAXINT64;
+	for (i = 0; i < BENCH_RUNS; i++) {
+		if (*data)
+			g_array_free(*data, TRUE);
+		start = g_get_monotonic_time();
+		if (get_floatv(scpi, "CURV?", data) != SR_OK) {
+			fprintf(stderr, "Reading the values failed.\n");
+			exit(1);
+		}
+		best = MIN(best, g_get_monotonic_time() - start);
+	}
+
+	return best;
+}
+
+int main(void)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GString *response;
+	GArray *ref_data, *new_data;
+	gint64 t_ref, t_new;
+	int i;
+
+	/* Values like those of a scope waveform, in volts. */
+	response = g_string_sized_new(BENCH_VALUES * 14);
+	srand(1);
+	for (i = 0; i < BENCH_VALUES; i++)
+		g_string_append_printf(response, "%s%.4E", i ? "," : "",
+			sin(i / 100.0) * 2.5 + (rand() % 100) / 1000.0);
+	g_string_append_c(response, '\n');
+
+	scpi = mock_new(BENCH_READ_SIZE, FALSE);
+	mock_respond("CURV?", response->str, response->len);
+
+	ref_data = new_data = NULL;
+	t_ref = run(scpi, ref_get_floatv, &ref_data);
+	t_new = run(scpi, sr_scpi_get_floatv, &new_data);
+
+	printf("%d values, %zu bytes  ref %6.1f MV/s  new %6.1f MV/s  x%.1f\n",
+		BENCH_VALUES, response->len,
+		(double)BENCH_VALUES / t_ref, (double)BENCH_VALUES / t_new,
+		(double)t_ref / t_new);
+
+	if (ref_data->len != new_data->len
+			|| memcmp(ref_data->data, new_data->data,
+				ref_data->len * sizeof(float))) {
+		fprintf(stderr, "The values differ.\n");
+		return 1;
+	}
+
+	g_array_free(ref_data, TRUE);
+	g_array_free(new_data, TRUE);
+	g_string_free(response, TRUE);
+	mock_free(scpi);
+
+	return 0;
+}
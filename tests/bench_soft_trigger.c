@@ -0,0 +1,361 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Soft-trigger microbenchmark. Not part of "make check", build and run it
+ * with "make benchmarks && ./tests/bench_soft_trigger".
+ *
+ * Runs the compiled trigger engine in src/soft-trigger.c and a copy of the
+ * previous per-match engine over the same data, checks that both fire on
+ * the same sample and prints the throughput of each.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define BENCH_SAMPLES (16 * 1024 * 1024)
+#define BENCH_CHUNK   (16 * 1024)
+#define BENCH_PRE_TRIGGER 1000
+#define MAX_STAGES 4
+#define MAX_MATCHES 4
+
+/*
+ * soft-trigger.c is linked in directly, stub out the session. Declared
+ * like its prototype in libsigrok-internal.h.
+ */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	(void)sdi;
+	(void)packet;
+
+	return SR_OK;
+}
+
+/* The pre-compilation soft-trigger engine, for reference. */
+struct ref_trigger_logic {
+	const struct sr_trigger *trigger;
+	int count;
+	int unitsize;
+	int cur_stage;
+	uint8_t *prev_sample;
+	uint8_t *pre_trigger_buffer;
+	uint8_t *pre_trigger_head;
+	int pre_trigger_size;
+	int pre_trigger_fill;
+};
+
+static void ref_pre_trigger_append(struct ref_trigger_logic *rtl,
+		uint8_t *buf, int len)
+{
+	if (len > rtl->pre_trigger_size) {
+		buf += len - rtl->pre_trigger_size;
+		len = rtl->pre_trigger_size;
+	}
+	rtl->pre_trigger_fill = MIN(rtl->pre_trigger_fill + len,
+	                            rtl->pre_trigger_size);
+	while (len > 0) {
+		size_t size = MIN(rtl->pre_trigger_buffer + rtl->pre_trigger_size
+		                  - rtl->pre_trigger_head, len);
+		memcpy(rtl->pre_trigger_head, buf, size);
+		rtl->pre_trigger_head += size;
+		if (rtl->pre_trigger_head >= rtl->pre_trigger_buffer
+		                             + rtl->pre_trigger_size)
+			rtl->pre_trigger_head = rtl->pre_trigger_buffer;
+		buf += size;
+		len -= size;
+	}
+}
+
+static gboolean ref_check_match(struct ref_trigger_logic *rtl,
+		uint8_t *sample, struct sr_trigger_match *match)
+{
+	int bit, prev_bit;
+	gboolean result;
+
+	rtl->count++;
+	result = FALSE;
+	bit = *(sample + match->channel->index / 8)
+			& (1 << (match->channel->index % 8));
+	if (match->match == SR_TRIGGER_ZERO)
+		result = bit == 0;
+	else if (match->match == SR_TRIGGER_ONE)
+		result = bit != 0;
+	else {
+		if (rtl->count == 1)
+			return FALSE;
+		prev_bit = *(rtl->prev_sample + match->channel->index / 8)
+				& (1 << (match->channel->index % 8));
+		if (match->match == SR_TRIGGER_RISING)
+			result = prev_bit == 0 && bit != 0;
+		else if (match->match == SR_TRIGGER_FALLING)
+			result = prev_bit != 0 && bit == 0;
+		else if (match->match == SR_TRIGGER_EDGE)
+			result = prev_bit != bit;
+	}
+
+	return result;
+}
+
+static int ref_check(struct ref_trigger_logic *rtl, uint8_t *buf, int len)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l, *l_stage;
+	int offset, i;
+	gboolean match_found;
+
+	offset = -1;
+	for (i = 0; i < len; i += rtl->unitsize) {
+		l_stage = g_slist_nth(rtl->trigger->stages, rtl->cur_stage);
+		stage = l_stage->data;
+		match_found = TRUE;
+		for (l = stage->matches; l; l = l->next) {
+			match = l->data;
+			if (!match->channel->enabled)
+				continue;
+			if (!ref_check_match(rtl, buf + i, match)) {
+				match_found = FALSE;
+				break;
+			}
+		}
+		memcpy(rtl->prev_sample, buf + i, rtl->unitsize);
+		if (match_found) {
+			if (l_stage->next) {
+				rtl->cur_stage++;
+			} else {
+				ref_pre_trigger_append(rtl, buf, i);
+				offset = i / rtl->unitsize;
+				break;
+			}
+		} else if (rtl->cur_stage > 0) {
+			i -= rtl->cur_stage * rtl->unitsize;
+			if (i < -1)
+				i = -1;
+			rtl->cur_stage = 0;
+		}
+	}
+	if (offset == -1)
+		ref_pre_trigger_append(rtl, buf, len);
+
+	return offset;
+}
+
+/*
+ * A benchmark case. The triggered channels are held low throughout the
+ * buffer except for the last num_stages samples, which are set to tail[]
+ * and make the trigger fire on the very last sample.
+ */
+struct bench_case {
+	const char *name;
+	int num_channels;
+	int num_stages;
+	struct {
+		int channel;
+		int match;
+	} stages[MAX_STAGES][MAX_MATCHES];
+	uint64_t tail[MAX_STAGES];
+};
+
+static const struct bench_case cases[] = {
+	{ "8ch, rising edge", 8, 1,
+		{ { { 0, SR_TRIGGER_RISING }, { -1, 0 } } },
+		{ 0x01 } },
+	{ "16ch, level + falling edge", 16, 2,
+		{ { { 3, SR_TRIGGER_ONE }, { -1, 0 } },
+		  { { 3, SR_TRIGGER_ONE }, { 9, SR_TRIGGER_FALLING }, { -1, 0 } } },
+		{ 0x0208, 0x0008 } },
+	{ "32ch, 3 stages", 32, 3,
+		{ { { 0, SR_TRIGGER_ONE }, { -1, 0 } },
+		  { { 0, SR_TRIGGER_ONE }, { 17, SR_TRIGGER_ONE }, { -1, 0 } },
+		  { { 30, SR_TRIGGER_EDGE }, { -1, 0 } } },
+		{ 0x00000001, 0x00020001, 0x40020001 } },
+	{ "64ch, level", 64, 1,
+		{ { { 5, SR_TRIGGER_ONE }, { 60, SR_TRIGGER_ONE }, { -1, 0 } } },
+		{ 0x1000000000000020ULL } },
+	{ "72ch, level (scalar)", 72, 1,
+		{ { { 2, SR_TRIGGER_ONE }, { 40, SR_TRIGGER_ONE }, { -1, 0 } } },
+		{ 0x0000010000000004ULL } },
+};
+
+static struct sr_dev_inst *bench_sdi_new(int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	int i;
+
+	sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	for (i = 0; i < num_channels; i++) {
+		ch = g_malloc0(sizeof(struct sr_channel));
+		ch->sdi = sdi;
+		ch->index = i;
+		ch->type = SR_CHANNEL_LOGIC;
+		ch->enabled = TRUE;
+		ch->name = g_strdup_printf("D%d", i);
+		sdi->channels = g_slist_append(sdi->channels, ch);
+	}
+
+	return sdi;
+}
+
+static void bench_sdi_free(struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		g_free(ch->name);
+		g_free(ch);
+	}
+	g_slist_free(sdi->channels);
+	g_free(sdi);
+}
+
+static struct sr_trigger *bench_trigger_new(const struct bench_case *bc,
+		struct sr_dev_inst *sdi, uint8_t *trigmask, int unitsize)
+{
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+	int s, m;
+
+	memset(trigmask, 0, unitsize);
+	trigger = sr_trigger_new("bench");
+	for (s = 0; s < bc->num_stages; s++) {
+		stage = sr_trigger_stage_add(trigger);
+		for (m = 0; m < MAX_MATCHES && bc->stages[s][m].channel >= 0; m++) {
+			ch = g_slist_nth_data(sdi->channels, bc->stages[s][m].channel);
+			sr_trigger_match_add(stage, ch, bc->stages[s][m].match, 0);
+			trigmask[ch->index / 8] |= 1 << (ch->index % 8);
+		}
+	}
+
+	return trigger;
+}
+
+/* Random data on all but the triggered channels, tail[] at the end. */
+static uint8_t *bench_data_new(const struct bench_case *bc,
+		const uint8_t *trigmask, int unitsize)
+{
+	uint8_t *buf, *sample;
+	int i, b, s;
+
+	buf = g_malloc((size_t)BENCH_SAMPLES * unitsize);
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		sample = buf + (size_t)i * unitsize;
+		for (b = 0; b < unitsize; b++)
+			sample[b] = g_random_int() & ~trigmask[b];
+	}
+	for (s = 0; s < bc->num_stages; s++) {
+		sample = buf + (size_t)(BENCH_SAMPLES - bc->num_stages + s) * unitsize;
+		for (b = 0; b < unitsize && b < 8; b++)
+			sample[b] = (sample[b] & ~trigmask[b])
+					| ((bc->tail[s] >> (8 * b)) & trigmask[b]);
+	}
+
+	return buf;
+}
+
+static int run_case(const struct bench_case *bc)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct soft_trigger_logic *stl;
+	struct ref_trigger_logic rtl;
+	uint8_t *buf, *trigmask;
+	int64_t start, t_ref, t_new;
+	size_t pos, total, chunk;
+	long ref_pos, new_pos;
+	int unitsize, offset, ret;
+
+	sdi = bench_sdi_new(bc->num_channels);
+	unitsize = (bc->num_channels + 7) / 8;
+	trigmask = g_malloc0(unitsize);
+	trigger = bench_trigger_new(bc, sdi, trigmask, unitsize);
+	buf = bench_data_new(bc, trigmask, unitsize);
+	total = (size_t)BENCH_SAMPLES * unitsize;
+	chunk = BENCH_CHUNK - BENCH_CHUNK % unitsize;
+
+	memset(&rtl, 0, sizeof(rtl));
+	rtl.trigger = trigger;
+	rtl.unitsize = unitsize;
+	rtl.prev_sample = g_malloc0(unitsize);
+	rtl.pre_trigger_size = BENCH_PRE_TRIGGER * unitsize;
+	rtl.pre_trigger_buffer = g_malloc(rtl.pre_trigger_size);
+	rtl.pre_trigger_head = rtl.pre_trigger_buffer;
+	ref_pos = -1;
+	start = g_get_monotonic_time();
+	for (pos = 0; pos < total && ref_pos < 0; pos += chunk) {
+		offset = ref_check(&rtl, buf + pos, MIN(chunk, total - pos));
+		if (offset >= 0)
+			ref_pos = pos / unitsize + offset;
+	}
+	t_ref = g_get_monotonic_time() - start;
+	g_free(rtl.pre_trigger_buffer);
+	g_free(rtl.prev_sample);
+
+	stl = soft_trigger_logic_new(sdi, trigger, BENCH_PRE_TRIGGER);
+	new_pos = -1;
+	start = g_get_monotonic_time();
+	for (pos = 0; pos < total && new_pos < 0; pos += chunk) {
+		offset = soft_trigger_logic_check(stl, buf + pos,
+				MIN(chunk, total - pos), NULL);
+		if (offset >= 0)
+			new_pos = pos / unitsize + offset;
+	}
+	t_new = g_get_monotonic_time() - start;
+	soft_trigger_logic_free(stl);
+
+	printf("%-28s ref %8.1f MS/s  new %8.1f MS/s  x%.1f%s\n", bc->name,
+		(double)BENCH_SAMPLES / MAX(t_ref, 1),
+		(double)BENCH_SAMPLES / MAX(t_new, 1),
+		(double)t_ref / MAX(t_new, 1),
+		ref_pos == new_pos && new_pos == BENCH_SAMPLES - 1
+			? "" : "  MISMATCH");
+	ret = 0;
+	if (ref_pos != new_pos || new_pos != BENCH_SAMPLES - 1) {
+		fprintf(stderr, "%s: expected %d, ref %ld, new %ld\n", bc->name,
+			BENCH_SAMPLES - 1, ref_pos, new_pos);
+		ret = 1;
+	}
+
+	g_free(buf);
+	g_free(trigmask);
+	sr_trigger_free(trigger);
+	bench_sdi_free(sdi);
+
+	return ret;
+}
+
+int main(void)
+{
+	unsigned int i;
+	int ret;
+
+	g_random_set_seed(1);
+	ret = 0;
+	for (i = 0; i < G_N_ELEMENTS(cases); i++)
+		ret |= run_case(&cases[i]);
+
+	return ret;
+}
@@ -0,0 +1,317 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * VCD output microbenchmark. Not part of "make check", build and run it
+ * with "make benchmarks && ./tests/bench_vcd_output".
+ *
+ * Feeds synthetic captures to the VCD output module and to a copy of the
+ * previous per-bit encoder, checks that both write the same value changes
+ * and prints the throughput of each.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define BENCH_CHUNK (256 * 1024)
+#define BENCH_SAMPLERATE SR_MHZ(100)
+
+/* The previous VCD encoder, for reference. */
+struct ref_context {
+	int num_enabled_channels;
+	int *channel_index;
+	uint8_t *prevsample;
+	int period;
+	uint64_t samplerate;
+	uint64_t samplecount;
+};
+
+static void ref_encode(struct ref_context *ctx, const uint8_t *data,
+		uint64_t length, uint16_t unitsize, GString *out)
+{
+	unsigned int i;
+	int p, curbit, prevbit, index;
+	const uint8_t *sample;
+	gboolean timestamp_written;
+
+	for (i = 0; i <= length - unitsize; i += unitsize) {
+		sample = data + i;
+		timestamp_written = FALSE;
+
+		for (p = 0; p < ctx->num_enabled_channels; p++) {
+			index = ctx->channel_index[p];
+
+			curbit = ((unsigned)sample[index / 8]
+					>> (index % 8)) & 1;
+			prevbit = ((unsigned)ctx->prevsample[index / 8]
+					>> (index % 8)) & 1;
+
+			if (prevbit == curbit && ctx->samplecount > 0)
+				continue;
+
+			if (!timestamp_written)
+				g_string_append_printf(out, "#%.0f",
+					(double)ctx->samplecount /
+						ctx->samplerate * ctx->period);
+
+			g_string_append_c(out, ' ');
+			g_string_append_c(out, '0' + curbit);
+			g_string_append_c(out, '!' + p);
+
+			timestamp_written = TRUE;
+		}
+
+		if (timestamp_written)
+			g_string_append_c(out, '\n');
+
+		ctx->samplecount++;
+		memcpy(ctx->prevsample, sample, unitsize);
+	}
+}
+
+/*
+ * A benchmark case: each channel toggles every toggle_odds[channel]
+ * samples on average, or never if that is 0.
+ */
+struct bench_case {
+	const char *name;
+	uint64_t num_samples;
+	int num_channels;
+	unsigned int toggle_odds[16];
+};
+
+static const struct bench_case cases[] = {
+	{ "16ch, mostly idle", 100000000, 16,
+		{ 1000, 20000, 20000, 50000, 0, 0, 0, 0,
+		  100000, 0, 0, 0, 0, 0, 0, 1000000 } },
+	{ "16ch, clock + bus", 100000000, 16,
+		{ 4, 64, 64, 64, 64, 64, 64, 64,
+		  64, 0, 0, 0, 0, 0, 0, 0 } },
+	{ "8ch, busy", 10000000, 8,
+		{ 2, 2, 2, 2, 2, 2, 2, 2 } },
+};
+
+static struct sr_dev_inst *bench_sdi_new(int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	int i;
+
+	sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	for (i = 0; i < num_channels; i++) {
+		ch = g_malloc0(sizeof(struct sr_channel));
+		ch->sdi = sdi;
+		ch->index = i;
+		ch->type = SR_CHANNEL_LOGIC;
+		ch->enabled = TRUE;
+		ch->name = g_strdup_printf("D%d", i);
+		sdi->channels = g_slist_append(sdi->channels, ch);
+	}
+
+	return sdi;
+}
+
+static void bench_sdi_free(struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		g_free(ch->name);
+		g_free(ch);
+	}
+	g_slist_free(sdi->channels);
+	g_free(sdi);
+}
+
+/* Synthetic data: the state of the channels and when they toggle next. */
+struct bench_gen {
+	const struct bench_case *bc;
+	int unitsize;
+	uint8_t state[2];
+	uint64_t next[16];
+};
+
+static void bench_gen_next(struct bench_gen *gen, int c, uint64_t pos)
+{
+	unsigned int odds;
+
+	odds = gen->bc->toggle_odds[c];
+	if (odds == 0)
+		gen->next[c] = G_MAXUINT64;
+	else
+		gen->next[c] = pos + g_random_int_range(1, 2 * odds);
+}
+
+static void bench_gen_init(struct bench_gen *gen, const struct bench_case *bc,
+		int unitsize)
+{
+	int c;
+
+	memset(gen, 0, sizeof(*gen));
+	gen->bc = bc;
+	gen->unitsize = unitsize;
+	for (c = 0; c < bc->num_channels; c++)
+		bench_gen_next(gen, c, 0);
+}
+
+/* Fill samples pos to pos + num_samples - 1 into buf. */
+static void bench_gen_fill(struct bench_gen *gen, uint8_t *buf, uint64_t pos,
+		uint64_t num_samples)
+{
+	uint64_t end, next, i;
+	int c, first;
+
+	end = pos + num_samples;
+	while (pos < end) {
+		first = 0;
+		for (c = 1; c < gen->bc->num_channels; c++) {
+			if (gen->next[c] < gen->next[first])
+				first = c;
+		}
+		next = MIN(gen->next[first], end);
+		for (i = pos; i < next; i++)
+			memcpy(buf + (i - pos) * gen->unitsize, gen->state,
+					gen->unitsize);
+		buf += (next - pos) * gen->unitsize;
+		pos = next;
+		if (gen->next[first] < end) {
+			gen->state[first / 8] ^= 1 << (first % 8);
+			bench_gen_next(gen, first, pos);
+		}
+	}
+}
+
+/* Skip the header, which only the output module writes. */
+static const char *skip_header(const char *s)
+{
+	const char *end;
+
+	if ((end = strstr(s, "$enddefinitions $end\n")))
+		return end + strlen("$enddefinitions $end\n");
+
+	return s;
+}
+
+static int run_case(const struct bench_case *bc)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct ref_context ref;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	struct bench_gen gen;
+	GString *ref_out, *new_out;
+	uint8_t *buf;
+	uint64_t pos, n, out_bytes;
+	int64_t start, t_ref, t_new;
+	int unitsize, i, ret;
+
+	sdi = bench_sdi_new(bc->num_channels);
+	unitsize = (bc->num_channels + 7) / 8;
+	buf = g_malloc((size_t)BENCH_CHUNK * unitsize);
+
+	memset(&ref, 0, sizeof(ref));
+	ref.num_enabled_channels = bc->num_channels;
+	ref.channel_index = g_malloc(sizeof(int) * bc->num_channels);
+	for (i = 0; i < bc->num_channels; i++)
+		ref.channel_index[i] = i;
+	ref.prevsample = g_malloc0(unitsize);
+	ref.samplerate = BENCH_SAMPLERATE;
+	ref.period = SR_GHZ(1);
+
+	o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(BENCH_SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	sr_output_send(o, &packet, &new_out);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = unitsize;
+	logic.data = buf;
+
+	ret = 0;
+	t_ref = t_new = 0;
+	out_bytes = 0;
+	g_random_set_seed(1);
+	bench_gen_init(&gen, bc, unitsize);
+	for (pos = 0; pos < bc->num_samples; pos += n) {
+		n = MIN(BENCH_CHUNK, bc->num_samples - pos);
+		bench_gen_fill(&gen, buf, pos, n);
+		logic.length = n * unitsize;
+
+		ref_out = g_string_sized_new(512);
+		start = g_get_monotonic_time();
+		ref_encode(&ref, buf, logic.length, unitsize, ref_out);
+		t_ref += g_get_monotonic_time() - start;
+
+		start = g_get_monotonic_time();
+		sr_output_send(o, &packet, &new_out);
+		t_new += g_get_monotonic_time() - start;
+
+		out_bytes += ref_out->len;
+		if (!ret && strcmp(ref_out->str, pos == 0
+				? skip_header(new_out->str) : new_out->str)) {
+			fprintf(stderr, "%s: output differs in samples %"
+				PRIu64 "-%" PRIu64 "\n", bc->name, pos, pos + n);
+			ret = 1;
+		}
+		g_string_free(ref_out, TRUE);
+		g_string_free(new_out, TRUE);
+	}
+
+	printf("%-20s %4" PRIu64 "M samples, %6.1f MB  ref %7.1f MS/s"
+		"  new %7.1f MS/s  x%.1f%s\n", bc->name,
+		bc->num_samples / 1000000, (double)out_bytes / 1000000,
+		(double)bc->num_samples / MAX(t_ref, 1),
+		(double)bc->num_samples / MAX(t_new, 1),
+		(double)t_ref / MAX(t_new, 1), ret ? "  MISMATCH" : "");
+
+	sr_output_free(o);
+	g_free(ref.channel_index);
+	g_free(ref.prevsample);
+	g_free(buf);
+	bench_sdi_free(sdi);
+
+	return ret;
+}
+
+int main(void)
+{
+	unsigned int i;
+	int ret;
+
+	ret = 0;
+	for (i = 0; i < G_N_ELEMENTS(cases); i++)
+		ret |= run_case(&cases[i]);
+
+	return ret;
+}
@@ -0,0 +1,164 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static int notify_count;
+
+static void count_notify(gpointer data)
+{
+	(void)data;
+	notify_count++;
+}
+
+/* Check whether buffers can be allocated, referenced and released. */
+START_TEST(test_buffer_new_ref_unref)
+{
+	struct sr_buffer *buf;
+
+	buf = sr_buffer_new(1000);
+	fail_unless(buf != NULL, "sr_buffer_new() failed.");
+	fail_unless(sr_buffer_data(buf) != NULL);
+	fail_unless(sr_buffer_size(buf) == 1000);
+	memset(sr_buffer_data(buf), 0x55, 1000);
+
+	fail_unless(sr_buffer_ref(buf) == buf);
+	sr_buffer_unref(buf);
+	/* Still referenced once, data must be intact. */
+	fail_unless(((uint8_t *)sr_buffer_data(buf))[999] == 0x55);
+	sr_buffer_unref(buf);
+
+	/* NULL must not segfault. */
+	fail_unless(sr_buffer_ref(NULL) == NULL);
+	sr_buffer_unref(NULL);
+}
+END_TEST
+
+/* Check whether wrapped memory is released on the last unref only. */
+START_TEST(test_buffer_wrap)
+{
+	struct sr_buffer *buf;
+	uint8_t data[16];
+
+	fail_unless(sr_buffer_wrap(NULL, 16, count_notify) == NULL);
+
+	notify_count = 0;
+	buf = sr_buffer_wrap(data, sizeof(data), count_notify);
+	fail_unless(buf != NULL, "sr_buffer_wrap() failed.");
+	fail_unless(sr_buffer_data(buf) == data);
+	fail_unless(sr_buffer_size(buf) == sizeof(data));
+	sr_buffer_ref(buf);
+	sr_buffer_unref(buf);
+	fail_unless(notify_count == 0);
+	sr_buffer_unref(buf);
+	fail_unless(notify_count == 1);
+}
+END_TEST
+
+/* Check whether pools hand out released buffers again. */
+START_TEST(test_buffer_pool_reuse)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *a, *b;
+
+	pool = sr_buffer_pool_new(4096, 4);
+	fail_unless(pool != NULL, "sr_buffer_pool_new() failed.");
+
+	a = sr_buffer_pool_get(pool);
+	fail_unless(a != NULL && sr_buffer_size(a) == 4096);
+	b = sr_buffer_pool_get(pool);
+	fail_unless(b != NULL && b != a);
+
+	/* A buffer still referenced elsewhere is not reused. */
+	sr_buffer_ref(a);
+	sr_buffer_unref(a);
+	sr_buffer_unref(b);
+	fail_unless(sr_buffer_pool_get(pool) == b);
+
+	sr_buffer_unref(b);
+	sr_buffer_unref(a);
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* Check whether buffers remain valid after their pool was freed. */
+START_TEST(test_buffer_pool_free_outstanding)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *buf;
+
+	pool = sr_buffer_pool_new(64, 4);
+	buf = sr_buffer_pool_get(pool);
+	sr_buffer_pool_free(pool);
+
+	memset(sr_buffer_data(buf), 0xaa, 64);
+	fail_unless(sr_buffer_size(buf) == 64);
+	sr_buffer_unref(buf);
+
+	/* NULL must not segfault. */
+	fail_unless(sr_buffer_pool_get(NULL) == NULL);
+	sr_buffer_pool_free(NULL);
+}
+END_TEST
+
+/* Check whether pool buffers are page aligned, and writable to the end. */
+START_TEST(test_buffer_pool_aligned)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *bufs[8];
+	unsigned int i;
+
+	pool = sr_buffer_pool_new(1000, 8);
+	for (i = 0; i < ARRAY_SIZE(bufs); i++) {
+		bufs[i] = sr_buffer_pool_get(pool);
+		fail_unless(((uintptr_t)sr_buffer_data(bufs[i]) & 4095) == 0,
+			"Buffer %u at %p is not page aligned.", i,
+			sr_buffer_data(bufs[i]));
+		memset(sr_buffer_data(bufs[i]), 0x55, 1000);
+	}
+	for (i = 0; i < ARRAY_SIZE(bufs); i++)
+		sr_buffer_unref(bufs[i]);
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+Suite *suite_buffer(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("buffer");
+
+	tc = tcase_create("buffer");
+	tcase_add_test(tc, test_buffer_new_ref_unref);
+	tcase_add_test(tc, test_buffer_wrap);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("pool");
+	tcase_add_test(tc, test_buffer_pool_reuse);
+	tcase_add_test(tc, test_buffer_pool_free_outstanding);
+	tcase_add_test(tc, test_buffer_pool_aligned);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
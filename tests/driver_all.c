@@ -21,6 +21,7 @@
 #include <config.h>
 #include <stdlib.h>
 #include <check.h>
+#include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -41,6 +42,85 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+#ifdef HAVE_HW_DEMO
+static uint64_t demo_samples;
+static size_t demo_max_length;
+
+static void demo_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 8, "Unitsize %u.", logic->unitsize);
+	demo_samples += logic->length / logic->unitsize;
+	demo_max_length = MAX(demo_max_length, logic->length);
+}
+
+/* Check whether the demo driver sends exactly the samples asked for unpaced. */
+START_TEST(test_demo_unpaced)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_config src[2];
+	GSList *options, *devices;
+	GVariant *gvar;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_new_int32(64);
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_new_int32(0);
+	options = g_slist_append(g_slist_append(NULL, &src[0]), &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_UNPACED,
+			g_variant_new_boolean(TRUE));
+	fail_unless(ret == SR_OK, "Setting unpaced mode failed: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_PACKET_SIZE,
+			g_variant_new_uint64(1001));
+	fail_unless(ret == SR_OK, "Setting the packet size failed: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(100000));
+	fail_unless(ret == SR_OK, "Setting the sample limit failed: %d.", ret);
+
+	demo_samples = 0;
+	demo_max_length = 0;
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, demo_datafeed_in, NULL);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	sr_session_run(sess);
+
+	fail_unless(demo_samples == 100000, "Got %" PRIu64 " samples.",
+			demo_samples);
+	fail_unless(demo_max_length == 1000,
+			"Packets of up to %zu bytes.", demo_max_length);
+	ret = sr_config_get(driver, sdi, NULL, SR_CONF_ACHIEVED_SAMPLERATE,
+			&gvar);
+	fail_unless(ret == SR_OK, "Getting the achieved samplerate failed.");
+	fail_unless(g_variant_get_uint64(gvar) > 0);
+	g_variant_unref(gvar);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+#endif
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -75,5 +155,12 @@ Suite *suite_driver_all(void)
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
 
+#ifdef HAVE_HW_DEMO
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_demo_unpaced);
+	suite_add_tcase(s, tc);
+#endif
+
 	return s;
 }
@@ -309,6 +309,170 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+static void check_file(const uint8_t *buf, int check, uint64_t samples,
+		uint64_t flags)
+{
+	int ret, fd;
+	char *filename;
+	struct sr_input *in;
+	const struct sr_input_module *imod;
+	struct sr_session *session;
+	GSList *devlist;
+
+	/* Initialize global variables for this run. */
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = check;
+	expected_samples = samples;
+	expected_samplerate = NULL;
+
+	fd = g_file_open_tmp("input-binary-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+	fail_unless(g_file_set_contents(filename, (const gchar *)buf,
+			(gssize)samples, NULL));
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	ret = sr_input_load_file(in, filename, session, flags);
+	fail_unless(ret == SR_OK, "sr_input_load_file() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END was sent.");
+	fail_unless(sr_session_dev_list(session, &devlist) == SR_OK);
+	fail_unless(devlist && devlist->data == sr_input_dev_inst_get(in),
+		"The device instance wasn't added to the session.");
+	g_slist_free(devlist);
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+
+/* Check whether whole files are loaded through sr_input_load_file(). */
+START_TEST(test_input_binary_load_file)
+{
+	uint64_t i;
+	uint8_t *buf;
+	struct sr_input *in;
+	struct sr_session *session;
+
+	buf = g_malloc(BUFSIZE);
+	memset(buf, 0xff, BUFSIZE);
+
+	check_file(buf, CHECK_ALL_HIGH, 0, 0);
+	for (i = 1; i < BUFSIZE; i *= 3) {
+		check_file(buf, CHECK_ALL_HIGH, i, 0);
+		check_file(buf, CHECK_ALL_HIGH, i, SR_INPUT_LOAD_COPY);
+	}
+	check_file((const uint8_t *)"Hello world", CHECK_HELLO_WORLD, 11, 0);
+	check_file((const uint8_t *)"Hello world", CHECK_HELLO_WORLD, 11,
+		SR_INPUT_LOAD_COPY);
+
+	g_free(buf);
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	sr_session_new(srtest_ctx, &session);
+	fail_unless(sr_input_load_file(in, "/nonexistent/file", session, 0)
+		== SR_ERR);
+	fail_unless(sr_input_load_file(in, "/nonexistent/file", session,
+		SR_INPUT_LOAD_COPY) == SR_ERR);
+	fail_unless(sr_input_load_file(in, NULL, session, 0) == SR_ERR_ARG);
+	fail_unless(sr_input_load_file(NULL, "file", session, 0) == SR_ERR_ARG);
+	sr_session_destroy(session);
+	sr_input_free(in);
+}
+END_TEST
+
+static uint64_t chunk_bytes, chunk_max;
+static gboolean chunk_data_ok;
+
+static void datafeed_chunks(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 2);
+	fail_unless(logic->length % logic->unitsize == 0);
+	data = logic->data;
+	for (i = 0; i < logic->length; i++) {
+		if (data[i] != (uint8_t)(chunk_bytes + i))
+			chunk_data_ok = FALSE;
+	}
+	chunk_bytes += logic->length;
+	chunk_max = MAX(chunk_max, logic->length);
+}
+
+/* Check whether data fed in odd pieces comes out in whole samples. */
+START_TEST(test_input_binary_chunks)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *gbuf;
+	uint8_t *buf;
+	uint64_t i;
+
+	buf = g_malloc(BUFSIZE);
+	for (i = 0; i < BUFSIZE; i++)
+		buf[i] = (uint8_t)i;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(16)));
+	g_hash_table_insert(options, g_strdup("chunksize"),
+			g_variant_ref_sink(g_variant_new_uint64(1001)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(options);
+
+	chunk_bytes = chunk_max = 0;
+	chunk_data_ok = TRUE;
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_chunks, NULL);
+
+	for (i = 0; i < BUFSIZE; i += 7777) {
+		gbuf = g_string_new_len((gchar *)buf + i, MIN(7777, BUFSIZE - i));
+		fail_unless(sr_input_send(in, gbuf) == SR_OK);
+		g_string_free(gbuf, TRUE);
+		if (i == 0)
+			sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	}
+	/* An incomplete sample at the end is dropped. */
+	gbuf = g_string_new_len("x", 1);
+	fail_unless(sr_input_send(in, gbuf) == SR_OK);
+	g_string_free(gbuf, TRUE);
+	fail_unless(sr_input_end(in) == SR_OK);
+
+	fail_unless(chunk_bytes == BUFSIZE, "Got %" PRIu64 " bytes.", chunk_bytes);
+	fail_unless(chunk_max == 1000, "Got packets of %" PRIu64 " bytes.",
+			chunk_max);
+	fail_unless(chunk_data_ok, "The data was changed.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_free(buf);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -322,6 +486,8 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_load_file);
+	tcase_add_test(tc, test_input_binary_chunks);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static GByteArray *samples;
+static int num_packets;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 1);
+	g_byte_array_append(samples, logic->data, logic->length);
+	num_packets++;
+}
+
+/*
+ * Feed text to the CSV input module, chunksize bytes at a time, and
+ * return the result of sr_input_end().
+ */
+static int load_chunked(const char *text, size_t len, size_t chunksize,
+		GHashTable *options)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	GString *buf;
+	size_t pos;
+	int ret;
+
+	samples = g_byte_array_new();
+	num_packets = 0;
+
+	in = sr_input_new(sr_input_find("csv"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	ret = SR_OK;
+	for (pos = 0; pos < len && ret == SR_OK; pos += chunksize) {
+		buf = g_string_new_len(text + pos, MIN(chunksize, len - pos));
+		ret = sr_input_send(in, buf);
+		g_string_free(buf, TRUE);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *gvar)
+{
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(gvar));
+}
+
+static void check_samples(const char *text, GHashTable *options,
+		const uint8_t *expected, size_t num_expected)
+{
+	size_t chunksize, len;
+	int ret;
+
+	len = strlen(text);
+	for (chunksize = 1; chunksize <= len; chunksize++) {
+		ret = load_chunked(text, len, chunksize, options);
+		fail_unless(ret == SR_OK, "Loading failed: %d (chunk size %zu).",
+			ret, chunksize);
+		fail_unless(samples->len == num_expected,
+			"Expected %zu samples, got %u (chunk size %zu).",
+			num_expected, samples->len, chunksize);
+		fail_unless(!memcmp(samples->data, expected, num_expected),
+			"Wrong samples (chunk size %zu).", chunksize);
+		g_byte_array_free(samples, TRUE);
+	}
+}
+
+/* Multi column mode, with a header, comments and CRLF line ends. */
+START_TEST(test_input_csv_multi_column)
+{
+	static const char text[] =
+		"a,b,c\r\n"
+		"1,0,1\r\n"
+		"; comment\r\n"
+		"\r\n"
+		"0, 1 ,1 ; comment\r\n"
+		"1,1,1";
+	static const uint8_t expected[] = { 0x05, 0x06, 0x07 };
+	GHashTable *options;
+
+	options = options_new();
+	option_set(options, "header", g_variant_new_boolean(TRUE));
+	check_samples(text, options, expected, sizeof(expected));
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Single column mode, in every format. */
+START_TEST(test_input_csv_single_column)
+{
+	static const char bin_text[] = "x,1011\nx,0110\n";
+	static const char hex_text[] = "x,ff\nx,0a\nx,3\n";
+	static const char oct_text[] = "x,777\nx,12\n";
+	static const uint8_t bin_expected[] = { 0x05, 0x03 };
+	static const uint8_t hex_expected[] = { 0xff, 0x0a, 0x03 };
+	static const uint8_t oct_expected[] = { 0xff, 0x05 };
+	GHashTable *options;
+
+	options = options_new();
+	option_set(options, "single-column", g_variant_new_int32(1));
+	option_set(options, "numchannels", g_variant_new_int32(3));
+	option_set(options, "first-channel", g_variant_new_int32(1));
+	check_samples(bin_text, options, bin_expected, sizeof(bin_expected));
+
+	option_set(options, "numchannels", g_variant_new_int32(8));
+	option_set(options, "first-channel", g_variant_new_int32(0));
+	option_set(options, "format", g_variant_new_string("hex"));
+	check_samples(hex_text, options, hex_expected, sizeof(hex_expected));
+
+	option_set(options, "first-channel", g_variant_new_int32(1));
+	option_set(options, "format", g_variant_new_string("oct"));
+	check_samples(oct_text, options, oct_expected, sizeof(oct_expected));
+
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Lines before the start line are skipped, the next one is the header. */
+START_TEST(test_input_csv_start_line)
+{
+	static const char text[] =
+		"junk\n"
+		"x::a::b\n"
+		"0::1::0\n"
+		"1::0::1\n";
+	static const uint8_t expected[] = { 0x01, 0x02 };
+	GHashTable *options;
+
+	options = options_new();
+	option_set(options, "delimiter", g_variant_new_string("::"));
+	option_set(options, "first-channel", g_variant_new_int32(1));
+	option_set(options, "header", g_variant_new_boolean(TRUE));
+	option_set(options, "startline", g_variant_new_int32(2));
+	check_samples(text, options, expected, sizeof(expected));
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/*
+ * A large input is parsed in line ranges by several threads. The samples
+ * must come in order, and be sent in few large packets.
+ */
+START_TEST(test_input_csv_large)
+{
+	GString *text;
+	GHashTable *options;
+	uint8_t *expected;
+	size_t i, num_samples;
+	int ret, c;
+
+	num_samples = 1000000;
+	text = g_string_sized_new(num_samples * 8);
+	expected = g_malloc0(num_samples);
+	for (i = 0; i < num_samples; i++) {
+		for (c = 0; c < 4; c++) {
+			if ((i >> c) & 1)
+				expected[i] |= 1 << c;
+			g_string_append_c(text, (i >> c) & 1 ? '1' : '0');
+			g_string_append_c(text, c < 3 ? ',' : '\n');
+		}
+	}
+
+	options = options_new();
+	ret = load_chunked(text->str, text->len, text->len, options);
+	fail_unless(ret == SR_OK, "Loading failed: %d.", ret);
+	fail_unless(samples->len == num_samples,
+		"Expected %zu samples, got %u.", num_samples, samples->len);
+	fail_unless(!memcmp(samples->data, expected, num_samples),
+		"Wrong samples.");
+	fail_unless(num_packets < 10, "Sent %d packets.", num_packets);
+
+	/* An error in any of the ranges must be reported. */
+	text->str[text->len - 10] = 'x';
+	g_byte_array_free(samples, TRUE);
+	ret = load_chunked(text->str, text->len, text->len, options);
+	fail_unless(ret != SR_OK, "Invalid value not reported.");
+
+	g_byte_array_free(samples, TRUE);
+	g_hash_table_destroy(options);
+	g_free(expected);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_csv_multi_column);
+	tcase_add_test(tc, test_input_csv_single_column);
+	tcase_add_test(tc, test_input_csv_start_line);
+	tcase_add_test(tc, test_input_csv_large);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
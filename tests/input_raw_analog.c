@@ -0,0 +1,248 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_FRAMES 25000
+
+static GArray *values;
+static uint64_t num_frames, max_frames;
+static gboolean seen_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	unsigned int count;
+	float *fbuf;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_END)
+		seen_end = TRUE;
+	if (packet->type != SR_DF_ANALOG)
+		return;
+
+	analog = packet->payload;
+	fail_unless(analog->num_samples > 0, "Got an empty packet.");
+	count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	fbuf = g_malloc(sizeof(float) * count);
+	fail_unless(sr_analog_to_float(analog, fbuf) == SR_OK);
+	g_array_append_vals(values, fbuf, count);
+	g_free(fbuf);
+
+	num_frames += analog->num_samples;
+	max_frames = MAX(max_frames, analog->num_samples);
+}
+
+/*
+ * Feed len bytes of data to a new raw_analog instance, in pieces of the
+ * given size, and gather the samples it sends as floats.
+ */
+static void run(GHashTable *options, const uint8_t *data, size_t len,
+		size_t piece)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	GString *gbuf;
+	size_t i;
+
+	values = g_array_new(FALSE, FALSE, sizeof(float));
+	num_frames = max_frames = 0;
+	seen_end = FALSE;
+
+	in = sr_input_new(sr_input_find("raw_analog"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	for (i = 0; i < len; i += piece) {
+		gbuf = g_string_new_len((const gchar *)data + i,
+				MIN(piece, len - i));
+		fail_unless(sr_input_send(in, gbuf) == SR_OK);
+		g_string_free(gbuf, TRUE);
+		if (i == 0)
+			sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	}
+	fail_unless(sr_input_end(in) == SR_OK);
+	fail_unless(seen_end, "No SR_DF_END was sent.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+static GHashTable *new_options(const char *format, int num_channels)
+{
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("format"),
+			g_variant_ref_sink(g_variant_new_string(format)));
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(num_channels)));
+
+	return options;
+}
+
+/* Two channels of S16_LE samples counting up from -32768. */
+static uint8_t *s16_data(void)
+{
+	uint8_t *data;
+	int16_t v;
+	int i;
+
+	data = g_malloc(NUM_FRAMES * 2 * 2);
+	for (i = 0; i < NUM_FRAMES * 2; i++) {
+		v = (int16_t)(i - 32768);
+		data[i * 2] = (uint16_t)v & 0xff;
+		data[i * 2 + 1] = (uint16_t)v >> 8;
+	}
+
+	return data;
+}
+
+/* Check that the chunksize option limits the packets to whole frames. */
+START_TEST(test_input_raw_analog_chunksize)
+{
+	GHashTable *options;
+	uint8_t *data;
+	int i;
+
+	data = s16_data();
+	options = new_options("S16_LE", 2);
+	g_hash_table_insert(options, g_strdup("chunksize"),
+			g_variant_ref_sink(g_variant_new_uint64(1001)));
+
+	/* Odd pieces, so samples and frames are split between them. */
+	run(options, data, NUM_FRAMES * 2 * 2, 7777);
+	fail_unless(num_frames == NUM_FRAMES, "Got %" PRIu64 " frames.",
+			num_frames);
+	fail_unless(max_frames == 250, "Got packets of %" PRIu64 " frames.",
+			max_frames);
+	for (i = 0; i < NUM_FRAMES * 2; i++) {
+		fail_unless(g_array_index(values, float, i)
+			== (float)(i - 32768) / 32768,
+			"Sample %d is %f.", i, g_array_index(values, float, i));
+	}
+	g_array_free(values, TRUE);
+
+	g_hash_table_destroy(options);
+	g_free(data);
+}
+END_TEST
+
+/*
+ * A chunksize beyond 4 GiB must not make the packet size wrap. This one
+ * used to wrap to 4 bytes per packet, each claiming 2^30 + 1 frames.
+ */
+START_TEST(test_input_raw_analog_huge_chunksize)
+{
+	GHashTable *options;
+	uint8_t *data;
+	int i;
+
+	data = s16_data();
+	options = new_options("S16_LE", 2);
+	g_hash_table_insert(options, g_strdup("chunksize"),
+			g_variant_ref_sink(g_variant_new_uint64(
+			((UINT64_C(1) << 30) + 1) * 4)));
+
+	run(options, data, NUM_FRAMES * 2 * 2, NUM_FRAMES * 2 * 2);
+	fail_unless(num_frames == NUM_FRAMES, "Got %" PRIu64 " frames.",
+			num_frames);
+	fail_unless(max_frames == NUM_FRAMES);
+	for (i = 0; i < NUM_FRAMES * 2; i++) {
+		fail_unless(g_array_index(values, float, i)
+			== (float)(i - 32768) / 32768);
+	}
+	g_array_free(values, TRUE);
+
+	g_hash_table_destroy(options);
+	g_free(data);
+}
+END_TEST
+
+/* Check that integer samples keep their raw counts without normalize. */
+START_TEST(test_input_raw_analog_normalize)
+{
+	GHashTable *options;
+	uint8_t *data, u8[256];
+	int i;
+
+	data = s16_data();
+	options = new_options("S16_LE", 2);
+	g_hash_table_insert(options, g_strdup("normalize"),
+			g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	run(options, data, NUM_FRAMES * 2 * 2, 4096);
+	fail_unless(num_frames == NUM_FRAMES);
+	for (i = 0; i < NUM_FRAMES * 2; i++)
+		fail_unless(g_array_index(values, float, i) == i - 32768);
+	g_array_free(values, TRUE);
+	g_hash_table_destroy(options);
+	g_free(data);
+
+	for (i = 0; i < 256; i++)
+		u8[i] = i;
+
+	/* Unsigned samples are normalized around zero by default... */
+	options = new_options("U8", 1);
+	run(options, u8, sizeof(u8), 100);
+	fail_unless(num_frames == 256);
+	for (i = 0; i < 256; i++) {
+		fail_unless(fabs(g_array_index(values, float, i)
+			- ((double)i / 255 - 0.5)) < 1e-6,
+			"Sample %d is %f.", i, g_array_index(values, float, i));
+	}
+	g_array_free(values, TRUE);
+
+	/* ...and left alone without normalize. */
+	g_hash_table_insert(options, g_strdup("normalize"),
+			g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	run(options, u8, sizeof(u8), 100);
+	fail_unless(num_frames == 256);
+	for (i = 0; i < 256; i++)
+		fail_unless(g_array_index(values, float, i) == i);
+	g_array_free(values, TRUE);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+Suite *suite_input_raw_analog(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-raw-analog");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_raw_analog_chunksize);
+	tcase_add_test(tc, test_input_raw_analog_huge_chunksize);
+	tcase_add_test(tc, test_input_raw_analog_normalize);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Channel 0 is clk, channels 1-4 are bus (LSB first), channel 5 is
+ * level. clk_alias shares the identifier of clk and gets no channel.
+ */
+static const char vcd_text[] =
+	"$timescale 1 us $end\n"
+	"$scope module top $end\n"
+	"$var wire 1 ! clk $end\n"
+	"$var wire 4 \" bus [3:0] $end\n"
+	"$var real 64 #a level $end\n"
+	"$var wire 1 ! clk_alias $end\n"
+	"$upscope $end\n"
+	"$enddefinitions $end\n"
+	"$comment 1! is ignored $end\n"
+	"#0\n"
+	"$dumpvars\n"
+	"0!\n"
+	"b0 \"\n"
+	"r0 #a\n"
+	"$end\n"
+	"#2\n"
+	"1!\n"
+	"b101 \"\n"
+	"#3\n"
+	"0! r1.5 #a\n"
+	"#5\n"
+	"1 !\n"
+	"bx1 \"\n"
+	"#6\n";
+
+static const uint8_t vcd_samples[] = { 0x00, 0x00, 0x0b, 0x2a, 0x2a, 0x23 };
+
+static GByteArray *samples;
+static uint64_t samplerate;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		g_byte_array_append(samples, logic->data, logic->length);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Feed vcd_text to the VCD input module, chunksize bytes at a time. */
+static void check_chunked(size_t chunksize)
+{
+	const struct sr_input_module *imod;
+	const struct sr_input *in;
+	struct sr_session *session;
+	GString *buf;
+	size_t pos, len;
+	int ret;
+
+	samples = g_byte_array_new();
+	samplerate = 0;
+
+	imod = sr_input_find("vcd");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	len = strlen(vcd_text);
+	for (pos = 0; pos < len; pos += chunksize) {
+		buf = g_string_new_len(vcd_text + pos, MIN(chunksize, len - pos));
+		ret = sr_input_send(in, buf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(buf, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	fail_unless(samplerate == SR_MHZ(1),
+			"Wrong samplerate %" PRIu64 ".", samplerate);
+	fail_unless(samples->len == sizeof(vcd_samples),
+			"Expected %zu samples, got %u (chunk size %zu).",
+			sizeof(vcd_samples), samples->len, chunksize);
+	fail_unless(!memcmp(samples->data, vcd_samples, sizeof(vcd_samples)),
+			"Wrong samples (chunk size %zu).", chunksize);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_byte_array_free(samples, TRUE);
+}
+
+/* Check scalar, vector and real value changes. */
+START_TEST(test_input_vcd_values)
+{
+	check_chunked(sizeof(vcd_text));
+}
+END_TEST
+
+/* Check whether tokens split across buffers are parsed correctly. */
+START_TEST(test_input_vcd_chunked)
+{
+	size_t chunksize;
+
+	for (chunksize = 1; chunksize < sizeof(vcd_text); chunksize++)
+		check_chunked(chunksize);
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_vcd_values);
+	tcase_add_test(tc, test_input_vcd_chunked);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,371 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_FRAMES 10000
+#define NUM_CHANNELS 2
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+static GArray *values;
+static uint64_t num_frames;
+static int unitsize;
+static gboolean is_float, seen_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	unsigned int count;
+	float *fbuf;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_END)
+		seen_end = TRUE;
+	if (packet->type != SR_DF_ANALOG)
+		return;
+
+	analog = packet->payload;
+	fail_unless(analog->num_samples > 0, "Got an empty packet.");
+	fail_unless(g_slist_length(analog->meaning->channels) == NUM_CHANNELS);
+	unitsize = analog->encoding->unitsize;
+	is_float = analog->encoding->is_float;
+
+	count = analog->num_samples * NUM_CHANNELS;
+	fbuf = g_malloc(sizeof(float) * count);
+	fail_unless(sr_analog_to_float(analog, fbuf) == SR_OK);
+	g_array_append_vals(values, fbuf, count);
+	g_free(fbuf);
+
+	num_frames += analog->num_samples;
+}
+
+static void append_le(GString *s, uint32_t value, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		g_string_append_c(s, (value >> (8 * i)) & 0xff);
+}
+
+/*
+ * Build a WAV file with NUM_FRAMES frames of the given sample format, in
+ * the plain or the extensible format chunk. A LIST chunk sits before the
+ * data chunk, which is left out if data is FALSE.
+ */
+static GString *wav_new(int fmt_code, int size, gboolean extensible,
+		gboolean data)
+{
+	GString *s;
+	uint32_t v;
+	float f;
+	int i;
+
+	s = g_string_new("RIFF");
+	append_le(s, 0, 4);
+	g_string_append(s, "WAVEfmt ");
+	append_le(s, extensible ? 40 : 16, 4);
+	append_le(s, extensible ? WAVE_FORMAT_EXTENSIBLE : fmt_code, 2);
+	append_le(s, NUM_CHANNELS, 2);
+	append_le(s, 48000, 4);
+	append_le(s, 48000 * NUM_CHANNELS * size, 4);
+	append_le(s, NUM_CHANNELS * size, 2);
+	append_le(s, 8 * size, 2);
+	if (extensible) {
+		append_le(s, 22, 2);
+		append_le(s, 8 * size, 2);
+		append_le(s, 0x3, 4);
+		/* KSDATAFORMAT_SUBTYPE_PCM or _IEEE_FLOAT. */
+		append_le(s, fmt_code, 2);
+		g_string_append_len(s, "\x00\x00\x00\x00\x10\x00\x80\x00"
+			"\x00\xaa\x00\x38\x9b\x71", 14);
+	}
+
+	g_string_append(s, "LIST");
+	append_le(s, 12, 4);
+	g_string_append_len(s, "INFOISFT\x02\x00\x00\x00", 12);
+
+	if (data) {
+		g_string_append(s, "data");
+		append_le(s, NUM_FRAMES * NUM_CHANNELS * size, 4);
+		for (i = 0; i < NUM_FRAMES * NUM_CHANNELS; i++) {
+			if (fmt_code == WAVE_FORMAT_IEEE_FLOAT) {
+				f = (float)(i - NUM_FRAMES) / NUM_FRAMES;
+				memcpy(&v, &f, sizeof(v));
+			} else if (size == 1) {
+				v = i;
+			} else if (size == 2) {
+				v = (uint16_t)(i * 7 - 32768);
+			} else {
+				v = (uint32_t)i * 429497 - 0x80000000;
+			}
+			append_le(s, v, size);
+		}
+	}
+
+	/* Fill in the RIFF chunk size. */
+	v = s->len - 8;
+	for (i = 0; i < 4; i++)
+		s->str[4 + i] = (v >> (8 * i)) & 0xff;
+
+	return s;
+}
+
+/* The value of sample i the way the module scaled it before. */
+static float old_value(int fmt_code, int size, int i)
+{
+	if (fmt_code == WAVE_FORMAT_IEEE_FLOAT)
+		return (float)(i - NUM_FRAMES) / NUM_FRAMES;
+	else if (size == 1)
+		return (uint8_t)i / (float)255;
+	else if (size == 2)
+		return (int16_t)(i * 7 - 32768) / (float)INT16_MAX;
+	else
+		return (int32_t)((uint32_t)i * 429497 - 0x80000000)
+			/ (float)INT32_MAX;
+}
+
+static void check_values(int fmt_code, int size)
+{
+	float expected;
+	int i;
+
+	fail_unless(num_frames == NUM_FRAMES, "Got %" PRIu64 " frames.",
+			num_frames);
+	fail_unless(unitsize == size, "Got unit size %d.", unitsize);
+	fail_unless(is_float == (fmt_code == WAVE_FORMAT_IEEE_FLOAT));
+	for (i = 0; i < NUM_FRAMES * NUM_CHANNELS; i++) {
+		expected = old_value(fmt_code, size, i);
+		fail_unless(fabs(g_array_index(values, float, i) - expected)
+			< 1e-6, "Sample %d is %f, expected %f.", i,
+			g_array_index(values, float, i), expected);
+	}
+	g_array_free(values, TRUE);
+}
+
+static struct sr_session *session_new(void)
+{
+	struct sr_session *session;
+
+	values = g_array_new(FALSE, FALSE, sizeof(float));
+	num_frames = 0;
+	unitsize = 0;
+	is_float = FALSE;
+	seen_end = FALSE;
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	return session;
+}
+
+/*
+ * Feed the file to a new wav instance in pieces of the given size.
+ * Returns what sr_input_end() returned.
+ */
+static int run_send(const GString *wav, size_t piece)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *gbuf;
+	size_t i;
+	int ret;
+
+	in = sr_input_new(sr_input_find("wav"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	session = session_new();
+
+	sdi = NULL;
+	for (i = 0; i < wav->len; i += piece) {
+		gbuf = g_string_new_len(wav->str + i, MIN(piece, wav->len - i));
+		fail_unless(sr_input_send(in, gbuf) == SR_OK);
+		g_string_free(gbuf, TRUE);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in)))
+			sr_session_dev_add(session, sdi);
+	}
+	fail_unless(sdi != NULL, "The header wasn't parsed.");
+	ret = sr_input_end(in);
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+
+	return ret;
+}
+
+/* Load the file through sr_input_load_file(). */
+static int run_load_file(const GString *wav)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	char *filename;
+	int fd, ret;
+
+	fd = g_file_open_tmp("input-wav-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+	fail_unless(g_file_set_contents(filename, wav->str, wav->len, NULL));
+
+	in = sr_input_new(sr_input_find("wav"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	session = session_new();
+
+	ret = sr_input_load_file(in, filename, session, 0);
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+	g_unlink(filename);
+	g_free(filename);
+
+	return ret;
+}
+
+/*
+ * Check that PCM samples are sent in their own unit size and give the
+ * same values as before.
+ */
+START_TEST(test_input_wav_pcm)
+{
+	GString *wav;
+	int size;
+
+	for (size = 1; size <= 4; size *= 2) {
+		wav = wav_new(WAVE_FORMAT_PCM, size, FALSE, TRUE);
+		fail_unless(run_send(wav, wav->len) == SR_OK);
+		fail_unless(seen_end, "No SR_DF_END was sent.");
+		check_values(WAVE_FORMAT_PCM, size);
+		g_string_free(wav, TRUE);
+
+		wav = wav_new(WAVE_FORMAT_PCM, size, TRUE, TRUE);
+		fail_unless(run_send(wav, wav->len) == SR_OK);
+		check_values(WAVE_FORMAT_PCM, size);
+		g_string_free(wav, TRUE);
+	}
+}
+END_TEST
+
+START_TEST(test_input_wav_float)
+{
+	GString *wav;
+
+	wav = wav_new(WAVE_FORMAT_IEEE_FLOAT, 4, FALSE, TRUE);
+	fail_unless(run_send(wav, wav->len) == SR_OK);
+	check_values(WAVE_FORMAT_IEEE_FLOAT, 4);
+	g_string_free(wav, TRUE);
+
+	wav = wav_new(WAVE_FORMAT_IEEE_FLOAT, 4, TRUE, TRUE);
+	fail_unless(run_send(wav, wav->len) == SR_OK);
+	check_values(WAVE_FORMAT_IEEE_FLOAT, 4);
+	g_string_free(wav, TRUE);
+}
+END_TEST
+
+/*
+ * Check that pieces splitting the header, the data chunk header and the
+ * samples don't lose or reorder any samples.
+ */
+START_TEST(test_input_wav_pieces)
+{
+	static const size_t pieces[] = { 1, 7, 45, 333, 4099 };
+	GString *wav;
+	unsigned int i;
+
+	wav = wav_new(WAVE_FORMAT_PCM, 2, FALSE, TRUE);
+	for (i = 0; i < G_N_ELEMENTS(pieces); i++) {
+		fail_unless(run_send(wav, pieces[i]) == SR_OK);
+		fail_unless(seen_end, "No SR_DF_END was sent.");
+		check_values(WAVE_FORMAT_PCM, 2);
+	}
+	g_string_free(wav, TRUE);
+
+	wav = wav_new(WAVE_FORMAT_PCM, 4, TRUE, TRUE);
+	fail_unless(run_send(wav, 7) == SR_OK);
+	check_values(WAVE_FORMAT_PCM, 4);
+	g_string_free(wav, TRUE);
+}
+END_TEST
+
+/* Check that files are loaded in place through sr_input_load_file(). */
+START_TEST(test_input_wav_load_file)
+{
+	GString *wav;
+	int size;
+
+	for (size = 1; size <= 4; size *= 2) {
+		wav = wav_new(WAVE_FORMAT_PCM, size, FALSE, TRUE);
+		fail_unless(run_load_file(wav) == SR_OK);
+		fail_unless(seen_end, "No SR_DF_END was sent.");
+		check_values(WAVE_FORMAT_PCM, size);
+		g_string_free(wav, TRUE);
+	}
+
+	wav = wav_new(WAVE_FORMAT_IEEE_FLOAT, 4, TRUE, TRUE);
+	fail_unless(run_load_file(wav) == SR_OK);
+	check_values(WAVE_FORMAT_IEEE_FLOAT, 4);
+	g_string_free(wav, TRUE);
+}
+END_TEST
+
+/* Check that a file without a data chunk is reported, both ways. */
+START_TEST(test_input_wav_no_data)
+{
+	GString *wav;
+
+	wav = wav_new(WAVE_FORMAT_PCM, 2, FALSE, FALSE);
+
+	fail_unless(run_send(wav, 7) == SR_ERR_DATA);
+	fail_unless(num_frames == 0);
+	g_array_free(values, TRUE);
+
+	fail_unless(run_load_file(wav) == SR_ERR_DATA);
+	fail_unless(num_frames == 0);
+	g_array_free(values, TRUE);
+
+	g_string_free(wav, TRUE);
+}
+END_TEST
+
+Suite *suite_input_wav(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-wav");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_wav_pcm);
+	tcase_add_test(tc, test_input_wav_float);
+	tcase_add_test(tc, test_input_wav_pieces);
+	tcase_add_test(tc, test_input_wav_load_file);
+	tcase_add_test(tc, test_input_wav_no_data);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
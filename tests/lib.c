@@ -161,3 +161,29 @@ GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi)
 
 	return channels;
 }
+
+/*
+ * Free a device instance from sr_dev_inst_user_new(), which must not be
+ * in a session. There's no public API for this, the library doesn't free
+ * user devices itself.
+ */
+void srtest_dev_inst_free(struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		g_free(ch->name);
+		g_free(ch->priv);
+		g_free(ch);
+	}
+	g_slist_free(sr_dev_inst_channels_get(sdi));
+
+	g_free((char *)sr_dev_inst_vendor_get(sdi));
+	g_free((char *)sr_dev_inst_model_get(sdi));
+	g_free((char *)sr_dev_inst_version_get(sdi));
+	g_free((char *)sr_dev_inst_sernum_get(sdi));
+	g_free((char *)sr_dev_inst_connid_get(sdi));
+	g_free(sdi);
+}
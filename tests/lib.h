@@ -41,18 +41,27 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 			     uint64_t samplerate);
 
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi);
+void srtest_dev_inst_free(struct sr_dev_inst *sdi);
 
 Suite *suite_core(void);
 Suite *suite_driver_all(void);
 Suite *suite_input_all(void);
 Suite *suite_input_binary(void);
+Suite *suite_input_csv(void);
+Suite *suite_input_raw_analog(void);
+Suite *suite_input_vcd(void);
+Suite *suite_input_wav(void);
 Suite *suite_output_all(void);
+Suite *suite_output_csv(void);
 Suite *suite_transform_all(void);
 Suite *suite_session(void);
+Suite *suite_session_driver(void);
 Suite *suite_strutil(void);
 Suite *suite_version(void);
 Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
+Suite *suite_buffer(void);
+Suite *suite_trace(void);
 
 #endif
@@ -0,0 +1,266 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test vectors for the Saleae Logic16 sample conversion. This is a
+ * program of its own, linking the driver's convert.c directly, so it
+ * runs without the device and without the rest of the driver.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "hardware/saleae-logic16/protocol.h"
+#include "private.h"
+
+/*
+ * Transfer dumps and the samples they hold.
+ *
+ * 3ch: D0-D2 enabled, a clock, a data line and a chip select.
+ * sparse: D2, D7, D9 and D15 enabled.
+ * 16ch: all channels enabled.
+ */
+static const uint8_t dump_3ch[] = {
+	0x55, 0x55, 0xcc, 0xf3, 0x00, 0xf0, 0x55, 0x55, 0xcc, 0x33, 0x00, 0x00,
+	0x55, 0x55, 0xcf, 0x33, 0x0f, 0x00,
+};
+
+static const uint16_t samples_3ch[] = {
+	0x0006, 0x0007, 0x0006, 0x0007, 0x0000, 0x0001, 0x0002, 0x0003,
+	0x0002, 0x0003, 0x0000, 0x0001, 0x0002, 0x0003, 0x0000, 0x0001,
+	0x0000, 0x0001, 0x0002, 0x0003, 0x0000, 0x0001, 0x0002, 0x0003,
+	0x0002, 0x0003, 0x0000, 0x0001, 0x0002, 0x0003, 0x0000, 0x0001,
+	0x0000, 0x0001, 0x0002, 0x0003, 0x0000, 0x0001, 0x0002, 0x0003,
+	0x0002, 0x0003, 0x0000, 0x0001, 0x0006, 0x0007, 0x0006, 0x0007,
+};
+
+static const uint8_t dump_sparse[] = {
+	0x49, 0x92, 0x3f, 0x00, 0x0f, 0x0f, 0x00, 0x06, 0x92, 0x24, 0xff, 0xff,
+	0x0f, 0x0f, 0x01, 0x40,
+};
+
+static const uint16_t samples_sparse[] = {
+	0x0004, 0x0000, 0x0000, 0x0004, 0x0200, 0x8200, 0x8204, 0x0200,
+	0x0000, 0x0004, 0x0080, 0x0080, 0x0284, 0x0280, 0x0280, 0x0284,
+	0x0080, 0x8080, 0x0084, 0x0080, 0x0280, 0x0284, 0x0280, 0x0280,
+	0x0084, 0x0080, 0x0080, 0x0084, 0x0280, 0x0280, 0x0284, 0x8280,
+};
+
+static const uint8_t dump_16ch[] = {
+	0x55, 0x55, 0x66, 0x66, 0x78, 0x78, 0xd5, 0x2a, 0x99, 0x4c, 0xe1, 0x70,
+	0x54, 0x2a, 0xcc, 0x19, 0xc3, 0x07, 0x6a, 0x55, 0x73, 0x66, 0x29, 0x2d,
+	0xb3, 0x4c, 0xa5, 0x25, 0x66, 0x19, 0xd2, 0x52, 0x55, 0x55, 0x66, 0x66,
+	0x78, 0x78, 0xd5, 0x2a, 0x66, 0xb3, 0x87, 0xc3, 0x52, 0xa9, 0x31, 0x67,
+	0xf0, 0xe0, 0x5a, 0xb5, 0x9c, 0x39, 0x4a, 0x6b, 0xd3, 0x0c, 0x5a, 0x9a,
+	0x33, 0x8c, 0x69, 0x29,
+};
+
+static const uint16_t samples_16ch[] = {
+	0x0000, 0x9637, 0x2c6e, 0xc2a5, 0x58dc, 0x3f13, 0x854a, 0x6b81,
+	0xb1b8, 0xc7ef, 0x7e26, 0x945d, 0x0a94, 0x60cb, 0xd702, 0x3d39,
+	0x6370, 0x09a7, 0x8fde, 0x2615, 0xfc4c, 0x5283, 0x28ba, 0x8ef1,
+	0x1528, 0xbb5f, 0xc196, 0x77cd, 0xae04, 0x043b, 0x7a72, 0xd0a9,
+};
+
+static const uint16_t masks_3ch[] = { 1 << 0, 1 << 1, 1 << 2 };
+static const uint16_t masks_sparse[] = { 1 << 2, 1 << 7, 1 << 9, 1 << 15 };
+static const uint16_t masks_16ch[] = {
+	1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+	1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15,
+};
+
+static void dev_context_init(struct dev_context *devc,
+		const uint16_t *masks, int num_channels)
+{
+	int i;
+
+	memset(devc, 0, sizeof(*devc));
+	devc->num_channels = num_channels;
+	for (i = 0; i < num_channels; i++) {
+#ifdef WORDS_BIGENDIAN
+		/* As set up by the driver, see configure_channels(). */
+		devc->channel_masks[i] = GUINT16_SWAP_LE_BE(masks[i]);
+#else
+		devc->channel_masks[i] = masks[i];
+#endif
+	}
+}
+
+/* Check the output buffer against the expected samples. */
+static void check_samples(const uint8_t *buf, const uint16_t *samples,
+		size_t num_samples, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < num_samples; i++) {
+		fail_unless(RL16(buf + 2 * i) == samples[i],
+			"%s: sample %zu is 0x%04x, expected 0x%04x.",
+			name, i, RL16(buf + 2 * i), samples[i]);
+	}
+}
+
+/*
+ * Convert a dump in transfers of transfer_size bytes (the whole dump if
+ * 0), and check the result.
+ */
+static void check_dump(const uint8_t *dump, size_t dump_size,
+		const uint16_t *samples, size_t num_samples,
+		const uint16_t *masks, int num_channels, size_t transfer_size,
+		const char *name)
+{
+	struct dev_context devc;
+	uint8_t *buf;
+	size_t pos, n, total;
+
+	dev_context_init(&devc, masks, num_channels);
+	buf = g_malloc0(2 * num_samples + 32);
+	if (transfer_size == 0)
+		transfer_size = dump_size;
+
+	total = 0;
+	for (pos = 0; pos < dump_size; pos += n) {
+		n = MIN(transfer_size, dump_size - pos);
+		total += logic16_convert_sample_data(&devc, buf + 2 * total,
+				2 * num_samples + 32 - 2 * total, dump + pos, n);
+	}
+
+	fail_unless(total == num_samples, "%s: got %zu samples, expected %zu "
+		"(transfer size %zu).", name, total, num_samples, transfer_size);
+	check_samples(buf, samples, num_samples, name);
+	fail_unless(devc.cur_channel == 0, "%s: incomplete group left.", name);
+
+	g_free(buf);
+}
+
+START_TEST(test_dump_3ch)
+{
+	check_dump(ARRAY_AND_SIZE(dump_3ch), ARRAY_AND_SIZE(samples_3ch),
+		ARRAY_AND_SIZE(masks_3ch), 0, "3ch");
+}
+END_TEST
+
+START_TEST(test_dump_sparse)
+{
+	check_dump(ARRAY_AND_SIZE(dump_sparse), ARRAY_AND_SIZE(samples_sparse),
+		ARRAY_AND_SIZE(masks_sparse), 0, "sparse");
+}
+END_TEST
+
+START_TEST(test_dump_16ch)
+{
+	check_dump(ARRAY_AND_SIZE(dump_16ch), ARRAY_AND_SIZE(samples_16ch),
+		ARRAY_AND_SIZE(masks_16ch), 0, "16ch");
+}
+END_TEST
+
+/* Groups split across transfers at every word boundary. */
+START_TEST(test_dump_split)
+{
+	size_t n;
+
+	for (n = 2; n < sizeof(dump_3ch); n += 2)
+		check_dump(ARRAY_AND_SIZE(dump_3ch), ARRAY_AND_SIZE(samples_3ch),
+			ARRAY_AND_SIZE(masks_3ch), n, "3ch");
+	for (n = 2; n < sizeof(dump_sparse); n += 2)
+		check_dump(ARRAY_AND_SIZE(dump_sparse),
+			ARRAY_AND_SIZE(samples_sparse),
+			ARRAY_AND_SIZE(masks_sparse), n, "sparse");
+	for (n = 2; n < sizeof(dump_16ch); n += 2)
+		check_dump(ARRAY_AND_SIZE(dump_16ch), ARRAY_AND_SIZE(samples_16ch),
+			ARRAY_AND_SIZE(masks_16ch), n, "16ch");
+}
+END_TEST
+
+/* Encode samples the way the device sends them, one word per channel. */
+static void encode(const uint16_t *samples, size_t num_samples,
+		const uint16_t *masks, int num_channels, uint8_t *dump)
+{
+	size_t g;
+	uint16_t word;
+	int c, i;
+
+	for (g = 0; g < num_samples; g += 16) {
+		for (c = 0; c < num_channels; c++) {
+			word = 0;
+			for (i = 0; i < 16; i++) {
+				if (samples[g + i] & masks[c])
+					word |= 1 << (15 - i);
+			}
+			*dump++ = word & 0xff;
+			*dump++ = word >> 8;
+		}
+	}
+}
+
+/* Random samples for random channel sets, in transfers of random size. */
+START_TEST(test_random)
+{
+	uint16_t masks[16], *samples;
+	uint8_t *dump;
+	size_t num_samples, i, n;
+	int run, num_channels, ch;
+
+	num_samples = 16 * 1000;
+	samples = g_malloc(2 * num_samples);
+	dump = g_malloc(2 * num_samples);
+
+	g_random_set_seed(16);
+	for (run = 0; run < 100; run++) {
+		num_channels = 0;
+		for (ch = 0; ch < 16; ch++) {
+			if (g_random_boolean() || (ch == 15 && !num_channels))
+				masks[num_channels++] = 1 << ch;
+		}
+		for (i = 0; i < num_samples; i++)
+			samples[i] = g_random_int();
+		/* Only enabled channels come back. */
+		n = 0;
+		for (ch = 0; ch < num_channels; ch++)
+			n |= masks[ch];
+		for (i = 0; i < num_samples; i++)
+			samples[i] &= n;
+		encode(samples, num_samples, masks, num_channels, dump);
+		check_dump(dump, 2 * num_samples / 16 * num_channels, samples,
+			num_samples, masks, num_channels,
+			2 * g_random_int_range(1, 200), "random");
+	}
+
+	g_free(samples);
+	g_free(dump);
+}
+END_TEST
+
+Suite *suite_private(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("saleae-logic16-convert");
+
+	tc = tcase_create("dumps");
+	tcase_add_test(tc, test_dump_3ch);
+	tcase_add_test(tc, test_dump_sparse);
+	tcase_add_test(tc, test_dump_16ch);
+	tcase_add_test(tc, test_dump_split);
+	tcase_add_test(tc, test_random);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
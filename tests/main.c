@@ -38,14 +38,22 @@ int main(void)
 	srunner_add_suite(srunner, suite_driver_all());
 	srunner_add_suite(srunner, suite_input_all());
 	srunner_add_suite(srunner, suite_input_binary());
+	srunner_add_suite(srunner, suite_input_csv());
+	srunner_add_suite(srunner, suite_input_raw_analog());
+	srunner_add_suite(srunner, suite_input_vcd());
+	srunner_add_suite(srunner, suite_input_wav());
 	srunner_add_suite(srunner, suite_output_all());
+	srunner_add_suite(srunner, suite_output_csv());
 	srunner_add_suite(srunner, suite_transform_all());
 	srunner_add_suite(srunner, suite_session());
+	srunner_add_suite(srunner, suite_session_driver());
 	srunner_add_suite(srunner, suite_strutil());
 	srunner_add_suite(srunner, suite_version());
 	srunner_add_suite(srunner, suite_device());
 	srunner_add_suite(srunner, suite_trigger());
 	srunner_add_suite(srunner, suite_analog());
+	srunner_add_suite(srunner, suite_buffer());
+	srunner_add_suite(srunner, suite_trace());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
@@ -0,0 +1,200 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests for the (Pipistrello) OLS sample decoder. This is a program of
+ * its own, linking ols_decoder.c directly to reach its private functions.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "private.h"
+
+static struct ols_decoder dec;
+
+/* Feed the data to the decoder, at most chunksize bytes per read. */
+static void feed(const uint8_t *data, size_t len, size_t chunksize)
+{
+	uint8_t *buf;
+	size_t n;
+
+	while (len > 0) {
+		buf = ols_decoder_write_ptr(&dec, &n);
+		n = MIN(n, MIN(len, chunksize));
+		memcpy(buf, data, n);
+		ols_decoder_commit(&dec, n);
+		ols_decoder_decode(&dec);
+		data += n;
+		len -= n;
+	}
+}
+
+static void check_samples(const uint32_t *expected, uint64_t num_samples)
+{
+	uint8_t *samples;
+	uint64_t i;
+
+	fail_unless(dec.num_samples == num_samples,
+		"Expected %" PRIu64 " samples, got %" PRIu64 ".",
+		num_samples, dec.num_samples);
+	samples = ols_decoder_samples(&dec);
+	for (i = 0; i < num_samples; i++)
+		fail_unless(RL32(samples + 4 * i) == expected[i],
+			"Sample %" PRIu64 " is 0x%08x, expected 0x%08x.",
+			i, RL32(samples + 4 * i), expected[i]);
+}
+
+/* All groups enabled, in reads of every size. */
+START_TEST(test_plain)
+{
+	static const uint8_t data[] = {
+		0x01, 0x02, 0x03, 0x04, 0x11, 0x12, 0x13, 0x14,
+		0x21, 0x22, 0x23, 0x24,
+	};
+	static const uint32_t expected[] = {
+		0x24232221, 0x14131211, 0x04030201,
+	};
+	size_t chunksize;
+
+	for (chunksize = 1; chunksize <= sizeof(data); chunksize++) {
+		fail_unless(ols_decoder_init(&dec, 0, 0, 3) == SR_OK);
+		feed(data, sizeof(data), chunksize);
+		check_samples(expected, 3);
+		ols_decoder_clear(&dec);
+	}
+}
+END_TEST
+
+/*
+ * Disabled groups are expanded. In demux mode, a disabled group 3 takes
+ * the place of group 1, which then reads as zero.
+ */
+START_TEST(test_groups)
+{
+	static const uint8_t data[] = { 0x01, 0x02, 0x11, 0x12 };
+	static const uint32_t expected[] = { 0x00120011, 0x00020001 };
+	static const uint32_t expected_demux[] = { 0x00000011, 0x00000001 };
+
+	fail_unless(ols_decoder_init(&dec, 0x0a, 0, 2) == SR_OK);
+	feed(data, sizeof(data), sizeof(data));
+	check_samples(expected, 2);
+	ols_decoder_clear(&dec);
+
+	fail_unless(ols_decoder_init(&dec, 0x0c, OLS_DECODER_DEMUX, 2) == SR_OK);
+	feed(data, sizeof(data), sizeof(data));
+	check_samples(expected_demux, 2);
+	ols_decoder_clear(&dec);
+}
+END_TEST
+
+/* Run lengths, with the last run cut off at the sample limit. */
+START_TEST(test_rle)
+{
+	static const uint8_t data[] = {
+		0x03, 0x80, 0x01, 0x00, 0x02, 0x00,
+		0x05, 0x80, 0x03, 0x00, 0x04, 0x00,
+	};
+	static const uint32_t expected[] = {
+		0x03, 0x03, 0x03, 0x03, 0x02, 0x01, 0x01, 0x01, 0x01,
+	};
+	const uint64_t *lengths;
+
+	fail_unless(ols_decoder_init(&dec, 0x0c, OLS_DECODER_RLE, 9) == SR_OK);
+	feed(data, sizeof(data), 5);
+	check_samples(expected, 9);
+	fail_unless(dec.cnt_samples_rle == 13);
+	ols_decoder_clear(&dec);
+
+	fail_unless(ols_decoder_init(&dec, 0x0c,
+			OLS_DECODER_RLE | OLS_DECODER_RUNS, 9) == SR_OK);
+	feed(data, sizeof(data), 5);
+	fail_unless(dec.run_lengths->len == 3);
+	lengths = (const uint64_t *)dec.run_lengths->data;
+	fail_unless(lengths[0] == 4 && lengths[1] == 1 && lengths[2] == 4);
+	fail_unless(RL32(dec.run_samples->data + 8) == 0x03);
+	ols_decoder_clear(&dec);
+}
+END_TEST
+
+/* Pairs of samples, the second one comes first in time. */
+START_TEST(test_pairs)
+{
+	static const uint8_t data[] = {
+		0x01, 0x02, 0x03, 0x04, 0x01, 0x00, 0x00, 0x80,
+		0x11, 0x12, 0x13, 0x14,
+	};
+	static const uint32_t expected[] = {
+		0x1413, 0x1211, 0x1413, 0x1211, 0x0403, 0x0201,
+	};
+
+	fail_unless(ols_decoder_init(&dec, 0x0c,
+			OLS_DECODER_RLE | OLS_DECODER_PAIRS, 6) == SR_OK);
+	feed(data, sizeof(data), 3);
+	check_samples(expected, 6);
+	ols_decoder_clear(&dec);
+}
+END_TEST
+
+/* Units split across the end of the ring buffer. */
+START_TEST(test_wrap)
+{
+	uint8_t *data;
+	uint32_t *expected;
+	uint64_t num_samples, i;
+
+	num_samples = OLS_DECODER_RING_SIZE;
+	data = g_malloc(num_samples * 3);
+	expected = g_malloc(num_samples * 4);
+	for (i = 0; i < num_samples; i++) {
+		data[3 * i] = i & 0xff;
+		data[3 * i + 1] = (i >> 8) & 0xff;
+		data[3 * i + 2] = i >> 16;
+		expected[num_samples - 1 - i] = i;
+	}
+
+	fail_unless(ols_decoder_init(&dec, 0x08, 0, num_samples) == SR_OK);
+	feed(data, num_samples * 3, 1000);
+	check_samples(expected, num_samples);
+	fail_unless(dec.cnt_bytes == num_samples * 3);
+	ols_decoder_clear(&dec);
+
+	g_free(data);
+	g_free(expected);
+}
+END_TEST
+
+Suite *suite_private(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("ols-decoder");
+
+	tc = tcase_create("decode");
+	tcase_add_test(tc, test_plain);
+	tcase_add_test(tc, test_groups);
+	tcase_add_test(tc, test_rle);
+	tcase_add_test(tc, test_pairs);
+	tcase_add_test(tc, test_wrap);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
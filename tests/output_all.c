@@ -20,7 +20,9 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -97,6 +99,445 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+static GString *output_packet_id(const char *id,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet end;
+	GString *out, *chunk;
+	int ret;
+
+	o = sr_output_new(sr_output_find((char *)id), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Couldn't create '%s' output.", id);
+
+	out = g_string_new(NULL);
+	ret = sr_output_send(o, packet, &chunk);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (chunk) {
+		g_string_append_len(out, chunk->str, chunk->len);
+		g_string_free(chunk, TRUE);
+	}
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	ret = sr_output_send(o, &end, &chunk);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (chunk) {
+		g_string_append_len(out, chunk->str, chunk->len);
+		g_string_free(chunk, TRUE);
+	}
+	sr_output_free(o);
+
+	return out;
+}
+
+static GString *output_packet(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	return output_packet_id("bits", sdi, packet);
+}
+
+/*
+ * Check whether run-length encoded logic packets are expanded for output
+ * modules which don't handle them.
+ */
+START_TEST(test_output_logic_rle)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_rle logic_rle;
+	uint8_t samples[] = { 0x01, 0x02, 0x02, 0x83 };
+	uint64_t lengths[] = { 5, 100, 0, 3 };
+	uint8_t data[108];
+	GString *plain, *rle;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	memset(data, 0x01, 5);
+	memset(data + 5, 0x02, 100);
+	memset(data + 105, 0x83, 3);
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	plain = output_packet(sdi, &packet);
+
+	logic_rle.num_runs = 4;
+	logic_rle.unitsize = 1;
+	logic_rle.samples = samples;
+	logic_rle.lengths = lengths;
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &logic_rle;
+	rle = output_packet(sdi, &packet);
+
+	fail_unless(plain->len > 0);
+	fail_unless(g_string_equal(plain, rle), "Expanded output differs.");
+
+	g_string_free(plain, TRUE);
+	g_string_free(rle, TRUE);
+	srtest_dev_inst_free(sdi);
+}
+END_TEST
+
+enum {
+	VIA_SEND,
+	VIA_BUFFER,
+	VIA_FD,
+};
+
+/*
+ * Send packets and an SR_DF_END to a new output, through sr_output_send(),
+ * a sink gathering the output in a string or a sink writing it to a file.
+ * Returns all of the output.
+ */
+static GString *output_packets_via(int via, const char *id,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packets, int num_packets)
+{
+	const struct sr_output *o;
+	const struct sr_datafeed_packet *packet;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet end;
+	GString *out, *chunk;
+	char *filename, *contents;
+	gsize len;
+	int fd, i;
+
+	o = sr_output_new(sr_output_find((char *)id), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Couldn't create '%s' output.", id);
+
+	out = NULL;
+	sink = NULL;
+	filename = NULL;
+	fd = -1;
+	if (via == VIA_SEND) {
+		out = g_string_new(NULL);
+	} else if (via == VIA_BUFFER) {
+		sink = sr_output_sink_new();
+	} else {
+		fd = g_file_open_tmp("output-XXXXXX", &filename, NULL);
+		fail_unless(fd >= 0, "Failed to create temporary file.");
+		sink = sr_output_sink_new_fd(fd);
+		fail_unless(sink != NULL);
+	}
+
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	for (i = 0; i <= num_packets; i++) {
+		packet = i < num_packets ? &packets[i] : &end;
+		if (via != VIA_SEND) {
+			fail_unless(sr_output_send_sink(o, packet, sink) == SR_OK);
+			continue;
+		}
+		chunk = NULL;
+		fail_unless(sr_output_send(o, packet, &chunk) == SR_OK);
+		if (chunk) {
+			g_string_append_len(out, chunk->str, chunk->len);
+			g_string_free(chunk, TRUE);
+		}
+	}
+	sr_output_free(o);
+
+	if (via == VIA_BUFFER) {
+		chunk = sr_output_sink_buffer_get(sink);
+		out = g_string_new_len(chunk->str, chunk->len);
+		fail_unless(sr_output_sink_free(sink) == SR_OK);
+	} else if (via == VIA_FD) {
+		/* SR_DF_END wrote everything. */
+		fail_unless(sr_output_sink_buffer_get(sink)->len == 0);
+		fail_unless(sr_output_sink_free(sink) == SR_OK);
+		g_close(fd, NULL);
+		fail_unless(g_file_get_contents(filename, &contents, &len, NULL));
+		out = g_string_new_len(contents, len);
+		g_free(contents);
+		g_unlink(filename);
+		g_free(filename);
+	}
+
+	return out;
+}
+
+/* The output after its header, which has a timestamp or version in it. */
+static const char *output_body(const char *id, const GString *out)
+{
+	const char *body;
+	int i;
+
+	body = out->str;
+	if (!strcmp(id, "vcd")) {
+		body = strstr(body, "$enddefinitions $end\n");
+		fail_unless(body != NULL, "No VCD header found.");
+		body += strlen("$enddefinitions $end\n");
+	} else if (!strcmp(id, "csv")) {
+		while (*body == ';')
+			body = strchr(body, '\n') + 1;
+	} else if (!strcmp(id, "bits")) {
+		for (i = 0; i < 2; i++)
+			body = strchr(body, '\n') + 1;
+	}
+
+	return body;
+}
+
+static struct sr_dev_inst *logic_sdi_new(int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < num_channels; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+/*
+ * Check the output of logic data split over two packets, through
+ * sr_output_send() and both kinds of sink, against fixed expected output.
+ */
+START_TEST(test_output_sink_logic)
+{
+	static const struct {
+		const char *id;
+		const char *expected;
+	} cases[] = {
+		{ "vcd", "#0 0! 0\" 0# 0$\n#1 1!\n#3 1\"\n#4 0!\n"
+			"#6 1! 1# 1$\n#7 0! 0\" 0# 0$\n#8\n" },
+		{ "csv", "0,0,0,0\n1,0,0,0\n1,0,0,0\n1,1,0,0\n"
+			"0,1,0,0\n0,1,0,0\n1,1,1,1\n0,0,0,0\n" },
+		{ "bits", "D0:01110010 \nD1:00011110 \n"
+			"D2:00000010 \nD3:00000010 \n" },
+	};
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packets[2];
+	struct sr_datafeed_logic logic[2];
+	uint8_t data[] = { 0x0, 0x1, 0x1, 0x3, 0x2, 0x2, 0xf, 0x0 };
+	const char *body;
+	GString *out;
+	unsigned int i;
+	int via;
+
+	sdi = logic_sdi_new(4);
+	for (i = 0; i < 2; i++) {
+		logic[i].length = 4;
+		logic[i].unitsize = 1;
+		logic[i].data = data + i * 4;
+		packets[i].type = SR_DF_LOGIC;
+		packets[i].payload = &logic[i];
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		for (via = VIA_SEND; via <= VIA_FD; via++) {
+			out = output_packets_via(via, cases[i].id, sdi, packets, 2);
+			body = output_body(cases[i].id, out);
+			fail_unless(!strcmp(body, cases[i].expected),
+				"Wrong '%s' output (%d):\n%s", cases[i].id, via, body);
+			g_string_free(out, TRUE);
+		}
+	}
+
+	srtest_dev_inst_free(sdi);
+}
+END_TEST
+
+/*
+ * Check the WAV output of two channels. The second packet doesn't fit in
+ * the channel buffers next to the samples still waiting from the first,
+ * the last one is only written at the end.
+ */
+START_TEST(test_output_sink_wav)
+{
+	static const uint8_t header[] = {
+		'R', 'I', 'F', 'F', 0xff, 0xff, 0xff, 0xff,
+		'W', 'A', 'V', 'E',
+		'f', 'm', 't', ' ', 0x12, 0x00, 0x00, 0x00,
+		/* IEEE float, 2 channels, 1 kHz, 8000 bytes/s. */
+		0x03, 0x00, 0x02, 0x00, 0xe8, 0x03, 0x00, 0x00,
+		0x40, 0x1f, 0x00, 0x00,
+		/* 8 bytes per frame, 32 bits per sample. */
+		0x08, 0x00, 0x20, 0x00, 0x00, 0x00,
+		'd', 'a', 't', 'a', 0xff, 0xff, 0xff, 0xff,
+	};
+	static const int frames[] = { 5, 150, 3 };
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packets[4];
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	struct sr_datafeed_analog analog[3];
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float data[158 * 2];
+	uint8_t expected[sizeof(header) + sizeof(data)], *p;
+	uint32_t bits;
+	GString *out;
+	unsigned int i, pos;
+	int via;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A1");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(1000));
+	meta.config = g_slist_append(NULL, &src);
+	packets[0].type = SR_DF_META;
+	packets[0].payload = &meta;
+
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.channels = sr_dev_inst_channels_get(sdi);
+
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = i * 0.25 - 10;
+	for (i = 0, pos = 0; i < G_N_ELEMENTS(frames); i++) {
+		analog[i].data = data + pos * 2;
+		analog[i].num_samples = frames[i];
+		analog[i].encoding = &encoding;
+		analog[i].meaning = &meaning;
+		analog[i].spec = &spec;
+		packets[i + 1].type = SR_DF_ANALOG;
+		packets[i + 1].payload = &analog[i];
+		pos += frames[i];
+	}
+
+	/* The header, then the samples as they came in little-endian. */
+	memcpy(expected, header, sizeof(header));
+	p = expected + sizeof(header);
+	for (i = 0; i < G_N_ELEMENTS(data); i++) {
+		memcpy(&bits, &data[i], sizeof(bits));
+		*p++ = bits & 0xff;
+		*p++ = (bits >> 8) & 0xff;
+		*p++ = (bits >> 16) & 0xff;
+		*p++ = bits >> 24;
+	}
+
+	for (via = VIA_SEND; via <= VIA_FD; via++) {
+		out = output_packets_via(via, "wav", sdi, packets, 4);
+		fail_unless(out->len == sizeof(expected),
+			"Got %d bytes of output (%d).", (int)out->len, via);
+		fail_unless(!memcmp(out->str, expected, sizeof(expected)),
+			"Wrong output (%d).", via);
+		g_string_free(out, TRUE);
+	}
+
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+	srtest_dev_inst_free(sdi);
+}
+END_TEST
+
+/*
+ * Check the VCD output of run-length encoded logic packets, which the
+ * module takes without expansion. Empty runs and runs repeating the
+ * previous sample, also across packets, don't write anything.
+ */
+START_TEST(test_output_vcd_rle)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packets[2];
+	struct sr_datafeed_logic_rle logic_rle[2];
+	uint8_t samples0[] = { 0x01, 0x02, 0x02 };
+	uint64_t lengths0[] = { 5, 100, 0 };
+	uint8_t samples1[] = { 0x02, 0x83 };
+	uint64_t lengths1[] = { 7, 3 };
+	const char *body;
+	GString *out;
+	int via;
+
+	sdi = logic_sdi_new(8);
+	logic_rle[0].num_runs = 3;
+	logic_rle[0].unitsize = 1;
+	logic_rle[0].samples = samples0;
+	logic_rle[0].lengths = lengths0;
+	logic_rle[1].num_runs = 2;
+	logic_rle[1].unitsize = 1;
+	logic_rle[1].samples = samples1;
+	logic_rle[1].lengths = lengths1;
+	packets[0].type = packets[1].type = SR_DF_LOGIC_RLE;
+	packets[0].payload = &logic_rle[0];
+	packets[1].payload = &logic_rle[1];
+
+	for (via = VIA_SEND; via <= VIA_FD; via++) {
+		out = output_packets_via(via, "vcd", sdi, packets, 2);
+		body = output_body("vcd", out);
+		fail_unless(!strcmp(body,
+			"#0 1! 0\" 0# 0$ 0% 0& 0' 0(\n"
+			"#5 0! 1\"\n"
+			"#112 1! 1(\n"
+			"#115\n"), "Wrong output (%d):\n%s", via, body);
+		g_string_free(out, TRUE);
+	}
+
+	srtest_dev_inst_free(sdi);
+}
+END_TEST
+
+/*
+ * Check whether output sent to a sink, either gathered in a string or
+ * written to a file, is the same as that of sr_output_send(). There's
+ * enough of it to have the file sink write more than once.
+ */
+START_TEST(test_output_sink)
+{
+	static const char *ids[] = { "vcd", "csv", "bits", "hex", "ascii" };
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *expected, *out;
+	uint8_t data[100000];
+	unsigned int i;
+	int via;
+
+	sdi = logic_sdi_new(8);
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7 + (i >> 8);
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+		expected = output_packets_via(VIA_SEND, ids[i], sdi, &packet, 1);
+		fail_unless(expected->len > 256 * 1024);
+		for (via = VIA_BUFFER; via <= VIA_FD; via++) {
+			out = output_packets_via(via, ids[i], sdi, &packet, 1);
+			fail_unless(!strcmp(output_body(ids[i], out),
+				output_body(ids[i], expected)),
+				"Output of '%s' differs (%d).", ids[i], via);
+			g_string_free(out, TRUE);
+		}
+		g_string_free(expected, TRUE);
+	}
+
+	fail_unless(sr_output_sink_new_fd(-1) == NULL);
+	fail_unless(sr_output_send_sink(NULL, &packet, NULL) == SR_ERR_ARG);
+
+	srtest_dev_inst_free(sdi);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -113,5 +554,16 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("logic_rle");
+	tcase_add_test(tc, test_output_logic_rle);
+	tcase_add_test(tc, test_output_vcd_rle);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sink");
+	tcase_add_test(tc, test_output_sink_logic);
+	tcase_add_test(tc, test_output_sink_wav);
+	tcase_add_test(tc, test_output_sink);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
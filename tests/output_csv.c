@@ -0,0 +1,235 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static struct sr_dev_inst *logic_sdi_new(int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < num_channels; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+/*
+ * Send the packets and an SR_DF_END packet to the CSV output module, and
+ * return the output without the comment lines of the header.
+ */
+static char *output_packets(const struct sr_dev_inst *sdi,
+		GHashTable *options, const struct sr_datafeed_packet *packets,
+		int num_packets)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet end;
+	GString *out, *chunk;
+	const char *body;
+	char *ret;
+	int i;
+
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "Couldn't create 'csv' output.");
+
+	out = g_string_new(NULL);
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	for (i = 0; i <= num_packets; i++) {
+		chunk = NULL;
+		fail_unless(sr_output_send(o, i < num_packets ? &packets[i] : &end,
+				&chunk) == SR_OK, "sr_output_send() failed.");
+		if (chunk) {
+			g_string_append_len(out, chunk->str, chunk->len);
+			g_string_free(chunk, TRUE);
+		}
+	}
+	sr_output_free(o);
+
+	body = out->str;
+	while (*body == ';')
+		body = strchr(body, '\n') + 1;
+	ret = g_strdup(body);
+	g_string_free(out, TRUE);
+
+	return ret;
+}
+
+/* Check logic rows, with a disabled channel and channels in two bytes. */
+START_TEST(test_output_csv_logic)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t data[] = { 0x01, 0x02, 0xfe, 0x03, 0x00, 0x00 };
+	char *out;
+
+	sdi = logic_sdi_new(10);
+	sr_dev_channel_enable(g_slist_nth_data(sr_dev_inst_channels_get(sdi), 2),
+			FALSE);
+
+	logic.length = sizeof(data);
+	logic.unitsize = 2;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	out = output_packets(sdi, NULL, &packet, 1);
+
+	fail_unless(!strcmp(out,
+		"1,0,0,0,0,0,0,0,1\n"
+		"0,1,1,1,1,1,1,1,1\n"
+		"0,0,0,0,0,0,0,0,0\n"), "Wrong output:\n%s", out);
+	g_free(out);
+}
+END_TEST
+
+/*
+ * Check that only changed samples are written with the "changes" option,
+ * across packets, and that the last sample is always written.
+ */
+START_TEST(test_output_csv_changes)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packets[2];
+	struct sr_datafeed_logic logic[2];
+	uint8_t data0[] = { 0x01, 0x01, 0x03 };
+	uint8_t data1[] = { 0x0b, 0x03, 0x05, 0x05 };
+	GHashTable *options;
+	char *out;
+
+	sdi = logic_sdi_new(3);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("changes"),
+			g_variant_ref_sink(g_variant_new_boolean(TRUE)));
+
+	logic[0].length = sizeof(data0);
+	logic[0].unitsize = 1;
+	logic[0].data = data0;
+	logic[1].length = sizeof(data1);
+	logic[1].unitsize = 1;
+	logic[1].data = data1;
+	packets[0].type = packets[1].type = SR_DF_LOGIC;
+	packets[0].payload = &logic[0];
+	packets[1].payload = &logic[1];
+	out = output_packets(sdi, options, packets, 2);
+
+	/* 0x0b only differs from 0x03 in a channel that doesn't exist. */
+	fail_unless(!strcmp(out,
+		"0,1,0,0\n"
+		"2,1,1,0\n"
+		"5,1,0,1\n"
+		"6,1,0,1\n"), "Wrong output:\n%s", out);
+	g_free(out);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/* Check that analog values are written with the shortest exact text. */
+START_TEST(test_output_csv_analog)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float data[1000];
+	char *out, *line, *end;
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	analog.data = data;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.channels = sr_dev_inst_channels_get(sdi);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	data[0] = 0.1;
+	data[1] = -2.5;
+	data[2] = 1.0 / 3;
+	data[3] = 1e-7;
+	data[4] = 100;
+	data[5] = 3.4028235e38;
+	data[6] = 0.0001;
+	data[7] = 123456792;
+	analog.num_samples = 8;
+	out = output_packets(sdi, NULL, &packet, 1);
+	fail_unless(!strcmp(out, "0.1\n-2.5\n0.33333334\n1e-07\n100\n"
+		"3.4028235e+38\n0.0001\n123456790\n"), "Wrong output:\n%s", out);
+	g_free(out);
+
+	/* Random values must read back exactly. */
+	srand(1);
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = ldexp(rand() - RAND_MAX / 2, rand() % 200 - 130);
+	analog.num_samples = G_N_ELEMENTS(data);
+	out = output_packets(sdi, NULL, &packet, 1);
+	line = out;
+	for (i = 0; i < G_N_ELEMENTS(data); i++) {
+		fail_unless((float)g_ascii_strtod(line, &end) == data[i],
+			"Value %g was written as %.*s.", data[i],
+			(int)(end - line), line);
+		fail_unless(*end == '\n');
+		line = end + 1;
+	}
+	g_free(out);
+}
+END_TEST
+
+Suite *suite_output_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_csv_logic);
+	tcase_add_test(tc, test_output_csv_changes);
+	tcase_add_test(tc, test_output_csv_analog);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
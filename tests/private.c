@@ -0,0 +1,44 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Library sources log through sr_log() and sr_cur_loglevel, which
+ * libsigrok doesn't export. Warnings and errors go to stderr.
+ */
+
+#include <config.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+SR_PRIV int sr_cur_loglevel = SR_LOG_WARN;
+
+SR_PRIV int sr_log(int loglevel, const char *format, ...)
+{
+	va_list args;
+
+	if (loglevel > SR_LOG_WARN)
+		return SR_OK;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+
+	return SR_OK;
+}
@@ -0,0 +1,32 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Shared by the test programs which link library sources directly, to
+ * reach their private functions.
+ */
+
+#ifndef LIBSIGROK_TESTS_PRIVATE_H
+#define LIBSIGROK_TESTS_PRIVATE_H
+
+#include <check.h>
+
+/* The suite of the program, run by private_main.c. */
+Suite *suite_private(void);
+
+#endif
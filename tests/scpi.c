@@ -0,0 +1,449 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Tests for reading SCPI responses, through a mock transport which answers
+ * commands with canned responses. This is a program of its own, linking
+ * scpi.c directly to reach its private functions.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+#include "scpi_mock.h"
+#include "private.h"
+
+/* A block with the bytes of a terminator and a header in its data. */
+static const char block_response[] = "#214ab\n#1x\r\n\0\xff" "0123\n";
+static const char block_data[] = "ab\n#1x\r\n\0\xff" "0123";
+
+/* Read a block in reads of every size, with and without stalls. */
+START_TEST(test_block)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block;
+	char *str;
+	int max_read;
+
+	for (max_read = 1; max_read <= (int)sizeof(block_response); max_read++) {
+		scpi = mock_new(max_read, max_read % 2);
+		mock_respond("WAV:DATA?", block_response,
+				sizeof(block_response) - 1);
+		mock_respond("*OPC?", "1\n", 2);
+
+		block = NULL;
+		fail_unless(sr_scpi_get_block(scpi, "WAV:DATA?", &block) == SR_OK,
+			"Reading failed (max_read %d).", max_read);
+		fail_unless(block->len == sizeof(block_data) - 1,
+			"Block has %u bytes (max_read %d).", block->len, max_read);
+		fail_unless(!memcmp(block->data, block_data, block->len),
+			"Wrong block data (max_read %d).", max_read);
+
+		/* The terminator is gone, the next response reads fine. */
+		fail_unless(mock.pos == mock.output->len);
+		fail_unless(sr_scpi_get_string(scpi, "*OPC?", &str) == SR_OK);
+		fail_unless(!strcmp(str, "1"));
+		g_free(str);
+
+		g_byte_array_free(block, TRUE);
+		mock_free(scpi);
+	}
+}
+END_TEST
+
+/* Large blocks are read in one piece, into a reused array. */
+START_TEST(test_block_large)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block, *response;
+	guint8 *data;
+	unsigned int i, len;
+
+	len = 1000000;
+	response = g_byte_array_new();
+	g_byte_array_append(response, (const guint8 *)"#71000000", 9);
+	g_byte_array_set_size(response, 9 + len + 1);
+	for (i = 0; i < len; i++)
+		response->data[9 + i] = i * 7;
+	response->data[9 + len] = '\n';
+
+	scpi = mock_new(G_MAXINT, FALSE);
+	mock_respond("CURV?", response->data, response->len);
+
+	block = NULL;
+	fail_unless(sr_scpi_get_block(scpi, "CURV?", &block) == SR_OK);
+	fail_unless(block->len == len);
+	fail_unless(!memcmp(block->data, response->data + 9, len));
+	fail_unless(mock.largest_read == (int)len,
+		"Largest read was %d bytes.", mock.largest_read);
+	fail_unless(mock.num_reads <= 4, "Read in %d pieces.", mock.num_reads);
+
+	data = block->data;
+	fail_unless(sr_scpi_get_block(scpi, "CURV?", &block) == SR_OK);
+	fail_unless(block->len == len);
+	fail_unless(block->data == data, "The array was not reused.");
+
+	g_byte_array_free(block, TRUE);
+	g_byte_array_free(response, TRUE);
+	mock_free(scpi);
+}
+END_TEST
+
+/* An indefinite length block takes up the rest of the response. */
+START_TEST(test_block_indefinite)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block;
+
+	scpi = mock_new(3, FALSE);
+	mock_respond("DATA?", "#0abcdefg\n", 10);
+
+	block = NULL;
+	fail_unless(sr_scpi_get_block(scpi, "DATA?", &block) == SR_OK);
+	fail_unless(block->len == 7 && !memcmp(block->data, "abcdefg", 7));
+
+	g_byte_array_free(block, TRUE);
+	mock_free(scpi);
+}
+END_TEST
+
+/* Responses which aren't blocks, or are cut short. */
+START_TEST(test_block_invalid)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block;
+
+	scpi = mock_new(4, FALSE);
+	mock_respond("TEXT?", "1.5E-3\n", 7);
+	mock_respond("LEN?", "#3x00abc\n", 9);
+	mock_respond("SHORT?", "#210abc", 7);
+	mock_respond("HUGE?", "#9999999999abc", 14);
+
+	block = NULL;
+	fail_unless(sr_scpi_get_block(scpi, "TEXT?", &block) == SR_ERR_DATA);
+	fail_unless(mock.pos == mock.output->len,
+		"The rest of the response was not read.");
+	fail_unless(sr_scpi_get_block(scpi, "LEN?", &block) == SR_ERR_DATA);
+	fail_unless(mock.pos == mock.output->len,
+		"The rest of the response was not read.");
+	fail_unless(sr_scpi_get_block(scpi, "SHORT?", &block) == SR_ERR_TIMEOUT);
+	/* A corrupt length only allocates as much as has been received. */
+	fail_unless(sr_scpi_get_block(scpi, "HUGE?", &block) == SR_ERR_TIMEOUT);
+	fail_unless(block->len <= 1024 * 1024,
+		"Allocated %u bytes for a short block.", block->len);
+
+	g_byte_array_free(block, TRUE);
+	mock_free(scpi);
+}
+END_TEST
+
+/* Text responses longer than a single read. */
+START_TEST(test_string)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GString *response;
+	char *str;
+	int i;
+
+	response = g_string_new(NULL);
+	for (i = 0; i < 5000; i++)
+		g_string_append_printf(response, "%d,", i);
+	g_string_append(response, "end\r\n");
+
+	scpi = mock_new(1000, TRUE);
+	mock_respond("LIST?", response->str, response->len);
+
+	fail_unless(sr_scpi_get_string(scpi, "LIST?", &str) == SR_OK);
+	fail_unless(strlen(str) == response->len - 2);
+	fail_unless(!strncmp(str, response->str, response->len - 2));
+	g_free(str);
+
+	g_string_free(response, TRUE);
+	mock_free(scpi);
+}
+END_TEST
+
+/* Queries are batched, into as few messages as fit. */
+START_TEST(test_strings)
+{
+	struct sr_scpi_dev_inst *scpi;
+	char *commands[41], *responses[41], reply[16];
+	int i;
+
+	scpi = mock_new(64, FALSE);
+	for (i = 0; i < 40; i++) {
+		commands[i] = g_strdup_printf("CHAN%d:STAT?", i);
+		g_snprintf(reply, sizeof(reply), "%d\n", i % 2);
+		mock_respond(commands[i], reply, strlen(reply));
+	}
+	commands[40] = g_strdup("*IDN?");
+	mock_respond("*IDN?", "\"a;b\",'c;d',e\n", 14);
+
+	fail_unless(sr_scpi_get_strings(scpi, (const char *const *)commands,
+			41, responses) == SR_OK);
+	for (i = 0; i < 40; i++)
+		fail_unless(!strcmp(responses[i], i % 2 ? "1" : "0"),
+			"Reply %d is '%s'.", i, responses[i]);
+	fail_unless(!strcmp(responses[40], "\"a;b\",'c;d',e"),
+		"Reply 40 is '%s'.", responses[40]);
+	fail_unless(mock.num_messages == 3,
+		"Took %d round trips.", mock.num_messages);
+	fail_unless(!scpi->no_compound_queries);
+
+	for (i = 0; i < 41; i++) {
+		g_free(commands[i]);
+		g_free(responses[i]);
+	}
+	mock_free(scpi);
+}
+END_TEST
+
+/* Devices without compound queries get the queries one by one. */
+START_TEST(test_strings_no_compound)
+{
+	struct sr_scpi_dev_inst *scpi;
+	const char *commands[] = { "VOLT?", "CURR?", ":OUTP?" };
+	char *responses[3];
+	int i, num_messages;
+
+	scpi = mock_new(64, FALSE);
+	mock.no_compound = TRUE;
+	mock_respond("VOLT?", "1.5\n", 4);
+	mock_respond("CURR?", "0.25\n", 5);
+	mock_respond(":OUTP?", "ON\n", 3);
+	mock_respond("OUTP?", "ON\n", 3);
+
+	for (num_messages = 4; num_messages >= 3; num_messages--) {
+		mock.num_messages = 0;
+		fail_unless(sr_scpi_get_strings(scpi, commands, 3,
+				responses) == SR_OK);
+		fail_unless(!strcmp(responses[0], "1.5"));
+		fail_unless(!strcmp(responses[1], "0.25"));
+		fail_unless(!strcmp(responses[2], "ON"));
+		fail_unless(scpi->no_compound_queries);
+		/* Only the first call tries a compound query. */
+		fail_unless(mock.num_messages == num_messages,
+			"Took %d round trips.", mock.num_messages);
+		for (i = 0; i < 3; i++)
+			g_free(responses[i]);
+	}
+
+	mock_free(scpi);
+}
+END_TEST
+
+/* Replies on a line each are taken in, leaving nothing pending. */
+START_TEST(test_strings_split)
+{
+	struct sr_scpi_dev_inst *scpi;
+	const char *commands[] = { "VOLT?", "CURR?", "OUTP?" };
+	char *responses[3], *response;
+	int i;
+
+	scpi = mock_new(64, TRUE);
+	mock.split_compound = TRUE;
+	mock_respond("VOLT?", "1.5\n", 4);
+	mock_respond("CURR?", "0.25\n", 5);
+	mock_respond("OUTP?", "ON\n", 3);
+
+	fail_unless(sr_scpi_get_strings(scpi, commands, 3, responses) == SR_OK);
+	fail_unless(!strcmp(responses[0], "1.5"));
+	fail_unless(!strcmp(responses[1], "0.25"));
+	fail_unless(!strcmp(responses[2], "ON"));
+	fail_unless(mock.num_messages == 1,
+		"Took %d round trips.", mock.num_messages);
+	fail_unless(!scpi->no_compound_queries);
+	for (i = 0; i < 3; i++)
+		g_free(responses[i]);
+
+	fail_unless(sr_scpi_get_string(scpi, "CURR?", &response) == SR_OK);
+	fail_unless(!strcmp(response, "0.25"), "Got '%s'.", response);
+	g_free(response);
+
+	mock_free(scpi);
+}
+END_TEST
+
+/* Devices which don't answer compound queries, or fail to, fall back. */
+START_TEST(test_strings_no_reply)
+{
+	struct sr_scpi_dev_inst *scpi;
+	const char *commands[] = { "VOLT?", "CURR?", "OUTP?" };
+	char *responses[3];
+	int i, fail;
+
+	for (fail = 0; fail <= 1; fail++) {
+		scpi = mock_new(64, FALSE);
+		mock.ignore_compound = !fail;
+		mock.fail_compound = fail;
+		mock_respond("VOLT?", "1.5\n", 4);
+		mock_respond("CURR?", "0.25\n", 5);
+		mock_respond("OUTP?", "ON\n", 3);
+
+		fail_unless(sr_scpi_get_strings(scpi, commands, 3,
+				responses) == SR_OK);
+		fail_unless(!strcmp(responses[0], "1.5"));
+		fail_unless(!strcmp(responses[1], "0.25"));
+		fail_unless(!strcmp(responses[2], "ON"));
+		fail_unless(scpi->no_compound_queries);
+		fail_unless(mock.num_messages == 4,
+			"Took %d round trips.", mock.num_messages);
+		for (i = 0; i < 3; i++)
+			g_free(responses[i]);
+
+		mock_free(scpi);
+	}
+}
+END_TEST
+
+/* Check a list of floats against strtod(), in reads of every size. */
+static void check_floatv(const char *response, gboolean valid)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GArray *data;
+	gchar **tokens;
+	float *values;
+	int max_read, len, num_values, i;
+
+	len = strlen(response);
+	tokens = g_strsplit(response, ",", 0);
+	values = g_malloc(g_strv_length(tokens) * sizeof(float));
+	num_values = 0;
+	for (i = 0; tokens[i]; i++) {
+		g_strchomp(tokens[i]);
+		if (sr_atof_ascii(tokens[i], &values[num_values]) == SR_OK)
+			num_values++;
+	}
+
+	for (max_read = 1; max_read <= len; max_read += 1 + max_read / 8) {
+		scpi = mock_new(max_read, FALSE);
+		mock_respond("CURV?", response, len);
+		data = NULL;
+		fail_unless(sr_scpi_get_floatv(scpi, "CURV?", &data)
+				== (valid ? SR_OK : SR_ERR_DATA),
+			"Wrong result (max_read %d).", max_read);
+		fail_unless(data && (int)data->len == num_values,
+			"Expected %d values (max_read %d).", num_values, max_read);
+		for (i = 0; i < num_values; i++)
+			fail_unless(g_array_index(data, float, i) == values[i],
+				"Value %d is %g, expected %g.", i,
+				g_array_index(data, float, i), values[i]);
+		g_array_free(data, TRUE);
+		mock_free(scpi);
+	}
+
+	g_free(values);
+	g_strfreev(tokens);
+}
+
+/* Lists of floats are parsed as they are read. */
+START_TEST(test_floatv)
+{
+	GString *response;
+	int i;
+
+	check_floatv("1.5,-2.5E-3,+4e2,.25,0.1,1.,-0,7\r\n", TRUE);
+	check_floatv("9.91E37,1e-30,123456789012345678,3.4028235e38,"
+		" 0.3333333333333333333\n", TRUE);
+	check_floatv("1,x,2e,3\n", FALSE);
+
+	/* Values as instruments send them. */
+	response = g_string_new(NULL);
+	srand(1);
+	for (i = 0; i < 1000; i++)
+		g_string_append_printf(response, "%s%.*E", i ? "," : "",
+			rand() % 8, ldexp(rand() - RAND_MAX / 2, rand() % 60 - 50));
+	g_string_append_c(response, '\n');
+	check_floatv(response->str, TRUE);
+	g_string_free(response, TRUE);
+}
+END_TEST
+
+START_TEST(test_uint8v)
+{
+	struct sr_scpi_dev_inst *scpi;
+	GArray *data;
+	const char response[] = "0,255, 17,3\n";
+	static const uint8_t expected[] = { 0, 255, 17, 3 };
+	int max_read;
+
+	for (max_read = 1; max_read <= (int)sizeof(response); max_read++) {
+		scpi = mock_new(max_read, max_read % 2);
+		mock_respond("POD1:DATA?", response, sizeof(response) - 1);
+		mock_respond("POD2:DATA?", "1,x\n", 4);
+		mock_respond("POD3:DATA?", "1,300\n", 6);
+		mock_respond("POD4:DATA?", "1,-1\n", 5);
+
+		data = NULL;
+		fail_unless(sr_scpi_get_uint8v(scpi, "POD1:DATA?", &data) == SR_OK);
+		fail_unless(data->len == sizeof(expected));
+		fail_unless(!memcmp(data->data, expected, sizeof(expected)),
+			"Wrong values (max_read %d).", max_read);
+		g_array_free(data, TRUE);
+
+		fail_unless(sr_scpi_get_uint8v(scpi, "POD2:DATA?", &data)
+				== SR_ERR_DATA);
+		fail_unless(data->len == 1 && data->data[0] == 1);
+		g_array_free(data, TRUE);
+
+		/* Values out of range are rejected, not truncated. */
+		fail_unless(sr_scpi_get_uint8v(scpi, "POD3:DATA?", &data)
+				== SR_ERR_DATA);
+		fail_unless(data->len == 1 && data->data[0] == 1);
+		g_array_free(data, TRUE);
+		fail_unless(sr_scpi_get_uint8v(scpi, "POD4:DATA?", &data)
+				== SR_ERR_DATA);
+		fail_unless(data->len == 1 && data->data[0] == 1);
+		g_array_free(data, TRUE);
+		mock_free(scpi);
+	}
+}
+END_TEST
+
+Suite *suite_private(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("read");
+	tcase_add_test(tc, test_block);
+	tcase_add_test(tc, test_block_large);
+	tcase_add_test(tc, test_block_indefinite);
+	tcase_add_test(tc, test_block_invalid);
+	tcase_add_test(tc, test_string);
+	tcase_add_test(tc, test_floatv);
+	tcase_add_test(tc, test_uint8v);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("batch");
+	tcase_add_test(tc, test_strings);
+	tcase_add_test(tc, test_strings_no_compound);
+	tcase_add_test(tc, test_strings_split);
+	tcase_add_test(tc, test_strings_no_reply);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,191 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * A mock SCPI transport for the tests and benchmarks, with scpi.c linked
+ * in directly.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+#include "scpi_mock.h"
+
+/* scpi.c lists the real transports, which aren't linked in here. */
+SR_PRIV const struct sr_scpi_dev_inst scpi_tcp_raw_dev = { .name = "tcp-raw" };
+SR_PRIV const struct sr_scpi_dev_inst scpi_tcp_rigol_dev = { .name = "tcp-rigol" };
+#ifdef HAVE_LIBUSB_1_0
+SR_PRIV const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev = { .name = "usbtmc" };
+#endif
+#if HAVE_RPC
+SR_PRIV const struct sr_scpi_dev_inst scpi_vxi_dev = { .name = "vxi" };
+#endif
+#ifdef HAVE_LIBREVISA
+SR_PRIV const struct sr_scpi_dev_inst scpi_visa_dev = { .name = "visa" };
+#endif
+#ifdef HAVE_LIBGPIB
+SR_PRIV const struct sr_scpi_dev_inst scpi_libgpib_dev = { .name = "gpib" };
+#endif
+#ifdef HAVE_LIBSERIALPORT
+SR_PRIV const struct sr_scpi_dev_inst scpi_serial_dev = { .name = "serial" };
+#endif
+
+struct mock_scpi mock;
+
+static int mock_send(void *priv, const char *command)
+{
+	struct mock_scpi *m = priv;
+	GByteArray *response;
+	gchar **queries;
+	int i;
+
+	m->num_messages++;
+
+	/* Drop the responses which have been read. */
+	if (m->pos == m->output->len) {
+		g_byte_array_set_size(m->output, 0);
+		m->pos = 0;
+	}
+
+	if (!strchr(command, ';')) {
+		if (!(response = g_hash_table_lookup(m->responses, command)))
+			return SR_ERR;
+		g_byte_array_append(m->output, response->data, response->len);
+		return SR_OK;
+	}
+
+	if (m->ignore_compound)
+		return SR_OK;
+	if (m->fail_compound) {
+		m->read_error = TRUE;
+		return SR_OK;
+	}
+
+	/* Answer compound queries with the replies joined by semicolons. */
+	queries = g_strsplit(command, ";", 0);
+	for (i = 0; queries[i] && !(m->no_compound && i > 0); i++) {
+		response = g_hash_table_lookup(m->responses,
+				queries[i] + (queries[i][0] == ':'));
+		if (!response)
+			continue;
+		if (i > 0)
+			g_byte_array_append(m->output, (const guint8 *)
+					(m->split_compound ? "\n" : ";"), 1);
+		g_byte_array_append(m->output, response->data, response->len - 1);
+	}
+	g_byte_array_append(m->output, (const guint8 *)"\n", 1);
+	g_strfreev(queries);
+
+	return SR_OK;
+}
+
+static int mock_read_begin(void *priv)
+{
+	struct mock_scpi *m = priv;
+
+	m->begin = m->pos;
+
+	return SR_OK;
+}
+
+static int mock_read_data(void *priv, char *buf, int maxlen)
+{
+	struct mock_scpi *m = priv;
+	const guint8 *nl;
+	int len;
+
+	if (m->read_error) {
+		m->read_error = FALSE;
+		return SR_ERR;
+	}
+	if (m->stall && (m->stalled = !m->stalled))
+		return 0;
+
+	len = MIN(MIN(maxlen, m->max_read), (int)(m->output->len - m->pos));
+	if (m->split_compound
+			&& (nl = memchr(m->output->data + m->pos, '\n', len)))
+		len = nl - (m->output->data + m->pos) + 1;
+	memcpy(buf, m->output->data + m->pos, len);
+	m->pos += len;
+	m->num_reads++;
+	m->largest_read = MAX(m->largest_read, len);
+
+	return len;
+}
+
+static int mock_read_complete(void *priv)
+{
+	struct mock_scpi *m = priv;
+
+	/* Nothing has arrived yet, like on a real transport. */
+	if (m->pos == m->begin)
+		return FALSE;
+	if (m->split_compound && m->output->data[m->pos - 1] == '\n')
+		return TRUE;
+
+	return m->pos == m->output->len;
+}
+
+static const struct sr_scpi_dev_inst mock_dev = {
+	.name          = "mock",
+	.prefix        = "mock",
+	.send          = mock_send,
+	.read_begin    = mock_read_begin,
+	.read_data     = mock_read_data,
+	.read_complete = mock_read_complete,
+	.read_timeout_ms = 100,
+};
+
+/* Set up the mock and a device on it. There is only one mock at a time. */
+struct sr_scpi_dev_inst *mock_new(int max_read, gboolean stall)
+{
+	struct sr_scpi_dev_inst *scpi;
+
+	memset(&mock, 0, sizeof(mock));
+	mock.responses = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)g_byte_array_unref);
+	mock.output = g_byte_array_new();
+	mock.max_read = max_read;
+	mock.stall = stall;
+
+	scpi = g_malloc(sizeof(*scpi));
+	*scpi = mock_dev;
+	scpi->priv = &mock;
+
+	return scpi;
+}
+
+void mock_free(struct sr_scpi_dev_inst *scpi)
+{
+	g_hash_table_destroy(mock.responses);
+	g_byte_array_free(mock.output, TRUE);
+	g_free(scpi);
+}
+
+/* Set the response to a command, including its terminator. */
+void mock_respond(const char *command, const void *response, size_t len)
+{
+	GByteArray *r;
+
+	r = g_byte_array_sized_new(len);
+	g_byte_array_append(r, response, len);
+	g_hash_table_insert(mock.responses, g_strdup(command), r);
+}
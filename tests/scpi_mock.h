@@ -0,0 +1,62 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBSIGROK_TESTS_SCPI_MOCK_H
+#define LIBSIGROK_TESTS_SCPI_MOCK_H
+
+#include <glib.h>
+#include "scpi.h"
+
+/*
+ * The mock transport, a small SCPI server. Responses are queued by send(),
+ * and handed out at most max_read bytes per read. With stall set, every
+ * other read returns nothing, like a nonblocking read of a slow device
+ * does. With split_compound set, reads stop at the end of each line, like
+ * on a serial port. The number of messages sent is the number of round trips a real
+ * device would take, which is what dominates the setup time of drivers.
+ */
+struct mock_scpi {
+	GHashTable *responses;
+	GByteArray *output;
+	guint pos;
+	int max_read;
+	gboolean stall;
+	gboolean stalled;
+	/* Only answer the first query of compound messages. */
+	gboolean no_compound;
+	/* Answer each query of compound messages on a line of its own. */
+	gboolean split_compound;
+	/* Don't answer compound messages, so reading them times out. */
+	gboolean ignore_compound;
+	/* Fail the read of the response to compound messages. */
+	gboolean fail_compound;
+	gboolean read_error;
+	/* Start of the response being read. */
+	guint begin;
+	int num_messages;
+	int num_reads;
+	int largest_read;
+};
+
+extern struct mock_scpi mock;
+
+struct sr_scpi_dev_inst *mock_new(int max_read, gboolean stall);
+void mock_free(struct sr_scpi_dev_inst *scpi);
+void mock_respond(const char *command, const void *response, size_t len);
+
+#endif
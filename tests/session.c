@@ -20,6 +20,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -186,6 +187,347 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/* Check whether switching the datafeed bus to asynchronous mode works. */
+START_TEST(test_session_async_set)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_bus_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	/* Synchronous by default, no statistics available. */
+	ret = sr_session_bus_stats_get(sess, &stats);
+	fail_unless(ret == SR_ERR_NA, "sr_session_bus_stats_get() worked.");
+
+	ret = sr_session_async_set(sess, 64, TRUE);
+	fail_unless(ret == SR_OK, "sr_session_async_set() failed: %d.", ret);
+	memset(&stats, 0xff, sizeof(stats));
+	ret = sr_session_bus_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK, "sr_session_bus_stats_get() failed: %d.", ret);
+	fail_unless(stats.queue_depth == 0 && stats.max_queue_depth == 0);
+	fail_unless(stats.queued == 0 && stats.dropped == 0);
+	fail_unless(stats.max_latency == 0);
+
+	/* Back to synchronous mode. */
+	ret = sr_session_async_set(sess, 0, FALSE);
+	fail_unless(ret == SR_OK, "sr_session_async_set() failed: %d.", ret);
+	ret = sr_session_bus_stats_get(sess, &stats);
+	fail_unless(ret == SR_ERR_NA, "sr_session_bus_stats_get() worked.");
+
+	/* Destroying a session with an asynchronous bus must work too. */
+	sr_session_async_set(sess, 16, FALSE);
+	ret = sr_session_destroy(sess);
+	fail_unless(ret == SR_OK, "sr_session_destroy() failed: %d.", ret);
+}
+END_TEST
+
+/* Check whether the datafeed bus functions fail for bogus parameters. */
+START_TEST(test_session_async_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_bus_stats stats;
+
+	ret = sr_session_async_set(NULL, 64, FALSE);
+	fail_unless(ret != SR_OK, "sr_session_async_set(NULL) worked.");
+	ret = sr_session_bus_stats_get(NULL, &stats);
+	fail_unless(ret != SR_OK, "sr_session_bus_stats_get(NULL) worked.");
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_async_set(sess, 64, FALSE);
+	ret = sr_session_bus_stats_get(sess, NULL);
+	fail_unless(ret != SR_OK, "sr_session_bus_stats_get() worked.");
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether the USB event thread can be switched on and off. */
+START_TEST(test_session_usb_thread_set)
+{
+	int ret;
+	struct sr_session *sess;
+
+	ret = sr_session_usb_thread_set(NULL, TRUE);
+	fail_unless(ret != SR_OK, "sr_session_usb_thread_set(NULL) worked.");
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_usb_thread_set(sess, TRUE);
+#ifdef HAVE_LIBUSB_1_0
+	fail_unless(ret == SR_OK, "sr_session_usb_thread_set() failed: %d.", ret);
+#else
+	fail_unless(ret == SR_ERR_NA, "sr_session_usb_thread_set() worked.");
+#endif
+	ret = sr_session_usb_thread_set(sess, FALSE);
+	fail_unless(ret == SR_OK, "sr_session_usb_thread_set() failed: %d.", ret);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+#ifdef HAVE_HW_DEMO
+/* State shared between the producer, the dispatch thread and the test. */
+static GMutex bus_mutex;
+static GCond bus_cond;
+static const struct sr_dev_inst *bus_sdi;
+static GArray *bus_seqs;
+static gboolean bus_hold, bus_blocked, bus_seen_end;
+static gulong bus_delay;
+
+static void bus_datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *p;
+	uint32_t seq;
+	uint64_t i;
+
+	(void)cb_data;
+
+	if (sdi != bus_sdi)
+		return;
+	if (packet->type == SR_DF_END)
+		bus_seen_end = TRUE;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 4, "Got unitsize %u.", logic->unitsize);
+	for (i = 0; i < logic->length; i += 4) {
+		p = (const uint8_t *)logic->data + i;
+		seq = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+		g_array_append_val(bus_seqs, seq);
+	}
+
+	/* Keep the dispatch thread here until the test lets it go. */
+	g_mutex_lock(&bus_mutex);
+	if (bus_hold) {
+		bus_blocked = TRUE;
+		g_cond_broadcast(&bus_cond);
+		while (bus_hold)
+			g_cond_wait(&bus_cond, &bus_mutex);
+	}
+	g_mutex_unlock(&bus_mutex);
+
+	if (bus_delay)
+		g_usleep(bus_delay);
+}
+
+/* Send one sample holding the sequence number seq. */
+static void bus_send(struct sr_input *in, uint32_t seq)
+{
+	GString *gbuf;
+	uint8_t data[4];
+
+	data[0] = seq & 0xff;
+	data[1] = (seq >> 8) & 0xff;
+	data[2] = (seq >> 16) & 0xff;
+	data[3] = seq >> 24;
+	gbuf = g_string_new_len((const gchar *)data, sizeof(data));
+	fail_unless(sr_input_send(in, gbuf) == SR_OK);
+	g_string_free(gbuf, TRUE);
+}
+
+struct bus_producer {
+	struct sr_input *in;
+	uint32_t count;
+	gboolean wait_blocked;
+};
+
+static gpointer bus_producer_thread(gpointer data)
+{
+	struct bus_producer *prod;
+	uint32_t seq;
+
+	prod = data;
+	for (seq = 0; seq < prod->count; seq++) {
+		bus_send(prod->in, seq);
+		if (seq > 0 || !prod->wait_blocked)
+			continue;
+		/* Fill the queue only once the first packet is being delivered. */
+		g_mutex_lock(&bus_mutex);
+		while (!bus_blocked)
+			g_cond_wait(&bus_cond, &bus_mutex);
+		g_mutex_unlock(&bus_mutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * Start a session with an asynchronous bus, anchored by a demo device,
+ * and add a binary input instance to it that the test can feed from
+ * another thread.
+ */
+static struct sr_session *bus_session_new(uint32_t queue_size, gboolean drop,
+		struct sr_input **in)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_config src[2];
+	GSList *options, *devices;
+	GHashTable *opts;
+	GString *gbuf;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_new_int32(8);
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_new_int32(0);
+	options = g_slist_append(g_slist_append(NULL, &src[0]), &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	/* Keep the demo device quiet, it's only there to start the session. */
+	ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_HZ(1)));
+	fail_unless(ret == SR_OK, "Setting the samplerate failed: %d.", ret);
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(32)));
+	*in = sr_input_new(sr_input_find("binary"), opts);
+	g_hash_table_destroy(opts);
+	fail_unless(*in != NULL, "Failed to create input instance.");
+	/* The first chunk only makes the device instance ready. */
+	gbuf = g_string_new(NULL);
+	fail_unless(sr_input_send(*in, gbuf) == SR_OK);
+	g_string_free(gbuf, TRUE);
+	bus_sdi = sr_input_dev_inst_get(*in);
+
+	bus_seqs = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+	bus_hold = bus_blocked = bus_seen_end = FALSE;
+	bus_delay = 0;
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, bus_datafeed_in, NULL);
+	ret = sr_session_async_set(sess, queue_size, drop);
+	fail_unless(ret == SR_OK, "sr_session_async_set() failed: %d.", ret);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_dev_add(sess, (struct sr_dev_inst *)bus_sdi);
+	fail_unless(ret == SR_OK, "sr_session_dev_add() failed: %d.", ret);
+
+	return sess;
+}
+
+/* End the input, stop the session and wait for the bus to drain. */
+static void bus_session_end(struct sr_session *sess, struct sr_input *in)
+{
+	fail_unless(sr_input_end(in) == SR_OK);
+	fail_unless(sr_session_stop(sess) == SR_OK);
+	fail_unless(sr_session_run(sess) == SR_OK);
+	fail_unless(bus_seen_end, "No SR_DF_END was delivered.");
+}
+
+static void bus_session_free(struct sr_session *sess, struct sr_input *in)
+{
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_array_free(bus_seqs, TRUE);
+}
+
+/*
+ * Check that a full queue in drop mode drops exactly the packets that
+ * don't fit, and delivers the others in order.
+ */
+START_TEST(test_session_async_drop)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct sr_session_bus_stats stats;
+	struct bus_producer prod;
+	GThread *thread;
+	uint32_t i;
+	const uint32_t queue_size = 8, drops = 5;
+
+	sess = bus_session_new(queue_size, TRUE, &in);
+	bus_hold = TRUE;
+
+	/* One packet stuck in the callback, a full queue, and the rest. */
+	prod.in = in;
+	prod.count = 1 + queue_size + drops;
+	prod.wait_blocked = TRUE;
+	thread = g_thread_new("producer", bus_producer_thread, &prod);
+	g_thread_join(thread);
+
+	fail_unless(sr_session_bus_stats_get(sess, &stats) == SR_OK);
+	fail_unless(stats.dropped == drops, "Dropped %" PRIu64 " packets.",
+			stats.dropped);
+	fail_unless(stats.queue_depth == queue_size,
+			"Queue depth is %" PRIu64 ".", stats.queue_depth);
+	fail_unless(stats.max_queue_depth == queue_size,
+			"Max queue depth is %" PRIu64 ".", stats.max_queue_depth);
+
+	g_mutex_lock(&bus_mutex);
+	bus_hold = FALSE;
+	g_cond_broadcast(&bus_cond);
+	g_mutex_unlock(&bus_mutex);
+	bus_session_end(sess, in);
+
+	fail_unless(bus_seqs->len == 1 + queue_size, "Got %u packets.",
+			bus_seqs->len);
+	for (i = 0; i < bus_seqs->len; i++) {
+		fail_unless(g_array_index(bus_seqs, uint32_t, i) == i,
+				"Packet %u has sequence number %u.", i,
+				g_array_index(bus_seqs, uint32_t, i));
+	}
+	fail_unless(sr_session_bus_stats_get(sess, &stats) == SR_OK);
+	fail_unless(stats.dropped == drops);
+
+	bus_session_free(sess, in);
+}
+END_TEST
+
+/*
+ * Check that a blocking bus delivers everything in order to a slow
+ * consumer, and that stopping the session drains the queue.
+ */
+START_TEST(test_session_async_order)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct sr_session_bus_stats stats;
+	struct bus_producer prod;
+	GThread *thread;
+	uint32_t i;
+	const uint32_t queue_size = 16, count = 2000;
+
+	sess = bus_session_new(queue_size, FALSE, &in);
+	bus_delay = 200;
+
+	prod.in = in;
+	prod.count = count;
+	prod.wait_blocked = FALSE;
+	thread = g_thread_new("producer", bus_producer_thread, &prod);
+	g_thread_join(thread);
+	bus_session_end(sess, in);
+
+	fail_unless(bus_seqs->len == count, "Got %u packets.", bus_seqs->len);
+	for (i = 0; i < count; i++) {
+		fail_unless(g_array_index(bus_seqs, uint32_t, i) == i,
+				"Packet %u has sequence number %u.", i,
+				g_array_index(bus_seqs, uint32_t, i));
+	}
+	fail_unless(sr_session_bus_stats_get(sess, &stats) == SR_OK);
+	fail_unless(stats.dropped == 0, "Dropped %" PRIu64 " packets.",
+			stats.dropped);
+	fail_unless(stats.queue_depth == 0, "Queue depth is %" PRIu64 ".",
+			stats.queue_depth);
+	fail_unless(stats.max_queue_depth <= queue_size,
+			"Max queue depth is %" PRIu64 ".", stats.max_queue_depth);
+
+	bus_session_free(sess, in);
+}
+END_TEST
+#endif
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -210,5 +552,16 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("async");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_async_set);
+	tcase_add_test(tc, test_session_async_bogus);
+	tcase_add_test(tc, test_session_usb_thread_set);
+#ifdef HAVE_HW_DEMO
+	tcase_add_test(tc, test_session_async_drop);
+	tcase_add_test(tc, test_session_async_order);
+#endif
+	suite_add_tcase(s, tc);
+
 	return s;
 }
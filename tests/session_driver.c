@@ -0,0 +1,426 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* 8 channels, in chunks of 1000 samples, more than there are readers. */
+#define NUM_SAMPLES 20000
+#define CHUNK_SAMPLES 1000
+#define PACKET_SAMPLES 4096
+
+static uint8_t *samples;
+static GByteArray *received;
+static gboolean seen_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_END) {
+		fail_unless(!seen_end, "SR_DF_END was sent twice.");
+		seen_end = TRUE;
+	}
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	fail_unless(!seen_end, "Got data after SR_DF_END.");
+	fail_unless(logic->unitsize == 1, "Got unit size %u.", logic->unitsize);
+	g_byte_array_append(received, logic->data, logic->length);
+}
+
+static struct sr_dev_inst *capture_sdi;
+
+/*
+ * Start a capture through the srzip output, with the given flush interval
+ * in ms. The samples don't compress, so each chunk is stored with about
+ * as many bytes as it has samples.
+ */
+static const struct sr_output *capture_open(char **filename,
+		uint32_t flush_interval)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GHashTable *options;
+	GString *out;
+	char *name;
+	uint32_t x;
+	int fd, i;
+
+	x = 1;
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		x = x * 1103515245 + 12345;
+		samples[i] = x >> 16;
+	}
+
+	capture_sdi = sr_dev_inst_user_new("Test", "Capture", NULL);
+	for (i = 0; i < 8; i++) {
+		name = g_strdup_printf("D%d", i);
+		sr_dev_inst_channel_add(capture_sdi, i, SR_CHANNEL_LOGIC, name);
+		g_free(name);
+	}
+
+	fd = g_file_open_tmp("session-driver-XXXXXX.sr", filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	g_close(fd, NULL);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("chunksize"),
+			g_variant_ref_sink(g_variant_new_uint64(CHUNK_SAMPLES)));
+	g_hash_table_insert(options, g_strdup("flush-interval"),
+			g_variant_ref_sink(g_variant_new_uint32(flush_interval)));
+	o = sr_output_new(sr_output_find("srzip"), options, capture_sdi,
+			*filename);
+	fail_unless(o != NULL, "Couldn't create srzip output.");
+	g_hash_table_destroy(options);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	out = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	return o;
+}
+
+/* Send samples start to end of the capture. */
+static void capture_send(const struct sr_output *o, int start, int end)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+	int i;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	for (i = start; i < end; i += PACKET_SAMPLES) {
+		logic.length = MIN(PACKET_SAMPLES, end - i);
+		logic.data = samples + i;
+		out = NULL;
+		fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+		fail_unless(out == NULL);
+	}
+}
+
+static void capture_close(const struct sr_output *o)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	out = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	fail_unless(out == NULL);
+
+	sr_output_free(o);
+	srtest_dev_inst_free(capture_sdi);
+}
+
+/* Write a whole capture of NUM_SAMPLES samples, return the file name. */
+static char *capture_write(void)
+{
+	const struct sr_output *o;
+	char *filename;
+
+	o = capture_open(&filename, 0);
+	capture_send(o, 0, NUM_SAMPLES);
+	capture_close(o);
+
+	return filename;
+}
+
+/*
+ * Check for a zip entry named name in the local (PK\3\4) or central
+ * (PK\1\2) header at pos, with its name length stored at len_offset.
+ */
+static gboolean header_match(const uint8_t *buf, gsize len, gsize pos,
+		const uint8_t *sig, gsize len_offset, gsize name_offset,
+		const char *name)
+{
+	gsize name_len;
+
+	name_len = strlen(name);
+	if (pos + name_offset + name_len > len || memcmp(buf + pos, sig, 4))
+		return FALSE;
+	if ((gsize)(buf[pos + len_offset] | buf[pos + len_offset + 1] << 8)
+			!= name_len)
+		return FALSE;
+
+	return !memcmp(buf + pos + name_offset, name, name_len);
+}
+
+/*
+ * Patch the zip entry name in the file. With a new name, the entry is
+ * renamed. Without one, a few bytes of its data are inverted, which
+ * breaks either its compression or its checksum.
+ */
+static void capture_patch(const char *filename, const char *name,
+		const char *new_name)
+{
+	static const uint8_t local_sig[] = { 'P', 'K', 3, 4 };
+	static const uint8_t central_sig[] = { 'P', 'K', 1, 2 };
+	uint8_t *buf;
+	gsize len, pos, name_len, data;
+	int i, found;
+
+	fail_unless(g_file_get_contents(filename, (char **)&buf, &len, NULL));
+
+	name_len = strlen(name);
+	found = 0;
+	for (pos = 0; pos < len; pos++) {
+		if (header_match(buf, len, pos, central_sig, 28, 46, name)) {
+			if (new_name)
+				memcpy(buf + pos + 46, new_name, name_len);
+			found++;
+		}
+		if (header_match(buf, len, pos, local_sig, 26, 30, name)) {
+			if (new_name) {
+				memcpy(buf + pos + 30, new_name, name_len);
+			} else {
+				data = pos + 30 + name_len
+					+ (buf[pos + 28] | buf[pos + 29] << 8);
+				fail_unless(data + 20 <= len);
+				for (i = 10; i < 20; i++)
+					buf[data + i] ^= 0xff;
+			}
+			found++;
+		}
+	}
+	fail_unless(found == 2, "Found %s in %d headers.", name, found);
+
+	fail_unless(g_file_set_contents(filename, (char *)buf, len, NULL));
+	g_free(buf);
+}
+
+/*
+ * Load the capture file into a new session and run it, with the given
+ * offset and sample limit (0 for none). Returns what sr_session_run()
+ * returned, or the sr_session_start() error.
+ */
+static int capture_run(const char *filename, uint64_t offset,
+		uint64_t limit)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GSList *devlist;
+	int ret;
+
+	received = g_byte_array_new();
+	seen_end = FALSE;
+
+	fail_unless(sr_session_load(srtest_ctx, filename, &session) == SR_OK,
+		"Failed to load %s.", filename);
+	devlist = NULL;
+	sr_session_dev_list(session, &devlist);
+	fail_unless(g_slist_length(devlist) == 1);
+	sdi = devlist->data;
+	g_slist_free(devlist);
+
+	if (offset) {
+		fail_unless(sr_config_set(sdi, NULL, SR_CONF_CAPTURE_OFFSET,
+				g_variant_new_uint64(offset)) == SR_OK);
+	}
+	if (limit) {
+		fail_unless(sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+				g_variant_new_uint64(limit)) == SR_OK);
+	}
+
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	if ((ret = sr_session_start(session)) == SR_OK) {
+		ret = sr_session_run(session);
+		fail_unless(seen_end, "No SR_DF_END was sent.");
+	}
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+static void check_received(uint64_t offset, uint64_t num_samples)
+{
+	uint64_t i;
+
+	fail_unless(received->len == num_samples, "Got %u samples, "
+		"expected %" PRIu64 ".", received->len, num_samples);
+	for (i = 0; i < num_samples; i++) {
+		fail_unless(received->data[i] == samples[offset + i],
+			"Sample %" PRIu64 " is 0x%02x, expected 0x%02x.",
+			offset + i, received->data[i], samples[offset + i]);
+	}
+	g_byte_array_free(received, TRUE);
+}
+
+static void setup(void)
+{
+	srtest_setup();
+	samples = g_malloc(NUM_SAMPLES);
+}
+
+static void teardown(void)
+{
+	g_free(samples);
+	srtest_teardown();
+}
+
+/*
+ * Check that all chunks are indexed and their samples arrive in order,
+ * though several threads read them.
+ */
+START_TEST(test_session_driver_order)
+{
+	char *filename;
+
+	filename = capture_write();
+	fail_unless(capture_run(filename, 0, 0) == SR_OK);
+	check_received(0, NUM_SAMPLES);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check that chunks end at the first one missing from the file. */
+START_TEST(test_session_driver_missing_chunk)
+{
+	char *filename;
+
+	filename = capture_write();
+	capture_patch(filename, "logic-1-5", "logic-1-x");
+	fail_unless(capture_run(filename, 0, 0) == SR_OK);
+	check_received(0, 4 * CHUNK_SAMPLES);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check that the offset and sample limit trim the capture. */
+START_TEST(test_session_driver_offset)
+{
+	char *filename;
+
+	filename = capture_write();
+
+	/* Starting in the middle of a chunk, ending in another one. */
+	fail_unless(capture_run(filename, 2500, 3000) == SR_OK);
+	check_received(2500, 3000);
+
+	/* Starting on a chunk boundary. */
+	fail_unless(capture_run(filename, 3 * CHUNK_SAMPLES, 10) == SR_OK);
+	check_received(3 * CHUNK_SAMPLES, 10);
+
+	/* A limit beyond the end of the capture. */
+	fail_unless(capture_run(filename, NUM_SAMPLES - 500,
+			NUM_SAMPLES) == SR_OK);
+	check_received(NUM_SAMPLES - 500, 500);
+
+	/* An offset beyond it. */
+	fail_unless(capture_run(filename, NUM_SAMPLES, 0) != SR_OK);
+	check_received(0, 0);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check that a chunk which can't be read fails the acquisition, after
+ * sending the samples before it and SR_DF_END.
+ */
+START_TEST(test_session_driver_read_error)
+{
+	char *filename;
+	unsigned int i;
+
+	filename = capture_write();
+	capture_patch(filename, "logic-1-3", NULL);
+	fail_unless(capture_run(filename, 0, 0) == SR_ERR_IO);
+	fail_unless(received->len <= 3 * CHUNK_SAMPLES,
+		"Got %u samples past the broken chunk.", received->len);
+	for (i = 0; i < MIN(received->len, 2 * CHUNK_SAMPLES); i++)
+		fail_unless(received->data[i] == samples[i]);
+	g_byte_array_free(received, TRUE);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check that the file written so far is a valid session after each flush
+ * interval, before SR_DF_END.
+ */
+START_TEST(test_session_driver_checkpoint)
+{
+	const struct sr_output *o;
+	char *filename;
+
+	o = capture_open(&filename, 1);
+	capture_send(o, 0, 5000);
+	g_usleep(2000);
+	/* The interval is over, this writes out all samples so far. */
+	capture_send(o, 5000, 5001);
+	fail_unless(capture_run(filename, 0, 0) == SR_OK);
+	check_received(0, 5001);
+
+	capture_send(o, 5001, NUM_SAMPLES);
+	capture_close(o);
+	fail_unless(capture_run(filename, 0, 0) == SR_OK);
+	check_received(0, NUM_SAMPLES);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+Suite *suite_session_driver(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("session-driver");
+
+	tc = tcase_create("read");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_session_driver_order);
+	tcase_add_test(tc, test_session_driver_missing_chunk);
+	tcase_add_test(tc, test_session_driver_offset);
+	tcase_add_test(tc, test_session_driver_read_error);
+	tcase_add_test(tc, test_session_driver_checkpoint);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
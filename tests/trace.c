@@ -0,0 +1,202 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_THREAD_EVENTS 1000
+
+static gpointer record_thread(gpointer data)
+{
+	int i;
+
+	(void)data;
+
+	for (i = 0; i < NUM_THREAD_EVENTS; i++)
+		sr_trace_record(SR_TRACE_USER + 1, i, -i);
+
+	return NULL;
+}
+
+/* Check whether events are only recorded while tracing is enabled. */
+START_TEST(test_trace_enable)
+{
+	struct sr_trace_event *events;
+	size_t num_events;
+
+	fail_unless(sr_trace_get() == FALSE, "Tracing enabled by default.");
+	sr_trace_clear();
+	sr_trace_record(SR_TRACE_USER, 1, 2);
+
+	fail_unless(sr_trace_set(TRUE) == SR_OK);
+	fail_unless(sr_trace_get() == TRUE);
+	sr_trace_record(SR_TRACE_USER, 3, 4);
+	sr_trace_set(FALSE);
+	sr_trace_record(SR_TRACE_USER, 5, 6);
+
+	fail_unless(sr_trace_events_get(&events, &num_events) == SR_OK);
+	fail_unless(num_events == 1, "Got %zu events.", num_events);
+	fail_unless(events[0].id == SR_TRACE_USER);
+	fail_unless(events[0].arg1 == 3 && events[0].arg2 == 4);
+	g_free(events);
+
+	sr_trace_clear();
+	fail_unless(sr_trace_events_get(&events, &num_events) == SR_OK);
+	fail_unless(num_events == 0 && events == NULL);
+
+	fail_unless(sr_trace_events_get(NULL, &num_events) == SR_ERR_ARG);
+	fail_unless(sr_trace_events_get(&events, NULL) == SR_ERR_ARG);
+}
+END_TEST
+
+/* Check whether the events of several threads are merged in time order. */
+START_TEST(test_trace_threads)
+{
+	struct sr_trace_event *events;
+	GThread *thread;
+	size_t num_events, i, n[2];
+	int64_t expected[2];
+	uint32_t main_thread;
+
+	sr_trace_clear();
+	sr_trace_set(TRUE);
+	thread = g_thread_new("trace", record_thread, NULL);
+	for (i = 0; i < NUM_THREAD_EVENTS; i++)
+		sr_trace_record(SR_TRACE_USER, i, i);
+	g_thread_join(thread);
+	sr_trace_set(FALSE);
+
+	fail_unless(sr_trace_events_get(&events, &num_events) == SR_OK);
+	fail_unless(num_events == 2 * NUM_THREAD_EVENTS,
+			"Got %zu events.", num_events);
+	n[0] = n[1] = 0;
+	expected[0] = expected[1] = 0;
+	main_thread = G_MAXUINT32;
+	for (i = 0; i < num_events; i++) {
+		if (events[i].id == SR_TRACE_USER && main_thread == G_MAXUINT32)
+			main_thread = events[i].thread;
+	}
+	for (i = 0; i < num_events; i++) {
+		if (i > 0)
+			fail_unless(events[i].time >= events[i - 1].time);
+		/* Each thread's events are in order. */
+		if (events[i].id == SR_TRACE_USER) {
+			fail_unless(events[i].thread == main_thread);
+			fail_unless(events[i].arg1 == expected[0]++);
+			n[0]++;
+		} else {
+			fail_unless(events[i].id == SR_TRACE_USER + 1);
+			fail_unless(events[i].thread != main_thread);
+			fail_unless(events[i].arg2 == -expected[1]++);
+			n[1]++;
+		}
+	}
+	fail_unless(n[0] == NUM_THREAD_EVENTS && n[1] == NUM_THREAD_EVENTS);
+	g_free(events);
+}
+END_TEST
+
+/* Check whether a full ring keeps the most recent events. */
+START_TEST(test_trace_wrap)
+{
+	struct sr_trace_event *events;
+	size_t num_events, i;
+	int64_t total;
+
+	total = 100000;
+	sr_trace_clear();
+	sr_trace_set(TRUE);
+	for (i = 0; i < (size_t)total; i++)
+		sr_trace_record(SR_TRACE_USER, i, 0);
+	sr_trace_set(FALSE);
+
+	fail_unless(sr_trace_events_get(&events, &num_events) == SR_OK);
+	fail_unless(num_events > 0 && num_events < (size_t)total);
+	for (i = 0; i < num_events; i++)
+		fail_unless(events[i].arg1 == total - (int64_t)num_events + (int64_t)i);
+	g_free(events);
+}
+END_TEST
+
+/* Check whether a dump has a line per event. */
+START_TEST(test_trace_dump)
+{
+	char *filename, *contents, **lines, *expected;
+	int fd;
+
+	fail_unless(sr_trace_event_name(SR_TRACE_SESSION_SEND) != NULL);
+	fail_unless(sr_trace_event_name(0) == NULL);
+	fail_unless(sr_trace_event_name(SR_TRACE_USER) == NULL);
+
+	sr_trace_clear();
+	sr_trace_set(TRUE);
+	sr_trace_record(SR_TRACE_SESSION_SEND, SR_DF_LOGIC, 4096);
+	sr_trace_record(SR_TRACE_USER, -1, 1);
+	sr_trace_set(FALSE);
+
+	fd = g_file_open_tmp("trace-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0);
+	g_close(fd, NULL);
+	fail_unless(sr_trace_dump(filename) == SR_OK);
+	fail_unless(g_file_get_contents(filename, &contents, NULL, NULL));
+	lines = g_strsplit(contents, "\n", 0);
+	fail_unless(g_strv_length(lines) == 4, "Dump: %s", contents);
+	fail_unless(lines[0][0] == '#');
+	/* Times are relative to the first event. */
+	expected = g_strdup_printf(" session_send %d 4096", SR_DF_LOGIC);
+	fail_unless(g_str_has_prefix(lines[1], "0 ")
+			&& g_str_has_suffix(lines[1], expected),
+			"Got '%s'.", lines[1]);
+	g_free(expected);
+	expected = g_strdup_printf(" %d -1 1", SR_TRACE_USER);
+	fail_unless(g_str_has_suffix(lines[2], expected),
+			"Got '%s'.", lines[2]);
+	g_free(expected);
+	fail_unless(lines[3][0] == '\0');
+	g_strfreev(lines);
+	g_free(contents);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(sr_trace_dump(NULL) == SR_ERR_ARG);
+}
+END_TEST
+
+Suite *suite_trace(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("trace");
+
+	tc = tcase_create("record");
+	tcase_add_test(tc, test_trace_enable);
+	tcase_add_test(tc, test_trace_threads);
+	tcase_add_test(tc, test_trace_wrap);
+	tcase_add_test(tc, test_trace_dump);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
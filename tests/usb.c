@@ -0,0 +1,327 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Tests for the USB event thread, which reaps transfers on a thread of
+ * its own and hands them to the session thread. This is a program of its
+ * own, linking usb.c directly to reach its private functions. The libusb
+ * event handling functions are replaced by fakes which complete every
+ * submitted transfer in order, so no device is needed.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <check.h>
+#include <glib.h>
+#include <libusb.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "private.h"
+
+#define NUM_TRANSFERS 4
+#define NUM_ROUNDS 3
+
+/* The session functions usb.c uses, attaching to a context of our own. */
+static GMainContext *test_context;
+
+SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
+		void *key, GSource *source)
+{
+	g_hash_table_insert(session->event_sources, key, source);
+	g_source_attach(source, test_context);
+
+	return SR_OK;
+}
+
+SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
+		void *key)
+{
+	g_source_destroy(g_hash_table_lookup(session->event_sources, key));
+
+	return SR_OK;
+}
+
+SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
+		void *key, GSource *source)
+{
+	fail_unless(g_hash_table_lookup(session->event_sources, key) == source);
+	g_hash_table_remove(session->event_sources, key);
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_usb_dev_inst *sr_usb_dev_inst_new(uint8_t bus,
+		uint8_t address, struct libusb_device_handle *hdl)
+{
+	struct sr_usb_dev_inst *udi;
+
+	udi = g_malloc0(sizeof(struct sr_usb_dev_inst));
+	udi->bus = bus;
+	udi->address = address;
+	udi->devhdl = hdl;
+
+	return udi;
+}
+
+/* Submitted transfers, completed in order by the event handling fake. */
+static GAsyncQueue *submitted;
+
+const struct libusb_pollfd **LIBUSB_CALL libusb_get_pollfds(
+		libusb_context *ctx)
+{
+	(void)ctx;
+
+	return calloc(1, sizeof(struct libusb_pollfd *));
+}
+
+#if (LIBUSB_API_VERSION >= 0x01000104)
+void LIBUSB_CALL libusb_free_pollfds(const struct libusb_pollfd **pollfds)
+{
+	free(pollfds);
+}
+#endif
+
+void LIBUSB_CALL libusb_set_pollfd_notifiers(libusb_context *ctx,
+		libusb_pollfd_added_cb added_cb,
+		libusb_pollfd_removed_cb removed_cb, void *user_data)
+{
+	(void)ctx;
+	(void)added_cb;
+	(void)removed_cb;
+	(void)user_data;
+}
+
+int LIBUSB_CALL libusb_get_next_timeout(libusb_context *ctx,
+		struct timeval *tv)
+{
+	(void)ctx;
+	(void)tv;
+
+	return 0;
+}
+
+#if (LIBUSB_API_VERSION >= 0x01000105)
+void LIBUSB_CALL libusb_interrupt_event_handler(libusb_context *ctx)
+{
+	(void)ctx;
+}
+#endif
+
+int LIBUSB_CALL libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	g_async_queue_push(submitted, transfer);
+
+	return 0;
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout_completed(libusb_context *ctx,
+		struct timeval *tv, int *completed)
+{
+	struct libusb_transfer *transfer;
+
+	(void)ctx;
+	(void)completed;
+
+	transfer = g_async_queue_timeout_pop(submitted,
+			tv->tv_sec * G_USEC_PER_SEC + tv->tv_usec);
+	if (transfer) {
+		transfer->status = LIBUSB_TRANSFER_COMPLETED;
+		transfer->actual_length = transfer->length;
+		transfer->callback(transfer);
+	}
+
+	return 0;
+}
+
+static struct sr_context ctx;
+static struct sr_session *session;
+static GThread *session_thread;
+static GArray *completions;
+static unsigned int dispatches;
+
+/* The driver's transfer callback, resubmitting for a few rounds. */
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *transfer)
+{
+	int index;
+
+	fail_unless(g_thread_self() == session_thread,
+		"Callback called from another thread.");
+	fail_unless(transfer->status == LIBUSB_TRANSFER_COMPLETED);
+
+	index = GPOINTER_TO_INT(transfer->user_data);
+	g_array_append_val(completions, index);
+	if (completions->len <= NUM_TRANSFERS * (NUM_ROUNDS - 1))
+		fail_unless(usb_submit_transfer(session, transfer) == 0);
+}
+
+static int receive_data(int fd, int revents, void *cb_data)
+{
+	(void)fd;
+	(void)cb_data;
+
+	fail_unless(revents == G_IO_IN, "Got revents 0x%x.", revents);
+	dispatches++;
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void setup(void)
+{
+	test_context = g_main_context_new();
+	submitted = g_async_queue_new();
+	completions = g_array_new(FALSE, FALSE, sizeof(int));
+	dispatches = 0;
+	session_thread = g_thread_self();
+
+	/* Never dereferenced, since libusb event handling is faked. */
+	ctx.libusb_ctx = (struct libusb_context *)&ctx;
+	session = g_malloc0(sizeof(struct sr_session));
+	session->ctx = &ctx;
+	session->event_sources = g_hash_table_new(NULL, NULL);
+	session->usb_thread = TRUE;
+}
+
+static void teardown(void)
+{
+	g_hash_table_unref(session->event_sources);
+	g_slist_free(session->devs);
+	g_free(session);
+	g_array_free(completions, TRUE);
+	g_async_queue_unref(submitted);
+	g_main_context_unref(test_context);
+}
+
+static struct libusb_transfer *transfer_new(int index)
+{
+	struct libusb_transfer *transfer;
+
+	transfer = g_malloc0(sizeof(struct libusb_transfer));
+	transfer->callback = transfer_done;
+	transfer->user_data = GINT_TO_POINTER(index);
+
+	return transfer;
+}
+
+/*
+ * Submit transfers and run the main loop until all rounds are done.
+ * Returns whether the transfers went through the event thread.
+ */
+static gboolean run_transfers(void)
+{
+	struct libusb_transfer *transfers[NUM_TRANSFERS];
+	gboolean deferred;
+	int i;
+
+	fail_unless(usb_source_add(session, &ctx, -1, receive_data,
+			NULL) == SR_OK);
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		transfers[i] = transfer_new(i);
+		fail_unless(usb_submit_transfer(session, transfers[i]) == 0);
+	}
+	/* The callback is swapped only while the transfer is deferred. */
+	deferred = transfers[0]->callback != transfer_done;
+
+	if (deferred) {
+		while (completions->len < NUM_TRANSFERS * NUM_ROUNDS)
+			g_main_context_iteration(test_context, TRUE);
+	} else {
+		/* Nobody reaps them, the fake libusb still has them. */
+		for (i = 0; i < NUM_TRANSFERS; i++)
+			fail_unless(g_async_queue_pop(submitted) == transfers[i]);
+	}
+
+	fail_unless(usb_source_remove(session, &ctx) == SR_OK);
+	fail_unless(g_hash_table_size(session->event_sources) == 0,
+		"The USB source wasn't finalized.");
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		fail_unless(transfers[i]->callback == transfer_done);
+		fail_unless(transfers[i]->user_data == GINT_TO_POINTER(i));
+		g_free(transfers[i]);
+	}
+
+	return deferred;
+}
+
+/*
+ * Check that completions reaped by the event thread are handed to the
+ * session thread in the order they completed, resubmissions included.
+ */
+START_TEST(test_usb_deferred)
+{
+	unsigned int i;
+
+	fail_unless(run_transfers(), "Transfers weren't deferred.");
+	fail_unless(completions->len == NUM_TRANSFERS * NUM_ROUNDS);
+	for (i = 0; i < completions->len; i++) {
+		fail_unless(g_array_index(completions, int, i)
+			== (int)(i % NUM_TRANSFERS),
+			"Completion %u is of transfer %d.", i,
+			g_array_index(completions, int, i));
+	}
+	fail_unless(dispatches > 0, "The source callback wasn't called.");
+}
+END_TEST
+
+/* Check that transfers aren't deferred with the thread switched off. */
+START_TEST(test_usb_deferred_disabled)
+{
+	session->usb_thread = FALSE;
+	fail_unless(!run_transfers(), "Transfers were deferred.");
+}
+END_TEST
+
+/*
+ * Check that the thread isn't started while the session holds a USB
+ * device whose driver submits transfers without usb_submit_transfer().
+ */
+START_TEST(test_usb_deferred_unsupported)
+{
+	struct sr_dev_driver driver = { 0 };
+	struct drv_context drvc = { 0 };
+	struct sr_dev_inst sdi = { 0 };
+
+	driver.context = &drvc;
+	sdi.driver = &driver;
+	sdi.inst_type = SR_INST_USB;
+	session->devs = g_slist_append(NULL, &sdi);
+
+	fail_unless(!usb_event_thread_supported(&sdi));
+	fail_unless(!run_transfers(), "Transfers were deferred.");
+
+	drvc.usb_event_thread = TRUE;
+	fail_unless(usb_event_thread_supported(&sdi));
+	fail_unless(run_transfers(), "Transfers weren't deferred.");
+}
+END_TEST
+
+Suite *suite_private(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("usb");
+
+	tc = tcase_create("deferred");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_usb_deferred);
+	tcase_add_test(tc, test_usb_deferred_disabled);
+	tcase_add_test(tc, test_usb_deferred_unsupported);
+	suite_add_tcase(s, tc);
+
+	return s;
+}